@@ -0,0 +1,38 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// errors: [n][plane][outrow][outcol]
+// selectors: [n][plane][outrow][outcol], one byte each
+// errorsForUpstream: [n][plane][inrow][incol]
+// one thread per: [n][plane][inrow][incol], ie per upstream error, rather than
+// per pooled error, as in backprop_errors
+// so every upstream error is written exactly once, by neighbouring threads, to
+// neighbouring addresses, and there's no need to zero errorsForUpstream first.
+// the threads of one pooling window all read the same selector and error
+kernel void backprop_errors_gather( const int batchSize,
+    global const float *errors, global const uchar *selectors, global float *errorsForUpstream ) {
+    const int globalId = get_global_id(0);
+    if( globalId >= batchSize * gNumPlanes * gInputImageSizeSquared ) {
+        return;
+    }
+    const int plane2d = globalId / gInputImageSizeSquared;
+    const int inputPos = globalId % gInputImageSizeSquared;
+    const int inputRow = inputPos / gInputImageSize;
+    const int inputCol = inputPos % gInputImageSize;
+    const int outputRow = inputRow / gPoolingSize;
+    const int outputCol = inputCol / gPoolingSize;
+
+    float error = 0.0f;
+    // without padZeros, the last rows and cols might not be in any pooling window
+    if( outputRow < gOutputImageSize && outputCol < gOutputImageSize ) {
+        const int resultIndex = ( plane2d * gOutputImageSize + outputRow ) * gOutputImageSize + outputCol;
+        const int thisSelector = ( inputRow - outputRow * gPoolingSize ) * gPoolingSize + inputCol - outputCol * gPoolingSize;
+        const float pooledError = errors[resultIndex];
+        error = selectors[resultIndex] == thisSelector ? pooledError : 0.0f;
+    }
+    errorsForUpstream[globalId] = error;
+}
+
@@ -6,13 +6,13 @@
 
 // inplane and outplane are always identical, 1:1 mapping, so can just write `plane`
 // errors: [n][plane][outrow][outcol]
-// selectors: [n][plane][outrow][outcol]
+// selectors: [n][plane][outrow][outcol], one byte each
 // errorsForUpstream: [n][plane][inrow][incol]
 // wont use workgroups (since 'naive')
 // one thread per: [n][plane][outrow][outcol]
 // globalId: [n][plane][outrow][outcol]
 kernel void backprop_errors( const int batchSize, 
-    global const float *errors, global const int *selectors, global float *errorsForUpstream ) {
+    global const float *errors, global const uchar *selectors, global float *errorsForUpstream ) {
 
     #define globalId get_global_id(0)
     #define nPlaneCombo ( globalId / gOutputImageSizeSquared ) 
@@ -6,13 +6,40 @@
 
 // expected defines:
 // one of: [ TANH | RELU | LINEAR | SIGMOID | SCALEDTANH ]
+// optional: FAST_MATH, to use approximations in place of tanh and exp
+
+#ifdef FAST_MATH
+// same approximation as FastMath::tanh, 13/6 rational, max error 5e-7
+float approx_tanh( float x ) {
+    x = clamp( x, -7.90531111f, 7.90531111f );
+    const float x2 = x * x;
+    float p = -2.76076847742355e-16f;
+    p = p * x2 + 2.00018790482477e-13f;
+    p = p * x2 - 8.60467152213735e-11f;
+    p = p * x2 + 5.12229709037114e-08f;
+    p = p * x2 + 1.48572235717979e-05f;
+    p = p * x2 + 6.37261928875436e-04f;
+    p = p * x2 + 4.89352455891786e-03f;
+    p = p * x;
+    float q = 1.19825839466702e-06f;
+    q = q * x2 + 1.18534705686654e-04f;
+    q = q * x2 + 2.26843463243900e-03f;
+    q = q * x2 + 4.89352518554385e-03f;
+    return p / q;
+}
+    #define TANH_FUNCTION(x) (approx_tanh(x))
+    #define SIGMOID_FUNCTION(x) (0.5f + 0.5f * approx_tanh(0.5f * (x)))
+#else
+    #define TANH_FUNCTION(x) (tanh(x))
+    #define SIGMOID_FUNCTION(x) (1.0f / (1 + exp(-(x))))
+#endif
 
 #ifdef TANH
-    #define ACTIVATION_FUNCTION(output) (tanh(output))
+    #define ACTIVATION_FUNCTION(output) (TANH_FUNCTION(output))
 #elif defined SCALEDTANH
-    #define ACTIVATION_FUNCTION(output) ( 1.7159f * tanh( 0.66667f * output))
+    #define ACTIVATION_FUNCTION(output) ( 1.7159f * TANH_FUNCTION( 0.66667f * output))
 #elif SIGMOID
-    #define ACTIVATION_FUNCTION(output) (1.0f / (1 + exp(-output)))
+    #define ACTIVATION_FUNCTION(output) (SIGMOID_FUNCTION(output))
 #elif defined RELU
     #define ACTIVATION_FUNCTION(output) (output> 0 ? output : 0)
 #elif defined LINEAR
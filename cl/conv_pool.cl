@@ -0,0 +1,125 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// convolution, bias, activation and max-pooling in one pass: each thread works
+// out the conv results for one pooling window, keeping only the max, so the
+// conv results are never written out
+//
+// expected defines:
+//  - the defines from LayerDimensions::buildOptionsString()
+//  - gPoolingSize, gPooledImageSize
+//  - BIASED (or not)
+//  - one of: [ TANH | RELU | LINEAR | SIGMOID | SCALEDTANH ]
+//  - optional: FAST_MATH, to use the same approximations as activate.cl
+//
+// images are organized like [n][inPlane][inRow][inCol]
+// filters are organized like [filter][inPlane][filterRow][filterCol]
+// pooled and selectors are organized like [n][filter][pooledRow][pooledCol]
+// global id is organized like pooled
+// selectors, one byte each, are only written if writeSelectors is 1, ie if we will backprop
+
+#ifdef FAST_MATH
+// same approximation as FastMath::tanh, 13/6 rational, max error 5e-7
+float approx_tanh( float x ) {
+    x = clamp( x, -7.90531111f, 7.90531111f );
+    const float x2 = x * x;
+    float p = -2.76076847742355e-16f;
+    p = p * x2 + 2.00018790482477e-13f;
+    p = p * x2 - 8.60467152213735e-11f;
+    p = p * x2 + 5.12229709037114e-08f;
+    p = p * x2 + 1.48572235717979e-05f;
+    p = p * x2 + 6.37261928875436e-04f;
+    p = p * x2 + 4.89352455891786e-03f;
+    p = p * x;
+    float q = 1.19825839466702e-06f;
+    q = q * x2 + 1.18534705686654e-04f;
+    q = q * x2 + 2.26843463243900e-03f;
+    q = q * x2 + 4.89352518554385e-03f;
+    return p / q;
+}
+    #define TANH_FUNCTION(x) (approx_tanh(x))
+    #define SIGMOID_FUNCTION(x) (0.5f + 0.5f * approx_tanh(0.5f * (x)))
+#else
+    #define TANH_FUNCTION(x) (tanh(x))
+    #define SIGMOID_FUNCTION(x) (1.0f / (1 + exp(-(x))))
+#endif
+
+#ifdef TANH
+    #define ACTIVATION_FUNCTION(output) (TANH_FUNCTION(output))
+#elif defined SCALEDTANH
+    #define ACTIVATION_FUNCTION(output) ( 1.7159f * TANH_FUNCTION( 0.66667f * output))
+#elif defined SIGMOID
+    #define ACTIVATION_FUNCTION(output) (SIGMOID_FUNCTION(output))
+#elif defined RELU
+    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : 0)
+#elif defined LINEAR
+    #define ACTIVATION_FUNCTION(output) (output)
+#endif
+
+#ifdef ACTIVATION_FUNCTION // protect against not defined
+kernel void conv_pool( const int batchSize, const int writeSelectors,
+        global const float *images, global const float *filters,
+        #ifdef BIASED
+        global const float *biases,
+        #endif
+        global uchar *selectors, global float *pooled ) {
+    const int globalId = get_global_id(0);
+    const int pooledImageSizeSquared = gPooledImageSize * gPooledImageSize;
+    const int n = globalId / ( gNumFilters * pooledImageSizeSquared );
+    if( n >= batchSize ) {
+        return;
+    }
+    const int filter = ( globalId / pooledImageSizeSquared ) % gNumFilters;
+    const int pooledRow = ( globalId % pooledImageSizeSquared ) / gPooledImageSize;
+    const int pooledCol = globalId % gPooledImageSize;
+    global const float *inputCube = images + n * gInputPlanes * gInputImageSizeSquared;
+    global const float *filterCube = filters + filter * gInputPlanes * gFilterSizeSquared;
+
+    float maxValue = - INFINITY;
+    int selector = 0;
+    for( int dRow = 0; dRow < gPoolingSize; dRow++ ) {
+        const int outRow = pooledRow * gPoolingSize + dRow;
+        for( int dCol = 0; dCol < gPoolingSize; dCol++ ) {
+            const int outCol = pooledCol * gPoolingSize + dCol;
+            if( outRow >= gOutputImageSize || outCol >= gOutputImageSize ) {
+                continue;
+            }
+            float sum = 0;
+            for( int inPlane = 0; inPlane < gInputPlanes; inPlane++ ) {
+                global const float *inputPlane = inputCube + inPlane * gInputImageSizeSquared;
+                global const float *filterPlane = filterCube + inPlane * gFilterSizeSquared;
+                for( int u = -gHalfFilterSize; u <= gHalfFilterSize - gEven; u++ ) {
+                    const int inRow = outRow + u + ( gPadZeros ? 0 : gHalfFilterSize );
+                    if( inRow < 0 || inRow >= gInputImageSize ) {
+                        continue;
+                    }
+                    for( int v = -gHalfFilterSize; v <= gHalfFilterSize - gEven; v++ ) {
+                        const int inCol = outCol + v + ( gPadZeros ? 0 : gHalfFilterSize );
+                        if( inCol < 0 || inCol >= gInputImageSize ) {
+                            continue;
+                        }
+                        sum += inputPlane[ inRow * gInputImageSize + inCol ]
+                            * filterPlane[ ( u + gHalfFilterSize ) * gFilterSize + v + gHalfFilterSize ];
+                    }
+                }
+            }
+            #ifdef BIASED
+            sum += biases[filter];
+            #endif
+            const float value = ACTIVATION_FUNCTION( sum );
+            if( value > maxValue ) { // first max wins, same as pooling.cl
+                maxValue = value;
+                selector = dRow * gPoolingSize + dCol;
+            }
+        }
+    }
+    pooled[globalId] = maxValue;
+    if( writeSelectors ) {
+        selectors[globalId] = (uchar)selector;
+    }
+}
+#endif
+
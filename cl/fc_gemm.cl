@@ -0,0 +1,224 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// fully-connected layers, as plain matrix multiplies
+//
+// expected defines:
+//  - gNumFilters, gInputCubeSize
+//  - gTileSize: workgroups are gTileSize * gTileSize threads, each computing one
+//    element of a gTileSize * gTileSize output tile
+//  - one of: [ TANH | RELU | LINEAR | SIGMOID | SCALEDTANH ]
+//    (activation of this layer for fc_propagate, activation of the layer below
+//    for fc_backprop_errors)
+//  - optional: FAST_MATH, to use approximations in place of tanh and exp
+//  - gGemvWorkgroupSize, a power of two: for fc_propagate_gemv only
+//
+// if we call numFilters N, and inputCubeSize K, then:
+//   images:  [n][K]   (ie [n][inputPlane][inputRow][inputCol])
+//   weights: [N][K]   (ie [filter][inputPlane][filterRow][filterCol], same as for convolution)
+//   results: [n][N]
+//   errors:  [n][N]
+//   errorsForUpstream: [n][K]
+
+#ifdef FAST_MATH
+// same approximation as FastMath::tanh, 13/6 rational, max error 5e-7
+float approx_tanh( float x ) {
+    x = clamp( x, -7.90531111f, 7.90531111f );
+    const float x2 = x * x;
+    float p = -2.76076847742355e-16f;
+    p = p * x2 + 2.00018790482477e-13f;
+    p = p * x2 - 8.60467152213735e-11f;
+    p = p * x2 + 5.12229709037114e-08f;
+    p = p * x2 + 1.48572235717979e-05f;
+    p = p * x2 + 6.37261928875436e-04f;
+    p = p * x2 + 4.89352455891786e-03f;
+    p = p * x;
+    float q = 1.19825839466702e-06f;
+    q = q * x2 + 1.18534705686654e-04f;
+    q = q * x2 + 2.26843463243900e-03f;
+    q = q * x2 + 4.89352518554385e-03f;
+    return p / q;
+}
+    #define TANH_FUNCTION(x) (approx_tanh(x))
+    #define SIGMOID_FUNCTION(x) (0.5f + 0.5f * approx_tanh(0.5f * (x)))
+#else
+    #define TANH_FUNCTION(x) (tanh(x))
+    #define SIGMOID_FUNCTION(x) (1.0f / (1 + exp(-(x))))
+#endif
+
+#ifdef TANH
+    #define ACTIVATION_FUNCTION(output) (TANH_FUNCTION(output))
+    #define ACTIVATION_DERIV(output) (1 - output * output)
+#elif defined SCALEDTANH
+    #define ACTIVATION_FUNCTION(output) ( 1.7159f * TANH_FUNCTION( 0.66667f * output))
+    #define ACTIVATION_DERIV(output) ( 0.66667f * ( 1.7159f - 1 / 1.7159f * output * output ) )
+#elif defined SIGMOID
+    #define ACTIVATION_FUNCTION(output) (SIGMOID_FUNCTION(output))
+    #define ACTIVATION_DERIV(output) (output * ( 1 - output ) )
+#elif defined RELU
+    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : 0)
+    #define ACTIVATION_DERIV(output) (output > 0 ? 1 : 0)
+#elif defined LINEAR
+    #define ACTIVATION_FUNCTION(output) (output)
+    #define ACTIVATION_DERIV(output) (1.0f)
+#endif
+
+// workgroup id organized like: [outTileRow][outTileCol]
+// local id organized like: [row within tile][col within tile]
+// numOutCols is the number of columns of the output matrix, so we can find our tile
+#define TILE_IDS( numOutCols ) \
+    const int localId = get_local_id(0); \
+    const int tx = localId % gTileSize; \
+    const int ty = localId / gTileSize; \
+    const int numTileCols = ( numOutCols + gTileSize - 1 ) / gTileSize; \
+    const int row0 = ( get_group_id(0) / numTileCols ) * gTileSize; \
+    const int col0 = ( get_group_id(0) % numTileCols ) * gTileSize;
+
+#ifdef ACTIVATION_FUNCTION // protect against not defined
+// results = activation( images . weights^T + bias )
+// output tile is [n][filter], and we reduce over K
+void kernel fc_propagate( const int batchSize,
+        global const float *images, global const float *weights,
+        #ifdef BIASED
+        global const float *biasWeights,
+        #endif
+        global float *results ) {
+    local float _images[gTileSize][gTileSize + 1];
+    local float _weights[gTileSize][gTileSize + 1];
+    TILE_IDS( gNumFilters )
+
+    const int n = row0 + ty;
+    const int filter = col0 + tx;
+    float sum = 0;
+    for( int k0 = 0; k0 < gInputCubeSize; k0 += gTileSize ) {
+        const int k = k0 + tx;
+        _images[ty][tx] = ( row0 + ty < batchSize && k < gInputCubeSize ) ? images[ ( row0 + ty ) * gInputCubeSize + k ] : 0.0f;
+        _weights[ty][tx] = ( col0 + ty < gNumFilters && k < gInputCubeSize ) ? weights[ ( col0 + ty ) * gInputCubeSize + k ] : 0.0f;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for( int kk = 0; kk < gTileSize; kk++ ) {
+            sum += _images[ty][kk] * _weights[tx][kk];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if( n < batchSize && filter < gNumFilters ) {
+        #ifdef BIASED
+        sum += biasWeights[filter];
+        #endif
+        results[ n * gNumFilters + filter ] = ACTIVATION_FUNCTION( sum );
+    }
+}
+#endif
+
+#if defined(ACTIVATION_FUNCTION) && defined(gGemvWorkgroupSize)
+// same as fc_propagate, but for batch sizes of one, or a few, where most of a
+// gTileSize * gTileSize tile would be padding: a matrix-vector multiply per image
+// one workgroup per: [n][filter].  each thread sums every gGemvWorkgroupSize'th
+// product, so neighbouring threads read neighbouring weights, then the partial
+// sums are added up in local memory
+void kernel fc_propagate_gemv( const int batchSize,
+        global const float *images, global const float *weights,
+        #ifdef BIASED
+        global const float *biasWeights,
+        #endif
+        global float *results ) {
+    local float _sums[gGemvWorkgroupSize];
+    const int localId = get_local_id(0);
+    const int n = get_group_id(0) / gNumFilters;
+    const int filter = get_group_id(0) % gNumFilters;
+
+    global const float *image = images + n * gInputCubeSize;
+    global const float *filterWeights = weights + filter * gInputCubeSize;
+    float sum = 0;
+    for( int k = localId; k < gInputCubeSize; k += gGemvWorkgroupSize ) {
+        sum += image[k] * filterWeights[k];
+    }
+    _sums[localId] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for( int stride = gGemvWorkgroupSize >> 1; stride > 0; stride >>= 1 ) {
+        if( localId < stride ) {
+            _sums[localId] += _sums[localId + stride];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if( localId == 0 ) {
+        sum = _sums[0];
+        #ifdef BIASED
+        sum += biasWeights[filter];
+        #endif
+        results[ n * gNumFilters + filter ] = ACTIVATION_FUNCTION( sum );
+    }
+}
+#endif
+
+// weights -= learningMultiplier * errors^T . images
+// output tile is [filter][k], and we reduce over n
+void kernel fc_backprop_weights( const int batchSize, const float learningMultiplier,
+        global const float *errors, global const float *images, global float *weights ) {
+    local float _errors[gTileSize][gTileSize + 1];
+    local float _images[gTileSize][gTileSize + 1];
+    TILE_IDS( gInputCubeSize )
+
+    const int filter = row0 + ty;
+    const int k = col0 + tx;
+    float sum = 0;
+    for( int n0 = 0; n0 < batchSize; n0 += gTileSize ) {
+        const int n = n0 + ty;
+        _errors[ty][tx] = ( n < batchSize && row0 + tx < gNumFilters ) ? errors[ n * gNumFilters + row0 + tx ] : 0.0f;
+        _images[ty][tx] = ( n < batchSize && k < gInputCubeSize ) ? images[ n * gInputCubeSize + k ] : 0.0f;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for( int nn = 0; nn < gTileSize; nn++ ) {
+            sum += _errors[nn][ty] * _images[nn][tx];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if( filter < gNumFilters && k < gInputCubeSize ) {
+        weights[ filter * gInputCubeSize + k ] -= learningMultiplier * sum;
+    }
+}
+
+// one thread per filter
+void kernel fc_backprop_bias( const int batchSize, const float learningMultiplier,
+        global const float *errors, global float *biasWeights ) {
+    const int filter = get_global_id(0);
+    if( filter >= gNumFilters ) {
+        return;
+    }
+    float sum = 0;
+    for( int n = 0; n < batchSize; n++ ) {
+        sum += errors[ n * gNumFilters + filter ];
+    }
+    biasWeights[filter] -= learningMultiplier * sum;
+}
+
+#ifdef ACTIVATION_DERIV // protect against not defined
+// errorsForUpstream = ( errors . weights ) * activationderiv( images )
+// output tile is [n][k], and we reduce over filters
+void kernel fc_backprop_errors( const int batchSize,
+        global const float *images, global const float *errors, global const float *weights,
+        global float *errorsForUpstream ) {
+    local float _errors[gTileSize][gTileSize + 1];
+    local float _weights[gTileSize][gTileSize + 1];
+    TILE_IDS( gInputCubeSize )
+
+    const int n = row0 + ty;
+    const int k = col0 + tx;
+    float sum = 0;
+    for( int filter0 = 0; filter0 < gNumFilters; filter0 += gTileSize ) {
+        _errors[ty][tx] = ( n < batchSize && filter0 + tx < gNumFilters ) ? errors[ n * gNumFilters + filter0 + tx ] : 0.0f;
+        _weights[ty][tx] = ( filter0 + ty < gNumFilters && k < gInputCubeSize ) ? weights[ ( filter0 + ty ) * gInputCubeSize + k ] : 0.0f;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        for( int ff = 0; ff < gTileSize; ff++ ) {
+            sum += _errors[ty][ff] * _weights[ff][tx];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if( n < batchSize && k < gInputCubeSize ) {
+        const int index = n * gInputCubeSize + k;
+        errorsForUpstream[index] = sum * ACTIVATION_DERIV( images[index] );
+    }
+}
+#endif
+
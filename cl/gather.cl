@@ -0,0 +1,27 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// builds one batch from a dataset that is already resident on the device
+// indices holds the example index, within data, of each example in the batch
+// each value is converted to float, and normalized, as it is copied, ie:
+//     batch = ( data + translate ) * scale
+// which is the same transform as NormalizationLayer
+//
+// globalid is: [n][cubeoffset], where n is the index within the batch
+// one thread per output float, so reads are coalesced within each example
+// needs gCubeSize
+kernel void gatherNormalize( const int batchSize, global const int *indices, global const unsigned char *data,
+        global float *batch, const float translate, const float scale ) {
+    const int globalId = get_global_id(0);
+    if( globalId >= batchSize * gCubeSize ) {
+        return;
+    }
+    const int n = globalId / gCubeSize;
+    const int cubeOffset = globalId % gCubeSize;
+    const int example = indices[n];
+    batch[globalId] = ( (float)data[ example * gCubeSize + cubeOffset ] + translate ) * scale;
+}
+
@@ -7,7 +7,8 @@
 // every plane is independent
 // every example is independent
 // so, globalid can be: [n][plane][outputRow][outputCol]
-kernel void propagateNaive( const int batchSize, global const float *input, global int *selectors, global float *output ) {
+// selectors are bytes, since they are less than gPoolingSize * gPoolingSize
+kernel void propagateNaive( const int batchSize, global const float *input, global uchar *selectors, global float *output ) {
     const int globalId = get_global_id(0);
 
     const int intraImageOffset = globalId % gOutputImageSizeSquared;
@@ -41,7 +42,7 @@ kernel void propagateNaive( const int batchSize, global const float *input, glob
         }
     }
     output[ globalId ] = maxValue;
-    selectors[ globalId ] = selector;
+    selectors[ globalId ] = (uchar)selector;
 //    selectors[globalId] = 123;
 }
 
@@ -0,0 +1,144 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// expected defines:
+//  - gGroupSize: number of values each softmax is taken over, ie numPlanes for
+//    per-column softmax, or imageSize * imageSize for per-plane softmax
+//  - gWorkgroupSize: power of 2
+//  - optional: FAST_MATH, to use approximations in place of exp and log
+//
+// one workgroup per softmax group, ie per [n] for per-column, or per [n][plane]
+// for per-plane, and each thread strides over the values of the group
+// logits, results, errorsForUpstream: [group][i]
+// labels, logSumExps, losses, rights: [group]
+
+#ifdef FAST_MATH
+// same approximation as FastMath::exp, max relative error 1e-5
+float approx_exp( float x ) {
+    x = clamp( x, -87.0f, 88.0f );
+    const float t = x * 1.44269504f;
+    const int n = (int)( t + ( t >= 0 ? 0.5f : -0.5f ) );
+    const float f = ( t - n ) * 0.693147181f;
+    const float p = 1.0f + f * ( 1.0f + f * ( 0.5f + f * ( 0.166666667f + f * ( 0.0416666667f
+        + f * 0.00833333333f ) ) ) );
+    return p * as_float( ( n + 127 ) << 23 );
+}
+    #define EXP(x) (approx_exp(x))
+    #define LOG(x) (native_log(x))
+#else
+    #define EXP(x) (exp(x))
+    #define LOG(x) (log(x))
+#endif
+
+// returns the max over the workgroup, to all threads
+float reduceMax( local float *_reduce, float value ) {
+    const int localId = get_local_id(0);
+    _reduce[localId] = value;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {
+        if( localId < offset ) {
+            _reduce[localId] = max( _reduce[localId], _reduce[localId + offset] );
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    const float result = _reduce[0];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    return result;
+}
+
+// returns the sum over the workgroup, to all threads
+float reduceSum( local float *_reduce, float value ) {
+    const int localId = get_local_id(0);
+    _reduce[localId] = value;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {
+        if( localId < offset ) {
+            _reduce[localId] += _reduce[localId + offset];
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    const float result = _reduce[0];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    return result;
+}
+
+// results = exp( logits - logsumexp( logits ) ), and keeps the logsumexp, for the loss
+kernel void softmax_propagate( const int numGroups,
+        global const float *logits, global float *results, global float *logSumExps ) {
+    local float _reduce[gWorkgroupSize];
+    const int group = get_group_id(0);
+    const int localId = get_local_id(0);
+    if( group >= numGroups ) { // whole workgroup returns together
+        return;
+    }
+    global const float *groupLogits = logits + group * gGroupSize;
+
+    float thisMax = - INFINITY;
+    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {
+        thisMax = max( thisMax, groupLogits[i] );
+    }
+    const float maxValue = reduceMax( _reduce, thisMax );
+    float thisSum = 0;
+    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {
+        thisSum += EXP( groupLogits[i] - maxValue );
+    }
+    const float logSumExp = maxValue + LOG( reduceSum( _reduce, thisSum ) );
+    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {
+        results[ group * gGroupSize + i ] = EXP( groupLogits[i] - logSumExp );
+    }
+    if( localId == 0 ) {
+        logSumExps[group] = logSumExp;
+    }
+}
+
+// one pass giving, for each group:
+// - errorsForUpstream = results - onehot( label )
+// - losses = - log( softmax[label] ) = logsumexp - logits[label]
+// - rights = 1 if argmax of results is label, else 0.  ties go to the lowest index
+// labels should already have been checked to be in range
+kernel void softmax_from_labels( const int numGroups, global const int *labels,
+        global const float *logits, global const float *results, global const float *logSumExps,
+        global float *errorsForUpstream, global float *losses, global int *rights ) {
+    local float _values[gWorkgroupSize];
+    local int _indices[gWorkgroupSize];
+    const int group = get_group_id(0);
+    const int localId = get_local_id(0);
+    if( group >= numGroups ) {
+        return;
+    }
+    const int label = labels[group];
+    const int groupOffset = group * gGroupSize;
+
+    float bestValue = - INFINITY;
+    int bestIndex = gGroupSize;
+    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {
+        const float result = results[ groupOffset + i ];
+        errorsForUpstream[ groupOffset + i ] = i == label ? result - 1.0f : result;
+        if( result > bestValue ) { // i is increasing, so first max wins
+            bestValue = result;
+            bestIndex = i;
+        }
+    }
+    _values[localId] = bestValue;
+    _indices[localId] = bestIndex;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {
+        if( localId < offset ) {
+            const float otherValue = _values[localId + offset];
+            const int otherIndex = _indices[localId + offset];
+            if( otherValue > _values[localId] || ( otherValue == _values[localId] && otherIndex < _indices[localId] ) ) {
+                _values[localId] = otherValue;
+                _indices[localId] = otherIndex;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    if( localId == 0 ) {
+        losses[group] = logSumExps[group] - logits[ groupOffset + label ];
+        rights[group] = _indices[0] == label ? 1 : 0;
+    }
+}
+
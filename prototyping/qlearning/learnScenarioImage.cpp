@@ -3,6 +3,7 @@
 //#include <thread>
 //#include <chrono>
 #include <vector>
+#include <cstdlib>
 
 #include "ScenarioImage.h"
 
@@ -11,12 +12,17 @@
 #include "array_helper.h"
 
 #include "QLearner.h"
+#include "VectorScenario.h"
 
 using namespace std;
 
+// usage: learn_scenario_image [numenvs]
+// with numenvs more than 1, that many worlds are played at once, choosing the
+// actions for all of them in one batched forward pass
 int main( int argc, char *argv[] ) {
 //    ScenarioImage scenario;
 
+    const int numEnvs = argc > 1 ? atoi( argv[1] ) : 1;
     ScenarioImage *scenario = new ScenarioImage( 5, true);
 
     NeuralNet *net = new NeuralNet();
@@ -35,7 +41,26 @@ int main( int argc, char *argv[] ) {
     scenario->setNet( net ); // used by the printQRepresentation method
 
     QLearner qLearner( scenario, net );
-    qLearner.run();
+    if( numEnvs > 1 ) {
+        // only the first world prints, when it resets
+        vector< Scenario * > scenarios;
+        scenarios.push_back( scenario );
+        for( int env = 1; env < numEnvs; env++ ) {
+            // otherwise every world would put its apples in the same places
+            ScenarioImage *world = new ScenarioImage( 5, true );
+            world->myrand.seed( env );
+            world->reset();
+            scenarios.push_back( world );
+        }
+        VectorScenario environments( scenarios );
+        environments.setParallel( true );
+        qLearner.run( &environments );
+        for( int env = 1; env < numEnvs; env++ ) {
+            delete scenarios[env];
+        }
+    } else {
+        qLearner.run();
+    }
     
 //    delete[] expectedOutputs;
 //    delete[] lastPerception;
@@ -60,6 +60,14 @@ cdef class QLearner:
         self.thisptr.setEpsilon( epsilon )
     def setLearningRate( self, float learningRate ):
         self.thisptr.setLearningRate( learningRate )
+    def setReplayCapacity( self, int replayCapacity ):
+        self.thisptr.setReplayCapacity( replayCapacity )
+    def setPrioritized( self, bool prioritized ):
+        self.thisptr.setPrioritized( prioritized )
+    def setTargetUpdateInterval( self, int targetUpdateInterval ):
+        self.thisptr.setTargetUpdateInterval( targetUpdateInterval )
+    def setExperiencesPerLearnStep( self, int experiencesPerLearnStep ):
+        self.thisptr.setExperiencesPerLearnStep( experiencesPerLearnStep )
 
 
 #cdef void Scenario_print(  void *pyObject ):
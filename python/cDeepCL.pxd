@@ -25,6 +25,10 @@ cdef extern from "QLearner.h":
         void setMaxSamples( int maxSamples )
         void setEpsilon( float epsilon )
         void setLearningRate( float learningRate )
+        void setReplayCapacity( int replayCapacity ) except +
+        void setPrioritized( bool prioritized ) except +
+        void setTargetUpdateInterval( int targetUpdateInterval )
+        void setExperiencesPerLearnStep( int experiencesPerLearnStep ) except +
 
 cdef extern from "CyScenario.h":
     #[[[cog
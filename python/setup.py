@@ -150,7 +150,10 @@ deepcl_sourcestring = """LayerMaker.cpp NeuralNetMould.cpp
     PropagateFc.cpp BackpropErrorsv2Cached.cpp PropagateByInputPlane.cpp
     PropagateExperimental.cpp PropagateAuto.cpp PropagateCpu.cpp Propagate3_unfactorized.cpp
     PoolingBackpropGpuNaive.cpp ForceBackpropLayerMaker.cpp ForceBackpropLayer.cpp
-    MnistLoader.cpp""" 
+    MnistLoader.cpp DeviceDataset.cpp BatchLearnerOnDevice.cpp NetLearnerOnDevice.cpp
+    ZeroCopy.cpp ActivationArena.cpp Sgemm.cpp PropagateFcGemm.cpp PropagateFcGemv.cpp BackpropWeights2FcGemm.cpp
+    BackpropErrorsv2FcGemm.cpp ConvPoolPropagate.cpp ConvPoolPropagateCpu.cpp ConvPoolPropagateGpu.cpp
+    ThreadPool.cpp PoolingBackpropGpuGather.cpp TaskGraph.cpp DataParallelNet.cpp HogwildLearner.cpp RingAllReduce.cpp DistributedNet.cpp WeightsCheckpointer.cpp MappedFile.cpp ResumeState.cpp InferenceSession.cpp InferenceServer.cpp InferenceClient.cpp""" 
 deepcl_sources_all = deepcl_sourcestring.split()
 deepcl_sources = []
 for source in deepcl_sources_all:
@@ -177,9 +180,10 @@ runtime_library_dirs = []
 libraries = []
 if osfamily == 'Linux':
     runtime_library_dirs= ['.']
+    libraries = ['pthread'] # for ThreadPool
 
 if osfamily == 'Windows':
-    libraries = ['winmm']
+    libraries = ['winmm', 'ws2_32']
 
 if cython_present:
     my_cythonize = cythonize
@@ -222,7 +226,8 @@ ext_modules = [
               sources=["PyDeepCL.pyx", 'CyWrappers.cpp'] 
                 + openclhelpersources
                 + list(map( lambda name : 'mysrc/' + name, deepcl_sources))
-                + ['mysrc/QLearner.cpp','mysrc/array_helper.cpp'], 
+                + ['mysrc/QLearner.cpp','mysrc/array_helper.cpp','mysrc/ReplayMemory.cpp','mysrc/VectorScenario.cpp',
+                   'mysrc/TransitionQueue.cpp','mysrc/ActorLearner.cpp'], 
 #                glob.glob('DeepCL/OpenCLHelper/*.h'),
               include_dirs = ['mysrc'],
               libraries= libraries,
@@ -0,0 +1,238 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+#include <chrono>
+
+#include "NeuralNet.h"
+#include "WeightsPersister.h"
+#include "mt19937defs.h"
+#include "Scenario.h"
+#include "QLearner.h"
+#include "TransitionQueue.h"
+#include "stringhelper.h"
+
+#include "ActorLearner.h"
+
+using namespace std;
+
+ActorLearner::ActorLearner( std::vector< Scenario * > const &scenarios, NeuralNet *net ) :
+        scenarios( scenarios ),
+        net( net ),
+        snapshotVersion( 0 ),
+        stopping( false ),
+        numFrames( 0 ),
+        numLearnSteps( 0 ),
+        numDropped( 0 ) {
+    if( scenarios.size() == 0 ) {
+        throw runtime_error("ActorLearner: need at least one scenario");
+    }
+    epsilon = 0.1f;
+    refreshEvery = 100;
+    publishEvery = 10;
+    queueCapacity = 4096;
+
+    const int size = scenarios[0]->getPerceptionSize();
+    perceptionSize = size * size * scenarios[0]->getPerceptionPlanes();
+    numActions = scenarios[0]->getNumActions();
+    qlearner = new QLearner( scenarios[0], net );
+
+    // each copy has its own OpenCLHelper, so the actors dont queue up behind
+    // the learner, or each other
+    numWeights = WeightsPersister::getTotalNumWeights( net );
+    snapshot = new float[ numWeights ];
+    publishBuffer = new float[ numWeights ];
+    WeightsPersister::copyNetWeightsToArray( net, snapshot );
+    for( int actor = 0; actor < (int)scenarios.size(); actor++ ) {
+        NeuralNet *actorNet = net->clone();
+        WeightsPersister::copyArrayToNetWeights( snapshot, actorNet );
+        actorNet->setBatchSize( 1 );
+        actorNet->setLowLatency( true );
+        actorNets.push_back( actorNet );
+    }
+}
+ActorLearner::~ActorLearner() {
+    stopping = true;
+    for( int i = 0; i < (int)threads.size(); i++ ) {
+        threads[i].join();
+    }
+    for( int i = 0; i < (int)queues.size(); i++ ) {
+        delete queues[i];
+    }
+    for( int i = 0; i < (int)actorNets.size(); i++ ) {
+        delete actorNets[i];
+    }
+    delete[] publishBuffer;
+    delete[] snapshot;
+    delete qlearner;
+}
+void ActorLearner::setRefreshEvery( int refreshEvery ) {
+    checkInterval( "refreshEvery", refreshEvery );
+    this->refreshEvery = refreshEvery;
+}
+void ActorLearner::setPublishEvery( int publishEvery ) {
+    checkInterval( "publishEvery", publishEvery );
+    this->publishEvery = publishEvery;
+}
+// both intervals are used as divisors, in the actor and learner threads
+void ActorLearner::checkInterval( std::string name, int interval ) {
+    if( interval < 1 ) {
+        throw runtime_error("ActorLearner: " + name + " must be at least 1, but was " + toString( interval ) );
+    }
+}
+void ActorLearner::start() {
+    if( threads.size() > 0 ) {
+        throw runtime_error("ActorLearner::start: already started");
+    }
+    // they are public, so may have been set without the setters
+    checkInterval( "refreshEvery", refreshEvery );
+    checkInterval( "publishEvery", publishEvery );
+    stopping = false;
+    for( int i = 0; i < (int)queues.size(); i++ ) {
+        delete queues[i];
+    }
+    queues.clear();
+    for( int actor = 0; actor < (int)scenarios.size(); actor++ ) {
+        queues.push_back( new TransitionQueue( queueCapacity, perceptionSize ) );
+    }
+    threads.push_back( std::thread( &ActorLearner::runLearner, this ) );
+    for( int actor = 0; actor < (int)scenarios.size(); actor++ ) {
+        threads.push_back( std::thread( &ActorLearner::runActor, this, actor ) );
+    }
+}
+// waits for every thread to finish its current frame, or learn step.
+// rethrows the first exception any of them threw
+void ActorLearner::stop() {
+    stopping = true;
+    for( int i = 0; i < (int)threads.size(); i++ ) {
+        threads[i].join();
+    }
+    threads.clear();
+    std::exception_ptr thisError = error;
+    error = nullptr;
+    if( thisError ) {
+        std::rethrow_exception( thisError );
+    }
+}
+// keeps the first error, and stops everything else
+void ActorLearner::fail() {
+    {
+        std::unique_lock< std::mutex > lock( errorMutex );
+        if( !error ) {
+            error = std::current_exception();
+        }
+    }
+    stopping = true;
+}
+void ActorLearner::runActor( int actor ) {
+    try {
+        Scenario *scenario = scenarios[actor];
+        NeuralNet *actorNet = actorNets[actor];
+        TransitionQueue *queue = queues[actor];
+        float *before = new float[ perceptionSize ];
+        float *after = new float[ perceptionSize ];
+        float *weights = new float[ numWeights ];
+        int version = -1;
+        MT19937 myrand;
+        myrand.seed( actor );
+        int frame = 0;
+        scenario->getPerception( before );
+        while( !stopping ) {
+            if( frame % refreshEvery == 0 && snapshotVersion.load() != version ) {
+                {
+                    std::unique_lock< std::mutex > lock( snapshotMutex );
+                    version = snapshotVersion.load();
+                    for( int i = 0; i < numWeights; i++ ) {
+                        weights[i] = snapshot[i];
+                    }
+                }
+                WeightsPersister::copyArrayToNetWeights( weights, actorNet );
+            }
+            int action = 0;
+            if( (myrand() % 10000 / 10000.0f) <= epsilon ) {
+                action = myrand() % numActions;
+            } else {
+                actorNet->propagate( before );
+                float const *results = actorNet->getResults();
+                for( int i = 1; i < numActions; i++ ) {
+                    if( results[i] > results[action] ) {
+                        action = i;
+                    }
+                }
+            }
+            const float reward = scenario->act( action );
+            const bool finished = scenario->hasFinished();
+            scenario->getPerception( after );
+            if( !queue->push( before, action, reward, finished, after ) ) {
+                numDropped++;
+            }
+            if( finished ) {
+                scenario->reset();
+                scenario->getPerception( before );
+            } else {
+                float *swap = before;
+                before = after;
+                after = swap;
+            }
+            frame++;
+            numFrames++;
+        }
+        delete[] weights;
+        delete[] after;
+        delete[] before;
+    } catch( ... ) {
+        fail();
+    }
+}
+void ActorLearner::runLearner() {
+    try {
+        while( !stopping ) {
+            if( drainQueues() == 0 && numLearnSteps.load() == 0 ) {
+                // nothing to learn from yet
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+                continue;
+            }
+            qlearner->learnFromPast();
+            numLearnSteps++;
+            if( numLearnSteps.load() % publishEvery == 0 ) {
+                publishWeights();
+            }
+        }
+    } catch( ... ) {
+        fail();
+    }
+}
+// moves everything queued so far into the replay memory; returns how many
+int ActorLearner::drainQueues() {
+    int numDrained = 0;
+    for( int actor = 0; actor < (int)queues.size(); actor++ ) {
+        TransitionQueue *queue = queues[actor];
+        float const *before = 0;
+        float const *after = 0;
+        int action = 0;
+        float reward = 0;
+        bool isEndState = false;
+        // at most one queue's worth, so an actor that keeps pushing cant keep us here
+        const int capacity = queue->getCapacity();
+        for( int i = 0; i < capacity && queue->peek( &before, &action, &reward, &isEndState, &after ); i++ ) {
+            qlearner->addExperience( before, action, reward, isEndState, after );
+            queue->pop();
+            numDrained++;
+        }
+    }
+    return numDrained;
+}
+// the weights come off the device before taking the lock, so actors refreshing
+// their weights only wait for a memory copy
+void ActorLearner::publishWeights() {
+    WeightsPersister::copyNetWeightsToArray( net, publishBuffer );
+    std::unique_lock< std::mutex > lock( snapshotMutex );
+    for( int i = 0; i < numWeights; i++ ) {
+        snapshot[i] = publishBuffer[i];
+    }
+    snapshotVersion++;
+}
+
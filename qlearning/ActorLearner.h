@@ -0,0 +1,86 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <string>
+
+#include "DeepCLDllExport.h"
+
+class Scenario;
+class NeuralNet;
+class QLearner;
+class TransitionQueue;
+
+// q-learning, with acting and learning on separate threads
+// one actor thread per scenario, each choosing actions with its own copy of
+// the net, at batch size 1, in low latency mode, and pushing its experiences
+// onto its own TransitionQueue.  one learner thread moves the queued experiences into the
+// replay memory of a QLearner, and runs learnFromPast over and over, at the
+// QLearner's maxSamples batch size
+// every publishEvery learn steps, the learner copies the weights into a
+// snapshot; actors pick up the latest snapshot every refreshEvery frames.
+// if the learner falls behind, and a queue fills up, the actor drops
+// experiences rather than waits, so acting never slows down for learning
+class DeepCL_EXPORT ActorLearner {
+public:
+    // following are user-configurable, before start:
+    float epsilon; // probability of exploring, for the actors (default: 0.1)
+    int refreshEvery; // frames an actor plays between checking for new weights (default: 100)
+    int publishEvery; // learn steps between weight snapshots (default: 10)
+    int queueCapacity; // experiences each actor can queue up for the learner (default: 4096)
+
+    ActorLearner( std::vector< Scenario * > const &scenarios, NeuralNet *net );
+    ~ActorLearner();
+
+    void setEpsilon( float epsilon ) { this->epsilon = epsilon; }
+    void setRefreshEvery( int refreshEvery );
+    void setPublishEvery( int publishEvery );
+    void setQueueCapacity( int queueCapacity ) { this->queueCapacity = queueCapacity; }
+    QLearner *getQLearner() { return qlearner; } // for lambda, maxSamples, learningRate etc
+
+    void start();
+    void stop();
+    long long getNumFrames() const { return numFrames.load(); }
+    long long getNumLearnSteps() const { return numLearnSteps.load(); }
+    long long getNumDropped() const { return numDropped.load(); }
+
+protected:
+    void runActor( int actor );
+    void runLearner();
+    int drainQueues();
+    void publishWeights();
+    void fail();
+    static void checkInterval( std::string name, int interval );
+
+    std::vector< Scenario * > scenarios; // NOT belong to us, dont delete
+    NeuralNet *net; // NOT belong to us, dont delete; the learner trains this one
+    QLearner *qlearner;
+    std::vector< NeuralNet * > actorNets;
+    std::vector< TransitionQueue * > queues;
+    int perceptionSize;
+    int numActions;
+
+    std::mutex snapshotMutex;
+    int numWeights;
+    float *snapshot;
+    float *publishBuffer; // learner thread only
+    std::atomic< int > snapshotVersion;
+
+    std::vector< std::thread > threads;
+    std::atomic< bool > stopping;
+    std::atomic< long long > numFrames;
+    std::atomic< long long > numLearnSteps;
+    std::atomic< long long > numDropped;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
@@ -4,8 +4,15 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <stdexcept>
+
 #include "NeuralNet.h"
 #include "array_helper.h"
+#include "stringhelper.h"
+#include "ReplayMemory.h"
+#include "VectorScenario.h"
+#include "ThreadPool.h"
+#include "WeightsPersister.h"
 
 #include "QLearner.h"
 
@@ -18,134 +25,295 @@ QLearner::QLearner( Scenario *scenario, NeuralNet *net ) :
     maxSamples = 32;
     epsilon = 0.1f;
     learningRate = 0.1f;
+    replayCapacity = 100000;
+    prioritized = false;
+    targetUpdateInterval = 0;
+    experiencesPerLearnStep = 1;
 
     size = scenario->getPerceptionSize();
     planes = scenario->getPerceptionPlanes();
     numActions = scenario->getNumActions();
 
-    lastPerception = new float[ size * size * planes ];
     game = 0;
-    lastAction = -1;
+    numEnvs = 0;
+    lastPerceptions = 0;
+    lastActions = 0;
+
+    replay = 0;
+    allocatedSamples = 0;
+    sampleIndices = 0;
+    states = 0;
+    bestQ = 0;
+    sampleWeights = 0;
+    expectedValues = 0;
+    targetNet = 0;
+    targetWeights = 0;
+    numLearnSteps = 0;
+    unlearntExperiences = 0;
 }
 
 QLearner::~QLearner() {
-    delete[] lastPerception;
+    delete[] targetWeights;
+    delete targetNet;
+    delete[] expectedValues;
+    delete[] sampleWeights;
+    delete[] bestQ;
+    delete[] states;
+    delete[] sampleIndices;
+    delete replay;
+    delete[] lastActions;
+    delete[] lastPerceptions;
+}
+
+void QLearner::setReplayCapacity( int replayCapacity ) {
+    if( replay != 0 ) {
+        throw runtime_error("QLearner::setReplayCapacity: must be called before the first step");
+    }
+    this->replayCapacity = replayCapacity;
+}
+
+void QLearner::setPrioritized( bool prioritized ) {
+    if( replay != 0 ) {
+        throw runtime_error("QLearner::setPrioritized: must be called before the first step");
+    }
+    this->prioritized = prioritized;
+}
+
+void QLearner::setTargetUpdateInterval( int targetUpdateInterval ) {
+    this->targetUpdateInterval = targetUpdateInterval;
+    if( targetUpdateInterval <= 0 && targetNet != 0 ) {
+        delete targetNet;
+        delete[] targetWeights;
+        targetNet = 0;
+        targetWeights = 0;
+    }
+}
+
+void QLearner::setExperiencesPerLearnStep( int experiencesPerLearnStep ) {
+    if( experiencesPerLearnStep < 1 ) {
+        throw runtime_error("QLearner::setExperiencesPerLearnStep: must be at least 1, but was " + toString( experiencesPerLearnStep ) );
+    }
+    this->experiencesPerLearnStep = experiencesPerLearnStep;
+}
+
+// buffers are sized for maxSamples, and the nets are set to their largest batch
+// size once here, so that later setBatchSize calls, which only shrink, just
+// change a counter, rather than reallocating every layer
+void QLearner::allocateSamples( int numSamples ) {
+    if( numSamples <= allocatedSamples ) {
+        return;
+    }
+    delete[] expectedValues;
+    delete[] sampleWeights;
+    delete[] bestQ;
+    delete[] states;
+    delete[] sampleIndices;
+    const int perceptionSize = planes * size * size;
+    sampleIndices = new int[ numSamples ];
+    states = new float[ (long)numSamples * 2 * perceptionSize ];
+    bestQ = new float[ numSamples ];
+    sampleWeights = new float[ numSamples ];
+    expectedValues = new float[ numSamples * numActions ];
+    allocatedSamples = numSamples;
+    // action selection propagates one batch of numEnvs
+    net->setBatchSize( 2 * numSamples > numEnvs ? 2 * numSamples : numEnvs );
+    if( targetNet != 0 ) {
+        targetNet->setBatchSize( numSamples );
+    }
+}
+
+void QLearner::syncTargetNet() {
+    if( targetNet == 0 ) {
+        targetNet = net->clone();
+        targetWeights = new float[ WeightsPersister::getTotalNumWeights( net ) ];
+        targetNet->setBatchSize( allocatedSamples > 0 ? allocatedSamples : 1 );
+    }
+    WeightsPersister::copyNetWeightsToArray( net, targetWeights );
+    WeightsPersister::copyArrayToNetWeights( targetWeights, targetNet );
 }
 
 void QLearner::learnFromPast() {
-    const int availableSamples = history.size();
+    if( replay == 0 ) {
+        return;
+    }
+    const int availableSamples = replay->getCount();
     int batchSize = availableSamples >= maxSamples ? maxSamples : availableSamples;
-//    batchSize = ;
-    const int size = scenario->getPerceptionSize();
-    const int numActions = scenario->getNumActions();
-    net->setBatchSize(batchSize);
+    if( targetUpdateInterval > 0 && ( targetNet == 0 || numLearnSteps % targetUpdateInterval == 0 ) ) {
+        syncTargetNet();
+    }
+    allocateSamples( maxSamples > batchSize ? maxSamples : batchSize );
 
-//    cout << "batchSize: " << batchSize << endl;
+    // draw samples, and copy in data: befores, then afters, in one array
+    float *befores = states;
+    float *afters = states + (long)batchSize * planes * size * size;
+    replay->sample( batchSize, myrand, sampleIndices );
+    replay->gather( batchSize, sampleIndices, befores, afters );
 
-    // draw samples
-    Experience **experiences = new Experience *[ batchSize ];
-    for( int n = 0; n < batchSize; n++ ) {
-        int sampleIdx = myrand() % availableSamples;
-        Experience *experience = history[sampleIdx];
-        experiences[n] = experience;
-    }    
-
-    // copy in data 
-    float *afters = new float[ batchSize * planes * size * size ];
-    float *befores = new float[ batchSize * planes * size * size ];
-    for( int n = 0; n < batchSize; n++ ) {
-        Experience *experience = experiences[n]; 
-        arrayCopy( afters + n * planes * size * size, experience->after, planes * size * size );
-        arrayCopy( befores + n * planes * size * size, experience->before, planes * size * size );
+    // forward prop 'befores', to get the current q values, and 'afters', to get
+    // the next q values
+    float const *beforeResults = 0;
+    float const *afterResults = 0;
+    if( targetNet == 0 ) {
+        // both in one pass, as one batch of twice the size
+        net->setBatchSize( 2 * batchSize );
+        net->propagate( states );
+        beforeResults = net->getResults();
+        afterResults = beforeResults + batchSize * numActions;
+    } else {
+        // each net has its own OpenCLHelper, so they can run at the same time
+        net->setBatchSize( batchSize );
+        targetNet->setBatchSize( batchSize );
+        ThreadPool::instance()->parallelFor( 2, [&]( int begin, int end ) {
+            for( int i = begin; i < end; i++ ) {
+                if( i == 0 ) {
+                    net->propagate( befores );
+                } else {
+                    targetNet->propagate( afters );
+                }
+            }
+        } );
+        beforeResults = net->getResults();
+        afterResults = targetNet->getResults();
     }
-
-    // get next q values, based on forward prop 'afters'
-    net->propagate( afters );
-    float const *allResults = net->getResults();
-    float *bestQ = new float[ batchSize ];
-    int *bestAction = new int[ batchSize ];
     for( int n = 0; n < batchSize; n++ ) {
-        float const *results = allResults + n * numActions;
+        float const *results = afterResults + n * numActions;
         float thisBestQ = results[0];
-        int thisBestAction = 0;
         for( int action = 1; action < numActions; action++ ) {
             if( results[action] > thisBestQ ) {
                 thisBestQ = results[action];
-                thisBestAction = action;
             }
         }
         bestQ[n] = thisBestQ;
-        bestAction[n] = thisBestAction;
-    }
-    // forward prop 'befores', set up expected values, and backprop
-    // new q values
-    net->propagate( befores );
-    allResults = net->getResults();
-    float *expectedValues = new float[ numActions * batchSize ];
-    arrayCopy( expectedValues, allResults, batchSize * numActions );
+    }
+    // set up expected values, and backprop new q values
+    arrayCopy( expectedValues, beforeResults, batchSize * numActions );
+    // weights first, since updating the priorities changes them
+    float maxWeight = 0;
+    if( prioritized ) {
+        for( int n = 0; n < batchSize; n++ ) {
+            sampleWeights[n] = replay->getSampleWeight( sampleIndices[n] );
+            maxWeight = sampleWeights[n] > maxWeight ? sampleWeights[n] : maxWeight;
+        }
+    }
     for( int n = 0; n < batchSize; n++ ) {
-        Experience *experience = experiences[n]; 
-        if( experience->isEndState ) {
-            expectedValues[ n * numActions + experience->action ] = experience->reward; 
-        } else {
-            expectedValues[ n * numActions + experience->action ] = experience->reward + lambda * bestQ[n];        
+        const int index = sampleIndices[n];
+        const int action = replay->getAction( index );
+        float target = replay->getReward( index );
+        if( !replay->getIsEndState( index ) ) {
+            target += lambda * bestQ[n];
         }
+        const float currentQ = beforeResults[ n * numActions + action ];
+        if( prioritized ) {
+            replay->updatePriority( index, target - currentQ );
+            // for a squared loss, scaling the distance to the target scales
+            // the gradient by the same amount
+            target = currentQ + sampleWeights[n] / maxWeight * ( target - currentQ );
+        }
+        expectedValues[ n * numActions + action ] = target;
     }
-    // backprop...
+    // backprop...  only the befores: they come first, so after shrinking the
+    // batch, the results of every layer are still theirs
+    net->setBatchSize( batchSize );
     net->backProp( learningRate / batchSize, expectedValues );
+    // back to one example, as callers expect, eg to show the q values of each
+    // square.  only changes a counter, since the net keeps its largest size
     net->setBatchSize(1);
-
-    delete[] expectedValues;
-    delete[] bestQ;
-    delete[] bestAction;
-    delete[] afters;
-    delete[] befores;
-    delete[] experiences;
+    numLearnSteps++;
 }
 
 // this is now a scenario-free zone, and therefore no callbacks, and easy to wrap with
 // swig, cython etc.
 int QLearner::step( float lastReward, bool wasReset, float *perception ) { // do one frame
-    if( lastAction != -1 ) {
-        Experience *experience = new Experience(); 
-        experience->action = lastAction;
-        experience->reward = lastReward;
-        experience->isEndState = wasReset;
-        experience->before = new float[ size * size * planes ];
-        arrayCopy( experience->before, this->lastPerception, size * size * planes );
-//        scenario->getPerception( perception );
-        experience->after = new float[ size * size * planes ];
-        arrayCopy( experience->after, perception, size * size * planes );
-        history.push_back( experience );
-        if( wasReset ) {
-            game++;
+    int action = -1;
+    stepBatch( 1, &lastReward, &wasReset, perception, &action );
+    return action;
+}
+
+// do one frame, for each of numEnvs environments at once.  perceptions are
+// [env][plane][row][col].  numEnvs must stay the same from one call to the next
+// learns from the past once per experiencesPerLearnStep new experiences, so by
+// default numEnvs times per call, and chooses all the non-random actions in one
+// forward pass
+void QLearner::stepBatch( int numEnvs, float const *lastRewards, bool const *wasResets,
+        float const *perceptions, int *actions ) {
+    setNumEnvs( numEnvs );
+    const int perceptionSize = size * size * planes;
+    if( lastActions[0] != -1 ) {
+        for( int env = 0; env < numEnvs; env++ ) {
+            addExperience( lastPerceptions + (long)env * perceptionSize, lastActions[env], lastRewards[env],
+                wasResets[env], perceptions + (long)env * perceptionSize );
+            if( wasResets[env] ) {
+                game++;
+            }
+        }
+        unlearntExperiences += numEnvs;
+        while( unlearntExperiences >= experiencesPerLearnStep ) {
+            learnFromPast();
+            unlearntExperiences -= experiencesPerLearnStep;
         }
-        learnFromPast();
     }
 //        cout << "see: " << toString( perception, perceptionSize + numActions ) << endl;
-    int action = -1;
-    if( lastAction == -1 || (myrand() % 10000 / 10000.0f) <= epsilon ) {
-        action = myrand() % numActions;
+    bool anyExploit = false;
+    for( int env = 0; env < numEnvs; env++ ) {
+        if( lastActions[env] == -1 || (myrand() % 10000 / 10000.0f) <= epsilon ) {
+            actions[env] = myrand() % numActions;
 //            cout << "action, rand: " << action << endl;
-    } else {
-        net->setBatchSize(1);
-        net->propagate( perception );
-        float highestQ = 0;
-        int bestAction = 0;
-        float const*results = net->getResults();
-        for( int i = 0; i < numActions; i++ ) {
-            if( i == 0 || results[i] > highestQ ) {
-                highestQ = results[i];
-                bestAction = i;
-            }
+        } else {
+            actions[env] = -1;
+            anyExploit = true;
         }
-        action = bestAction;
+    }
+    if( anyExploit ) {
+        net->setBatchSize( numEnvs );
+        net->propagate( perceptions );
+        float const*allResults = net->getResults();
+        for( int env = 0; env < numEnvs; env++ ) {
+            if( actions[env] != -1 ) {
+                continue;
+            }
+            float const *results = allResults + env * numActions;
+            float highestQ = 0;
+            int bestAction = 0;
+            for( int i = 0; i < numActions; i++ ) {
+                if( i == 0 || results[i] > highestQ ) {
+                    highestQ = results[i];
+                    bestAction = i;
+                }
+            }
+            actions[env] = bestAction;
 //            cout << "action, q: " << action << endl;
+        }
     }
-    arrayCopy( this->lastPerception, perception, size * size * planes );
+    arrayCopy( lastPerceptions, perceptions, numEnvs * perceptionSize );
 //        printDirections( net, scenario->height, scenario->width );
-    this->lastAction = action;
-    return action;
+    for( int env = 0; env < numEnvs; env++ ) {
+        lastActions[env] = actions[env];
+    }
+}
+
+// remember one experience, for learnFromPast to sample from later.  for
+// callers that act some other way than step, eg on other threads
+void QLearner::addExperience( float const *before, int action, float reward, bool isEndState, float const *after ) {
+    if( replay == 0 ) {
+        replay = new ReplayMemory( replayCapacity, size * size * planes, prioritized );
+    }
+    replay->add( before, action, reward, isEndState, after );
+}
+
+void QLearner::setNumEnvs( int numEnvs ) {
+    if( numEnvs == this->numEnvs ) {
+        return;
+    }
+    if( this->numEnvs != 0 ) {
+        throw runtime_error("QLearner::stepBatch: number of environments was " + toString( this->numEnvs ) +
+            ", cannot change it to " + toString( numEnvs ) );
+    }
+    this->numEnvs = numEnvs;
+    lastPerceptions = new float[ (long)numEnvs * size * size * planes ];
+    lastActions = new int[ numEnvs ];
+    for( int env = 0; env < numEnvs; env++ ) {
+        lastActions[env] = -1;
+    }
 }
 
 void QLearner::run() {
@@ -169,3 +337,30 @@ void QLearner::run() {
     delete[] perception; // I guess we will never get to here :-P
 }
 
+// like run(), but for several instances of the scenario at once
+void QLearner::run( VectorScenario *environments ) {
+    if( environments->getPerceptionSize() != size || environments->getPerceptionPlanes() != planes
+            || environments->getNumActions() != numActions ) {
+        throw runtime_error("QLearner::run: environments dont match the scenario QLearner was created with");
+    }
+    game = 0;
+
+    const int numEnvs = environments->getNumEnvs();
+    float *perceptions = new float[ (long)numEnvs * size * size * planes ];
+    float *lastRewards = new float[ numEnvs ];
+    bool *wasResets = new bool[ numEnvs ];
+    int *actions = new int[ numEnvs ];
+    for( int env = 0; env < numEnvs; env++ ) {
+        lastRewards[env] = 0;
+        wasResets[env] = false;
+    }
+    while( true ) {
+        environments->getPerceptions( perceptions );
+        stepBatch( numEnvs, lastRewards, wasResets, perceptions, actions );
+        environments->act( actions, lastRewards, wasResets );
+    }
+    delete[] actions;
+    delete[] wasResets;
+    delete[] lastRewards;
+    delete[] perceptions;
+}
@@ -6,7 +6,6 @@
 
 #pragma once
 
-#include <vector>
 #include <random>
 
 #include "Scenario.h"
@@ -15,15 +14,8 @@
 #include "DeepCLDllExport.h"
 
 class NeuralNet;
-
-class Experience {
-public:
-    float *before;
-    int action;
-    float reward;
-    bool isEndState;
-    float *after;
-};
+class ReplayMemory;
+class VectorScenario;
 
 class DeepCL_EXPORT QLearner {
 public:
@@ -33,19 +25,36 @@ public:
     float epsilon; // probability of exploring, instead of exploiting, 0.0 to 1.0 ok
     float learningRate; // learning rate for the neuralnet; depends on what is appropriate for your particular
                         // network design
+    // following 2 can only be changed before the first step:
+    int replayCapacity; // how many experiences to remember; after that, the oldest are forgotten (default: 100000)
+    bool prioritized; // sample experiences with large td errors more often (default: false)
+    int targetUpdateInterval; // if more than 0, the next q values come from a frozen copy of the net,
+                              // updated every this many steps (default: 0, ie from the net itself)
+    int experiencesPerLearnStep; // stepBatch learns from the past once per this many new experiences, so
+                                 // numEnvs times per call by default, the same as step (default: 1)
 
     QLearner( Scenario *scenario, NeuralNet *net );
     // do one frame:
     int step( float lastReward, bool wasReset, float *perception );
+    void stepBatch( int numEnvs, float const *lastRewards, bool const *wasResets, float const *perceptions,
+        int *actions );
     void run();  // main entry point
+    void run( VectorScenario *environments );
     virtual ~QLearner();
 
+    void addExperience( float const *before, int action, float reward, bool isEndState, float const *after );
     void learnFromPast(); // internal method; probably not useful to user, but who knows, so leaving it 
                           // public :-)
     void setLambda( float lambda ) { this->lambda = lambda; }
     void setMaxSamples( int maxSamples ) { this->maxSamples = maxSamples; }
     void setEpsilon( float epsilon ) { this->epsilon = epsilon; }
     void setLearningRate( float learningRate ) { this->learningRate = learningRate; }
+    void setReplayCapacity( int replayCapacity );
+    void setPrioritized( bool prioritized );
+    void setTargetUpdateInterval( int targetUpdateInterval );
+    void setExperiencesPerLearnStep( int experiencesPerLearnStep );
+    int getNumLearnSteps() { return numLearnSteps; }
+    ReplayMemory *getReplayMemory() { return replay; }
 
 protected:
     int size;
@@ -53,13 +62,30 @@ protected:
     int numActions;
 
   //  float *perception;
-    float *lastPerception;
     int game;
-    int lastAction;
+    int numEnvs; // 0 until the first step
+    float *lastPerceptions;
+    int *lastActions;
 
     MT19937 myrand;
 
-    std::vector< Experience * > history;
+    ReplayMemory *replay; // created on the first experience
+    // batch buffers for learnFromPast, reallocated only if maxSamples grows
+    int allocatedSamples;
+    int *sampleIndices;
+    float *states; // befores, then afters
+    float *bestQ;
+    float *sampleWeights;
+    float *expectedValues;
+
+    NeuralNet *targetNet; // 0 unless targetUpdateInterval > 0
+    float *targetWeights;
+    int numLearnSteps;
+    int unlearntExperiences; // since the last learn step, for experiencesPerLearnStep
+
+    void allocateSamples( int numSamples );
+    void syncTargetNet();
+    void setNumEnvs( int numEnvs );
     Scenario *scenario; // NOT belong to us, dont delete
     NeuralNet *net; // NOT belong to us, dont delete
 };
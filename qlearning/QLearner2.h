@@ -102,5 +102,8 @@ public:
     void setMaxSamples( int maxSamples ) { qlearner->setMaxSamples( maxSamples ); }
     void setEpsilon( float epsilon ) { qlearner->setEpsilon( epsilon ); }
     void setLearningRate( float learningRate ) { qlearner->setLearningRate( learningRate ); }
+    void setReplayCapacity( int replayCapacity ) { qlearner->setReplayCapacity( replayCapacity ); }
+    void setPrioritized( bool prioritized ) { qlearner->setPrioritized( prioritized ); }
+    void setTargetUpdateInterval( int targetUpdateInterval ) { qlearner->setTargetUpdateInterval( targetUpdateInterval ); }
 };
 
@@ -0,0 +1,157 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+#include <cmath>
+
+#include "array_helper.h"
+
+#include "ReplayMemory.h"
+
+using namespace std;
+
+ReplayMemory::ReplayMemory( int capacity, int stateSize, bool prioritized ) :
+        capacity( capacity ),
+        stateSize( stateSize ),
+        prioritized( prioritized ),
+        head( 0 ),
+        count( 0 ),
+        treeLeaves( 0 ),
+        sumTree( 0 ),
+        maxPriority( 1.0f ) {
+    if( capacity <= 0 || stateSize <= 0 ) {
+        throw runtime_error("ReplayMemory: capacity and stateSize should be positive");
+    }
+    alpha = 0.6f;
+    beta = 0.4f;
+    minPriority = 0.01f;
+    states = new float[ (long)capacity * 2 * stateSize ];
+    actions = new int[ capacity ];
+    rewards = new float[ capacity ];
+    isEndStates = new unsigned char[ capacity ];
+    if( prioritized ) {
+        treeLeaves = 1;
+        while( treeLeaves < capacity ) {
+            treeLeaves <<= 1;
+        }
+        sumTree = new float[ 2 * treeLeaves ];
+        for( int i = 0; i < 2 * treeLeaves; i++ ) {
+            sumTree[i] = 0;
+        }
+    }
+}
+ReplayMemory::~ReplayMemory() {
+    delete[] sumTree;
+    delete[] isEndStates;
+    delete[] rewards;
+    delete[] actions;
+    delete[] states;
+}
+// returns the slot written to
+int ReplayMemory::add( float const *before, int action, float reward, bool isEndState, float const *after ) {
+    const int index = head;
+    float *slot = states + (long)index * 2 * stateSize;
+    arrayCopy( slot, before, stateSize );
+    arrayCopy( slot + stateSize, after, stateSize );
+    actions[index] = action;
+    rewards[index] = reward;
+    isEndStates[index] = isEndState ? 1 : 0;
+    if( prioritized ) {
+        setPriority( index, maxPriority );
+    }
+    head = ( head + 1 ) % capacity;
+    if( count < capacity ) {
+        count++;
+    }
+    return index;
+}
+// writes batchSize slot indices into indices.  uniform, or, if prioritized,
+// one draw from each of batchSize equal slices of the total priority, which
+// spreads a batch across the distribution better than independent draws
+void ReplayMemory::sample( int batchSize, MT19937 &random, int *indices ) {
+    if( count == 0 ) {
+        throw runtime_error("ReplayMemory::sample: memory is empty");
+    }
+    if( !prioritized ) {
+        for( int n = 0; n < batchSize; n++ ) {
+            indices[n] = random() % count;
+        }
+        return;
+    }
+    const double segment = (double)getTotalPriority() / batchSize;
+    for( int n = 0; n < batchSize; n++ ) {
+        const double uniform = random() / 4294967296.0;
+        indices[n] = findPrefixSum( (float)( ( n + uniform ) * segment ) );
+    }
+}
+// copies the states of the given slots into contiguous [n][stateSize] arrays
+void ReplayMemory::gather( int batchSize, int const *indices, float *befores, float *afters ) const {
+    for( int n = 0; n < batchSize; n++ ) {
+        float const *slot = states + (long)indices[n] * 2 * stateSize;
+        arrayCopy( befores + (long)n * stateSize, slot, stateSize );
+        arrayCopy( afters + (long)n * stateSize, slot + stateSize, stateSize );
+    }
+}
+// no-op, unless prioritized
+void ReplayMemory::updatePriority( int index, float tdError ) {
+    if( !prioritized ) {
+        return;
+    }
+    const float priority = (float)pow( fabs( tdError ) + minPriority, alpha );
+    if( priority > maxPriority ) {
+        maxPriority = priority;
+    }
+    setPriority( index, priority );
+}
+// importance-sampling weight, to undo the bias from sampling non-uniformly.
+// not normalized: callers typically divide by the largest weight in the batch.
+// always 1, unless prioritized
+float ReplayMemory::getSampleWeight( int index ) const {
+    if( !prioritized ) {
+        return 1.0f;
+    }
+    const double probability = getPriority( index ) / (double)getTotalPriority();
+    return (float)pow( count * probability, -beta );
+}
+float ReplayMemory::getPriority( int index ) const {
+    if( !prioritized ) {
+        return 1.0f;
+    }
+    return sumTree[treeLeaves + index];
+}
+float ReplayMemory::getTotalPriority() const {
+    if( !prioritized ) {
+        return (float)count;
+    }
+    return sumTree[1];
+}
+// recomputes the path to the root from the children, rather than adding the
+// difference, so rounding errors dont build up over millions of updates
+void ReplayMemory::setPriority( int index, float priority ) {
+    int node = treeLeaves + index;
+    sumTree[node] = priority;
+    node >>= 1;
+    while( node >= 1 ) {
+        sumTree[node] = sumTree[2 * node] + sumTree[2 * node + 1];
+        node >>= 1;
+    }
+}
+// returns the slot where the running total of priorities passes value.
+// never returns an empty slot, even if rounding pushes value past the total
+int ReplayMemory::findPrefixSum( float value ) const {
+    int node = 1;
+    while( node < treeLeaves ) {
+        const int left = 2 * node;
+        if( value < sumTree[left] || sumTree[left + 1] <= 0 ) {
+            node = left;
+        } else {
+            value -= sumTree[left];
+            node = left + 1;
+        }
+    }
+    return node - treeLeaves;
+}
+
@@ -0,0 +1,74 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "mt19937defs.h"
+
+#include "DeepCLDllExport.h"
+
+// fixed-capacity experience replay, for QLearner
+// everything is allocated once, in the constructor: each slot holds one
+// experience, with its before and after states next to each other in one
+// slab, [slot][before/after][stateSize].  once full, add overwrites the oldest
+// experience.
+// optionally, samples in proportion to a per-slot priority, rather than
+// uniformly, using a sum-tree over the slots.  new experiences get the
+// highest priority seen so far, so they are sampled at least once
+class DeepCL_EXPORT ReplayMemory {
+public:
+    ReplayMemory( int capacity, int stateSize, bool prioritized );
+    ~ReplayMemory();
+
+    int add( float const *before, int action, float reward, bool isEndState, float const *after );
+    void sample( int batchSize, MT19937 &random, int *indices );
+    void gather( int batchSize, int const *indices, float *befores, float *afters ) const;
+    void updatePriority( int index, float tdError );
+    float getSampleWeight( int index ) const;
+
+    int getCapacity() const { return capacity; }
+    int getStateSize() const { return stateSize; }
+    int getCount() const { return count; }
+    bool isPrioritized() const { return prioritized; }
+    float const *getBefore( int index ) const { return states + (long)index * 2 * stateSize; }
+    float const *getAfter( int index ) const { return states + ( (long)index * 2 + 1 ) * stateSize; }
+    int getAction( int index ) const { return actions[index]; }
+    float getReward( int index ) const { return rewards[index]; }
+    bool getIsEndState( int index ) const { return isEndStates[index] != 0; }
+    float getPriority( int index ) const;
+    float getTotalPriority() const;
+
+    // prioritized sampling only:
+    float alpha; // how much the td error counts; 0 means uniform (default: 0.6)
+    float beta; // how much to correct for the non-uniform sampling; 1 means fully (default: 0.4)
+    float minPriority; // so nothing ends up never sampled (default: 0.01)
+    void setAlpha( float alpha ) { this->alpha = alpha; }
+    void setBeta( float beta ) { this->beta = beta; }
+    void setMinPriority( float minPriority ) { this->minPriority = minPriority; }
+
+protected:
+    void setPriority( int index, float priority );
+    int findPrefixSum( float value ) const;
+
+    const int capacity;
+    const int stateSize;
+    const bool prioritized;
+    int head; // next slot to write
+    int count;
+
+    float *states;
+    int *actions;
+    float *rewards;
+    unsigned char *isEndStates;
+
+    // sumTree[1] is the root; node i has children 2i and 2i+1; slot i is leaf
+    // treeLeaves + i.  treeLeaves is capacity, rounded up to a power of two
+    // not allocated, unless prioritized
+    int treeLeaves;
+    float *sumTree;
+    float maxPriority;
+};
+
@@ -0,0 +1,74 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "array_helper.h"
+
+#include "TransitionQueue.h"
+
+using namespace std;
+
+TransitionQueue::TransitionQueue( int capacity, int stateSize ) :
+        capacity( capacity ),
+        stateSize( stateSize ),
+        numPushed( 0 ),
+        numPopped( 0 ) {
+    if( capacity <= 0 || stateSize <= 0 ) {
+        throw runtime_error("TransitionQueue: capacity and stateSize should be positive");
+    }
+    states = new float[ (long)capacity * 2 * stateSize ];
+    actions = new int[ capacity ];
+    rewards = new float[ capacity ];
+    isEndStates = new unsigned char[ capacity ];
+}
+TransitionQueue::~TransitionQueue() {
+    delete[] isEndStates;
+    delete[] rewards;
+    delete[] actions;
+    delete[] states;
+}
+// returns false, and drops the experience, if the queue is full
+bool TransitionQueue::push( float const *before, int action, float reward, bool isEndState, float const *after ) {
+    const long long pushed = numPushed.load( std::memory_order_relaxed );
+    // acquire: the consumer has finished reading the slot we are about to reuse
+    if( pushed - numPopped.load( std::memory_order_acquire ) >= capacity ) {
+        return false;
+    }
+    const int slot = (int)( pushed % capacity );
+    float *slotStates = states + (long)slot * 2 * stateSize;
+    arrayCopy( slotStates, before, stateSize );
+    arrayCopy( slotStates + stateSize, after, stateSize );
+    actions[slot] = action;
+    rewards[slot] = reward;
+    isEndStates[slot] = isEndState ? 1 : 0;
+    // release: the slot is written before the consumer can see it
+    numPushed.store( pushed + 1, std::memory_order_release );
+    return true;
+}
+// the pointers stay valid until pop
+bool TransitionQueue::peek( float const **before, int *action, float *reward, bool *isEndState, float const **after ) const {
+    const long long popped = numPopped.load( std::memory_order_relaxed );
+    if( popped == numPushed.load( std::memory_order_acquire ) ) {
+        return false;
+    }
+    const int slot = (int)( popped % capacity );
+    float const *slotStates = states + (long)slot * 2 * stateSize;
+    *before = slotStates;
+    *after = slotStates + stateSize;
+    *action = actions[slot];
+    *reward = rewards[slot];
+    *isEndState = isEndStates[slot] != 0;
+    return true;
+}
+void TransitionQueue::pop() {
+    numPopped.store( numPopped.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+// only a snapshot, since the other side might be pushing or popping
+int TransitionQueue::getSize() const {
+    return (int)( numPushed.load( std::memory_order_acquire ) - numPopped.load( std::memory_order_acquire ) );
+}
+
@@ -0,0 +1,44 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <atomic>
+
+#include "DeepCLDllExport.h"
+
+// fixed-capacity queue of experiences, from one producer thread to one
+// consumer thread, without locks: each side only writes its own counter
+// slots are laid out like ReplayMemory's, [slot][before/after][stateSize], and
+// allocated once.  push fails, rather than waits, when the queue is full
+class DeepCL_EXPORT TransitionQueue {
+public:
+    TransitionQueue( int capacity, int stateSize );
+    ~TransitionQueue();
+
+    // producer only:
+    bool push( float const *before, int action, float reward, bool isEndState, float const *after );
+
+    // consumer only: peek at the oldest experience, without copying it, then pop it
+    bool peek( float const **before, int *action, float *reward, bool *isEndState, float const **after ) const;
+    void pop();
+
+    int getCapacity() const { return capacity; }
+    int getSize() const;
+
+protected:
+    const int capacity;
+    const int stateSize;
+    float *states;
+    int *actions;
+    float *rewards;
+    unsigned char *isEndStates;
+
+    // count of experiences ever pushed, and ever popped; slot is count % capacity
+    std::atomic< long long > numPushed;
+    std::atomic< long long > numPopped;
+};
+
@@ -0,0 +1,58 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "Scenario.h"
+#include "ThreadPool.h"
+
+#include "VectorScenario.h"
+
+using namespace std;
+
+VectorScenario::VectorScenario( std::vector< Scenario * > const &scenarios ) :
+        scenarios( scenarios ),
+        parallel( false ) {
+    if( scenarios.size() == 0 ) {
+        throw runtime_error("VectorScenario: need at least one scenario");
+    }
+    size = scenarios[0]->getPerceptionSize();
+    planes = scenarios[0]->getPerceptionPlanes();
+    numActions = scenarios[0]->getNumActions();
+    for( int env = 1; env < (int)scenarios.size(); env++ ) {
+        if( scenarios[env]->getPerceptionSize() != size || scenarios[env]->getPerceptionPlanes() != planes
+                || scenarios[env]->getNumActions() != numActions ) {
+            throw runtime_error("VectorScenario: all scenarios should have the same perception size, planes and actions");
+        }
+    }
+}
+VectorScenario::~VectorScenario() {
+}
+void VectorScenario::getPerceptions( float *perceptions ) {
+    const int perceptionSize = planes * size * size;
+    for( int env = 0; env < (int)scenarios.size(); env++ ) {
+        scenarios[env]->getPerception( perceptions + (long)env * perceptionSize );
+    }
+}
+// finished[env] says whether env finished, and so has been reset
+void VectorScenario::act( int const *actions, float *rewards, bool *finished ) {
+    const int numEnvs = (int)scenarios.size();
+    ThreadPool::RangeFunction actRange = [&]( int begin, int end ) {
+        for( int env = begin; env < end; env++ ) {
+            rewards[env] = scenarios[env]->act( actions[env] );
+            finished[env] = scenarios[env]->hasFinished();
+            if( finished[env] ) {
+                scenarios[env]->reset();
+            }
+        }
+    };
+    if( parallel ) {
+        ThreadPool::instance()->parallelFor( numEnvs, actRange );
+    } else {
+        actRange( 0, numEnvs );
+    }
+}
+
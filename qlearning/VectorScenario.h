@@ -0,0 +1,43 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#include "DeepCLDllExport.h"
+
+class Scenario;
+
+// steps several instances of a scenario together, so that QLearner can choose
+// the actions for all of them in one batched forward pass
+// perceptions are [env][plane][row][col].  any environment that finishes is
+// reset straight away, like QLearner::run does with a single scenario
+// with setParallel( true ), the environments act on the thread pool, so each
+// Scenario instance must not share state with the others
+class DeepCL_EXPORT VectorScenario {
+public:
+    VectorScenario( std::vector< Scenario * > const &scenarios ); // scenarios NOT belong to us
+    virtual ~VectorScenario();
+
+    int getNumEnvs() const { return (int)scenarios.size(); }
+    Scenario *getScenario( int env ) { return scenarios[env]; }
+    int getPerceptionSize() const { return size; }
+    int getPerceptionPlanes() const { return planes; }
+    int getNumActions() const { return numActions; }
+    void setParallel( bool parallel ) { this->parallel = parallel; }
+
+    void getPerceptions( float *perceptions );
+    void act( int const *actions, float *rewards, bool *finished );
+
+protected:
+    std::vector< Scenario * > scenarios;
+    int size;
+    int planes;
+    int numActions;
+    bool parallel;
+};
+
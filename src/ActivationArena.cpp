@@ -0,0 +1,212 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include "OpenCLHelper.h"
+#include "Layer.h"
+#include "ZeroCopy.h"
+#include "stringhelper.h"
+
+#include "ActivationArena.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+// slots start on page boundaries, so each one can be used zero-copy
+#define SLOT_ALIGN_FLOATS 1024
+
+ActivationArena::ActivationArena( OpenCLHelper *cl ) :
+        cl( cl ),
+        batchSize( 0 ),
+        arena( 0 ),
+        arenaSize( 0 ),
+        scratch( 0 ),
+        scratchSize( 0 ),
+        scratchWrapper( 0 ) {
+}
+VIRTUAL ActivationArena::~ActivationArena() {
+    for( int i = 0; i < (int)slotWrappers.size(); i++ ) {
+        delete slotWrappers[i];
+    }
+    ZeroCopy::deallocate( arena );
+    if( scratchWrapper != 0 ) {
+        delete scratchWrapper;
+    }
+    ZeroCopy::deallocate( scratch );
+}
+// results of layer i are written during propagate of layer i, and last read
+// during propagate of layer lastUse[i]
+// layers with size 0 dont go in the arena, and get slot -1
+// greedy, in layer order: take the smallest free slot that is big enough,
+// otherwise grow the biggest free slot, otherwise open a new slot
+// returns the number of slots
+STATIC int ActivationArena::assignSlots( std::vector< int > const &lastUse, std::vector< int > const &sizes, std::vector< int > &slots, std::vector< int > &slotSizes ) {
+    const int numTensors = (int)sizes.size();
+    std::vector< int > slotFreeAfter; // slot can be reused by any layer after this one
+    slots.clear();
+    slotSizes.clear();
+    for( int i = 0; i < numTensors; i++ ) {
+        if( sizes[i] == 0 ) {
+            slots.push_back( -1 );
+            continue;
+        }
+        int bestFit = -1;
+        int biggest = -1;
+        for( int slot = 0; slot < (int)slotSizes.size(); slot++ ) {
+            if( slotFreeAfter[slot] >= i ) {
+                continue;
+            }
+            if( slotSizes[slot] >= sizes[i] && ( bestFit == -1 || slotSizes[slot] < slotSizes[bestFit] ) ) {
+                bestFit = slot;
+            }
+            if( biggest == -1 || slotSizes[slot] > slotSizes[biggest] ) {
+                biggest = slot;
+            }
+        }
+        int slot = bestFit != -1 ? bestFit : biggest;
+        if( slot == -1 ) {
+            slot = (int)slotSizes.size();
+            slotSizes.push_back( 0 );
+            slotFreeAfter.push_back( 0 );
+        }
+        slotSizes[slot] = std::max( slotSizes[slot], sizes[i] );
+        slotFreeAfter[slot] = lastUse[i];
+        slots.push_back( slot );
+    }
+    return (int)slotSizes.size();
+}
+// layers should already have had setInferenceOnly() called
+// replaces setBatchSize: each layer is given its batch size from here, and
+// batch sizes larger than this one are then refused
+void ActivationArena::plan( std::vector< Layer * > const &layers, int batchSize ) {
+    const int numLayers = (int)layers.size();
+    std::vector< int > sizes( numLayers );
+    std::vector< int > lastUse( numLayers );
+    for( int i = 0; i < numLayers; i++ ) {
+        Layer *layer = layers[i];
+        if( !layer->inferenceOnly ) {
+            throw runtime_error("ActivationArena::plan: layer " + toString(i) + " is not inference only");
+        }
+        sizes[i] = layer->canUseArena() ? getLayerResultsSize( layer, batchSize ) : 0;
+        lastUse[i] = i == numLayers - 1 ? numLayers : i + 1; // results of last layer stay alive
+    }
+    for( int i = numLayers - 1; i >= 1; i-- ) {
+        if( !layers[i]->canUseArena() ) {
+            lastUse[i - 1] = std::max( lastUse[i - 1], lastUse[i] );
+        }
+    }
+    assignSlots( lastUse, sizes, layerSlots, slotSizes );
+    allocate( layers, batchSize );
+}
+// for training with activation recomputation
+// layers 0, every, 2*every, ... are checkpoints, and keep their own results, as
+// do the last layer, and layers that dont need backprop (these might be random,
+// eg RandomTranslations, so cannot be recomputed)
+// the layers in between form segments, and the n-th layer of every segment goes
+// in slot n, so only one segment's results are held at any one time.  the
+// caller recomputes each segment, from the checkpoint below it, before
+// backpropping into it
+void ActivationArena::planCheckpoints( std::vector< Layer * > const &layers, int batchSize, int checkpointEvery ) {
+    if( checkpointEvery < 2 ) {
+        throw runtime_error("ActivationArena::planCheckpoints: checkpointEvery should be at least 2, but is " + toString(checkpointEvery) );
+    }
+    const int numLayers = (int)layers.size();
+    layerSlots.clear();
+    slotSizes.clear();
+    slotSizes.resize( checkpointEvery - 1, 0 );
+    for( int i = 0; i < numLayers; i++ ) {
+        Layer *layer = layers[i];
+        int slot = -1;
+        // a checkpoint that cant use the arena might still need its own input when the
+        // segment after it is recomputed (eg a convolution fused with the pooling
+        // after it), so that input is kept too
+        const bool inputOfCheckpoint = ( i + 1 ) % checkpointEvery == 0 && i + 1 < numLayers && !layers[i + 1]->canUseArena();
+        if( i % checkpointEvery != 0 && i != numLayers - 1 && layer->canUseArena() && layer->needsBackProp() && !inputOfCheckpoint ) {
+            slot = i % checkpointEvery - 1;
+            slotSizes[slot] = std::max( slotSizes[slot], getLayerResultsSize( layer, batchSize ) );
+        }
+        layerSlots.push_back( slot );
+    }
+    while( slotSizes.size() > 0 && slotSizes[ slotSizes.size() - 1 ] == 0 ) {
+        slotSizes.pop_back();
+    }
+    allocate( layers, batchSize );
+}
+STATIC int ActivationArena::getLayerResultsSize( Layer *layer, int batchSize ) {
+    const int imageSize = layer->getOutputImageSize();
+    return batchSize * layer->getOutputPlanes() * imageSize * imageSize;
+}
+// frees any previous arena, then allocates the slots in layerSlots and slotSizes,
+// and hands them out to the layers
+void ActivationArena::allocate( std::vector< Layer * > const &layers, int batchSize ) {
+    for( int i = 0; i < (int)slotWrappers.size(); i++ ) {
+        delete slotWrappers[i];
+    }
+    slotWrappers.clear();
+    ZeroCopy::deallocate( arena );
+    arena = 0;
+    if( scratchWrapper != 0 ) {
+        delete scratchWrapper;
+        scratchWrapper = 0;
+    }
+    ZeroCopy::deallocate( scratch );
+    scratch = 0;
+    scratchSize = 0;
+
+    this->batchSize = batchSize;
+    const int numLayers = (int)layers.size();
+    const int numSlots = (int)slotSizes.size();
+    arenaSize = 0;
+    slotOffsets.clear();
+    for( int slot = 0; slot < numSlots; slot++ ) {
+        slotOffsets.push_back( arenaSize );
+        arenaSize += ( ( slotSizes[slot] + SLOT_ALIGN_FLOATS - 1 ) / SLOT_ALIGN_FLOATS ) * SLOT_ALIGN_FLOATS;
+    }
+    arena = ZeroCopy::allocateFloats( arenaSize );
+    for( int slot = 0; slot < numSlots; slot++ ) {
+        // slots can be empty when planning checkpoints, if no layer at that offset can use them
+        slotWrappers.push_back( slotSizes[slot] == 0 ? 0 : ZeroCopy::wrap( cl, slotSizes[slot], arena + slotOffsets[slot] ) );
+    }
+    for( int i = 0; i < numLayers; i++ ) {
+        const int slot = layerSlots[i];
+        if( slot == -1 ) {
+            layers[i]->setBatchSize( batchSize );
+        } else {
+            layers[i]->setResultsBuffer( batchSize, arena + slotOffsets[slot], slotWrappers[slot] );
+        }
+    }
+
+    for( int i = 0; i < numLayers; i++ ) {
+        scratchSize = std::max( scratchSize, layers[i]->getScratchSize() );
+    }
+    if( scratchSize > 0 ) {
+        scratch = ZeroCopy::allocateBytes( scratchSize );
+        scratchWrapper = ZeroCopy::wrap( cl, scratchSize, scratch );
+        for( int i = 0; i < numLayers; i++ ) {
+            if( layers[i]->getScratchSize() > 0 ) {
+                layers[i]->setScratchBuffer( scratch, scratchWrapper );
+            }
+        }
+    }
+}
+int ActivationArena::getNumSlots() const {
+    return (int)slotSizes.size();
+}
+// in floats, excluding the scratch buffer
+int ActivationArena::getArenaSize() const {
+    return arenaSize;
+}
+int ActivationArena::getSlot( int layerIndex ) const {
+    return layerSlots[layerIndex];
+}
+
@@ -0,0 +1,67 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+class OpenCLHelper;
+class CLWrapper;
+class Layer;
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+// memory planner for inference-only nets
+// works out, for each layer, the span of layers during which its results
+// are still needed, and then packs all the results into a few slots of
+// one single aligned block, so that layers whose results are never needed
+// at the same time share the same slot
+// for a plain chain this gives two slots, used ping-pong fashion
+// there is one CLWrapper per slot, so the device side buffers are shared too
+// layers which dont accept an external results buffer keep their own, and we
+// assume they might alias their upstream results, so we keep those alive for
+// longer
+// pooling selectors are written during propagate, but only read during
+// backprop, so all pooling layers share a single scratch buffer for them
+// planCheckpoints is the training counterpart: see ActivationArena.cpp
+class DeepCL_EXPORT ActivationArena {
+public:
+    OpenCLHelper *cl; // NOT owned by us
+    int batchSize;
+
+    float *arena;
+    int arenaSize; // in floats
+    std::vector< int > slotOffsets;
+    std::vector< int > slotSizes;
+    std::vector< CLWrapper * > slotWrappers;
+    std::vector< int > layerSlots; // -1 means the layer keeps its own results
+
+    unsigned char *scratch;
+    int scratchSize; // in bytes
+    CLWrapper *scratchWrapper;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    ActivationArena( OpenCLHelper *cl );
+    VIRTUAL ~ActivationArena();
+    STATIC int assignSlots( std::vector< int > const &lastUse, std::vector< int > const &sizes, std::vector< int > &slots, std::vector< int > &slotSizes );
+    void plan( std::vector< Layer * > const &layers, int batchSize );
+    void planCheckpoints( std::vector< Layer * > const &layers, int batchSize, int checkpointEvery );
+    STATIC int getLayerResultsSize( Layer *layer, int batchSize );
+    void allocate( std::vector< Layer * > const &layers, int batchSize );
+    int getNumSlots() const;
+    int getArenaSize() const;
+    int getSlot( int layerIndex ) const;
+
+    // [[[end]]]
+};
+
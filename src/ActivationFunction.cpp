@@ -4,17 +4,17 @@
 
 using namespace std;
 
-ActivationFunction *ActivationFunction::fromName( std::string name ) {
+ActivationFunction *ActivationFunction::fromName( std::string name, bool fastMath ) {
     if( name == "tanh" ) {
-        return new TanhActivation();
+        return ( new TanhActivation() )->setFastMath( fastMath );
     } else if( name == "scaledtanh" ) {
-        return new ScaledTanhActivation();
+        return ( new ScaledTanhActivation() )->setFastMath( fastMath );
     } else if( name == "sigmoid" ) {
-        return new SigmoidActivation();
+        return ( new SigmoidActivation() )->setFastMath( fastMath );
     } else if( name == "linear" ) {
-        return new LinearActivation();
+        return ( new LinearActivation() )->setFastMath( fastMath );
     } else if( name == "relu" ) {
-        return new ReluActivation();
+        return ( new ReluActivation() )->setFastMath( fastMath );
     } else {
         throw std::runtime_error("activation " + name + " not known");
     }
@@ -11,24 +11,89 @@
 #include <cmath>
 
 #include "DeepCLDllExport.h"
+#include "FastMath.h"
 
 class DeepCL_EXPORT ActivationFunction {
+protected:
+    bool fastMath; // use the FastMath approximations, rather than the libm functions
 public:
+    ActivationFunction() :
+        fastMath( false ) {
+    }
     virtual ~ActivationFunction() {}
+    ActivationFunction *setFastMath( bool fastMath ) {
+        this->fastMath = fastMath;
+        return this;
+    }
+    bool isFastMath() const {
+        return fastMath;
+    }
+    // options for building kernels that use this activation
+    std::string getKernelDefines() const {
+        return "-D " + getDefineName() + ( fastMath ? " -D FAST_MATH" : "" );
+    }
     virtual float calc( float value ) const { throw std::runtime_error("calc not implemented"); };
     virtual float calcDerivative( float output ) const { throw std::runtime_error("calcDerivative not implemented"); };
     virtual float getFalse() const {  throw std::runtime_error("getFalse not implemented"); } 
     virtual float getTrue() const {  throw std::runtime_error("getTrue not implemented"); } 
     virtual std::string getDefineName() const { throw std::runtime_error("getDefineName not implemented"); } 
-    static ActivationFunction *fromName( std::string name );
+    // whole-array versions, so callers make one virtual call per array, rather than
+    // one per element.  subclasses of ActivationFunctionBatched override these with
+    // loops that have no calls in them
+    // inout[i] = calc( inout[i] )
+    virtual void calcArray( int N, float *inout ) const {
+        for( int i = 0; i < N; i++ ) {
+            inout[i] = calc( inout[i] );
+        }
+    }
+    // target[i] *= calcDerivative( outputs[i] )
+    virtual void multiplyByDerivative( int N, float *target, float const *outputs ) const {
+        for( int i = 0; i < N; i++ ) {
+            target[i] *= calcDerivative( outputs[i] );
+        }
+    }
+    static ActivationFunction *fromName( std::string name, bool fastMath = false );
 };
 
-class TanhActivation : public ActivationFunction {
+// Derived provides static inline activate( value ), activateFast( value ) and
+// derivative( output ), and the loops here get compiled once for each activation,
+// with those inlined, so they can be vectorized
+template< typename Derived >
+class ActivationFunctionBatched : public ActivationFunction {
 public:
     virtual float calc( float value ) const {
-        return tanh( value );
+        return fastMath ? Derived::activateFast( value ) : Derived::activate( value );
     }
     virtual float calcDerivative( float output ) const {
+        return Derived::derivative( output );
+    }
+    virtual void calcArray( int N, float *inout ) const {
+        if( fastMath ) {
+            for( int i = 0; i < N; i++ ) {
+                inout[i] = Derived::activateFast( inout[i] );
+            }
+        } else {
+            for( int i = 0; i < N; i++ ) {
+                inout[i] = Derived::activate( inout[i] );
+            }
+        }
+    }
+    virtual void multiplyByDerivative( int N, float *target, float const *outputs ) const {
+        for( int i = 0; i < N; i++ ) {
+            target[i] *= Derived::derivative( outputs[i] );
+        }
+    }
+};
+
+class TanhActivation : public ActivationFunctionBatched< TanhActivation > {
+public:
+    static inline float activate( float value ) {
+        return tanh( value );
+    }
+    static inline float activateFast( float value ) {
+        return FastMath::tanh( value );
+    }
+    static inline float derivative( float output ) {
         return 1 - output * output;
     }
     virtual float getTrue() const {
@@ -42,12 +107,15 @@ public:
     } 
 };
 
-class ScaledTanhActivation : public ActivationFunction {
+class ScaledTanhActivation : public ActivationFunctionBatched< ScaledTanhActivation > {
 public:
-    virtual float calc( float value ) const {
+    static inline float activate( float value ) {
         return 1.7159f * tanh( value * 0.66667f );
     }
-    virtual float calcDerivative( float output ) const {
+    static inline float activateFast( float value ) {
+        return 1.7159f * FastMath::tanh( value * 0.66667f );
+    }
+    static inline float derivative( float output ) {
         return 0.66667f * ( 1.7159f - 1 / 1.7159f * output * output );
     }
     virtual float getTrue() const {
@@ -61,12 +129,15 @@ public:
     } 
 };
 
-class SigmoidActivation : public ActivationFunction {
+class SigmoidActivation : public ActivationFunctionBatched< SigmoidActivation > {
 public:
-    virtual float calc( float value ) const {
+    static inline float activate( float value ) {
         return 1.0f / ( 1.0f + exp( - value ) );
     }
-    virtual float calcDerivative( float output ) const {
+    static inline float activateFast( float value ) {
+        return FastMath::sigmoid( value );
+    }
+    static inline float derivative( float output ) {
         return output * ( 1 - output );
     }
     virtual float getTrue() const {
@@ -80,12 +151,15 @@ public:
     } 
 };
 
-class LinearActivation : public ActivationFunction {
+class LinearActivation : public ActivationFunctionBatched< LinearActivation > {
 public:
-    virtual float calc( float value ) const {
+    static inline float activate( float value ) {
         return value;
     }
-    virtual float calcDerivative( float output ) const {
+    static inline float activateFast( float value ) {
+        return value;
+    }
+    static inline float derivative( float output ) {
         return 1;
     }
     virtual float getTrue() const {
@@ -99,12 +173,15 @@ public:
     } 
 };
 
-class ReluActivation : public ActivationFunction {
+class ReluActivation : public ActivationFunctionBatched< ReluActivation > {
 public:
-    virtual float calc( float value ) const {
+    static inline float activate( float value ) {
         return value > 0 ? value : 0;
     }
-    virtual float calcDerivative( float output ) const {
+    static inline float activateFast( float value ) {
+        return value > 0 ? value : 0;
+    }
+    static inline float derivative( float output ) {
         return output > 0 ? 1.0f : 0.0f;
     }
     virtual float getTrue() const {
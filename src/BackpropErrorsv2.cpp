@@ -12,6 +12,7 @@
 #include "BackpropErrorsv2Cpu.h"
 #include "BackpropErrorsv2Naive.h"
 #include "BackpropErrorsv2Cached.h"
+#include "BackpropErrorsv2FcGemm.h"
 
 #include "BackpropErrorsv2.h"
 
@@ -24,6 +25,9 @@ using namespace std;
 #define VIRTUAL 
 
 STATIC BackpropErrorsv2 *BackpropErrorsv2::instance(OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const *upstreamFn ) {
+    if( dim.isFullyConnected() ) {
+        return new BackpropErrorsv2FcGemm( cl, dim, upstreamFn );
+    }
     if( ( dim.inputImageSize - dim.filterSize > 6 ) && square( dim.inputImageSize ) <= cl->getMaxWorkgroupSize() ) {
 //        return new BackpropErrorsv2Naive( cl, dim, upstreamFn );
         return new BackpropErrorsv2Cached( cl, dim, upstreamFn );
@@ -44,6 +48,9 @@ STATIC BackpropErrorsv2 *BackpropErrorsv2::instanceSpecific( int idx, OpenCLHelp
     if( idx == 2 ) {
         return new BackpropErrorsv2Cached( cl, layerDimensions, upstreamFn );
     }
+    if( idx == 3 ) {
+        return new BackpropErrorsv2FcGemm( cl, layerDimensions, upstreamFn );
+    }
     throw std::runtime_error("backproperrorsv2::isntancespecifc, index not known: " + toString( idx ) );
 }
 BackpropErrorsv2::BackpropErrorsv2( OpenCLHelper *cl, LayerDimensions layerDimensions, ActivationFunction const *upstreamFn ) :
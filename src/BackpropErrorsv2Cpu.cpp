@@ -9,6 +9,8 @@
 #include "BackpropErrorsv2Cpu.h"
 #include "StatefulTimer.h"
 #include "stringhelper.h"
+#include "ZeroCopy.h"
+#include "Sgemm.h"
 
 using namespace std;
 
@@ -30,6 +32,14 @@ VIRTUAL float *BackpropErrorsv2Cpu::backpropErrors( int batchSize, float *inputD
 
 //        Timer timer;
     StatefulTimer::instance()->timeCheck("BackpropErrorsv2Cpu start" );
+    if( dim.isFullyConnected() ) {
+        // errorsForUpstream[n][k] = sum over filters of errors[n][filter] * weights[filter][k]
+        Sgemm::sgemm( false, false, batchSize, dim.inputCubeSize, dim.numFilters, 1.0f, errors, dim.numFilters,
+            weights, dim.inputCubeSize, 0.0f, errorsForUpstream, dim.inputCubeSize );
+        upstreamFn->multiplyByDerivative( batchSize * dim.inputCubeSize, errorsForUpstream, inputData );
+        StatefulTimer::instance()->timeCheck("BackpropErrorsv2Cpu end" );
+        return errorsForUpstream;
+    }
     const int halfFilterSize = dim.filterSize >> 1;
     const int margin = dim.padZeros ? halfFilterSize : 0;
     // handle lower layer...
@@ -51,12 +61,6 @@ VIRTUAL float *BackpropErrorsv2Cpu::backpropErrors( int batchSize, float *inputD
                 int maxFilterRow = std::min( dim.filterSize - 1, upstreamRow + margin );
                 for( int upstreamCol = 0; upstreamCol < dim.inputImageSize; upstreamCol++ ) {
                     float sumWeightTimesOutError = 0;
-                    int inputDataIndex = ( ( n
-                        * dim.inputPlanes + upstreamPlane )
-                        * dim.inputImageSize + upstreamRow )
-                        * dim.inputImageSize + upstreamCol;
-                    float inputValue = inputData[inputDataIndex];
-                    float activationDerivativeUpstream = upstreamFn->calcDerivative(inputValue);
                     // aggregate over [outPlane][outRow][outCol]
                     int minFilterCol = std::max( 0, upstreamCol + margin - (dim.outputImageSize -1) );
                     int maxFilterCol = std::min( dim.filterSize - 1, upstreamCol + margin );
@@ -83,11 +87,13 @@ VIRTUAL float *BackpropErrorsv2Cpu::backpropErrors( int batchSize, float *inputD
                         * dim.inputPlanes + upstreamPlane )
                         * dim.inputImageSize + upstreamRow )
                         * dim.inputImageSize + upstreamCol;
-                    errorsForUpstream[upstreamResultIndex] = sumWeightTimesOutError * activationDerivativeUpstream;
+                    errorsForUpstream[upstreamResultIndex] = sumWeightTimesOutError;
                 }
             }
         }
     }
+    // inputData and errorsForUpstream are both [n][inPlane][inRow][inCol]
+    upstreamFn->multiplyByDerivative( batchSize * dim.inputCubeSize, errorsForUpstream, inputData );
 //        timer.timeCheck("calced errors for upstream");   
     StatefulTimer::instance()->timeCheck("BackpropErrorsv2Cpu end" );
 
@@ -97,9 +103,9 @@ VIRTUAL void BackpropErrorsv2Cpu::backpropErrors( int batchSize,
         CLWrapper *inputDataWrapper, CLWrapper *errorsWrapper, CLWrapper *weightsWrapper,
         CLWrapper *errorsForUpstreamWrapper ) {
 
-    inputDataWrapper->copyToHost();
-    errorsWrapper->copyToHost();
-    weightsWrapper->copyToHost();
+    ZeroCopy::copyToHost( inputDataWrapper );
+    ZeroCopy::copyToHost( errorsWrapper );
+    ZeroCopy::copyToHost( weightsWrapper );
 //    float *biasWeights = 0;
 //    if( dim.biased ) {
 //        biasWeightsWrapper->copyToHost();
@@ -112,7 +118,7 @@ VIRTUAL void BackpropErrorsv2Cpu::backpropErrors( int batchSize,
     for( int i = 0; i < errorsForUpstreamWrapperSize; i++ ) {
         errorsForUpstreamHostArray[i] = errorsForUpstream[i];
     }
-    errorsForUpstreamWrapper->copyToDevice();
+    ZeroCopy::copyToDevice( errorsForUpstreamWrapper );
     delete[] errorsForUpstream;
 }
 
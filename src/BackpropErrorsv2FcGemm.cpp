@@ -0,0 +1,287 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "BackpropErrorsv2FcGemm.h"
+#include "StatefulTimer.h"
+#include "stringhelper.h"
+
+using namespace std;
+
+#undef STATIC
+#define STATIC
+
+#undef VIRTUAL
+#define VIRTUAL
+
+VIRTUAL BackpropErrorsv2FcGemm::~BackpropErrorsv2FcGemm() {
+    delete kernel;
+}
+VIRTUAL void BackpropErrorsv2FcGemm::backpropErrors( int batchSize,
+        CLWrapper *inputDataWrapper, CLWrapper *errorsWrapper, CLWrapper *weightsWrapper,
+        CLWrapper *errorsForUpstreamWrapper ) {
+    StatefulTimer::instance()->timeCheck("BackpropErrorsv2FcGemm start" );
+
+    kernel
+       ->in( batchSize )
+       ->in( inputDataWrapper )
+       ->in( errorsWrapper )
+       ->in( weightsWrapper )
+       ->out( errorsForUpstreamWrapper );
+    const int numTiles = ( ( batchSize + tileSize - 1 ) / tileSize ) * ( ( dim.inputCubeSize + tileSize - 1 ) / tileSize );
+    const int workgroupSize = tileSize * tileSize;
+    kernel->run_1d( numTiles * workgroupSize, workgroupSize );
+    cl->finish();
+
+    StatefulTimer::instance()->timeCheck("BackpropErrorsv2FcGemm end" );
+}
+BackpropErrorsv2FcGemm::BackpropErrorsv2FcGemm( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const *upstreamFn ) :
+        BackpropErrorsv2( cl, dim, upstreamFn )
+            {
+    if( !dim.isFullyConnected() ) {
+        throw runtime_error("For BackpropErrorsv2FcGemm, filtersize and inputimagesize must be identical, and padzeros and skip must be disabled");
+    }
+    tileSize = cl->getMaxWorkgroupSize() >= 256 ? 16 : 8;
+
+    std::string options = dim.buildOptionsString();
+    options += " -D " + upstreamFn->getDefineName();
+    options += " -D gInputCubeSize=" + toString( dim.inputCubeSize );
+    options += " -D gTileSize=" + toString( tileSize );
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2( "kernel", "cl/fc_gemm.cl", "fc_backprop_errors", 'options' )
+    // ]]]
+    // generated using cog, from cl/fc_gemm.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n" 
+    "//\n" 
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n" 
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n" 
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n" 
+    "\n" 
+    "// fully-connected layers, as plain matrix multiplies\n" 
+    "//\n" 
+    "// expected defines:\n" 
+    "//  - gNumFilters, gInputCubeSize\n" 
+    "//  - gTileSize: workgroups are gTileSize * gTileSize threads, each computing one\n" 
+    "//    element of a gTileSize * gTileSize output tile\n" 
+    "//  - one of: [ TANH | RELU | LINEAR | SIGMOID | SCALEDTANH ]\n" 
+    "//    (activation of this layer for fc_propagate, activation of the layer below\n" 
+    "//    for fc_backprop_errors)\n" 
+    "//  - optional: FAST_MATH, to use approximations in place of tanh and exp\n" 
+    "//  - gGemvWorkgroupSize, a power of two: for fc_propagate_gemv only\n" 
+    "//\n" 
+    "// if we call numFilters N, and inputCubeSize K, then:\n" 
+    "//   images:  [n][K]   (ie [n][inputPlane][inputRow][inputCol])\n" 
+    "//   weights: [N][K]   (ie [filter][inputPlane][filterRow][filterCol], same as for convolution)\n" 
+    "//   results: [n][N]\n" 
+    "//   errors:  [n][N]\n" 
+    "//   errorsForUpstream: [n][K]\n" 
+    "\n" 
+    "#ifdef FAST_MATH\n" 
+    "// same approximation as FastMath::tanh, 13/6 rational, max error 5e-7\n" 
+    "float approx_tanh( float x ) {\n" 
+    "    x = clamp( x, -7.90531111f, 7.90531111f );\n" 
+    "    const float x2 = x * x;\n" 
+    "    float p = -2.76076847742355e-16f;\n" 
+    "    p = p * x2 + 2.00018790482477e-13f;\n" 
+    "    p = p * x2 - 8.60467152213735e-11f;\n" 
+    "    p = p * x2 + 5.12229709037114e-08f;\n" 
+    "    p = p * x2 + 1.48572235717979e-05f;\n" 
+    "    p = p * x2 + 6.37261928875436e-04f;\n" 
+    "    p = p * x2 + 4.89352455891786e-03f;\n" 
+    "    p = p * x;\n" 
+    "    float q = 1.19825839466702e-06f;\n" 
+    "    q = q * x2 + 1.18534705686654e-04f;\n" 
+    "    q = q * x2 + 2.26843463243900e-03f;\n" 
+    "    q = q * x2 + 4.89352518554385e-03f;\n" 
+    "    return p / q;\n" 
+    "}\n" 
+    "    #define TANH_FUNCTION(x) (approx_tanh(x))\n" 
+    "    #define SIGMOID_FUNCTION(x) (0.5f + 0.5f * approx_tanh(0.5f * (x)))\n" 
+    "#else\n" 
+    "    #define TANH_FUNCTION(x) (tanh(x))\n" 
+    "    #define SIGMOID_FUNCTION(x) (1.0f / (1 + exp(-(x))))\n" 
+    "#endif\n" 
+    "\n" 
+    "#ifdef TANH\n" 
+    "    #define ACTIVATION_FUNCTION(output) (TANH_FUNCTION(output))\n" 
+    "    #define ACTIVATION_DERIV(output) (1 - output * output)\n" 
+    "#elif defined SCALEDTANH\n" 
+    "    #define ACTIVATION_FUNCTION(output) ( 1.7159f * TANH_FUNCTION( 0.66667f * output))\n" 
+    "    #define ACTIVATION_DERIV(output) ( 0.66667f * ( 1.7159f - 1 / 1.7159f * output * output ) )\n" 
+    "#elif defined SIGMOID\n" 
+    "    #define ACTIVATION_FUNCTION(output) (SIGMOID_FUNCTION(output))\n" 
+    "    #define ACTIVATION_DERIV(output) (output * ( 1 - output ) )\n" 
+    "#elif defined RELU\n" 
+    "    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : 0)\n" 
+    "    #define ACTIVATION_DERIV(output) (output > 0 ? 1 : 0)\n" 
+    "#elif defined LINEAR\n" 
+    "    #define ACTIVATION_FUNCTION(output) (output)\n" 
+    "    #define ACTIVATION_DERIV(output) (1.0f)\n" 
+    "#endif\n" 
+    "\n" 
+    "// workgroup id organized like: [outTileRow][outTileCol]\n" 
+    "// local id organized like: [row within tile][col within tile]\n" 
+    "// numOutCols is the number of columns of the output matrix, so we can find our tile\n" 
+    "#define TILE_IDS( numOutCols ) \\\n" 
+    "    const int localId = get_local_id(0); \\\n" 
+    "    const int tx = localId % gTileSize; \\\n" 
+    "    const int ty = localId / gTileSize; \\\n" 
+    "    const int numTileCols = ( numOutCols + gTileSize - 1 ) / gTileSize; \\\n" 
+    "    const int row0 = ( get_group_id(0) / numTileCols ) * gTileSize; \\\n" 
+    "    const int col0 = ( get_group_id(0) % numTileCols ) * gTileSize;\n" 
+    "\n" 
+    "#ifdef ACTIVATION_FUNCTION // protect against not defined\n" 
+    "// results = activation( images . weights^T + bias )\n" 
+    "// output tile is [n][filter], and we reduce over K\n" 
+    "void kernel fc_propagate( const int batchSize,\n" 
+    "        global const float *images, global const float *weights,\n" 
+    "        #ifdef BIASED\n" 
+    "        global const float *biasWeights,\n" 
+    "        #endif\n" 
+    "        global float *results ) {\n" 
+    "    local float _images[gTileSize][gTileSize + 1];\n" 
+    "    local float _weights[gTileSize][gTileSize + 1];\n" 
+    "    TILE_IDS( gNumFilters )\n" 
+    "\n" 
+    "    const int n = row0 + ty;\n" 
+    "    const int filter = col0 + tx;\n" 
+    "    float sum = 0;\n" 
+    "    for( int k0 = 0; k0 < gInputCubeSize; k0 += gTileSize ) {\n" 
+    "        const int k = k0 + tx;\n" 
+    "        _images[ty][tx] = ( row0 + ty < batchSize && k < gInputCubeSize ) ? images[ ( row0 + ty ) * gInputCubeSize + k ] : 0.0f;\n" 
+    "        _weights[ty][tx] = ( col0 + ty < gNumFilters && k < gInputCubeSize ) ? weights[ ( col0 + ty ) * gInputCubeSize + k ] : 0.0f;\n" 
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+    "        for( int kk = 0; kk < gTileSize; kk++ ) {\n" 
+    "            sum += _images[ty][kk] * _weights[tx][kk];\n" 
+    "        }\n" 
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+    "    }\n" 
+    "    if( n < batchSize && filter < gNumFilters ) {\n" 
+    "        #ifdef BIASED\n" 
+    "        sum += biasWeights[filter];\n" 
+    "        #endif\n" 
+    "        results[ n * gNumFilters + filter ] = ACTIVATION_FUNCTION( sum );\n" 
+    "    }\n" 
+    "}\n" 
+    "#endif\n" 
+    "\n" 
+    "#if defined(ACTIVATION_FUNCTION) && defined(gGemvWorkgroupSize)\n" 
+    "// same as fc_propagate, but for batch sizes of one, or a few, where most of a\n" 
+    "// gTileSize * gTileSize tile would be padding: a matrix-vector multiply per image\n" 
+    "// one workgroup per: [n][filter].  each thread sums every gGemvWorkgroupSize'th\n" 
+    "// product, so neighbouring threads read neighbouring weights, then the partial\n" 
+    "// sums are added up in local memory\n" 
+    "void kernel fc_propagate_gemv( const int batchSize,\n" 
+    "        global const float *images, global const float *weights,\n" 
+    "        #ifdef BIASED\n" 
+    "        global const float *biasWeights,\n" 
+    "        #endif\n" 
+    "        global float *results ) {\n" 
+    "    local float _sums[gGemvWorkgroupSize];\n" 
+    "    const int localId = get_local_id(0);\n" 
+    "    const int n = get_group_id(0) / gNumFilters;\n" 
+    "    const int filter = get_group_id(0) % gNumFilters;\n" 
+    "\n" 
+    "    global const float *image = images + n * gInputCubeSize;\n" 
+    "    global const float *filterWeights = weights + filter * gInputCubeSize;\n" 
+    "    float sum = 0;\n" 
+    "    for( int k = localId; k < gInputCubeSize; k += gGemvWorkgroupSize ) {\n" 
+    "        sum += image[k] * filterWeights[k];\n" 
+    "    }\n" 
+    "    _sums[localId] = sum;\n" 
+    "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+    "    for( int stride = gGemvWorkgroupSize >> 1; stride > 0; stride >>= 1 ) {\n" 
+    "        if( localId < stride ) {\n" 
+    "            _sums[localId] += _sums[localId + stride];\n" 
+    "        }\n" 
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+    "    }\n" 
+    "    if( localId == 0 ) {\n" 
+    "        sum = _sums[0];\n" 
+    "        #ifdef BIASED\n" 
+    "        sum += biasWeights[filter];\n" 
+    "        #endif\n" 
+    "        results[ n * gNumFilters + filter ] = ACTIVATION_FUNCTION( sum );\n" 
+    "    }\n" 
+    "}\n" 
+    "#endif\n" 
+    "\n" 
+    "// weights -= learningMultiplier * errors^T . images\n" 
+    "// output tile is [filter][k], and we reduce over n\n" 
+    "void kernel fc_backprop_weights( const int batchSize, const float learningMultiplier,\n" 
+    "        global const float *errors, global const float *images, global float *weights ) {\n" 
+    "    local float _errors[gTileSize][gTileSize + 1];\n" 
+    "    local float _images[gTileSize][gTileSize + 1];\n" 
+    "    TILE_IDS( gInputCubeSize )\n" 
+    "\n" 
+    "    const int filter = row0 + ty;\n" 
+    "    const int k = col0 + tx;\n" 
+    "    float sum = 0;\n" 
+    "    for( int n0 = 0; n0 < batchSize; n0 += gTileSize ) {\n" 
+    "        const int n = n0 + ty;\n" 
+    "        _errors[ty][tx] = ( n < batchSize && row0 + tx < gNumFilters ) ? errors[ n * gNumFilters + row0 + tx ] : 0.0f;\n" 
+    "        _images[ty][tx] = ( n < batchSize && k < gInputCubeSize ) ? images[ n * gInputCubeSize + k ] : 0.0f;\n" 
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+    "        for( int nn = 0; nn < gTileSize; nn++ ) {\n" 
+    "            sum += _errors[nn][ty] * _images[nn][tx];\n" 
+    "        }\n" 
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+    "    }\n" 
+    "    if( filter < gNumFilters && k < gInputCubeSize ) {\n" 
+    "        weights[ filter * gInputCubeSize + k ] -= learningMultiplier * sum;\n" 
+    "    }\n" 
+    "}\n" 
+    "\n" 
+    "// one thread per filter\n" 
+    "void kernel fc_backprop_bias( const int batchSize, const float learningMultiplier,\n" 
+    "        global const float *errors, global float *biasWeights ) {\n" 
+    "    const int filter = get_global_id(0);\n" 
+    "    if( filter >= gNumFilters ) {\n" 
+    "        return;\n" 
+    "    }\n" 
+    "    float sum = 0;\n" 
+    "    for( int n = 0; n < batchSize; n++ ) {\n" 
+    "        sum += errors[ n * gNumFilters + filter ];\n" 
+    "    }\n" 
+    "    biasWeights[filter] -= learningMultiplier * sum;\n" 
+    "}\n" 
+    "\n" 
+    "#ifdef ACTIVATION_DERIV // protect against not defined\n" 
+    "// errorsForUpstream = ( errors . weights ) * activationderiv( images )\n" 
+    "// output tile is [n][k], and we reduce over filters\n" 
+    "void kernel fc_backprop_errors( const int batchSize,\n" 
+    "        global const float *images, global const float *errors, global const float *weights,\n" 
+    "        global float *errorsForUpstream ) {\n" 
+    "    local float _errors[gTileSize][gTileSize + 1];\n" 
+    "    local float _weights[gTileSize][gTileSize + 1];\n" 
+    "    TILE_IDS( gInputCubeSize )\n" 
+    "\n" 
+    "    const int n = row0 + ty;\n" 
+    "    const int k = col0 + tx;\n" 
+    "    float sum = 0;\n" 
+    "    for( int filter0 = 0; filter0 < gNumFilters; filter0 += gTileSize ) {\n" 
+    "        _errors[ty][tx] = ( n < batchSize && filter0 + tx < gNumFilters ) ? errors[ n * gNumFilters + filter0 + tx ] : 0.0f;\n" 
+    "        _weights[ty][tx] = ( filter0 + ty < gNumFilters && k < gInputCubeSize ) ? weights[ ( filter0 + ty ) * gInputCubeSize + k ] : 0.0f;\n" 
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+    "        for( int ff = 0; ff < gTileSize; ff++ ) {\n" 
+    "            sum += _errors[ty][ff] * _weights[ff][tx];\n" 
+    "        }\n" 
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+    "    }\n" 
+    "    if( n < batchSize && k < gInputCubeSize ) {\n" 
+    "        const int index = n * gInputCubeSize + k;\n" 
+    "        errorsForUpstream[index] = sum * ACTIVATION_DERIV( images[index] );\n" 
+    "    }\n" 
+    "}\n" 
+    "#endif\n" 
+    "\n" 
+    "";
+    kernel = cl->buildKernelFromString( kernelSource, "fc_backprop_errors", options, "cl/fc_gemm.cl" );
+    // [[[end]]]
+}
+
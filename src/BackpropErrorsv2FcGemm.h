@@ -0,0 +1,36 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "BackpropErrorsv2.h"
+#include "OpenCLHelper.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// fully-connected error backprop, as a tiled matrix multiply: errorsForUpstream = errors . weights,
+// times the upstream activation derivative, in the same kernel
+// only handles layers where dim.isFullyConnected()
+class BackpropErrorsv2FcGemm : public BackpropErrorsv2 {
+public:
+    CLKernel *kernel;
+    int tileSize;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    VIRTUAL ~BackpropErrorsv2FcGemm();
+    VIRTUAL void backpropErrors( int batchSize,
+    CLWrapper *inputDataWrapper, CLWrapper *errorsWrapper, CLWrapper *weightsWrapper,
+    CLWrapper *errorsForUpstreamWrapper );
+    BackpropErrorsv2FcGemm( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const *upstreamFn );
+
+    // [[[end]]]
+};
+
@@ -15,6 +15,8 @@
 #include "BackpropWeights2Naive.h"
 #include "BackpropWeights2Scratch.h"
 #include "BackpropWeights2ScratchLarge.h"
+#include "BackpropWeights2FcGemm.h"
+#include "ZeroCopy.h"
 
 using namespace std;
 
@@ -29,7 +31,22 @@ BackpropWeights2::BackpropWeights2( OpenCLHelper *cl, LayerDimensions layerDimen
         dim( layerDimensions ),
         debug( false ) {
 }
+// number of multiply-adds per example, below which the cpu may update the
+// weights, on gpus
+#define HOST_WEIGHTS_MAX_WORK 4096
+
+// for tiny layers, launching the kernels costs more than the sums, and on the
+// host, the update runs alongside the gpu working out the errors of the layers
+// below, see NeuralNet::setTinyLayerWeightsOnHost.  not on cpu opencl devices,
+// or others sharing memory with the host, since the cpu is busy there anyway
+STATIC bool BackpropWeights2::suitsHost( OpenCLHelper *cl, LayerDimensions dim ) {
+    return square( dim.outputImageSize ) * dim.filtersSize <= HOST_WEIGHTS_MAX_WORK
+        && !ZeroCopy::isHostUnifiedMemory( cl );
+}
 STATIC BackpropWeights2 *BackpropWeights2::instance(OpenCLHelper *cl, LayerDimensions dim ) {
+    if( dim.isFullyConnected() ) {
+        return new BackpropWeights2FcGemm( cl, dim );
+    }
     if( dim.inputImageSize - dim.filterSize < 4 ) {
         return new BackpropWeights2Naive( cl, dim );
     }
@@ -67,6 +84,9 @@ STATIC BackpropWeights2 *BackpropWeights2::instanceSpecific( int idx, OpenCLHelp
     if( idx == 3 ) {
         return new BackpropWeights2ScratchLarge( cl, layerDimensions );
     }
+    if( idx == 4 ) {
+        return new BackpropWeights2FcGemm( cl, layerDimensions );
+    }
     throw std::runtime_error("BackpropWeights::instanceSpecific doesnt handle idx " + toString(idx) );
 }
 
@@ -32,6 +32,7 @@ public:
     // ]]]
     // generated, using cog:
     BackpropWeights2( OpenCLHelper *cl, LayerDimensions layerDimensions );
+    STATIC bool suitsHost( OpenCLHelper *cl, LayerDimensions dim );
     STATIC BackpropWeights2 *instance(OpenCLHelper *cl, LayerDimensions dim );
     STATIC BackpropWeights2 *instanceForTest(OpenCLHelper *cl, LayerDimensions layerDimensions );
     STATIC BackpropWeights2 *instanceSpecific( int idx, OpenCLHelper *cl, LayerDimensions layerDimensions );
@@ -7,6 +7,8 @@
 #include "BackpropWeights2Cpu.h"
 #include "StatefulTimer.h"
 #include "stringhelper.h"
+#include "ZeroCopy.h"
+#include "Sgemm.h"
 
 using namespace std;
 
@@ -23,18 +25,18 @@ BackpropWeights2Cpu::BackpropWeights2Cpu( OpenCLHelper *cl, LayerDimensions dim
 VIRTUAL BackpropWeights2Cpu::~BackpropWeights2Cpu() {
 }
 VIRTUAL void BackpropWeights2Cpu::backpropWeights( int batchSize, float learningRate,  CLWrapper *derivLossBySumWrapper, CLWrapper *imagesWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper ) {
-    derivLossBySumWrapper->copyToHost();
-    imagesWrapper->copyToHost();
+    ZeroCopy::copyToHost( derivLossBySumWrapper );
+    ZeroCopy::copyToHost( imagesWrapper );
     float *biasWeights = 0;
     if( dim.biased ) {
-        biasWeightsWrapper->copyToHost();
+        ZeroCopy::copyToHost( biasWeightsWrapper );
         biasWeights =  (float *)biasWeightsWrapper->getHostArray();
     }
     backpropWeights( batchSize, learningRate, (float *)derivLossBySumWrapper->getHostArray(), (float *)imagesWrapper->getHostArray(),
         (float *)weightsWrapper->getHostArray(), biasWeights );
-    weightsWrapper->copyToDevice();
+    ZeroCopy::copyToDevice( weightsWrapper );
     if( dim.biased ) {
-        biasWeightsWrapper->copyToDevice();
+        ZeroCopy::copyToDevice( biasWeightsWrapper );
     }
 }
 VIRTUAL void BackpropWeights2Cpu::backpropWeights( int batchSize, float learningRate, float *derivLossBySum,
@@ -44,6 +46,23 @@ VIRTUAL void BackpropWeights2Cpu::backpropWeights( int batchSize, float learning
 
     const float learningMultiplier = learningRateToMultiplier( batchSize, learningRate );
 
+    if( dim.isFullyConnected() ) {
+        // weights[filter][k] -= learningMultiplier * sum over n of derivLossBySum[n][filter] * images[n][k]
+        Sgemm::sgemm( true, false, dim.numFilters, dim.inputCubeSize, batchSize, - learningMultiplier, derivLossBySum, dim.numFilters,
+            images, dim.inputCubeSize, 1.0f, weights, dim.inputCubeSize );
+        if( dim.biased ) {
+            for( int filter = 0; filter < dim.numFilters; filter++ ) {
+                float thisBiasChange = 0;
+                for( int n = 0; n < batchSize; n++ ) {
+                    thisBiasChange += derivLossBySum[ n * dim.numFilters + filter ];
+                }
+                biasWeights[ filter ] += - learningMultiplier * thisBiasChange;
+            }
+        }
+        StatefulTimer::instance()->timeCheck(" BackpropWeights2Cpu end" );
+        return;
+    }
+
     const int halfFilterSize = dim.filterSize >> 1;
     const int margin = dim.padZeros ? halfFilterSize : 0;
     for( int outPlane = 0; outPlane < dim.numFilters; outPlane++ ) {
@@ -0,0 +1,33 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "BackpropWeights2.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// fully-connected weight update, as a tiled matrix multiply: weights -= rate * errors^T . images
+// only handles layers where dim.isFullyConnected()
+class BackpropWeights2FcGemm : public BackpropWeights2 {
+public:
+    CLKernel *kernel;
+    CLKernel *kernelBias;
+    int tileSize;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    VIRTUAL ~BackpropWeights2FcGemm();
+    VIRTUAL void backpropWeights( int batchSize, float learningRate,  CLWrapper *errorsWrapper, CLWrapper *imagesWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper );
+    BackpropWeights2FcGemm( OpenCLHelper *cl, LayerDimensions dim );
+
+    // [[[end]]]
+};
+
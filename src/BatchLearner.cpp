@@ -8,6 +8,8 @@
 #include "NeuralNet.h"
 #include "AccuracyHelper.h"
 #include "Trainable.h"
+#include "NetLearner.h"
+#include "ResumeState.h"
 
 #include "BatchLearner.h"
 
@@ -39,8 +41,15 @@ void NetBackpropBatch<T>::run( Trainable *net, T *batchData, int const*batchLabe
 template< typename T > BatchLearner<T>::BatchLearner( Trainable *net ) :
     net( net ) {
 }
+template< typename T > void BatchLearner<T>::addPostBatchAction( PostBatchAction *action ) {
+    postBatchActions.push_back( action );
+}
 
 template< typename T > EpochResult BatchLearner<T>::batchedNetAction( int batchSize, int N, T *data, int const*labels, NetAction<T> *netAction ) {
+    return batchedNetAction( batchSize, N, data, labels, netAction, 0 );
+}
+// if progress isnt 0, adds each batch to it, then runs the postBatchActions
+template< typename T > EpochResult BatchLearner<T>::batchedNetAction( int batchSize, int N, T *data, int const*labels, NetAction<T> *netAction, ResumeState *progress ) {
     int numRight = 0;
     float loss = 0;
     int thisBatchSize = batchSize;
@@ -54,10 +63,19 @@ template< typename T > EpochResult BatchLearner<T>::batchedNetAction( int batchS
             net->setBatchSize( thisBatchSize );
         }
         netAction->run( net, &(data[ batchStart * inputCubeSize ]), &(labels[batchStart]) );
-        loss += net->calcLossFromLabels( &(labels[batchStart]) );
+        float thisLoss = net->calcLossFromLabels( &(labels[batchStart]) );
+        loss += thisLoss;
         int thisNumRight = net->calcNumRight( &(labels[batchStart]) );
         numRight += thisNumRight;
 //        cout << "batchlearner batch=" << batch << " thisbatchsize=" << thisBatchSize << " thisnumright " << thisNumRight << " numright=" << numRight << " batchstart=" << batchStart << endl;
+        if( progress != 0 ) {
+            progress->batch++;
+            progress->numRight += thisNumRight;
+            progress->loss += thisLoss;
+            for( int i = 0; i < (int)postBatchActions.size(); i++ ) {
+                postBatchActions[i]->run( *progress );
+            }
+        }
     }
     EpochResult epochResult( loss, numRight );
     return epochResult;
@@ -94,6 +112,18 @@ template< typename T > EpochResult BatchLearner<T>::runEpochFromLabels( float le
     delete action;
     return epochResult;
 }
+// carries on from progress->batch, and returns the totals for the whole epoch,
+// including the batches learnt before
+template< typename T > EpochResult BatchLearner<T>::runEpochFromLabels( float learningRate, int batchSize, int Ntrain, T *trainData, int const*trainLabels, ResumeState *progress ) {
+    net->setTraining( true );
+    const int startN = std::min( Ntrain, progress->batch * batchSize );
+    const int inputCubeSize = net->getInputCubeSize();
+    NetAction<T> *action = new NetLearnLabeledBatch<T>( learningRate );
+    batchedNetAction( batchSize, Ntrain - startN, trainData + (long)startN * inputCubeSize, trainLabels + startN, action, progress );
+    delete action;
+    EpochResult epochResult( progress->loss, progress->numRight );
+    return epochResult;
+}
 
 template< typename T > float BatchLearner<T>::runEpochFromExpected( float learningRate, int batchSize, int N, T *data, float *expectedResults ) {
     net->setTraining( true );
@@ -10,8 +10,12 @@
 #include <iostream>
 #include <stdexcept>
 
+#include <vector>
+
 class NeuralNet;
 class Trainable;
+class PostBatchAction;
+class ResumeState;
 
 #define VIRTUAL virtual
 #define STATIC static
@@ -70,6 +74,7 @@ template< typename T>
 class DeepCL_EXPORT BatchLearner {
 public:
     Trainable *net; // NOT owned by us, dont delete
+    std::vector< PostBatchAction * > postBatchActions; // NOT owned by us; run after each batch, when there is a ResumeState to update
 
     // [[[cog
     // import cog_addheaders
@@ -77,11 +82,14 @@ public:
     // ]]]
     // generated, using cog:
     BatchLearner( Trainable *net );
+    void addPostBatchAction( PostBatchAction *action );
     EpochResult batchedNetAction( int batchSize, int N, T *data, int const*labels, NetAction<T> *netAction );
+    EpochResult batchedNetAction( int batchSize, int N, T *data, int const*labels, NetAction<T> *netAction, ResumeState *progress );
     int test( int batchSize, int N, T *testData, int const*testLabels );
     int propagateForTrain( int batchSize, int N, T *data, int const*labels );
     EpochResult backprop( float learningRate, int batchSize, int N, T *data, int const*labels );
     EpochResult runEpochFromLabels( float learningRate, int batchSize, int Ntrain, T *trainData, int const*trainLabels );
+    EpochResult runEpochFromLabels( float learningRate, int batchSize, int Ntrain, T *trainData, int const*trainLabels, ResumeState *progress );
     float runEpochFromExpected( float learningRate, int batchSize, int N, T *data, float *expectedResults );
 
     // [[[end]]]
@@ -10,6 +10,7 @@
 #include "Trainable.h"
 #include "GenericLoader.h"
 #include "BatchLearner.h"
+#include "ResumeState.h"
 
 #include "BatchLearnerOnDemand.h"
 
@@ -24,25 +25,39 @@ template< typename T > BatchLearnerOnDemand<T>::BatchLearnerOnDemand( Trainable
     net( net ) {
 }
 
+template< typename T > void BatchLearnerOnDemand<T>::addPostBatchAction( PostBatchAction *action ) {
+    postBatchActions.push_back( action );
+}
 template< typename T > EpochResult BatchLearnerOnDemand<T>::batchedNetAction( std::string filepath, int fileReadBatches, int batchSize, int N, NetAction<T> *netAction ) {
+    return batchedNetAction( filepath, fileReadBatches, batchSize, 0, N, netAction, 0 );
+}
+// examples startN to N of the file.  if progress isnt 0, each batch is added
+// to it, then the postBatchActions are run
+template< typename T > EpochResult BatchLearnerOnDemand<T>::batchedNetAction( std::string filepath, int fileReadBatches, int batchSize, int startN, int N, NetAction<T> *netAction, ResumeState *progress ) {
     int numRight = 0;
     float loss = 0;
+    if( startN >= N ) {
+        return EpochResult( loss, numRight );
+    }
     int fileBatchSize = batchSize * fileReadBatches;
-    fileBatchSize = fileBatchSize > N ? N : fileBatchSize;
+    fileBatchSize = fileBatchSize > N - startN ? N - startN : fileBatchSize;
     int inputCubeSize = net->getInputCubeSize();
     T *dataBuffer = new T[ fileBatchSize * inputCubeSize ];
     int *labelsBuffer = new int[ fileBatchSize * inputCubeSize ];
-    int numFileBatches = ( N + fileBatchSize - 1 ) / fileBatchSize;
+    int numFileBatches = ( N - startN + fileBatchSize - 1 ) / fileBatchSize;
     int thisFileBatchSize = fileBatchSize;
     BatchLearner<unsigned char> batchLearner( net );
+    for( int i = 0; i < (int)postBatchActions.size(); i++ ) {
+        batchLearner.addPostBatchAction( postBatchActions[i] );
+    }
     for( int fileBatch = 0; fileBatch < numFileBatches; fileBatch++ ) {
-        int fileBatchStart = fileBatch * fileBatchSize;
+        int fileBatchStart = startN + fileBatch * fileBatchSize;
         if( fileBatch == numFileBatches - 1 ) {
             thisFileBatchSize = N - fileBatchStart;
         }
         GenericLoader::load( filepath, dataBuffer, labelsBuffer, fileBatchStart, thisFileBatchSize );
 //        GenericLoader::load( filepath, dataBuffer, labelsBuffer );
-        EpochResult epochResult = batchLearner.batchedNetAction( batchSize, thisFileBatchSize, dataBuffer, labelsBuffer, netAction );
+        EpochResult epochResult = batchLearner.batchedNetAction( batchSize, thisFileBatchSize, dataBuffer, labelsBuffer, netAction, progress );
         loss += epochResult.loss;
         numRight += epochResult.numRight;
 //        cout << "fileBatch " << fileBatch << " batchSize " << batchSize << " filebatchsize " << fileBatchSize << " filebatchStart " << fileBatchStart << " thisFileBatchSize " << thisFileBatchSize << " numRight " << epochResult.numRight << endl;
@@ -52,7 +67,6 @@ template< typename T > EpochResult BatchLearnerOnDemand<T>::batchedNetAction( st
     delete[] labelsBuffer;
     return epochResult;
 }
-
 template< typename T > int BatchLearnerOnDemand<T>::test( std::string filepath, int fileReadBatches, int batchSize, int Ntest ) {
     net->setTraining( false );
     NetAction<T> *action = new NetPropagateBatch<T>();
@@ -68,6 +82,17 @@ template< typename T > EpochResult BatchLearnerOnDemand<T>::runEpochFromLabels(
     delete action;
     return epochResult;
 }
+// carries on from progress->batch, reading the file from there, and returns
+// the totals for the whole epoch, including the batches learnt before
+template< typename T > EpochResult BatchLearnerOnDemand<T>::runEpochFromLabels( float learningRate, std::string filepath, int fileReadBatches, int batchSize, int Ntrain, ResumeState *progress ) {
+    net->setTraining( true );
+    const int startN = std::min( Ntrain, progress->batch * batchSize );
+    NetAction<T> *action = new NetLearnLabeledBatch<T>( learningRate );
+    batchedNetAction( filepath, fileReadBatches, batchSize, startN, Ntrain, action, progress );
+    delete action;
+    EpochResult epochResult( progress->loss, progress->numRight );
+    return epochResult;
+}
 
 template class BatchLearnerOnDemand<unsigned char>;
 
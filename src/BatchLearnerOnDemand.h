@@ -27,6 +27,7 @@ template< typename T>
 class DeepCL_EXPORT BatchLearnerOnDemand {
 public:
     Trainable *net; // NOT owned by us, dont delete
+    std::vector< PostBatchAction * > postBatchActions; // NOT owned by us; run after each batch, when there is a ResumeState to update
 
     // [[[cog
     // import cog_addheaders
@@ -34,9 +35,12 @@ public:
     // ]]]
     // generated, using cog:
     BatchLearnerOnDemand( Trainable *net );
+    void addPostBatchAction( PostBatchAction *action );
     EpochResult batchedNetAction( std::string filepath, int fileReadBatches, int batchSize, int N, NetAction<T> *netAction );
+    EpochResult batchedNetAction( std::string filepath, int fileReadBatches, int batchSize, int startN, int N, NetAction<T> *netAction, ResumeState *progress );
     int test( std::string filepath, int fileReadBatches, int batchSize, int Ntest );
     EpochResult runEpochFromLabels( float learningRate, std::string filepath, int fileReadBatches, int batchSize, int Ntrain );
+    EpochResult runEpochFromLabels( float learningRate, std::string filepath, int fileReadBatches, int batchSize, int Ntrain, ResumeState *progress );
 
     // [[[end]]]
 };
@@ -0,0 +1,95 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "NeuralNet.h"
+#include "DeviceDataset.h"
+#include "NetLearner.h"
+#include "ResumeState.h"
+
+#include "BatchLearnerOnDevice.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+BatchLearnerOnDevice::BatchLearnerOnDevice( NeuralNet *net ) :
+    net( net ) {
+}
+void BatchLearnerOnDevice::addPostBatchAction( PostBatchAction *action ) {
+    postBatchActions.push_back( action );
+}
+
+// starts at batch startBatch.  if progress isnt 0, each batch is added to it,
+// then the postBatchActions are run
+EpochResult BatchLearnerOnDevice::batchedNetAction( bool learn, float learningRate, int batchSize, DeviceDataset *dataset, int const*labels, int const*permutation, int startBatch, ResumeState *progress ) {
+    int numRight = 0;
+    float loss = 0;
+    const int N = dataset->getN();
+    if( dataset->getCubeSize() != net->getInputCubeSize() ) {
+        throw runtime_error("BatchLearnerOnDevice: dataset cube size " + toString( dataset->getCubeSize() ) + " doesnt match net input cube size " + toString( net->getInputCubeSize() ) );
+    }
+    int *batchIndices = new int[batchSize];
+    int *batchLabels = new int[batchSize];
+    int thisBatchSize = batchSize;
+    net->setBatchSize( batchSize );
+    int numBatches = (N + batchSize - 1 ) / batchSize;
+    for( int batch = startBatch; batch < numBatches; batch++ ) {
+        int batchStart = batch * batchSize;
+        if( batch == numBatches - 1 ) {
+            thisBatchSize = N - batchStart;
+            net->setBatchSize( thisBatchSize );
+        }
+        for( int i = 0; i < thisBatchSize; i++ ) {
+            int example = permutation == 0 ? batchStart + i : permutation[ batchStart + i ];
+            batchIndices[i] = example;
+            batchLabels[i] = labels[example];
+        }
+        net->propagateFromDevice( dataset->gather( thisBatchSize, batchIndices ) );
+        if( learn ) {
+            net->backPropFromLabels( learningRate, batchLabels );
+        }
+        float thisLoss = net->calcLossFromLabels( batchLabels );
+        loss += thisLoss;
+        int thisNumRight = net->calcNumRight( batchLabels );
+        numRight += thisNumRight;
+        if( progress != 0 ) {
+            progress->batch++;
+            progress->numRight += thisNumRight;
+            progress->loss += thisLoss;
+            for( int i = 0; i < (int)postBatchActions.size(); i++ ) {
+                postBatchActions[i]->run( *progress );
+            }
+        }
+    }
+    delete[] batchLabels;
+    delete[] batchIndices;
+    EpochResult epochResult( loss, numRight );
+    return epochResult;
+}
+
+int BatchLearnerOnDevice::test( int batchSize, DeviceDataset *dataset, int const*labels ) {
+    net->setTraining( false );
+    return batchedNetAction( false, 0, batchSize, dataset, labels, 0, 0, 0 ).numRight;
+}
+
+EpochResult BatchLearnerOnDevice::runEpochFromLabels( float learningRate, int batchSize, DeviceDataset *dataset, int const*labels, int const*permutation ) {
+    net->setTraining( true );
+    return batchedNetAction( true, learningRate, batchSize, dataset, labels, permutation, 0, 0 );
+}
+// carries on from progress->batch, in the order of progress->permutation, if
+// there is one, and returns the totals for the whole epoch, including the
+// batches learnt before
+EpochResult BatchLearnerOnDevice::runEpochFromLabels( float learningRate, int batchSize, DeviceDataset *dataset, int const*labels, ResumeState *progress ) {
+    net->setTraining( true );
+    int const *permutation = progress->permutation.size() == 0 ? 0 : &progress->permutation[0];
+    batchedNetAction( true, learningRate, batchSize, dataset, labels, permutation, progress->batch, progress );
+    EpochResult epochResult( progress->loss, progress->numRight );
+    return epochResult;
+}
+
@@ -0,0 +1,47 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+class NeuralNet;
+class DeviceDataset;
+
+#include "BatchLearner.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+// this handles learning one single epoch, like BatchLearner, but the data
+// is held on the device, in a DeviceDataset, and each batch is gathered there
+// using a list of example indices, rather than being uploaded from the host
+// permutation gives the order to visit the examples in; pass 0 to visit them
+// in order
+class DeepCL_EXPORT BatchLearnerOnDevice {
+public:
+    NeuralNet *net; // NOT owned by us, dont delete
+    std::vector< PostBatchAction * > postBatchActions; // NOT owned by us; run after each batch, when there is a ResumeState to update
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    BatchLearnerOnDevice( NeuralNet *net );
+    void addPostBatchAction( PostBatchAction *action );
+    EpochResult batchedNetAction( bool learn, float learningRate, int batchSize, DeviceDataset *dataset, int const*labels, int const*permutation, int startBatch, ResumeState *progress );
+    int test( int batchSize, DeviceDataset *dataset, int const*labels );
+    EpochResult runEpochFromLabels( float learningRate, int batchSize, DeviceDataset *dataset, int const*labels, int const*permutation );
+    EpochResult runEpochFromLabels( float learningRate, int batchSize, DeviceDataset *dataset, int const*labels, ResumeState *progress );
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,54 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+
+#include "OpenCLHelper.h"
+#include "stringhelper.h"
+#include "ConvPoolPropagateCpu.h"
+#include "ConvPoolPropagateGpu.h"
+
+#include "ConvPoolPropagate.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+ConvPoolPropagate::ConvPoolPropagate( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize ) :
+        cl( cl ),
+        dim( dim ),
+        fn( fn ),
+        poolingPadZeros( poolingPadZeros ),
+        poolingSize( poolingSize ),
+        pooledImageSize( poolingPadZeros ? ( dim.outputImageSize + poolingSize - 1 ) / poolingSize : dim.outputImageSize / poolingSize ) {
+    if( dim.skip != 0 ) {
+        throw runtime_error("ConvPoolPropagate: skip not supported, but skip is " + toString( dim.skip ) );
+    }
+}
+STATIC ConvPoolPropagate *ConvPoolPropagate::instance( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize ) {
+    return new ConvPoolPropagateGpu( cl, dim, fn, poolingPadZeros, poolingSize );
+}
+STATIC ConvPoolPropagate *ConvPoolPropagate::instanceSpecific( int idx, OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize ) {
+    if( idx == 0 ) {
+        return new ConvPoolPropagateCpu( cl, dim, fn, poolingPadZeros, poolingSize );
+    }
+    if( idx == 1 ) {
+        return new ConvPoolPropagateGpu( cl, dim, fn, poolingPadZeros, poolingSize );
+    }
+    throw runtime_error("ConvPoolPropagate::instanceSpecific idx not known: " + toString( idx ) );
+}
+// selectors are only written if writeSelectors, and can be 0 otherwise
+VIRTUAL void ConvPoolPropagate::propagate( int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper,
+        CLWrapper *selectorsWrapper, CLWrapper *pooledWrapper, bool writeSelectors ) {
+    throw runtime_error("propagate not implemented for this child type");
+}
+VIRTUAL int ConvPoolPropagate::getPooledSize( int batchSize ) const {
+    return batchSize * dim.numFilters * pooledImageSize * pooledImageSize;
+}
+
@@ -0,0 +1,48 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "ActivationFunction.h"
+#include "LayerDimensions.h"
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+class OpenCLHelper;
+class CLWrapper;
+
+// convolution, followed by max-pooling, in one pass, so the convolution results
+// never get written out.  used by a ConvolutionalLayer that is directly followed
+// by a PoolingLayer, see PoolingMaker::fused()
+class DeepCL_EXPORT ConvPoolPropagate {
+public:
+    OpenCLHelper *cl;
+    LayerDimensions dim;
+    ActivationFunction const*fn;
+
+    const bool poolingPadZeros;
+    const int poolingSize;
+    const int pooledImageSize;
+
+    virtual ~ConvPoolPropagate() {}
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    ConvPoolPropagate( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize );
+    STATIC ConvPoolPropagate *instance( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize );
+    STATIC ConvPoolPropagate *instanceSpecific( int idx, OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize );
+    VIRTUAL void propagate( int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper,
+    CLWrapper *selectorsWrapper, CLWrapper *pooledWrapper, bool writeSelectors );
+    VIRTUAL int getPooledSize( int batchSize ) const;
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,115 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <cmath>
+
+#include "OpenCLHelper.h"
+#include "StatefulTimer.h"
+#include "ZeroCopy.h"
+
+#include "ConvPoolPropagateCpu.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+ConvPoolPropagateCpu::ConvPoolPropagateCpu( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize ) :
+        ConvPoolPropagate( cl, dim, fn, poolingPadZeros, poolingSize ) {
+}
+VIRTUAL void ConvPoolPropagateCpu::propagate( int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper,
+        CLWrapper *selectorsWrapper, CLWrapper *pooledWrapper, bool writeSelectors ) {
+    ZeroCopy::copyToHost( dataWrapper );
+    ZeroCopy::copyToHost( weightsWrapper );
+    float *biasWeights = 0;
+    if( dim.biased ) {
+        ZeroCopy::copyToHost( biasWeightsWrapper );
+        biasWeights = (float *)biasWeightsWrapper->getHostArray();
+    }
+    unsigned char *selectors = writeSelectors ? (unsigned char *)selectorsWrapper->getHostArray() : 0;
+    propagate( batchSize, (float *)dataWrapper->getHostArray(), (float *)weightsWrapper->getHostArray(), biasWeights,
+        selectors, (float *)pooledWrapper->getHostArray() );
+    if( writeSelectors ) {
+        ZeroCopy::copyToDevice( selectorsWrapper );
+    }
+    ZeroCopy::copyToDevice( pooledWrapper );
+}
+// works out one conv output plane at a time, into a scratch plane, applies the
+// activation to the whole plane, and pools from there, so only one plane of the
+// conv results is ever held
+// selectors can be 0, if not needed
+VIRTUAL void ConvPoolPropagateCpu::propagate( int batchSize, float const*inputData, float const*weights, float const*biasWeights,
+        unsigned char *selectors, float *pooled ) {
+    StatefulTimer::instance()->timeCheck("ConvPoolPropagateCpu::propagate start" );
+    const int halfFilterSize = dim.filterSize >> 1;
+    const int even = dim.filterSize % 2 == 0 ? 1 : 0;
+    const int margin = dim.padZeros ? 0 : halfFilterSize;
+    const int outputImageSize = dim.outputImageSize;
+    float *plane = new float[ outputImageSize * outputImageSize ];
+    for( int n = 0; n < batchSize; n++ ) {
+        float const*inputCube = inputData + n * dim.inputCubeSize;
+        for( int filter = 0; filter < dim.numFilters; filter++ ) {
+            float const*filterCube = weights + filter * dim.inputPlanes * dim.filterSizeSquared;
+            const float bias = dim.biased ? biasWeights[filter] : 0;
+            for( int outRow = 0; outRow < outputImageSize; outRow++ ) {
+                for( int outCol = 0; outCol < outputImageSize; outCol++ ) {
+                    float sum = 0;
+                    for( int inPlane = 0; inPlane < dim.inputPlanes; inPlane++ ) {
+                        float const*inputPlane = inputCube + inPlane * dim.inputImageSizeSquared;
+                        float const*filterPlane = filterCube + inPlane * dim.filterSizeSquared;
+                        for( int u = -halfFilterSize; u <= halfFilterSize - even; u++ ) {
+                            const int inRow = outRow + u + margin;
+                            if( inRow < 0 || inRow >= dim.inputImageSize ) {
+                                continue;
+                            }
+                            for( int v = -halfFilterSize; v <= halfFilterSize - even; v++ ) {
+                                const int inCol = outCol + v + margin;
+                                if( inCol < 0 || inCol >= dim.inputImageSize ) {
+                                    continue;
+                                }
+                                sum += inputPlane[ inRow * dim.inputImageSize + inCol ]
+                                    * filterPlane[ ( u + halfFilterSize ) * dim.filterSize + v + halfFilterSize ];
+                            }
+                        }
+                    }
+                    plane[ outRow * outputImageSize + outCol ] = sum + bias;
+                }
+            }
+            fn->calcArray( outputImageSize * outputImageSize, plane );
+            const int pooledPlaneOffset = ( n * dim.numFilters + filter ) * pooledImageSize * pooledImageSize;
+            for( int pooledRow = 0; pooledRow < pooledImageSize; pooledRow++ ) {
+                for( int pooledCol = 0; pooledCol < pooledImageSize; pooledCol++ ) {
+                    const int outRow = pooledRow * poolingSize;
+                    const int outCol = pooledCol * poolingSize;
+                    float maxValue = plane[ outRow * outputImageSize + outCol ];
+                    int selector = 0;
+                    for( int dRow = 0; dRow < poolingSize; dRow++ ) {
+                        for( int dCol = 0; dCol < poolingSize; dCol++ ) {
+                            if( outRow + dRow < outputImageSize && outCol + dCol < outputImageSize ) {
+                                const float value = plane[ ( outRow + dRow ) * outputImageSize + outCol + dCol ];
+                                if( value > maxValue ) {
+                                    maxValue = value;
+                                    selector = dRow * poolingSize + dCol;
+                                }
+                            }
+                        }
+                    }
+                    const int pooledIndex = pooledPlaneOffset + pooledRow * pooledImageSize + pooledCol;
+                    pooled[ pooledIndex ] = maxValue;
+                    if( selectors != 0 ) {
+                        selectors[ pooledIndex ] = (unsigned char)selector;
+                    }
+                }
+            }
+        }
+    }
+    delete[] plane;
+    StatefulTimer::instance()->timeCheck("ConvPoolPropagateCpu::propagate end" );
+}
+
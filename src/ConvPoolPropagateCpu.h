@@ -0,0 +1,30 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "ConvPoolPropagate.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+class ConvPoolPropagateCpu : public ConvPoolPropagate {
+public:
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    ConvPoolPropagateCpu( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize );
+    VIRTUAL void propagate( int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper,
+    CLWrapper *selectorsWrapper, CLWrapper *pooledWrapper, bool writeSelectors );
+    VIRTUAL void propagate( int batchSize, float const*inputData, float const*weights, float const*biasWeights,
+    unsigned char *selectors, float *pooled );
+
+    // [[[end]]]
+};
+
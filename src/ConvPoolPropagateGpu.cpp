@@ -0,0 +1,184 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+
+#include "OpenCLHelper.h"
+#include "StatefulTimer.h"
+#include "stringhelper.h"
+
+#include "ConvPoolPropagateGpu.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+VIRTUAL ConvPoolPropagateGpu::~ConvPoolPropagateGpu() {
+    delete kernel;
+}
+VIRTUAL void ConvPoolPropagateGpu::propagate( int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper,
+        CLWrapper *selectorsWrapper, CLWrapper *pooledWrapper, bool writeSelectors ) {
+    StatefulTimer::instance()->timeCheck("ConvPoolPropagateGpu::propagate start" );
+    kernel->in( batchSize )->in( writeSelectors ? 1 : 0 )
+        ->in( dataWrapper )->in( weightsWrapper );
+    if( dim.biased ) {
+        kernel->in( biasWeightsWrapper );
+    }
+    // the kernel only writes selectors if writeSelectors, but needs a buffer either way
+    kernel->out( selectorsWrapper != 0 ? selectorsWrapper : pooledWrapper )
+        ->out( pooledWrapper );
+    int globalSize = getPooledSize( batchSize );
+    const int workgroupSize = cl->getMaxWorkgroupSize();
+    globalSize = ( ( globalSize + workgroupSize - 1 ) / workgroupSize ) * workgroupSize;
+    kernel->run_1d( globalSize, workgroupSize );
+    cl->finish();
+    StatefulTimer::instance()->timeCheck("ConvPoolPropagateGpu::propagate end" );
+}
+ConvPoolPropagateGpu::ConvPoolPropagateGpu( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn, bool poolingPadZeros, int poolingSize ) :
+        ConvPoolPropagate( cl, dim, fn, poolingPadZeros, poolingSize ) {
+    std::string options = fn->getKernelDefines();
+    options += dim.buildOptionsString();
+    options += " -D gPoolingSize=" + toString( poolingSize );
+    options += " -D gPooledImageSize=" + toString( pooledImageSize );
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2( "kernel", "cl/conv_pool.cl", "conv_pool", 'options' )
+    // ]]]
+    // generated using cog, from cl/conv_pool.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n" 
+    "//\n" 
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n" 
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n" 
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n" 
+    "\n" 
+    "// convolution, bias, activation and max-pooling in one pass: each thread works\n" 
+    "// out the conv results for one pooling window, keeping only the max, so the\n" 
+    "// conv results are never written out\n" 
+    "//\n" 
+    "// expected defines:\n" 
+    "//  - the defines from LayerDimensions::buildOptionsString()\n" 
+    "//  - gPoolingSize, gPooledImageSize\n" 
+    "//  - BIASED (or not)\n" 
+    "//  - one of: [ TANH | RELU | LINEAR | SIGMOID | SCALEDTANH ]\n" 
+    "//  - optional: FAST_MATH, to use the same approximations as activate.cl\n" 
+    "//\n" 
+    "// images are organized like [n][inPlane][inRow][inCol]\n" 
+    "// filters are organized like [filter][inPlane][filterRow][filterCol]\n" 
+    "// pooled and selectors are organized like [n][filter][pooledRow][pooledCol]\n" 
+    "// global id is organized like pooled\n" 
+    "// selectors, one byte each, are only written if writeSelectors is 1, ie if we will backprop\n" 
+    "\n" 
+    "#ifdef FAST_MATH\n" 
+    "// same approximation as FastMath::tanh, 13/6 rational, max error 5e-7\n" 
+    "float approx_tanh( float x ) {\n" 
+    "    x = clamp( x, -7.90531111f, 7.90531111f );\n" 
+    "    const float x2 = x * x;\n" 
+    "    float p = -2.76076847742355e-16f;\n" 
+    "    p = p * x2 + 2.00018790482477e-13f;\n" 
+    "    p = p * x2 - 8.60467152213735e-11f;\n" 
+    "    p = p * x2 + 5.12229709037114e-08f;\n" 
+    "    p = p * x2 + 1.48572235717979e-05f;\n" 
+    "    p = p * x2 + 6.37261928875436e-04f;\n" 
+    "    p = p * x2 + 4.89352455891786e-03f;\n" 
+    "    p = p * x;\n" 
+    "    float q = 1.19825839466702e-06f;\n" 
+    "    q = q * x2 + 1.18534705686654e-04f;\n" 
+    "    q = q * x2 + 2.26843463243900e-03f;\n" 
+    "    q = q * x2 + 4.89352518554385e-03f;\n" 
+    "    return p / q;\n" 
+    "}\n" 
+    "    #define TANH_FUNCTION(x) (approx_tanh(x))\n" 
+    "    #define SIGMOID_FUNCTION(x) (0.5f + 0.5f * approx_tanh(0.5f * (x)))\n" 
+    "#else\n" 
+    "    #define TANH_FUNCTION(x) (tanh(x))\n" 
+    "    #define SIGMOID_FUNCTION(x) (1.0f / (1 + exp(-(x))))\n" 
+    "#endif\n" 
+    "\n" 
+    "#ifdef TANH\n" 
+    "    #define ACTIVATION_FUNCTION(output) (TANH_FUNCTION(output))\n" 
+    "#elif defined SCALEDTANH\n" 
+    "    #define ACTIVATION_FUNCTION(output) ( 1.7159f * TANH_FUNCTION( 0.66667f * output))\n" 
+    "#elif defined SIGMOID\n" 
+    "    #define ACTIVATION_FUNCTION(output) (SIGMOID_FUNCTION(output))\n" 
+    "#elif defined RELU\n" 
+    "    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : 0)\n" 
+    "#elif defined LINEAR\n" 
+    "    #define ACTIVATION_FUNCTION(output) (output)\n" 
+    "#endif\n" 
+    "\n" 
+    "#ifdef ACTIVATION_FUNCTION // protect against not defined\n" 
+    "kernel void conv_pool( const int batchSize, const int writeSelectors,\n" 
+    "        global const float *images, global const float *filters,\n" 
+    "        #ifdef BIASED\n" 
+    "        global const float *biases,\n" 
+    "        #endif\n" 
+    "        global uchar *selectors, global float *pooled ) {\n" 
+    "    const int globalId = get_global_id(0);\n" 
+    "    const int pooledImageSizeSquared = gPooledImageSize * gPooledImageSize;\n" 
+    "    const int n = globalId / ( gNumFilters * pooledImageSizeSquared );\n" 
+    "    if( n >= batchSize ) {\n" 
+    "        return;\n" 
+    "    }\n" 
+    "    const int filter = ( globalId / pooledImageSizeSquared ) % gNumFilters;\n" 
+    "    const int pooledRow = ( globalId % pooledImageSizeSquared ) / gPooledImageSize;\n" 
+    "    const int pooledCol = globalId % gPooledImageSize;\n" 
+    "    global const float *inputCube = images + n * gInputPlanes * gInputImageSizeSquared;\n" 
+    "    global const float *filterCube = filters + filter * gInputPlanes * gFilterSizeSquared;\n" 
+    "\n" 
+    "    float maxValue = - INFINITY;\n" 
+    "    int selector = 0;\n" 
+    "    for( int dRow = 0; dRow < gPoolingSize; dRow++ ) {\n" 
+    "        const int outRow = pooledRow * gPoolingSize + dRow;\n" 
+    "        for( int dCol = 0; dCol < gPoolingSize; dCol++ ) {\n" 
+    "            const int outCol = pooledCol * gPoolingSize + dCol;\n" 
+    "            if( outRow >= gOutputImageSize || outCol >= gOutputImageSize ) {\n" 
+    "                continue;\n" 
+    "            }\n" 
+    "            float sum = 0;\n" 
+    "            for( int inPlane = 0; inPlane < gInputPlanes; inPlane++ ) {\n" 
+    "                global const float *inputPlane = inputCube + inPlane * gInputImageSizeSquared;\n" 
+    "                global const float *filterPlane = filterCube + inPlane * gFilterSizeSquared;\n" 
+    "                for( int u = -gHalfFilterSize; u <= gHalfFilterSize - gEven; u++ ) {\n" 
+    "                    const int inRow = outRow + u + ( gPadZeros ? 0 : gHalfFilterSize );\n" 
+    "                    if( inRow < 0 || inRow >= gInputImageSize ) {\n" 
+    "                        continue;\n" 
+    "                    }\n" 
+    "                    for( int v = -gHalfFilterSize; v <= gHalfFilterSize - gEven; v++ ) {\n" 
+    "                        const int inCol = outCol + v + ( gPadZeros ? 0 : gHalfFilterSize );\n" 
+    "                        if( inCol < 0 || inCol >= gInputImageSize ) {\n" 
+    "                            continue;\n" 
+    "                        }\n" 
+    "                        sum += inputPlane[ inRow * gInputImageSize + inCol ]\n" 
+    "                            * filterPlane[ ( u + gHalfFilterSize ) * gFilterSize + v + gHalfFilterSize ];\n" 
+    "                    }\n" 
+    "                }\n" 
+    "            }\n" 
+    "            #ifdef BIASED\n" 
+    "            sum += biases[filter];\n" 
+    "            #endif\n" 
+    "            const float value = ACTIVATION_FUNCTION( sum );\n" 
+    "            if( value > maxValue ) { // first max wins, same as pooling.cl\n" 
+    "                maxValue = value;\n" 
+    "                selector = dRow * gPoolingSize + dCol;\n" 
+    "            }\n" 
+    "        }\n" 
+    "    }\n" 
+    "    pooled[globalId] = maxValue;\n" 
+    "    if( writeSelectors ) {\n" 
+    "        selectors[globalId] = (uchar)selector;\n" 
+    "    }\n" 
+    "}\n" 
+    "#endif\n" 
+    "\n" 
+    "";
+    kernel = cl->buildKernelFromString( kernelSource, "conv_pool", options, "cl/conv_pool.cl" );
+    // [[[end]]]
+}
+
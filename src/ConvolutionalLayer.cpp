@@ -11,6 +11,10 @@
 #include "WeightsHelper.h"
 #include "BackpropErrorsv2.h"
 #include "BackpropWeights2.h"
+#include "BackpropWeights2Cpu.h"
+#include "ZeroCopy.h"
+#include "ConvPoolPropagate.h"
+#include "PropagateFcGemv.h"
 
 using namespace std;
 
@@ -23,20 +27,29 @@ ConvolutionalLayer::ConvolutionalLayer( OpenCLHelper *cl, Layer *previousLayer,
 //        filterSizeSquared( filterSize * filterSize ),
 //        padZeros( maker->_padZeros ),
         cl( cl ),
+        convPoolImpl( 0 ),
         backpropErrorsImpl(0),
         activationFunction( maker->_activationFunction ),
         results(0),
         weights(0),
         biasWeights(0),
         weightsWrapper( 0 ),
+        ownsWeights( true ),
         resultsWrapper( 0 ),
         errorsForUpstreamWrapper( 0 ),
+        backpropImagesWrapper( 0 ),
+        backpropErrorsWrapper( 0 ),
+        ownsBackpropErrorsWrapper( false ),
         batchSize( 0 ),
         allocatedSpaceNumExamples( 0 ),
         errorsForUpstream( 0 ),
         resultsCopiedToHost( false ),
         errorsForUpstreamCopiedToHost( false ),
-        weightsCopiedToHost(false) {
+        weightsCopiedToHost(false),
+        resultsStale(false),
+        gemvPropagateimpl( 0 ),
+        persistentBiasWeightsWrapper( 0 ),
+        biasWeightsDirty( true ) {
     dim.setInputPlanes( previousLayer->getOutputPlanes() )
         .setInputImageSize( previousLayer->getOutputImageSize() )
         .setNumFilters( maker->_numFilters )
@@ -59,36 +72,33 @@ ConvolutionalLayer::ConvolutionalLayer( OpenCLHelper *cl, Layer *previousLayer,
             throw std::runtime_error("filter size cannot be larger than upstream image size: " + toString( dim.filterSize) +
                 " > " + toString(dim.inputImageSize) );
     }
-    biasWeights = new float[ getBiasWeightsSize() ];
-    weights = new float[ getWeightsSize() ];
+    biasWeights = ZeroCopy::allocateFloats( getBiasWeightsSize() );
+    weights = ZeroCopy::allocateFloats( getWeightsSize() );
     randomizeWeights();
-    weightsWrapper = cl->wrap( getWeightsSize(), weights );
-    weightsWrapper->copyToDevice();
+    weightsWrapper = ZeroCopy::wrap( cl, getWeightsSize(), weights );
+    ZeroCopy::copyToDevice( weightsWrapper );
     weightsCopiedToHost = true;
 }
 VIRTUAL ConvolutionalLayer::~ConvolutionalLayer() {
-    if( weightsWrapper != 0 ) {
+    if( ownsWeights ) {
         delete weightsWrapper;
+        ZeroCopy::deallocate( weights );
     }
-    if( resultsWrapper != 0 ) {
-        delete resultsWrapper;
-    }
-    if( results != 0 ) {
-        delete[] results;
-    }
-    if( weights != 0 ) {
-        delete[] weights;
-    }
-    if( biasWeights != 0 ) {
-        delete[] biasWeights;
+    if( !resultsInArena ) {
+        if( resultsWrapper != 0 ) {
+            delete resultsWrapper;
+        }
+        ZeroCopy::deallocate( results );
     }
+    ZeroCopy::deallocate( biasWeights );
     if( errorsForUpstreamWrapper != 0 ) {
         delete errorsForUpstreamWrapper;
     }
-    if( errorsForUpstream != 0 ) {
-        delete[] errorsForUpstream;
-    }
+    ZeroCopy::deallocate( errorsForUpstream );
+    deleteLowLatencyWrappers();
+    delete gemvPropagateimpl;
     delete propagateimpl;
+    delete convPoolImpl;
     delete backpropWeightsImpl;
     delete backpropErrorsImpl;
 }
@@ -101,7 +111,7 @@ VIRTUAL ActivationFunction const*ConvolutionalLayer::getActivationFunction() {
 VIRTUAL float *ConvolutionalLayer::getErrorsForUpstream() {
     if( !errorsForUpstreamCopiedToHost ) {
         std::cout << "copying errorsForUpstream to host, from GPU" << std::endl;
-        errorsForUpstreamWrapper->copyToHost();
+        ZeroCopy::copyToHost( errorsForUpstreamWrapper );
         errorsForUpstreamCopiedToHost = true;
     }
     return errorsForUpstream;
@@ -116,6 +126,9 @@ VIRTUAL bool ConvolutionalLayer::hasResultsWrapper() const {
     return true;
 }
 VIRTUAL CLWrapper *ConvolutionalLayer::getResultsWrapper() {
+    if( resultsStale ) {
+        calcResults();
+    }
     return resultsWrapper;
 }
 VIRTUAL bool ConvolutionalLayer::needsBackProp() {
@@ -131,11 +144,14 @@ VIRTUAL float *ConvolutionalLayer::getWeights() {
     if( !weightsCopiedToHost ) {
 //        cout << "copying weights to host" << endl;
         cl->finish();
-        weightsWrapper->copyToHost();
+        ZeroCopy::copyToHost( weightsWrapper );
     }
     return weights;
 }
+// the caller might write to them, so they get uploaded again, before the next
+// low latency propagate
 VIRTUAL float *ConvolutionalLayer::getBiasWeights() {
+    biasWeightsDirty = true;
     //if( !biasWeightsCopiedToHost ) {
 //        cout << "copying weights to host" << endl;
       //  cl->finish();
@@ -234,32 +250,163 @@ VIRTUAL void ConvolutionalLayer::setBatchSize( int batchSize ) {
         this->batchSize = batchSize;
         return;
     }
+    if( resultsInArena ) {
+        throw runtime_error("layer " + toString(layerIndex) + ": results are in an arena planned for batch size " +
+            toString(allocatedSpaceNumExamples) + ", cannot set batch size " + toString(batchSize) );
+    }
 
     this->batchSize = batchSize;
     this->allocatedSpaceNumExamples = batchSize;
-    if( results != 0 ) {
-        delete[] results;
-    }
-    results = new float[getResultsSize()];
     if( resultsWrapper != 0 ) {
         delete resultsWrapper;
     }
-    resultsWrapper = cl->wrap( getResultsSize(), results );
-    if( errorsForUpstream != 0 ) {
-        delete[] errorsForUpstream;
+    ZeroCopy::deallocate( results );
+    results = ZeroCopy::allocateFloats( getResultsSize() );
+    resultsWrapper = ZeroCopy::wrap( cl, getResultsSize(), results );
+    if( errorsForUpstreamWrapper != 0 ) {
+        delete errorsForUpstreamWrapper;
+        errorsForUpstreamWrapper = 0;
+    }
+    ZeroCopy::deallocate( errorsForUpstream );
+    errorsForUpstream = 0;
+    if( layerIndex > 1 && !inferenceOnly ) {
+        errorsForUpstream = ZeroCopy::allocateFloats( previousLayer->getResultsSize() );
+        errorsForUpstreamWrapper = ZeroCopy::wrap( cl, previousLayer->getResultsSize(), errorsForUpstream );
+    }
+}
+// when fused with pooling, the pooling layer reads our input, so we stay out of
+// the arena, which keeps our input alive until the pooling layer has run
+VIRTUAL bool ConvolutionalLayer::canUseArena() const {
+    return convPoolImpl == 0;
+}
+VIRTUAL void ConvolutionalLayer::setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper ) {
+    if( !resultsInArena ) {
+        if( this->resultsWrapper != 0 ) {
+            delete this->resultsWrapper;
+        }
+        ZeroCopy::deallocate( this->results );
     }
     if( errorsForUpstreamWrapper != 0 ) {
         delete errorsForUpstreamWrapper;
+        errorsForUpstreamWrapper = 0;
+    }
+    ZeroCopy::deallocate( errorsForUpstream );
+    errorsForUpstream = 0;
+    this->results = results;
+    this->resultsWrapper = resultsWrapper;
+    this->resultsInArena = true;
+    this->resultsCopiedToHost = false;
+    this->batchSize = batchSize;
+    this->allocatedSpaceNumExamples = batchSize;
+    if( layerIndex > 1 && !inferenceOnly ) {
+        errorsForUpstream = ZeroCopy::allocateFloats( previousLayer->getResultsSize() );
+        errorsForUpstreamWrapper = ZeroCopy::wrap( cl, previousLayer->getResultsSize(), errorsForUpstream );
+    }
+}
+// the weights are used in place, on the device.  the bias weights are uploaded
+// from the host before each propagate, so we copy those, which are small, and
+// so take a snapshot: call after the source's weights are final
+VIRTUAL void ConvolutionalLayer::shareWeightsFrom( Layer *source ) {
+    ConvolutionalLayer *sourceLayer = dynamic_cast< ConvolutionalLayer * >( source );
+    if( sourceLayer == 0 || sourceLayer->getWeightsSize() != getWeightsSize() || sourceLayer->getBiasWeightsSize() != getBiasWeightsSize() ) {
+        throw runtime_error("layer " + toString( layerIndex ) + ": can only share weights with a convolutional layer of the same dimensions");
     }
-    if( layerIndex > 1 ) {
-        errorsForUpstream = new float[ previousLayer->getResultsSize() ];
-        errorsForUpstreamWrapper = cl->wrap( previousLayer->getResultsSize(), errorsForUpstream );
+    if( ownsWeights ) {
+        delete weightsWrapper;
+        ZeroCopy::deallocate( weights );
+    }
+    weights = sourceLayer->weights;
+    weightsWrapper = sourceLayer->weightsWrapper;
+    weightsCopiedToHost = sourceLayer->weightsCopiedToHost;
+    ownsWeights = false;
+    if( dim.biased ) {
+        initBiasWeights( sourceLayer->biasWeights );
+    }
+}
+VIRTUAL void ConvolutionalLayer::setLowLatency( bool lowLatency ) {
+    Layer::setLowLatency( lowLatency );
+    deleteLowLatencyWrappers();
+    delete gemvPropagateimpl;
+    gemvPropagateimpl = 0;
+    if( !lowLatency ) {
+        return;
+    }
+    if( dim.isFullyConnected() ) {
+        gemvPropagateimpl = new PropagateFcGemv( cl, dim, activationFunction );
+    }
+    if( dim.biased ) {
+        persistentBiasWeightsWrapper = ZeroCopy::wrap( cl, getBiasWeightsSize(), biasWeights );
+        biasWeightsDirty = true;
+    }
+}
+void ConvolutionalLayer::deleteLowLatencyWrappers() {
+    deleteCachedUpstreamWrappers();
+    delete persistentBiasWeightsWrapper;
+    persistentBiasWeightsWrapper = 0;
+}
+CLWrapper *ConvolutionalLayer::getLowLatencyBiasWeightsWrapper() {
+    if( biasWeightsDirty ) {
+        ZeroCopy::copyToDevice( persistentBiasWeightsWrapper );
+        biasWeightsDirty = false;
     }
+    return persistentBiasWeightsWrapper;
+}
+// called by the pooling layer after us, from its constructor, when it is fused with us
+void ConvolutionalLayer::fusePooling( bool poolingPadZeros, int poolingSize ) {
+    if( convPoolImpl != 0 ) {
+        throw runtime_error("layer " + toString( layerIndex ) + " is already fused with a pooling layer");
+    }
+    convPoolImpl = ConvPoolPropagate::instance( cl, dim, activationFunction, poolingPadZeros, poolingSize );
+}
+// does our propagate, and the pooling layer's, in one pass, writing only the
+// pooled results, and the selectors if writeSelectors
+void ConvolutionalLayer::propagateFused( CLWrapper *selectorsWrapper, CLWrapper *pooledWrapper, bool writeSelectors ) {
+    if( lowLatency ) {
+        CLWrapper *upstreamWrapper = previousLayer->hasResultsWrapper() ? previousLayer->getResultsWrapper() : getLowLatencyUpstreamWrapper( cl );
+        convPoolImpl->propagate( batchSize, upstreamWrapper, weightsWrapper, dim.biased ? getLowLatencyBiasWeightsWrapper() : 0,
+            selectorsWrapper, pooledWrapper, writeSelectors );
+        return;
+    }
+    StatefulTimer::instance()->timeCheck("    propagate fused layer " + toString( layerIndex ) + ", START");
+    CLWrapper *upstreamWrapper = 0;
+    if( previousLayer->hasResultsWrapper() ) {
+        upstreamWrapper = previousLayer->getResultsWrapper();
+    } else {
+        upstreamWrapper = ZeroCopy::wrap( cl, previousLayer->getResultsSize(), (float *)previousLayer->getResults() );
+        ZeroCopy::copyToDevice( upstreamWrapper );
+    }
+    CLWrapper *biasWeightsWrapper = 0;
+    if( dim.biased ) {
+        biasWeightsWrapper = ZeroCopy::wrap( cl, getBiasWeightsSize(), biasWeights );
+        ZeroCopy::copyToDevice( biasWeightsWrapper );
+    }
+    convPoolImpl->propagate( batchSize, upstreamWrapper, weightsWrapper, biasWeightsWrapper,
+        selectorsWrapper, pooledWrapper, writeSelectors );
+    if( !previousLayer->hasResultsWrapper() ) {
+        delete upstreamWrapper;
+    }
+    if( dim.biased ) {
+        delete biasWeightsWrapper;
+    }
+    StatefulTimer::instance()->timeCheck("    propagate fused layer " + toString( layerIndex ) + ", END");
 }
 VIRTUAL void ConvolutionalLayer::propagate() {
     if( batchSize == 0 ) {
         throw runtime_error("Need to call setBatchSize(size) before calling propagate etc");
     }
+    if( convPoolImpl != 0 ) {
+        // the pooling layer after us does the work, in propagateFused, and our own
+        // results are only calculated if something asks for them
+        resultsStale = true;
+        return;
+    }
+    calcResults();
+}
+void ConvolutionalLayer::calcResults() {
+    if( lowLatency ) {
+        calcResultsLowLatency();
+        return;
+    }
 //    if( imageSizeSquared <= cl->getMaxWorkgroupSize() ) {
 ////        propagate2();
 //    } else {
@@ -274,13 +421,13 @@ VIRTUAL void ConvolutionalLayer::propagate() {
         upstreamWrapper = previousLayer->getResultsWrapper();
     } else {
 //            std::cout << "layer " << previousLayer->layerIndex << " has no resultsWrapper" << std::endl;
-        upstreamWrapper = cl->wrap( previousLayer->getResultsSize(), (float *)previousLayer->getResults() );
-        upstreamWrapper->copyToDevice();
+        upstreamWrapper = ZeroCopy::wrap( cl, previousLayer->getResultsSize(), (float *)previousLayer->getResults() );
+        ZeroCopy::copyToDevice( upstreamWrapper );
     }
-    CLFloatWrapper *biasWeightsWrapper = 0;
+    CLWrapper *biasWeightsWrapper = 0;
     if( dim.biased ) {
-        biasWeightsWrapper = cl->wrap( getBiasWeightsSize(), biasWeights );
-        biasWeightsWrapper->copyToDevice();
+        biasWeightsWrapper = ZeroCopy::wrap( cl, getBiasWeightsSize(), biasWeights );
+        ZeroCopy::copyToDevice( biasWeightsWrapper );
     }
     StatefulTimer::instance()->timeCheck("    propagate layer " + toString( layerIndex ) + ", copied to device");
     propagateimpl->propagate( batchSize, upstreamWrapper, weightsWrapper, biasWeightsWrapper, resultsWrapper );
@@ -293,11 +440,24 @@ VIRTUAL void ConvolutionalLayer::propagate() {
         delete biasWeightsWrapper;
     }
     resultsCopiedToHost = false;
+    resultsStale = false;
+}
+// same as calcResults, without the timers, and without creating any wrappers
+// fully connected layers use the gemv kernel, for batches of up to 8
+void ConvolutionalLayer::calcResultsLowLatency() {
+    CLWrapper *upstreamWrapper = previousLayer->hasResultsWrapper() ? previousLayer->getResultsWrapper() : getLowLatencyUpstreamWrapper( cl );
+    Propagate *impl = ( gemvPropagateimpl != 0 && batchSize <= 8 ) ? gemvPropagateimpl : propagateimpl;
+    impl->propagate( batchSize, upstreamWrapper, weightsWrapper, dim.biased ? getLowLatencyBiasWeightsWrapper() : 0, resultsWrapper );
+    resultsCopiedToHost = false;
+    resultsStale = false;
 }
 VIRTUAL float * ConvolutionalLayer::getResults() {
+    if( resultsStale ) {
+        calcResults();
+    }
     if( !resultsCopiedToHost ) {
 //            std::cout << "layer " << layerIndex << " copying results to host " << std::endl;
-        resultsWrapper->copyToHost();
+        ZeroCopy::copyToHost( resultsWrapper );
         resultsCopiedToHost = true;
     }
     return results;
@@ -305,7 +465,7 @@ VIRTUAL float * ConvolutionalLayer::getResults() {
 VIRTUAL void ConvolutionalLayer::initWeights( float const*weights ) {
     int weightsSize = dim.filtersSize;
     memcpy( this->weights, weights, sizeof(float) * weightsSize );
-    weightsWrapper->copyToDevice();
+    ZeroCopy::copyToDevice( weightsWrapper );
 }
 VIRTUAL int ConvolutionalLayer::getOutputCubeSize() const {
     return dim.outputCubeSize;
@@ -336,6 +496,7 @@ VIRTUAL void ConvolutionalLayer::unpersistFromArray(float const*array) {
 VIRTUAL void ConvolutionalLayer::initBiasWeights( float const*biasWeights ) {
     int biasWeightsSize = dim.numFilters;
     memcpy( this->biasWeights, biasWeights, sizeof(float) * biasWeightsSize );
+    biasWeightsDirty = true;
 //    biasWeightsWrapper->copyToDevice();
 }
 VIRTUAL int ConvolutionalLayer::getWeightsSize() const {
@@ -355,56 +516,119 @@ VIRTUAL int ConvolutionalLayer::getBiasWeightsSize() const {
 //       aggregate over:  [upstreamPlane][filterRow][filterCol][outRow][outCol][n]
 
 VIRTUAL void ConvolutionalLayer::backProp( float learningRate ) {
+    backPropErrors( learningRate );
+    if( backPropWeightsOnHost() ) {
+        startBackPropWeightsOnHost();
+        backPropWeights( learningRate );
+        finishBackPropWeightsOnHost();
+    } else {
+        backPropWeights( learningRate );
+    }
+}
+VIRTUAL bool ConvolutionalLayer::backPropWeightsOnHost() const {
+    return dynamic_cast< BackpropWeights2Cpu * >( backpropWeightsImpl ) != 0;
+}
+VIRTUAL void ConvolutionalLayer::setTinyWeightsOnHost( bool onHost ) {
+    const bool wantHost = onHost && BackpropWeights2::suitsHost( cl, dim );
+    if( wantHost == backPropWeightsOnHost() ) {
+        return;
+    }
+    delete backpropWeightsImpl;
+    if( wantHost ) {
+        backpropWeightsImpl = new BackpropWeights2Cpu( cl, dim );
+    } else {
+        backpropWeightsImpl = BackpropWeights2::instance( cl, dim );
+    }
+}
+// calculates errorsForUpstream from the weights, so has to run before
+// backPropWeights, which updates them in place
+VIRTUAL void ConvolutionalLayer::backPropErrors( float learningRate ) {
 //        Timer timer;
     StatefulTimer::instance()->timeCheck("backprop(): start, layer " + toString( layerIndex ) );
 
-    CLWrapper *biasWeightsWrapper = 0;
-    if( dim.biased ) {
-        biasWeightsWrapper = cl->wrap( getBiasWeightsSize(), biasWeights );
-        biasWeightsWrapper->copyToDevice();
-    }
-
-    CLWrapper *imagesWrapper = 0;
     if( previousLayer->hasResultsWrapper() ) {
-        imagesWrapper = previousLayer->getResultsWrapper();
+        backpropImagesWrapper = previousLayer->getResultsWrapper();
     } else {
-        imagesWrapper = cl->wrap( previousLayer->getResultsSize(), previousLayer->getResults() );
-        imagesWrapper->copyToDevice();
+        backpropImagesWrapper = ZeroCopy::wrap( cl, previousLayer->getResultsSize(), previousLayer->getResults() );
+        ZeroCopy::copyToDevice( backpropImagesWrapper );
     }
 
-    CLWrapper *errorsWrapper = 0;
-    bool weOwnErrorsWrapper = false;
+    ownsBackpropErrorsWrapper = false;
     if( nextLayer->providesErrorsForUpstreamWrapper() ) {
-        errorsWrapper = nextLayer->getErrorsForUpstreamWrapper();
+        backpropErrorsWrapper = nextLayer->getErrorsForUpstreamWrapper();
     } else {
-        errorsWrapper = cl->wrap( getResultsSize(), nextLayer->getErrorsForUpstream() );
-        errorsWrapper->copyToDevice();
+        backpropErrorsWrapper = ZeroCopy::wrap( cl, getResultsSize(), nextLayer->getErrorsForUpstream() );
+        ZeroCopy::copyToDevice( backpropErrorsWrapper );
 //        int resultsSize = getResultsSize();
 //        for( int i = 0; i < resultsSize; i++ ) {
 //            cout << "convolutional::backproperrors errorsfromupstream[" << i << "]=" << nextLayer->getErrorsForUpstream()[i] << endl;
 //        }
-        weOwnErrorsWrapper = true;
+        ownsBackpropErrorsWrapper = true;
     }
     if( previousLayer->needsBackProp() ) {
-        backpropErrorsImpl->backpropErrors( batchSize, imagesWrapper, errorsWrapper, weightsWrapper, errorsForUpstreamWrapper );
+        backpropErrorsImpl->backpropErrors( batchSize, backpropImagesWrapper, backpropErrorsWrapper, weightsWrapper, errorsForUpstreamWrapper );
+        errorsForUpstreamCopiedToHost = false;
         StatefulTimer::instance()->timeCheck("backproperrors(): calced errors for upstream, layer " + ::toString( layerIndex ) );
     }
+}
+// on the host, only uses host arrays, so it can run on a pool thread while
+// the device works on other layers; see startBackPropWeightsOnHost and
+// finishBackPropWeightsOnHost
+VIRTUAL void ConvolutionalLayer::backPropWeights( float learningRate ) {
+    if( backpropErrorsWrapper == 0 ) {
+        throw runtime_error("ConvolutionalLayer::backPropWeights: call backPropErrors first, layer " + ::toString( layerIndex ) );
+    }
+    if( backPropWeightsOnHost() ) {
+        BackpropWeights2Cpu *hostImpl = static_cast< BackpropWeights2Cpu * >( backpropWeightsImpl );
+        hostImpl->backpropWeights( batchSize, learningRate, (float *)backpropErrorsWrapper->getHostArray(),
+            (float *)backpropImagesWrapper->getHostArray(), weights, dim.biased ? biasWeights : 0 );
+        return;
+    }
+    CLWrapper *biasWeightsWrapper = 0;
+    if( dim.biased ) {
+        biasWeightsWrapper = ZeroCopy::wrap( cl, getBiasWeightsSize(), biasWeights );
+        ZeroCopy::copyToDevice( biasWeightsWrapper );
+    }
 
-    backpropWeightsImpl->backpropWeights( batchSize, learningRate, errorsWrapper, imagesWrapper,  weightsWrapper, biasWeightsWrapper );
+    backpropWeightsImpl->backpropWeights( batchSize, learningRate, backpropErrorsWrapper, backpropImagesWrapper,  weightsWrapper, biasWeightsWrapper );
     weightsCopiedToHost = false;
     StatefulTimer::instance()->timeCheck("backproperrors(): done weight backprop, layer " + ::toString( layerIndex ) );
 
     if( dim.biased ) {
-        biasWeightsWrapper->copyToHost();
+        ZeroCopy::copyToHost( biasWeightsWrapper );
         delete biasWeightsWrapper;
+        this->biasWeightsDirty = true;
     }
+    releaseBackpropWrappers();
+    StatefulTimer::instance()->timeCheck("backproperrors(): updated weights, layer " + ::toString( layerIndex ) );
+}
+// fetches what backPropWeights reads on the host; the bias weights live on the
+// host anyway
+VIRTUAL void ConvolutionalLayer::startBackPropWeightsOnHost() {
+    ZeroCopy::copyToHost( backpropErrorsWrapper );
+    ZeroCopy::copyToHost( backpropImagesWrapper );
+    if( !weightsCopiedToHost ) {
+        ZeroCopy::copyToHost( weightsWrapper );
+        weightsCopiedToHost = true;
+    }
+}
+VIRTUAL void ConvolutionalLayer::finishBackPropWeightsOnHost() {
+    ZeroCopy::copyToDevice( weightsWrapper );
+    weightsCopiedToHost = true;
+    this->biasWeightsDirty = true;
+    releaseBackpropWrappers();
+    StatefulTimer::instance()->timeCheck("backproperrors(): updated weights on host, layer " + ::toString( layerIndex ) );
+}
+void ConvolutionalLayer::releaseBackpropWrappers() {
     if( !previousLayer->hasResultsWrapper() ) {
-        delete imagesWrapper;
+        delete backpropImagesWrapper;
     }
-    if( weOwnErrorsWrapper ) {
-        delete errorsWrapper;
+    if( ownsBackpropErrorsWrapper ) {
+        delete backpropErrorsWrapper;
     }
-    StatefulTimer::instance()->timeCheck("backproperrors(): updated weights, layer " + ::toString( layerIndex ) );
+    backpropImagesWrapper = 0;
+    backpropErrorsWrapper = 0;
+    ownsBackpropErrorsWrapper = false;
 }
 
 VIRTUAL std::string ConvolutionalLayer::asString() const {
@@ -19,6 +19,7 @@
 #define VIRTUAL virtual
 
 class Propagate;
+class ConvPoolPropagate;
 class BackpropErrorsv2;
 class BackpropWeights2;
 class ConvolutionalMaker;
@@ -28,6 +29,7 @@ public:
     OpenCLHelper *const cl; // NOT owned by us
 
     Propagate *propagateimpl;
+    ConvPoolPropagate *convPoolImpl; // set if the pooling layer after us is fused with us, else 0
     BackpropWeights2 *backpropWeightsImpl;
     BackpropErrorsv2 *backpropErrorsImpl;
 
@@ -43,9 +45,15 @@ public:
 //    const bool padZeros;
 
     CLWrapper *weightsWrapper;
+    bool ownsWeights; // false after shareWeightsFrom, then weights and weightsWrapper belong to another layer
     CLWrapper *resultsWrapper;
     CLWrapper *errorsForUpstreamWrapper;
 
+    // set up by backPropErrors, for backPropWeights
+    CLWrapper *backpropImagesWrapper;
+    CLWrapper *backpropErrorsWrapper;
+    bool ownsBackpropErrorsWrapper;
+
     int batchSize;
     int allocatedSpaceNumExamples;
 
@@ -54,6 +62,12 @@ public:
     bool resultsCopiedToHost;
     bool errorsForUpstreamCopiedToHost;
     bool weightsCopiedToHost;
+    bool resultsStale; // fused with pooling, so propagate didnt write our results
+
+    // low latency mode only, see setLowLatency:
+    Propagate *gemvPropagateimpl; // used instead of propagateimpl, for small batches, if fully connected; else 0
+    CLWrapper *persistentBiasWeightsWrapper; // kept between propagates, and uploaded only when biasWeightsDirty
+    bool biasWeightsDirty;
 
     inline int getWeightIndex( int filterId, int inputPlane, int filterRow, int filterCol ) const {
         return ( ( filterId 
@@ -115,7 +129,17 @@ public:
     VIRTUAL void printWeights();
     VIRTUAL void printOutput() const;
     VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL bool canUseArena() const;
+    VIRTUAL void setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper );
+    VIRTUAL void shareWeightsFrom( Layer *source );
+    VIRTUAL void setLowLatency( bool lowLatency );
+    void deleteLowLatencyWrappers();
+    CLWrapper *getLowLatencyBiasWeightsWrapper();
+    void fusePooling( bool poolingPadZeros, int poolingSize );
+    void propagateFused( CLWrapper *selectorsWrapper, CLWrapper *pooledWrapper, bool writeSelectors );
     VIRTUAL void propagate();
+    void calcResults();
+    void calcResultsLowLatency();
     VIRTUAL float * getResults();
     VIRTUAL void initWeights( float const*weights );
     VIRTUAL int getOutputCubeSize() const;
@@ -126,6 +150,13 @@ public:
     VIRTUAL int getWeightsSize() const;
     VIRTUAL int getBiasWeightsSize() const;
     VIRTUAL void backProp( float learningRate );
+    VIRTUAL bool backPropWeightsOnHost() const;
+    VIRTUAL void setTinyWeightsOnHost( bool onHost );
+    VIRTUAL void backPropErrors( float learningRate );
+    VIRTUAL void backPropWeights( float learningRate );
+    VIRTUAL void startBackPropWeightsOnHost();
+    VIRTUAL void finishBackPropWeightsOnHost();
+    void releaseBackpropWrappers();
     VIRTUAL std::string asString() const;
 
     // [[[end]]]
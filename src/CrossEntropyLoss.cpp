@@ -6,6 +6,7 @@
 
 #include "CrossEntropyLoss.h"
 #include "LossLayer.h"
+#include "ZeroCopy.h"
 
 using namespace std;
 
@@ -21,7 +22,7 @@ CrossEntropyLoss::CrossEntropyLoss( Layer *previousLayer, CrossEntropyLossMaker
 }
 VIRTUAL CrossEntropyLoss::~CrossEntropyLoss(){
     if( errors != 0 ) {
-        delete[] errors;
+        ZeroCopy::deallocate( errors );
     }
 }
 VIRTUAL std::string CrossEntropyLoss::getClassName() const {
@@ -71,9 +72,9 @@ VIRTUAL void CrossEntropyLoss::setBatchSize( int batchSize ) {
         return;
     }
     if( errors != 0 ) {
-        delete[] errors;
+        ZeroCopy::deallocate( errors );
     }
-    errors = new float[ batchSize * previousLayer->getResultsSize() ];
+    errors = ZeroCopy::allocateFloats( batchSize * previousLayer->getResultsSize() );
     this->batchSize = batchSize;
     allocatedSize = batchSize;
 }
@@ -84,9 +85,10 @@ VIRTUAL void CrossEntropyLoss::calcErrors( float const*expectedResults ) {
     float *results = previousLayer->getResults();
     for( int i = 0; i < resultsSize; i++ ) {
         float result = results[i];
-        float partialOutBySum = fn->calcDerivative( result );
         float partialLossByOut = ( result - expectedResults[i] ) / result / ( 1.0f - result );
-        errors[i] = partialLossByOut * partialOutBySum;
+        errors[i] = partialLossByOut;
     }
+    // times partialOutBySum
+    fn->multiplyByDerivative( resultsSize, errors, results );
 }
 
@@ -0,0 +1,242 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+#include "NeuralNet.h"
+#include "WeightsPersister.h"
+#include "ThreadPool.h"
+#include "StatefulTimer.h"
+#include "stringhelper.h"
+
+#include "DataParallelNet.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+DataParallelNet::DataParallelNet( int numReplicas, NeuralNet *model ) :
+        batchSize( 0 ),
+        results( 0 ),
+        allocatedSize( 0 ),
+        numParams( 0 ),
+        params( 0 ) {
+    if( numReplicas < 1 ) {
+        throw runtime_error("DataParallelNet needs at least one replica, not " + toString( numReplicas ) );
+    }
+    numParams = WeightsPersister::getTotalNumWeights( model );
+    params = new float[ numParams ];
+    WeightsPersister::copyNetWeightsToArray( model, params );
+    replicas.push_back( model );
+    for( int i = 1; i < numReplicas; i++ ) {
+        replicas.push_back( model->clone() );
+    }
+    for( int i = 0; i < numReplicas; i++ ) {
+        replicaParams.push_back( new float[ numParams ] );
+    }
+    broadcastParams();
+    shardBegins.resize( numReplicas + 1, 0 );
+}
+VIRTUAL DataParallelNet::~DataParallelNet() {
+    for( int i = 0; i < (int)replicaParams.size(); i++ ) {
+        delete[] replicaParams[i];
+    }
+    for( int i = 1; i < (int)replicas.size(); i++ ) {
+        delete replicas[i];
+    }
+    if( results != 0 ) {
+        delete[] results;
+    }
+    delete[] params;
+}
+int DataParallelNet::getNumReplicas() const {
+    return (int)replicas.size();
+}
+NeuralNet *DataParallelNet::getReplica( int replica ) {
+    return replicas[replica];
+}
+// replicas get no examples, if the batch is smaller than the number of replicas
+int DataParallelNet::getShardSize( int replica ) const {
+    return shardBegins[replica + 1] - shardBegins[replica];
+}
+VIRTUAL int DataParallelNet::getInputCubeSize() const {
+    return replicas[0]->getInputCubeSize();
+}
+VIRTUAL int DataParallelNet::getOutputCubeSize() const {
+    return replicas[0]->getOutputCubeSize();
+}
+VIRTUAL int DataParallelNet::getResultsSize() const {
+    return batchSize * getOutputCubeSize();
+}
+VIRTUAL int DataParallelNet::getOutputPlanes() const {
+    return replicas[0]->getOutputPlanes();
+}
+VIRTUAL int DataParallelNet::getOutputImageSize() const {
+    return replicas[0]->getOutputImageSize();
+}
+VIRTUAL LossLayerMaker *DataParallelNet::cloneLossLayerMaker() const {
+    return replicas[0]->cloneLossLayerMaker();
+}
+VIRTUAL float DataParallelNet::calcLoss(float const *expectedValues ) {
+    const int outputCubeSize = getOutputCubeSize();
+    vector< float > losses( replicas.size(), 0.0f );
+    runOnReplicas( [&]( int replica ) {
+        losses[replica] = replicas[replica]->calcLoss( expectedValues + shardBegins[replica] * outputCubeSize );
+    } );
+    float loss = 0.0f;
+    for( int i = 0; i < (int)losses.size(); i++ ) {
+        loss += losses[i];
+    }
+    return loss;
+}
+VIRTUAL float DataParallelNet::calcLossFromLabels(int const *labels ) {
+    vector< float > losses( replicas.size(), 0.0f );
+    runOnReplicas( [&]( int replica ) {
+        losses[replica] = replicas[replica]->calcLossFromLabels( labels + shardBegins[replica] );
+    } );
+    float loss = 0.0f;
+    for( int i = 0; i < (int)losses.size(); i++ ) {
+        loss += losses[i];
+    }
+    return loss;
+}
+VIRTUAL void DataParallelNet::setBatchSize( int batchSize ) {
+    const int numReplicas = (int)replicas.size();
+    for( int i = 0; i <= numReplicas; i++ ) {
+        shardBegins[i] = (int)( (long long)batchSize * i / numReplicas );
+    }
+    for( int i = 0; i < numReplicas; i++ ) {
+        if( getShardSize( i ) > 0 ) {
+            replicas[i]->setBatchSize( getShardSize( i ) );
+        }
+    }
+    this->batchSize = batchSize;
+    if( batchSize <= allocatedSize ) {
+        return;
+    }
+    if( results != 0 ) {
+        delete[] results;
+    }
+    allocatedSize = batchSize;
+    results = new float[ batchSize * getOutputCubeSize() ];
+}
+VIRTUAL void DataParallelNet::setTraining( bool training ) {
+    for( int i = 0; i < (int)replicas.size(); i++ ) {
+        replicas[i]->setTraining( training );
+    }
+}
+VIRTUAL int DataParallelNet::calcNumRight( int const *labels ) {
+    vector< int > numRights( replicas.size(), 0 );
+    runOnReplicas( [&]( int replica ) {
+        numRights[replica] = replicas[replica]->calcNumRight( labels + shardBegins[replica] );
+    } );
+    int numRight = 0;
+    for( int i = 0; i < (int)numRights.size(); i++ ) {
+        numRight += numRights[i];
+    }
+    return numRight;
+}
+VIRTUAL void DataParallelNet::propagate( float const*images) {
+    const int inputCubeSize = getInputCubeSize();
+    runOnReplicas( [&]( int replica ) {
+        replicas[replica]->propagate( images + shardBegins[replica] * inputCubeSize );
+        copyResults( replica );
+    } );
+}
+VIRTUAL void DataParallelNet::propagate( unsigned char const*images) {
+    const int inputCubeSize = getInputCubeSize();
+    runOnReplicas( [&]( int replica ) {
+        replicas[replica]->propagate( images + shardBegins[replica] * inputCubeSize );
+        copyResults( replica );
+    } );
+}
+VIRTUAL void DataParallelNet::backPropFromLabels( float learningRate, int const *labels) {
+    runOnReplicas( [&]( int replica ) {
+        replicas[replica]->backPropFromLabels( learningRate, labels + shardBegins[replica] );
+        WeightsPersister::copyNetWeightsToArray( replicas[replica], replicaParams[replica] );
+    } );
+    reduceParams();
+    broadcastParams();
+}
+VIRTUAL void DataParallelNet::backProp( float learningRate, float const *expectedResults) {
+    const int outputCubeSize = getOutputCubeSize();
+    runOnReplicas( [&]( int replica ) {
+        replicas[replica]->backProp( learningRate, expectedResults + shardBegins[replica] * outputCubeSize );
+        WeightsPersister::copyNetWeightsToArray( replicas[replica], replicaParams[replica] );
+    } );
+    reduceParams();
+    broadcastParams();
+}
+VIRTUAL float const *DataParallelNet::getResults() const {
+    return results;
+}
+// runs fn for each replica with some examples in this batch, in parallel
+void DataParallelNet::runOnReplicas( ReplicaFunction const &fn ) {
+    ThreadPool::instance()->parallelFor( (int)replicas.size(), [&]( int begin, int end ) {
+        for( int replica = begin; replica < end; replica++ ) {
+            if( getShardSize( replica ) > 0 ) {
+                fn( replica );
+            }
+        }
+    } );
+}
+void DataParallelNet::copyResults( int replica ) {
+    const int outputCubeSize = getOutputCubeSize();
+    memcpy( results + shardBegins[replica] * outputCubeSize, replicas[replica]->getResults(),
+        sizeof( float ) * getShardSize( replica ) * outputCubeSize );
+}
+// params += the sum of the changes each replica made, added up pairwise, then
+// pairs of pairs, and so on, so no one replica's sum gets much bigger than the
+// others.  each thread has its own range of weights, so there are no locks, and
+// no atomics.  replicaParams are overwritten
+void DataParallelNet::reduceParams() {
+    StatefulTimer::timeCheck("DataParallelNet::reduceParams start");
+    vector< float * > deltas;
+    for( int i = 0; i < (int)replicas.size(); i++ ) {
+        if( getShardSize( i ) > 0 ) {
+            deltas.push_back( replicaParams[i] );
+        }
+    }
+    const int numDeltas = (int)deltas.size();
+    ThreadPool::instance()->parallelFor( numParams, 4096, [&]( int begin, int end ) {
+        for( int i = 0; i < numDeltas; i++ ) {
+            float *delta = deltas[i];
+            for( int j = begin; j < end; j++ ) {
+                delta[j] -= params[j];
+            }
+        }
+        for( int stride = 1; stride < numDeltas; stride *= 2 ) {
+            for( int i = 0; i + stride < numDeltas; i += 2 * stride ) {
+                float *sum = deltas[i];
+                float const *other = deltas[i + stride];
+                for( int j = begin; j < end; j++ ) {
+                    sum[j] += other[j];
+                }
+            }
+        }
+        if( numDeltas > 0 ) {
+            float const *sum = deltas[0];
+            for( int j = begin; j < end; j++ ) {
+                params[j] += sum[j];
+            }
+        }
+    } );
+    StatefulTimer::timeCheck("DataParallelNet::reduceParams end");
+}
+// every replica, including those with no examples this batch, gets params
+void DataParallelNet::broadcastParams() {
+    ThreadPool::instance()->parallelFor( (int)replicas.size(), [&]( int begin, int end ) {
+        for( int replica = begin; replica < end; replica++ ) {
+            WeightsPersister::copyArrayToNetWeights( params, replicas[replica] );
+        }
+    } );
+}
+
@@ -0,0 +1,74 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#include "Trainable.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+class NeuralNet;
+
+// trains several replicas of one net at once, on the ThreadPool, each on its own
+// slice of every batch.  the model passed in is replica 0, and holds the shared
+// weights; the others are clones, each with its own OpenCLHelper
+// after each backprop, the changes each replica made to its weights are added
+// up, pairwise, in a tree, and every replica gets the result.  learning rates in
+// DeepCL apply to the loss summed over the batch, so this gives the same weights
+// as model learning the whole batch on its own, up to rounding
+class DeepCL_EXPORT DataParallelNet : public Trainable {
+public:
+    typedef std::function< void( int replica ) > ReplicaFunction;
+
+    std::vector< NeuralNet * > replicas; // we dont own replicas[0]
+    std::vector< int > shardBegins; // replica i gets examples [shardBegins[i], shardBegins[i+1])
+    int batchSize;
+    float *results;
+    int allocatedSize;
+    int numParams;
+    float *params; // the shared weights, in WeightsPersister order
+    std::vector< float * > replicaParams;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    DataParallelNet( int numReplicas, NeuralNet *model );
+    VIRTUAL ~DataParallelNet();
+    int getNumReplicas() const;
+    NeuralNet *getReplica( int replica );
+    int getShardSize( int replica ) const;
+    VIRTUAL int getInputCubeSize() const;
+    VIRTUAL int getOutputCubeSize() const;
+    VIRTUAL int getResultsSize() const;
+    VIRTUAL int getOutputPlanes() const;
+    VIRTUAL int getOutputImageSize() const;
+    VIRTUAL LossLayerMaker *cloneLossLayerMaker() const;
+    VIRTUAL float calcLoss(float const *expectedValues );
+    VIRTUAL float calcLossFromLabels(int const *labels );
+    VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL void setTraining( bool training );
+    VIRTUAL int calcNumRight( int const *labels );
+    VIRTUAL void propagate( float const*images);
+    VIRTUAL void propagate( unsigned char const*images);
+    VIRTUAL void backPropFromLabels( float learningRate, int const *labels);
+    VIRTUAL void backProp( float learningRate, float const *expectedResults);
+    VIRTUAL float const *getResults() const;
+    void runOnReplicas( ReplicaFunction const &fn );
+    void copyResults( int replica );
+    void reduceParams();
+    void broadcastParams();
+
+    // [[[end]]]
+};
+
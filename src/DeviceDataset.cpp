@@ -0,0 +1,149 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+
+#include "OpenCLHelper.h"
+#include "StatefulTimer.h"
+#include "stringhelper.h"
+#include "ZeroCopy.h"
+
+#include "DeviceDataset.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+DeviceDataset::DeviceDataset( OpenCLHelper *cl, int N, int cubeSize, unsigned char *data, float translate, float scale ) :
+        cl( cl ),
+        N( N ),
+        cubeSize( cubeSize ),
+        translate( translate ),
+        scale( scale ),
+        data( data ),
+        dataWrapper( 0 ),
+        kernel( 0 ),
+        allocatedBatchSize( 0 ),
+        indices( 0 ),
+        indicesWrapper( 0 ),
+        batch( 0 ),
+        batchWrapper( 0 ) {
+    long dataSize = (long)N * cubeSize;
+    if( dataSize > ( 1l << 31 ) - 1 ) {
+        throw runtime_error("dataset too large to hold on device: " + toString( dataSize ) + " bytes" );
+    }
+    if( dataSize / 1024 / 1024 >= cl->getMaxAllocSizeMB() ) {
+        throw runtime_error("dataset of " + toString( dataSize / 1024 / 1024 ) + "MB doesnt fit in a single device buffer, max alloc size is " 
+            + toString( cl->getMaxAllocSizeMB() ) + "MB" );
+    }
+    dataWrapper = ZeroCopy::wrap( cl, (int)dataSize, data );
+    ZeroCopy::copyToDevice( dataWrapper );
+    StatefulTimer::timeCheck("DeviceDataset uploaded dataset");
+
+    string options = "";
+    options += " -DgCubeSize=" + toString( cubeSize );
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2( "kernel", "cl/gather.cl", "gatherNormalize", 'options' )
+    // ]]]
+    // generated using cog, from cl/gather.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n" 
+    "//\n" 
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n" 
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n" 
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n" 
+    "\n" 
+    "// builds one batch from a dataset that is already resident on the device\n" 
+    "// indices holds the example index, within data, of each example in the batch\n" 
+    "// each value is converted to float, and normalized, as it is copied, ie:\n" 
+    "//     batch = ( data + translate ) * scale\n" 
+    "// which is the same transform as NormalizationLayer\n" 
+    "//\n" 
+    "// globalid is: [n][cubeoffset], where n is the index within the batch\n" 
+    "// one thread per output float, so reads are coalesced within each example\n" 
+    "// needs gCubeSize\n" 
+    "kernel void gatherNormalize( const int batchSize, global const int *indices, global const unsigned char *data,\n" 
+    "        global float *batch, const float translate, const float scale ) {\n" 
+    "    const int globalId = get_global_id(0);\n" 
+    "    if( globalId >= batchSize * gCubeSize ) {\n" 
+    "        return;\n" 
+    "    }\n" 
+    "    const int n = globalId / gCubeSize;\n" 
+    "    const int cubeOffset = globalId % gCubeSize;\n" 
+    "    const int example = indices[n];\n" 
+    "    batch[globalId] = ( (float)data[ example * gCubeSize + cubeOffset ] + translate ) * scale;\n" 
+    "}\n" 
+    "\n" 
+    "";
+    kernel = cl->buildKernelFromString( kernelSource, "gatherNormalize", options, "cl/gather.cl" );
+    // [[[end]]]
+}
+VIRTUAL DeviceDataset::~DeviceDataset() {
+    delete kernel;
+    if( batchWrapper != 0 ) {
+        delete batchWrapper;
+    }
+    ZeroCopy::deallocate( batch );
+    if( indicesWrapper != 0 ) {
+        delete indicesWrapper;
+    }
+    ZeroCopy::deallocate( indices );
+    delete dataWrapper;
+}
+int DeviceDataset::getN() const {
+    return N;
+}
+int DeviceDataset::getCubeSize() const {
+    return cubeSize;
+}
+void DeviceDataset::setBatchSize( int batchSize ) {
+    if( batchSize <= allocatedBatchSize ) {
+        return;
+    }
+    if( batchWrapper != 0 ) {
+        delete batchWrapper;
+    }
+    ZeroCopy::deallocate( batch );
+    if( indicesWrapper != 0 ) {
+        delete indicesWrapper;
+    }
+    ZeroCopy::deallocate( indices );
+    allocatedBatchSize = batchSize;
+    indices = ZeroCopy::allocateInts( batchSize );
+    indicesWrapper = ZeroCopy::wrap( cl, batchSize, indices );
+    batch = ZeroCopy::allocateFloats( batchSize * cubeSize );
+    batchWrapper = ZeroCopy::wrap( cl, batchSize * cubeSize, batch );
+    ZeroCopy::createOnDevice( batchWrapper );
+}
+// gathers the examples batchIndices[0..batchSize-1] into the batch buffer, on the device,
+// and returns the wrapper for that buffer. Only the device-side copy is written; the 
+// host array of the returned wrapper is only valid after calling ZeroCopy::copyToHost() on it
+// the returned wrapper is owned by this object, and is reused by the next call
+CLWrapper *DeviceDataset::gather( int batchSize, int const*batchIndices ) {
+    setBatchSize( batchSize );
+    for( int i = 0; i < batchSize; i++ ) {
+        if( batchIndices[i] < 0 || batchIndices[i] >= N ) {
+            throw runtime_error("DeviceDataset::gather index " + toString( batchIndices[i] ) + " out of range, N=" + toString( N ) );
+        }
+        indices[i] = batchIndices[i];
+    }
+    ZeroCopy::copyToDevice( indicesWrapper );
+    kernel->in( batchSize )->in( indicesWrapper )->in( dataWrapper )->out( batchWrapper )->in( translate )->in( scale );
+    int globalSize = batchSize * cubeSize;
+    int workgroupSize = cl->getMaxWorkgroupSize();
+    globalSize = ( ( globalSize + workgroupSize - 1 ) / workgroupSize ) * workgroupSize;
+    kernel->run_1d( globalSize, workgroupSize );
+    cl->finish();
+    StatefulTimer::timeCheck("DeviceDataset::gather end");
+    return batchWrapper;
+}
+
@@ -0,0 +1,58 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+class OpenCLHelper;
+class CLWrapper;
+class CLKernel;
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+// holds an entire unsigned char dataset in an OpenCL buffer, which is uploaded
+// just once, when this object is created
+// each batch is then built on the device, by a gather kernel, which takes a list
+// of example indices, and writes the normalized float images into a batch buffer
+// that can be fed straight into InputLayer<float>::inWrapper
+// only the indices cross the bus, per batch
+// on cpu opencl devices, the dataset buffer lives in main memory anyway, so this 
+// path then just avoids the per-batch conversion and copy on the host side
+class DeepCL_EXPORT DeviceDataset {
+public:
+    OpenCLHelper *cl; // NOT owned by us
+    const int N;
+    const int cubeSize;
+    const float translate;
+    const float scale;
+
+    unsigned char *data; // NOT owned by us, but must stay alive as long as we do
+    CLWrapper *dataWrapper;
+    CLKernel *kernel;
+
+    int allocatedBatchSize;
+    int *indices;
+    CLWrapper *indicesWrapper;
+    float *batch;
+    CLWrapper *batchWrapper;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    DeviceDataset( OpenCLHelper *cl, int N, int cubeSize, unsigned char *data, float translate, float scale );
+    VIRTUAL ~DeviceDataset();
+    int getN() const;
+    int getCubeSize() const;
+    void setBatchSize( int batchSize );
+    CLWrapper *gather( int batchSize, int const*batchIndices );
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,248 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+#include "NeuralNet.h"
+#include "Layer.h"
+#include "WeightsPersister.h"
+#include "RingAllReduce.h"
+#include "StatefulTimer.h"
+#include "ResumeState.h"
+
+#include "DistributedNet.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+// every process starts from the weights of the process with rank 0
+DistributedNet::DistributedNet( NeuralNet *net, RingAllReduce *ring ) :
+        net( net ),
+        ring( ring ),
+        numParams( 0 ),
+        params( 0 ),
+        changes( 0 ),
+        numBucketsReduced( 0 ),
+        reducing( false ),
+        stopping( false ) {
+    numParams = WeightsPersister::getTotalNumWeights( net );
+    params = new float[ numParams ];
+    changes = new float[ numParams ];
+    WeightsPersister::copyNetWeightsToArray( net, params );
+    ring->broadcastFromRank0( params, numParams );
+    WeightsPersister::copyArrayToNetWeights( params, net );
+
+    const int numLayers = net->getNumLayers();
+    bucketOfLayer.resize( numLayers, -1 );
+    for( int layerIdx = numLayers - 1; layerIdx >= 1; layerIdx-- ) {
+        const int persistSize = net->getLayer( layerIdx )->getPersistSize();
+        if( persistSize > 0 ) {
+            bucketOfLayer[layerIdx] = (int)bucketLayers.size();
+            bucketLayers.push_back( layerIdx );
+            bucketOffsets.push_back( WeightsPersister::getArrayOffsetForLayer( net, layerIdx ) );
+            bucketSizes.push_back( persistSize );
+        }
+    }
+    bucketReady.resize( bucketLayers.size(), 0 );
+    net->setWeightsUpdatedListener( this );
+    reducer = std::thread( &DistributedNet::runReducer, this );
+}
+VIRTUAL DistributedNet::~DistributedNet() {
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        stopping = true;
+    }
+    bucketChanged.notify_all();
+    reducer.join();
+    net->setWeightsUpdatedListener( 0 );
+    delete[] changes;
+    delete[] params;
+}
+VIRTUAL int DistributedNet::getInputCubeSize() const {
+    return net->getInputCubeSize();
+}
+VIRTUAL int DistributedNet::getOutputCubeSize() const {
+    return net->getOutputCubeSize();
+}
+VIRTUAL int DistributedNet::getResultsSize() const {
+    return net->getResultsSize();
+}
+VIRTUAL int DistributedNet::getOutputPlanes() const {
+    return net->getOutputPlanes();
+}
+VIRTUAL int DistributedNet::getOutputImageSize() const {
+    return net->getOutputImageSize();
+}
+VIRTUAL LossLayerMaker *DistributedNet::cloneLossLayerMaker() const {
+    return net->cloneLossLayerMaker();
+}
+VIRTUAL float DistributedNet::calcLoss(float const *expectedValues ) {
+    return net->calcLoss( expectedValues );
+}
+VIRTUAL float DistributedNet::calcLossFromLabels(int const *labels ) {
+    return net->calcLossFromLabels( labels );
+}
+VIRTUAL void DistributedNet::setBatchSize( int batchSize ) {
+    net->setBatchSize( batchSize );
+}
+VIRTUAL void DistributedNet::setTraining( bool training ) {
+    net->setTraining( training );
+}
+VIRTUAL int DistributedNet::calcNumRight( int const *labels ) {
+    return net->calcNumRight( labels );
+}
+VIRTUAL void DistributedNet::propagate( float const*images) {
+    net->propagate( images );
+}
+VIRTUAL void DistributedNet::propagate( unsigned char const*images) {
+    net->propagate( images );
+}
+VIRTUAL void DistributedNet::backPropFromLabels( float learningRate, int const *labels) {
+    startReduce();
+    net->backPropFromLabels( learningRate, labels );
+    finishReduce();
+}
+VIRTUAL void DistributedNet::backProp( float learningRate, float const *expectedResults) {
+    startReduce();
+    net->backProp( learningRate, expectedResults );
+    finishReduce();
+}
+VIRTUAL float const *DistributedNet::getResults() const {
+    return net->getResults();
+}
+// called by net, during backprop, maybe from the thread pool
+VIRTUAL void DistributedNet::weightsUpdated( int layerIndex ) {
+    const int bucket = bucketOfLayer[layerIndex];
+    if( bucket == -1 ) {
+        return;
+    }
+    calcChanges( bucket );
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        bucketReady[bucket] = 1;
+    }
+    bucketChanged.notify_all();
+}
+void DistributedNet::calcChanges( int bucket ) {
+    const int offset = bucketOffsets[bucket];
+    const int size = bucketSizes[bucket];
+    net->getLayer( bucketLayers[bucket] )->persistToArray( changes + offset );
+    for( int i = offset; i < offset + size; i++ ) {
+        changes[i] -= params[i];
+    }
+}
+void DistributedNet::startReduce() {
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        for( int i = 0; i < (int)bucketReady.size(); i++ ) {
+            bucketReady[i] = 0;
+        }
+        numBucketsReduced = 0;
+        reduceError = std::exception_ptr();
+        reducing = true;
+    }
+    bucketChanged.notify_all();
+}
+// buckets of layers that backprop skipped still go round the ring, so every
+// process sends the same buckets, in the same order
+void DistributedNet::finishReduce() {
+    const int numBuckets = (int)bucketLayers.size();
+    std::unique_lock< std::mutex > lock( mutex );
+    for( int bucket = 0; bucket < numBuckets; bucket++ ) {
+        if( !bucketReady[bucket] ) {
+            lock.unlock();
+            calcChanges( bucket );
+            lock.lock();
+            bucketReady[bucket] = 1;
+            bucketChanged.notify_all();
+        }
+    }
+    while( numBucketsReduced < numBuckets ) {
+        bucketChanged.wait( lock );
+    }
+    reducing = false;
+    if( reduceError ) {
+        std::rethrow_exception( reduceError );
+    }
+    lock.unlock();
+    for( int i = 0; i < numParams; i++ ) {
+        params[i] += changes[i];
+    }
+    WeightsPersister::copyArrayToNetWeights( params, net );
+}
+// reduces the buckets of each batch in order, as they become ready
+void DistributedNet::runReducer() {
+    const int numBuckets = (int)bucketLayers.size();
+    std::unique_lock< std::mutex > lock( mutex );
+    while( true ) {
+        while( !stopping && !( reducing && numBucketsReduced < numBuckets && bucketReady[numBucketsReduced] ) ) {
+            bucketChanged.wait( lock );
+        }
+        if( stopping ) {
+            return;
+        }
+        const int bucket = numBucketsReduced;
+        lock.unlock();
+        StatefulTimer::timeCheck("DistributedNet bucket start");
+        try {
+            ring->allReduce( changes + bucketOffsets[bucket], bucketSizes[bucket] );
+        } catch( ... ) {
+            lock.lock();
+            reduceError = std::current_exception();
+            numBucketsReduced = numBuckets;
+            bucketChanged.notify_all();
+            continue;
+        }
+        StatefulTimer::timeCheck("DistributedNet bucket end");
+        lock.lock();
+        numBucketsReduced++;
+        bucketChanged.notify_all();
+    }
+}
+
+// only rank 0 needs to have loaded the weights file: the other ranks take where
+// to resume from, ie the epoch, batch, totals, example order and MyRandom
+// state, from rank 0, so every rank runs the same batches.  call before
+// creating the DistributedNet, which takes the weights from rank 0 too.
+// returns whether rank 0 is resuming
+STATIC bool DistributedNet::broadcastResumeState( RingAllReduce *ring, bool resuming, ResumeState *resumeState ) {
+    // resuming, epoch, batch, numRight, loss, annealedLearningRate, section size
+    int header[7] = { 0, 0, 0, 0, 0, 0, 0 };
+    if( ring->getRank() == 0 && resuming ) {
+        header[0] = 1;
+        header[1] = resumeState->epoch;
+        header[2] = resumeState->batch;
+        header[3] = resumeState->numRight;
+        memcpy( &header[4], &resumeState->loss, sizeof( float ) );
+        memcpy( &header[5], &resumeState->annealedLearningRate, sizeof( float ) );
+        header[6] = resumeState->getSectionSize();
+    }
+    ring->broadcastBytesFromRank0( (char *)header, sizeof( header ) );
+    if( header[0] == 0 ) {
+        *resumeState = ResumeState();
+        return false;
+    }
+    std::vector< char > section( header[6] );
+    if( ring->getRank() == 0 ) {
+        resumeState->writeSection( &section[0], resumeState->randomState );
+    }
+    ring->broadcastBytesFromRank0( &section[0], header[6] );
+    if( ring->getRank() != 0 ) {
+        resumeState->epoch = header[1];
+        resumeState->batch = header[2];
+        resumeState->numRight = header[3];
+        memcpy( &resumeState->loss, &header[4], sizeof( float ) );
+        memcpy( &resumeState->annealedLearningRate, &header[5], sizeof( float ) );
+        resumeState->readSection( &section[0], header[6] );
+    }
+    return true;
+}
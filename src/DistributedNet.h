@@ -0,0 +1,89 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "Trainable.h"
+#include "IWeightsUpdatedListener.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+class NeuralNet;
+class RingAllReduce;
+class ResumeState;
+
+// one process's part of data-parallel training across several processes: net
+// learns this process's shard of the data, and after each backprop, the weight
+// changes of every process are summed, over ring, and applied everywhere, so the
+// nets stay the same.  as for DataParallelNet, this matches one net learning all
+// the processes' batches at once, with the same learning rate
+// the changes go one bucket, ie one layer, at a time, on a thread of their own,
+// starting as soon as backprop has updated that layer, so sending the top
+// layers overlaps backprop of the layers below
+// every process must make the same calls, with the same batch sizes
+class DeepCL_EXPORT DistributedNet : public Trainable, public IWeightsUpdatedListener {
+public:
+    NeuralNet *net; // not owned by us
+    RingAllReduce *ring; // not owned by us
+    int numParams;
+    float *params; // weights at the start of the batch, the same on every process
+    float *changes; // changes made by this process, then the sum over all of them
+    std::vector< int > bucketLayers; // layers with weights, top first, ie in backprop order
+    std::vector< int > bucketOffsets; // into params and changes
+    std::vector< int > bucketSizes;
+    std::vector< int > bucketOfLayer; // -1 for layers without weights
+
+    std::mutex mutex;
+    std::condition_variable bucketChanged;
+    std::vector< char > bucketReady; // changes for the bucket are in changes
+    int numBucketsReduced;
+    bool reducing;
+    bool stopping;
+    std::exception_ptr reduceError;
+    std::thread reducer;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    DistributedNet( NeuralNet *net, RingAllReduce *ring );
+    VIRTUAL ~DistributedNet();
+    VIRTUAL int getInputCubeSize() const;
+    VIRTUAL int getOutputCubeSize() const;
+    VIRTUAL int getResultsSize() const;
+    VIRTUAL int getOutputPlanes() const;
+    VIRTUAL int getOutputImageSize() const;
+    VIRTUAL LossLayerMaker *cloneLossLayerMaker() const;
+    VIRTUAL float calcLoss(float const *expectedValues );
+    VIRTUAL float calcLossFromLabels(int const *labels );
+    VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL void setTraining( bool training );
+    VIRTUAL int calcNumRight( int const *labels );
+    VIRTUAL void propagate( float const*images);
+    VIRTUAL void propagate( unsigned char const*images);
+    VIRTUAL void backPropFromLabels( float learningRate, int const *labels);
+    VIRTUAL void backProp( float learningRate, float const *expectedResults);
+    VIRTUAL float const *getResults() const;
+    VIRTUAL void weightsUpdated( int layerIndex );
+    void calcChanges( int bucket );
+    void startReduce();
+    void finishReduce();
+    void runReducer();
+    STATIC bool broadcastResumeState( RingAllReduce *ring, bool resuming, ResumeState *resumeState );
+
+    // [[[end]]]
+};
+
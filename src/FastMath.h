@@ -0,0 +1,62 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <cstring>
+
+#include "DeepCLDllExport.h"
+
+// approximations to exp, tanh and sigmoid, for the 'fastmath' precision setting
+// they have no branches or library calls, so loops over arrays of them vectorize
+// max errors, measured over the float range, are:
+//  - exp: relative error 1e-5, for x in [-87, 88]; clamped outside that
+//  - tanh: absolute and relative error 5e-7
+//  - sigmoid: absolute error 3e-7
+// cl/activate.cl, cl/fc_gemm.cl and cl/softmax.cl have the same approximations,
+// when built with -D FAST_MATH
+class DeepCL_EXPORT FastMath {
+public:
+    // 2^n * 2^f, with n = round( x * log2(e) ), and f in [-0.5, 0.5], where the
+    // degree 5 taylor series for 2^f is good enough
+    static inline float exp( float x ) {
+        x = x < -87.0f ? -87.0f : x;
+        x = x > 88.0f ? 88.0f : x;
+        const float t = x * 1.44269504f;
+        const float rounded = t + ( t >= 0 ? 0.5f : -0.5f );
+        const int n = (int)rounded;
+        const float f = ( t - n ) * 0.693147181f;
+        const float p = 1.0f + f * ( 1.0f + f * ( 0.5f + f * ( 0.166666667f + f * ( 0.0416666667f
+            + f * 0.00833333333f ) ) ) );
+        const int bits = ( n + 127 ) << 23;
+        float scale;
+        memcpy( &scale, &bits, sizeof( scale ) );
+        return p * scale;
+    }
+    // 13/6 rational approximation, on [-7.9, 7.9], outside which tanh is 1 to float precision
+    static inline float tanh( float x ) {
+        x = x < -7.90531111f ? -7.90531111f : x;
+        x = x > 7.90531111f ? 7.90531111f : x;
+        const float x2 = x * x;
+        float p = -2.76076847742355e-16f;
+        p = p * x2 + 2.00018790482477e-13f;
+        p = p * x2 - 8.60467152213735e-11f;
+        p = p * x2 + 5.12229709037114e-08f;
+        p = p * x2 + 1.48572235717979e-05f;
+        p = p * x2 + 6.37261928875436e-04f;
+        p = p * x2 + 4.89352455891786e-03f;
+        p = p * x;
+        float q = 1.19825839466702e-06f;
+        q = q * x2 + 1.18534705686654e-04f;
+        q = q * x2 + 2.26843463243900e-03f;
+        q = q * x2 + 4.89352518554385e-03f;
+        return p / q;
+    }
+    static inline float sigmoid( float x ) {
+        return 0.5f + 0.5f * tanh( 0.5f * x );
+    }
+};
+
@@ -4,6 +4,7 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "ZeroCopy.h"
 #include "ForceBackpropLayerMaker.h"
 
 #include "ForceBackpropLayer.h"
@@ -23,7 +24,7 @@ ForceBackpropLayer::ForceBackpropLayer( Layer *previousLayer, ForceBackpropLayer
 }
 VIRTUAL ForceBackpropLayer::~ForceBackpropLayer() {
     if( results != 0 ) {
-        delete[] results;
+        ZeroCopy::deallocate( results );
     }
 }
 VIRTUAL std::string ForceBackpropLayer::getClassName() const {
@@ -80,11 +81,11 @@ VIRTUAL void ForceBackpropLayer::setBatchSize( int batchSize ) {
         return;
     }
     if( results != 0 ) {
-        delete[] results;
+        ZeroCopy::deallocate( results );
     }
     this->batchSize = batchSize;
     this->allocatedSize = allocatedSize;
-    results = new float[ getResultsSize() ];
+    results = ZeroCopy::allocateFloats( getResultsSize() );
 }
 VIRTUAL void ForceBackpropLayer::propagate() {
     int totalLinearLength = getResultsSize();
@@ -41,6 +41,31 @@ VIRTUAL void FullyConnectedLayer::setBatchSize( int batchSize ) {
     convolutionalLayer->setBatchSize( batchSize );
     this->batchSize = batchSize;
 }
+VIRTUAL void FullyConnectedLayer::setInferenceOnly() {
+    Layer::setInferenceOnly();
+    convolutionalLayer->setInferenceOnly();
+}
+VIRTUAL void FullyConnectedLayer::shareWeightsFrom( Layer *source ) {
+    FullyConnectedLayer *sourceLayer = dynamic_cast< FullyConnectedLayer * >( source );
+    if( sourceLayer == 0 ) {
+        throw runtime_error("layer " + toString( layerIndex ) + ": can only share weights with another fully connected layer");
+    }
+    convolutionalLayer->shareWeightsFrom( sourceLayer->convolutionalLayer );
+}
+VIRTUAL void FullyConnectedLayer::setLowLatency( bool lowLatency ) {
+    Layer::setLowLatency( lowLatency );
+    convolutionalLayer->previousLayer = this->previousLayer;
+    convolutionalLayer->setLowLatency( lowLatency );
+}
+VIRTUAL bool FullyConnectedLayer::canUseArena() const {
+    return convolutionalLayer->canUseArena();
+}
+VIRTUAL void FullyConnectedLayer::setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper ) {
+    convolutionalLayer->previousLayer = this->previousLayer;
+    convolutionalLayer->nextLayer = this->nextLayer;
+    convolutionalLayer->setResultsBuffer( batchSize, results, resultsWrapper );
+    this->batchSize = batchSize;
+}
 VIRTUAL int FullyConnectedLayer::getOutputImageSize() const {
     return imageSize;
 }
@@ -95,6 +120,24 @@ VIRTUAL void FullyConnectedLayer::propagate() {
 VIRTUAL void FullyConnectedLayer::backProp( float learningRate ) {
     convolutionalLayer->backProp( learningRate );
 }
+VIRTUAL void FullyConnectedLayer::backPropErrors( float learningRate ) {
+    convolutionalLayer->backPropErrors( learningRate );
+}
+VIRTUAL void FullyConnectedLayer::backPropWeights( float learningRate ) {
+    convolutionalLayer->backPropWeights( learningRate );
+}
+VIRTUAL bool FullyConnectedLayer::backPropWeightsOnHost() const {
+    return convolutionalLayer->backPropWeightsOnHost();
+}
+VIRTUAL void FullyConnectedLayer::startBackPropWeightsOnHost() {
+    convolutionalLayer->startBackPropWeightsOnHost();
+}
+VIRTUAL void FullyConnectedLayer::finishBackPropWeightsOnHost() {
+    convolutionalLayer->finishBackPropWeightsOnHost();
+}
+VIRTUAL void FullyConnectedLayer::setTinyWeightsOnHost( bool onHost ) {
+    convolutionalLayer->setTinyWeightsOnHost( onHost );
+}
 VIRTUAL std::string FullyConnectedLayer::asString() const {
     return "FullyConnectedLayer{ numPlanes=" + toString( numPlanes ) + " imageSize=" + toString( imageSize ) + " " + fn->getDefineName() + " }";
 }
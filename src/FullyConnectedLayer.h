@@ -32,6 +32,11 @@ public:
     VIRTUAL ~FullyConnectedLayer();
     VIRTUAL std::string getClassName() const;
     VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL void setInferenceOnly();
+    VIRTUAL void shareWeightsFrom( Layer *source );
+    VIRTUAL void setLowLatency( bool lowLatency );
+    VIRTUAL bool canUseArena() const;
+    VIRTUAL void setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper );
     VIRTUAL int getOutputImageSize() const;
     VIRTUAL int getOutputPlanes() const;
     VIRTUAL int getPersistSize() const;
@@ -50,6 +55,12 @@ public:
     VIRTUAL bool needsBackProp();
     VIRTUAL void propagate();
     VIRTUAL void backProp( float learningRate );
+    VIRTUAL void backPropErrors( float learningRate );
+    VIRTUAL void backPropWeights( float learningRate );
+    VIRTUAL bool backPropWeightsOnHost() const;
+    VIRTUAL void startBackPropWeightsOnHost();
+    VIRTUAL void finishBackPropWeightsOnHost();
+    VIRTUAL void setTinyWeightsOnHost( bool onHost );
     VIRTUAL std::string asString() const;
 
     // [[[end]]]
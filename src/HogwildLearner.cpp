@@ -0,0 +1,190 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+#include <cmath>
+
+#include "StatefulTimer.h"
+#include "Timer.h"
+#include "BatchLearner.h"
+#include "NetLearner.h"
+#include "NeuralNet.h"
+#include "WeightsPersister.h"
+#include "ThreadPool.h"
+#include "stringhelper.h"
+
+#include "HogwildLearner.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+template< typename T > HogwildLearner<T>::HogwildLearner( NeuralNet *net, int numWorkers ) :
+        net( net ),
+        numWeights( 0 ),
+        sharedWeights( 0 ) {
+    if( numWorkers < 1 ) {
+        throw runtime_error("HogwildLearner needs at least one worker, not " + toString( numWorkers ) );
+    }
+    batchSize = 128;
+    numEpochs = 12;
+    startEpoch = 1;
+    dumpTimings = false;
+    numWeights = WeightsPersister::getTotalNumWeights( net );
+    sharedWeights = new std::atomic< float >[ numWeights ];
+    replicas.push_back( net );
+    for( int i = 1; i < numWorkers; i++ ) {
+        replicas.push_back( net->clone() );
+    }
+    for( int i = 0; i < numWorkers; i++ ) {
+        loadedWeights.push_back( new float[ numWeights ] );
+        updatedWeights.push_back( new float[ numWeights ] );
+    }
+    WeightsPersister::copyNetWeightsToArray( net, loadedWeights[0] );
+    for( int i = 0; i < numWeights; i++ ) {
+        sharedWeights[i].store( loadedWeights[0][i], std::memory_order_relaxed );
+    }
+}
+template< typename T > VIRTUAL HogwildLearner<T>::~HogwildLearner() {
+    for( int i = 0; i < (int)loadedWeights.size(); i++ ) {
+        delete[] loadedWeights[i];
+        delete[] updatedWeights[i];
+    }
+    for( int i = 1; i < (int)replicas.size(); i++ ) {
+        delete replicas[i];
+    }
+    delete[] sharedWeights;
+}
+template< typename T > int HogwildLearner<T>::getNumWorkers() const {
+    return (int)replicas.size();
+}
+template< typename T > void HogwildLearner<T>::setTrainingData( int Ntrain, T *trainData, int *trainLabels ) {
+    this->Ntrain = Ntrain;
+    this->trainData = trainData;
+    this->trainLabels = trainLabels;
+}
+template< typename T > void HogwildLearner<T>::setTestingData( int Ntest, T *testData, int *testLabels ) {
+    this->Ntest = Ntest;
+    this->testData = testData;
+    this->testLabels = testLabels;
+}
+template< typename T > void HogwildLearner<T>::setSchedule( int numEpochs ) {
+    setSchedule( numEpochs, 1 );
+}
+template< typename T > void HogwildLearner<T>::setDumpTimings( bool dumpTimings ) {
+    this->dumpTimings = dumpTimings;
+}
+template< typename T > void HogwildLearner<T>::setSchedule( int numEpochs, int startEpoch ) {
+    this->numEpochs = numEpochs;
+    this->startEpoch = startEpoch;
+}
+template< typename T > void HogwildLearner<T>::setBatchSize( int batchSize ) {
+    this->batchSize = batchSize;
+}
+template< typename T > VIRTUAL void HogwildLearner<T>::addPostEpochAction( PostEpochAction *action ) {
+    postEpochActions.push_back( action );
+}
+template< typename T > void HogwildLearner<T>::learn( float learningRate ) {
+    learn( learningRate, 1.0f );
+}
+// prints the same as NetLearner, so the two can be compared by images/s, and by
+// test accuracy against training time
+template< typename T > void HogwildLearner<T>::learn( float learningRate, float annealLearningRate ) {
+    BatchLearner<T> batchLearner( net );
+    Timer timer;
+    double trainingMilliseconds = 0;
+    for( int epoch = startEpoch; epoch <= numEpochs; epoch++ ) {
+        float annealedLearningRate = learningRate * pow( annealLearningRate, epoch );
+        Timer epochTimer;
+        EpochResult epochResult = runEpoch( annealedLearningRate );
+        const double epochMilliseconds = epochTimer.lap();
+        trainingMilliseconds += epochMilliseconds;
+        if( dumpTimings ) {
+            StatefulTimer::dump(true);
+        }
+        cout << endl;
+        timer.timeCheck("after epoch " + toString(epoch ) );
+        cout << getNumWorkers() << " hogwild workers: " << ( Ntrain * 1000.0 / epochMilliseconds ) << " images/s" << endl;
+        cout << "annealed learning rate: " << annealedLearningRate << " training loss: " << epochResult.loss << endl;
+        cout << " train accuracy: " << epochResult.numRight << "/" << Ntrain << " " << (epochResult.numRight * 100.0f/ Ntrain) << "%" << std::endl;
+        int testNumRight = batchLearner.test( batchSize, Ntest, testData, testLabels );
+        cout << "test accuracy: " << testNumRight << "/" << Ntest << " " << (testNumRight * 100.0f / Ntest ) << "%"
+            << " after " << ( trainingMilliseconds / 1000.0 ) << "s training" << endl;
+        timer.timeCheck("after tests");
+        for( vector<PostEpochAction *>::iterator it = postEpochActions.begin(); it != postEpochActions.end(); it++ ) {
+            (*it)->run( epoch );
+        }
+    }
+}
+// one pass through the training data, shared between the workers.  afterwards,
+// net holds the shared weights
+template< typename T > EpochResult HogwildLearner<T>::runEpoch( float learningRate ) {
+    const int numWorkers = getNumWorkers();
+    std::atomic< int > nextBatch( 0 );
+    vector< float > losses( numWorkers, 0.0f );
+    vector< int > numRights( numWorkers, 0 );
+    for( int worker = 0; worker < numWorkers; worker++ ) {
+        replicas[worker]->setTraining( true );
+    }
+    ThreadPool::instance()->parallelFor( numWorkers, [&]( int begin, int end ) {
+        for( int worker = begin; worker < end; worker++ ) {
+            learnBatches( worker, learningRate, &nextBatch, &losses[worker], &numRights[worker] );
+        }
+    } );
+    for( int i = 0; i < numWeights; i++ ) {
+        loadedWeights[0][i] = sharedWeights[i].load( std::memory_order_relaxed );
+    }
+    WeightsPersister::copyArrayToNetWeights( loadedWeights[0], net );
+    float loss = 0.0f;
+    int numRight = 0;
+    for( int worker = 0; worker < numWorkers; worker++ ) {
+        loss += losses[worker];
+        numRight += numRights[worker];
+    }
+    return EpochResult( loss, numRight );
+}
+// runs on one thread, until the epoch has no batches left
+template< typename T > void HogwildLearner<T>::learnBatches( int worker, float learningRate, std::atomic< int > *nextBatch, float *loss, int *numRight ) {
+    NeuralNet *replica = replicas[worker];
+    float *loaded = loadedWeights[worker];
+    float *updated = updatedWeights[worker];
+    const int numBatches = ( Ntrain + batchSize - 1 ) / batchSize;
+    const int inputCubeSize = replica->getInputCubeSize();
+    int replicaBatchSize = 0;
+    for( int batch = (*nextBatch)++; batch < numBatches; batch = (*nextBatch)++ ) {
+        const int batchStart = batch * batchSize;
+        const int thisBatchSize = std::min( batchSize, Ntrain - batchStart );
+        if( thisBatchSize != replicaBatchSize ) {
+            replica->setBatchSize( thisBatchSize );
+            replicaBatchSize = thisBatchSize;
+        }
+        for( int i = 0; i < numWeights; i++ ) {
+            loaded[i] = sharedWeights[i].load( std::memory_order_relaxed );
+        }
+        WeightsPersister::copyArrayToNetWeights( loaded, replica );
+        replica->propagate( &(trainData[ batchStart * inputCubeSize ]) );
+        *loss += replica->calcLossFromLabels( &(trainLabels[batchStart]) );
+        *numRight += replica->calcNumRight( &(trainLabels[batchStart]) );
+        replica->backPropFromLabels( learningRate, &(trainLabels[batchStart]) );
+        WeightsPersister::copyNetWeightsToArray( replica, updated );
+        // not an atomic add: another worker's update to the same weight, between
+        // our load and our store, is lost.  rare, when updates are sparse
+        for( int i = 0; i < numWeights; i++ ) {
+            const float change = updated[i] - loaded[i];
+            if( change != 0.0f ) {
+                sharedWeights[i].store( sharedWeights[i].load( std::memory_order_relaxed ) + change, std::memory_order_relaxed );
+            }
+        }
+    }
+}
+
+template class HogwildLearner<unsigned char>;
+template class HogwildLearner<float>;
+
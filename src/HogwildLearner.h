@@ -0,0 +1,77 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+
+#define VIRTUAL virtual
+#define STATIC static
+
+class NeuralNet;
+class PostEpochAction;
+class EpochResult;
+
+#include "DeepCLDllExport.h"
+
+// asynchronous sgd, as in Hogwild! (Niu et al, 2011): several workers, each with
+// its own replica of the net, take the next batch of the epoch as soon as they
+// finish the last one.  for each batch, a worker reads the shared weights, learns
+// the batch, and adds the change to the shared weights, with no locks, so
+// workers can read half-updated weights, and updates can occasionally be lost.
+// works best when each batch only changes a few of the weights.
+// the shared weights are copied into net at the end of each epoch, for testing,
+// and for the PostEpochActions
+template<typename T>
+class DeepCL_EXPORT HogwildLearner {
+public:
+    NeuralNet *net; // replica 0, not owned by us
+    std::vector< NeuralNet * > replicas;
+    int numWeights;
+    std::atomic< float > *sharedWeights;
+    std::vector< float * > loadedWeights; // per worker, what it read from sharedWeights
+    std::vector< float * > updatedWeights; // per worker
+
+    int Ntrain;
+    int Ntest;
+    T *trainData;
+    int *trainLabels;
+    T *testData;
+    int *testLabels;
+
+    int batchSize;
+
+    bool dumpTimings;
+
+    int startEpoch;
+    int numEpochs;
+
+    std::vector<PostEpochAction *> postEpochActions; // note: we DONT own these, dont delete, caller owns
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add_templated()
+    // ]]]
+    // generated, using cog:
+    HogwildLearner( NeuralNet *net, int numWorkers );
+    VIRTUAL ~HogwildLearner();
+    int getNumWorkers() const;
+    void setTrainingData( int Ntrain, T *trainData, int *trainLabels );
+    void setTestingData( int Ntest, T *testData, int *testLabels );
+    void setSchedule( int numEpochs );
+    void setDumpTimings( bool dumpTimings );
+    void setSchedule( int numEpochs, int startEpoch );
+    void setBatchSize( int batchSize );
+    VIRTUAL void addPostEpochAction( PostEpochAction *action );
+    void learn( float learningRate );
+    void learn( float learningRate, float annealLearningRate );
+    EpochResult runEpoch( float learningRate );
+    void learnBatches( int worker, float learningRate, std::atomic< int > *nextBatch, float *loss, int *numRight );
+
+    // [[[end]]]
+};
+
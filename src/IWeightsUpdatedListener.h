@@ -0,0 +1,15 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+// told by NeuralNet when backprop has finished updating the weights of a layer,
+// eg so the changes can be sent on, while the layers below are still backpropping.
+// can be called from any thread, and for several layers at once
+class IWeightsUpdatedListener {
+public:
+    virtual void weightsUpdated( int layerIndex ) = 0;
+};
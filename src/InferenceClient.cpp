@@ -0,0 +1,73 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+#include <vector>
+
+#include "InferenceClient.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+// address as for InferenceServer::listen: tcp:port, or unix:path
+InferenceClient::InferenceClient( std::string address ) :
+        socketHandle( InferenceServer::connectTo( address ) ),
+        inputCubeSize( 0 ),
+        outputCubeSize( 0 ) {
+    int header[2];
+    try {
+        InferenceServer::receiveAll( socketHandle, (char *)header, sizeof( header ) );
+    } catch( runtime_error & ) {
+        RingAllReduce::closeSocket( socketHandle );
+        throw;
+    }
+    inputCubeSize = header[0];
+    outputCubeSize = header[1];
+}
+InferenceClient::~InferenceClient() {
+    RingAllReduce::closeSocket( socketHandle );
+}
+int InferenceClient::getInputCubeSize() const {
+    return inputCubeSize;
+}
+int InferenceClient::getOutputCubeSize() const {
+    return outputCubeSize;
+}
+// input is inputCubeSize floats; output gets outputCubeSize floats.  throws
+// runtime_error if the server could not propagate the batch this was in
+void InferenceClient::propagate( float const *input, float *output ) {
+    const int command = InferenceServer::PROPAGATE;
+    InferenceServer::sendAll( socketHandle, (char const *)&command, sizeof( command ) );
+    InferenceServer::sendAll( socketHandle, (char const *)input, inputCubeSize * (int)sizeof( float ) );
+    int status = 0;
+    InferenceServer::receiveAll( socketHandle, (char *)&status, sizeof( status ) );
+    if( status != InferenceServer::OK ) {
+        int length = 0;
+        InferenceServer::receiveAll( socketHandle, (char *)&length, sizeof( length ) );
+        vector< char > error( length );
+        if( length > 0 ) {
+            InferenceServer::receiveAll( socketHandle, &error[0], length );
+        }
+        throw runtime_error( "InferenceServer: " + std::string( error.begin(), error.end() ) );
+    }
+    InferenceServer::receiveAll( socketHandle, (char *)output, outputCubeSize * (int)sizeof( float ) );
+}
+// see InferenceServer::statsToString
+std::string InferenceClient::getStats() {
+    const int command = InferenceServer::STATS;
+    InferenceServer::sendAll( socketHandle, (char const *)&command, sizeof( command ) );
+    int length = 0;
+    InferenceServer::receiveAll( socketHandle, (char *)&length, sizeof( length ) );
+    vector< char > stats( length );
+    if( length > 0 ) {
+        InferenceServer::receiveAll( socketHandle, &stats[0], length );
+    }
+    return std::string( stats.begin(), stats.end() );
+}
@@ -0,0 +1,42 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+
+#include "InferenceServer.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+// talks to an InferenceServer on this machine.  one request at a time per
+// client, so use one client per thread, to have the server batch them together
+class DeepCL_EXPORT InferenceClient {
+public:
+    typedef InferenceServer::SocketHandle SocketHandle;
+
+    SocketHandle socketHandle;
+    int inputCubeSize;
+    int outputCubeSize;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    InferenceClient( std::string address );
+    ~InferenceClient();
+    int getInputCubeSize() const;
+    int getOutputCubeSize() const;
+    void propagate( float const *input, float *output );
+    std::string getStats();
+
+    // [[[end]]]
+};
+
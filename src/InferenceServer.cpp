@@ -0,0 +1,480 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <sstream>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+#include "NeuralNet.h"
+#include "InferenceSession.h"
+#include "stringhelper.h"
+
+#include "InferenceServer.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+#ifdef _WIN32
+typedef int socklen_t;
+#endif
+
+#define NUM_LATENCIES 4096
+
+InferenceServer::InferenceServer( NeuralNet *net, int maxBatchSize, int maxLatencyMicroseconds ) :
+        net( net ),
+        session( 0 ),
+        maxBatchSize( maxBatchSize ),
+        maxLatencyMicroseconds( maxLatencyMicroseconds ),
+        batchInput( 0 ),
+        listenSocket( RingAllReduce::invalidSocket() ),
+        stopping( false ),
+        batcherStopped( false ),
+        numRequests( 0 ),
+        numBatches( 0 ),
+        nextLatency( 0 ) {
+    if( maxBatchSize < 1 || maxLatencyMicroseconds < 0 ) {
+        throw runtime_error("InferenceServer: maxBatchSize should be at least 1, and maxLatencyMicroseconds at least 0");
+    }
+    session = new InferenceSession( net, maxBatchSize );
+    inputCubeSize = session->getInputCubeSize();
+    outputCubeSize = session->getOutputCubeSize();
+    batchInput = new float[ maxBatchSize * inputCubeSize ];
+}
+InferenceServer::~InferenceServer() {
+    stop();
+    delete[] batchInput;
+    delete session;
+}
+// address is tcp:port, on 127.0.0.1, or unix:path.  port 0 picks a free port,
+// see getPort
+void InferenceServer::listen( std::string address ) {
+    if( listenSocket != RingAllReduce::invalidSocket() ) {
+        throw runtime_error("InferenceServer::listen: already listening");
+    }
+    #ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup( MAKEWORD( 2, 2 ), &wsaData );
+    #endif
+    std::string path;
+    int port = 0;
+    parseAddress( address, &path, &port );
+    if( path != "" ) {
+        #ifdef _WIN32
+        throw runtime_error("InferenceServer: unix sockets not supported on windows, use tcp:port");
+        #else
+        sockaddr_un unixAddress;
+        memset( &unixAddress, 0, sizeof( unixAddress ) );
+        unixAddress.sun_family = AF_UNIX;
+        if( path.size() >= sizeof( unixAddress.sun_path ) ) {
+            throw runtime_error("InferenceServer: unix socket path too long: " + path );
+        }
+        strcpy( unixAddress.sun_path, path.c_str() );
+        unlink( path.c_str() ); // left over from a previous run
+        listenSocket = (SocketHandle)socket( AF_UNIX, SOCK_STREAM, 0 );
+        if( listenSocket == RingAllReduce::invalidSocket()
+                || ::bind( listenSocket, (sockaddr *)&unixAddress, sizeof( unixAddress ) ) != 0 ) {
+            closeListenSocket();
+            throw runtime_error("InferenceServer: couldnt bind unix socket " + path );
+        }
+        unixPath = path;
+        #endif
+    } else {
+        listenSocket = (SocketHandle)socket( AF_INET, SOCK_STREAM, 0 );
+        int reuse = 1;
+        setsockopt( listenSocket, SOL_SOCKET, SO_REUSEADDR, (char const *)&reuse, sizeof( reuse ) );
+        sockaddr_in tcpAddress;
+        memset( &tcpAddress, 0, sizeof( tcpAddress ) );
+        tcpAddress.sin_family = AF_INET;
+        tcpAddress.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        tcpAddress.sin_port = htons( (unsigned short)port );
+        if( listenSocket == RingAllReduce::invalidSocket()
+                || ::bind( listenSocket, (sockaddr *)&tcpAddress, sizeof( tcpAddress ) ) != 0 ) {
+            closeListenSocket();
+            throw runtime_error("InferenceServer: couldnt bind 127.0.0.1 port " + toString( port ) );
+        }
+    }
+    if( ::listen( listenSocket, 64 ) != 0 ) {
+        closeListenSocket();
+        throw runtime_error("InferenceServer: couldnt listen on " + address );
+    }
+}
+// the tcp port we are listening on, eg after listen( "tcp:0" ); 0 for a unix socket
+int InferenceServer::getPort() const {
+    if( unixPath != "" || listenSocket == RingAllReduce::invalidSocket() ) {
+        return 0;
+    }
+    sockaddr_in tcpAddress;
+    socklen_t addressLength = sizeof( tcpAddress );
+    getsockname( listenSocket, (sockaddr *)&tcpAddress, &addressLength );
+    return ntohs( tcpAddress.sin_port );
+}
+void InferenceServer::start() {
+    if( listenSocket == RingAllReduce::invalidSocket() ) {
+        throw runtime_error("InferenceServer::start: call listen first");
+    }
+    startTime = std::chrono::steady_clock::now();
+    batchThread = std::thread( &InferenceServer::runBatcher, this );
+    acceptThread = std::thread( &InferenceServer::runAccept, this );
+}
+// the batcher finishes its current batch; requests still waiting are dropped,
+// and their connections closed
+void InferenceServer::stop() {
+    {
+        std::unique_lock< std::mutex > lock( queueMutex );
+        if( stopping ) {
+            return;
+        }
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    if( batchThread.joinable() ) {
+        batchThread.join();
+    }
+    {
+        std::unique_lock< std::mutex > lock( queueMutex );
+        pending.clear();
+        batcherStopped = true;
+    }
+    resultsReady.notify_all();
+    if( listenSocket != RingAllReduce::invalidSocket() ) {
+        shutdownSocket( listenSocket ); // wakes accept
+    }
+    if( acceptThread.joinable() ) {
+        acceptThread.join();
+    }
+    closeListenSocket();
+    std::unique_lock< std::mutex > lock( connectionsMutex );
+    for( int i = 0; i < (int)connections.size(); i++ ) {
+        shutdownSocket( connections[i]->socket ); // wakes recv
+    }
+    for( int i = 0; i < (int)connections.size(); i++ ) {
+        connections[i]->thread.join();
+        RingAllReduce::closeSocket( connections[i]->socket );
+        delete connections[i];
+    }
+    connections.clear();
+}
+void InferenceServer::closeListenSocket() {
+    if( listenSocket != RingAllReduce::invalidSocket() ) {
+        RingAllReduce::closeSocket( listenSocket );
+        listenSocket = RingAllReduce::invalidSocket();
+    }
+    #ifndef _WIN32
+    if( unixPath != "" ) {
+        unlink( unixPath.c_str() );
+        unixPath = "";
+    }
+    #endif
+}
+InferenceServerStats InferenceServer::getStats() {
+    std::unique_lock< std::mutex > lock( queueMutex );
+    InferenceServerStats stats;
+    stats.numRequests = numRequests;
+    stats.numBatches = numBatches;
+    stats.meanBatchSize = numBatches == 0 ? 0 : (float)numRequests / numBatches;
+    const double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - startTime ).count();
+    stats.requestsPerSecond = seconds <= 0 ? 0 : (float)( numRequests / seconds );
+    vector< float > sorted( latencies );
+    lock.unlock();
+    sort( sorted.begin(), sorted.end() );
+    const int numLatencies = (int)sorted.size();
+    stats.p50LatencyMicroseconds = numLatencies == 0 ? 0 : sorted[ numLatencies / 2 ];
+    stats.p99LatencyMicroseconds = numLatencies == 0 ? 0 : sorted[ numLatencies * 99 / 100 ];
+    return stats;
+}
+STATIC std::string InferenceServer::statsToString( InferenceServerStats const &stats ) {
+    ostringstream oss;
+    oss << "requests=" << stats.numRequests << " batches=" << stats.numBatches
+        << " meanbatchsize=" << stats.meanBatchSize << " requestspersecond=" << stats.requestsPerSecond
+        << " p50us=" << stats.p50LatencyMicroseconds << " p99us=" << stats.p99LatencyMicroseconds;
+    return oss.str();
+}
+bool InferenceServer::isStopping() {
+    std::unique_lock< std::mutex > lock( queueMutex );
+    return stopping;
+}
+// accept fails when stop shuts the listen socket down, but also when a signal
+// interrupts it, a client gives up before being accepted, or the process is
+// out of file descriptors.  only the first, or a broken listen socket, end
+// the loop
+void InferenceServer::runAccept() {
+    while( true ) {
+        SocketHandle connectionSocket = (SocketHandle)accept( listenSocket, 0, 0 );
+        if( connectionSocket == RingAllReduce::invalidSocket() ) {
+            // before isStopping, since locking its mutex may change errno
+            #ifdef _WIN32
+            const int error = WSAGetLastError();
+            #else
+            const int error = errno;
+            #endif
+            if( isStopping() ) {
+                return;
+            }
+            #ifdef _WIN32
+            const bool retryNow = error == WSAEINTR || error == WSAECONNRESET;
+            const bool retryLater = error == WSAEMFILE || error == WSAENOBUFS;
+            #else
+            const bool retryNow = error == EINTR || error == ECONNABORTED || error == EPROTO;
+            const bool retryLater = error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM;
+            #endif
+            if( retryNow ) {
+                continue;
+            }
+            if( retryLater ) {
+                // give the connections a chance to finish, and free some up
+                std::cout << "InferenceServer: accept failed, error " << error << ", retrying" << std::endl;
+                std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+                continue;
+            }
+            std::cout << "InferenceServer: accept failed, error " << error << ", no longer accepting connections" << std::endl;
+            return;
+        }
+        if( unixPath == "" ) {
+            RingAllReduce::setNoDelay( connectionSocket );
+        }
+        RingAllReduce::setNoSigPipe( connectionSocket );
+        std::unique_lock< std::mutex > lock( connectionsMutex );
+        // tidy up after clients that went away
+        for( int i = (int)connections.size() - 1; i >= 0; i-- ) {
+            if( connections[i]->finished.load() ) {
+                connections[i]->thread.join();
+                RingAllReduce::closeSocket( connections[i]->socket );
+                delete connections[i];
+                connections.erase( connections.begin() + i );
+            }
+        }
+        Connection *connection = new Connection( connectionSocket );
+        connection->thread = std::thread( &InferenceServer::runConnection, this, connection );
+        connections.push_back( connection );
+    }
+}
+// the socket is closed by whoever joins this thread, so that it cant be reused
+// whilst stop might still shut it down
+void InferenceServer::runConnection( Connection *connection ) {
+    float *input = new float[ inputCubeSize ];
+    float *output = new float[ outputCubeSize ];
+    InferenceRequest request;
+    request.input = input;
+    request.output = output;
+    try {
+        int header[2] = { inputCubeSize, outputCubeSize };
+        sendAll( connection->socket, (char const *)header, sizeof( header ) );
+        while( true ) {
+            int command = 0;
+            receiveAll( connection->socket, (char *)&command, sizeof( command ) );
+            if( command == PROPAGATE ) {
+                receiveAll( connection->socket, (char *)input, inputCubeSize * (int)sizeof( float ) );
+                std::string error;
+                {
+                    std::unique_lock< std::mutex > lock( queueMutex );
+                    if( stopping ) {
+                        break;
+                    }
+                    request.done = false;
+                    request.error = "";
+                    request.arrived = std::chrono::steady_clock::now();
+                    pending.push_back( &request );
+                    queueChanged.notify_all();
+                    resultsReady.wait( lock, [this, &request]() { return request.done || batcherStopped; } );
+                    if( !request.done ) {
+                        break;
+                    }
+                    error = request.error;
+                }
+                const int status = error == "" ? OK : FAILED;
+                sendAll( connection->socket, (char const *)&status, sizeof( status ) );
+                if( status == OK ) {
+                    sendAll( connection->socket, (char const *)output, outputCubeSize * (int)sizeof( float ) );
+                } else {
+                    const int length = (int)error.size();
+                    sendAll( connection->socket, (char const *)&length, sizeof( length ) );
+                    sendAll( connection->socket, error.c_str(), length );
+                }
+            } else if( command == STATS ) {
+                const std::string stats = statsToString( getStats() );
+                const int length = (int)stats.size();
+                sendAll( connection->socket, (char const *)&length, sizeof( length ) );
+                sendAll( connection->socket, stats.c_str(), length );
+            } else {
+                break;
+            }
+        }
+    } catch( runtime_error & ) {
+        // client went away
+    }
+    delete[] output;
+    delete[] input;
+    connection->finished = true;
+}
+// waits for the first request, then for either a full batch, or for that
+// request's deadline.  if propagating throws, eg the device ran out of memory,
+// the batch's clients are sent the error, and the batcher carries on
+void InferenceServer::runBatcher() {
+    vector< InferenceRequest * > batch;
+    int batchSize = session->getBatchSize();
+    std::unique_lock< std::mutex > lock( queueMutex );
+    while( true ) {
+        queueChanged.wait( lock, [this]() { return stopping || pending.size() > 0; } );
+        if( stopping ) {
+            return;
+        }
+        const std::chrono::steady_clock::time_point deadline = pending.front()->arrived
+            + std::chrono::microseconds( maxLatencyMicroseconds );
+        queueChanged.wait_until( lock, deadline, [this]() { return stopping || (int)pending.size() >= maxBatchSize; } );
+        if( stopping ) {
+            return;
+        }
+        batch.clear();
+        while( (int)batch.size() < maxBatchSize && pending.size() > 0 ) {
+            batch.push_back( pending.front() );
+            pending.pop_front();
+        }
+        lock.unlock();
+
+        const int numExamples = (int)batch.size();
+        for( int n = 0; n < numExamples; n++ ) {
+            memcpy( batchInput + n * inputCubeSize, batch[n]->input, sizeof(float) * inputCubeSize );
+        }
+        std::string error;
+        try {
+            if( numExamples != batchSize ) {
+                batchSize = 0; // unknown, until setBatchSize returns
+                session->setBatchSize( numExamples );
+                batchSize = numExamples;
+            }
+            session->propagate( batchInput );
+            float const *results = session->getResults();
+            for( int n = 0; n < numExamples; n++ ) {
+                memcpy( batch[n]->output, results + n * outputCubeSize, sizeof(float) * outputCubeSize );
+            }
+        } catch( std::exception &e ) {
+            error = e.what();
+            if( error == "" ) {
+                error = "propagate failed";
+            }
+            std::cout << "InferenceServer: " << error << std::endl;
+        }
+        const std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+
+        lock.lock();
+        if( error != "" ) {
+            for( int n = 0; n < numExamples; n++ ) {
+                batch[n]->error = error;
+                batch[n]->done = true;
+            }
+            resultsReady.notify_all();
+            continue;
+        }
+        for( int n = 0; n < numExamples; n++ ) {
+            const float latency = (float)std::chrono::duration< double, std::micro >( finished - batch[n]->arrived ).count();
+            if( (int)latencies.size() < NUM_LATENCIES ) {
+                latencies.push_back( latency );
+            } else {
+                latencies[nextLatency] = latency;
+            }
+            nextLatency = ( nextLatency + 1 ) % NUM_LATENCIES;
+            batch[n]->done = true;
+        }
+        numRequests += numExamples;
+        numBatches++;
+        resultsReady.notify_all();
+    }
+}
+// unix:path, tcp:port, or just port
+STATIC void InferenceServer::parseAddress( std::string address, std::string *unixPath, int *port ) {
+    *unixPath = "";
+    *port = 0;
+    if( address.find( "unix:" ) == 0 ) {
+        *unixPath = address.substr( 5 );
+        if( *unixPath == "" ) {
+            throw runtime_error("InferenceServer: no path in address " + address );
+        }
+        return;
+    }
+    std::string portString = address.find( "tcp:" ) == 0 ? address.substr( 4 ) : address;
+    if( portString == "" || portString.find_first_not_of( "0123456789" ) != std::string::npos ) {
+        throw runtime_error("InferenceServer: address should be tcp:port or unix:path, not " + address );
+    }
+    *port = atoi( portString.c_str() );
+}
+// connects to a server on this machine, eg for InferenceClient
+STATIC InferenceServer::SocketHandle InferenceServer::connectTo( std::string address ) {
+    #ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup( MAKEWORD( 2, 2 ), &wsaData );
+    #endif
+    std::string path;
+    int port = 0;
+    parseAddress( address, &path, &port );
+    SocketHandle socketHandle = RingAllReduce::invalidSocket();
+    bool connected = false;
+    if( path != "" ) {
+        #ifdef _WIN32
+        throw runtime_error("InferenceServer: unix sockets not supported on windows, use tcp:port");
+        #else
+        sockaddr_un unixAddress;
+        memset( &unixAddress, 0, sizeof( unixAddress ) );
+        unixAddress.sun_family = AF_UNIX;
+        if( path.size() >= sizeof( unixAddress.sun_path ) ) {
+            throw runtime_error("InferenceServer: unix socket path too long: " + path );
+        }
+        strcpy( unixAddress.sun_path, path.c_str() );
+        socketHandle = (SocketHandle)socket( AF_UNIX, SOCK_STREAM, 0 );
+        connected = socketHandle != RingAllReduce::invalidSocket()
+            && connect( socketHandle, (sockaddr *)&unixAddress, sizeof( unixAddress ) ) == 0;
+        if( connected ) {
+            RingAllReduce::setNoSigPipe( socketHandle );
+        }
+        #endif
+    } else {
+        socketHandle = RingAllReduce::connectTcp( "127.0.0.1", port );
+        connected = socketHandle != RingAllReduce::invalidSocket();
+    }
+    if( !connected ) {
+        if( socketHandle != RingAllReduce::invalidSocket() ) {
+            RingAllReduce::closeSocket( socketHandle );
+        }
+        throw runtime_error("InferenceServer: couldnt connect to " + address );
+    }
+    return socketHandle;
+}
+STATIC void InferenceServer::shutdownSocket( SocketHandle socketHandle ) {
+    #ifdef _WIN32
+    shutdown( socketHandle, SD_BOTH );
+    #else
+    shutdown( socketHandle, SHUT_RDWR );
+    #endif
+}
+STATIC void InferenceServer::sendAll( SocketHandle socketHandle, char const *data, int numBytes ) {
+    if( !RingAllReduce::sendAllTo( socketHandle, data, numBytes ) ) {
+        throw runtime_error("InferenceServer: connection lost");
+    }
+}
+STATIC void InferenceServer::receiveAll( SocketHandle socketHandle, char *data, int numBytes ) {
+    if( !RingAllReduce::receiveAllFrom( socketHandle, data, numBytes ) ) {
+        throw runtime_error("InferenceServer: connection lost");
+    }
+}
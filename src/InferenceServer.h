@@ -0,0 +1,134 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#include "RingAllReduce.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+class NeuralNet;
+class InferenceSession;
+
+// one example waiting to be propagated; belongs to the connection that received it
+class DeepCL_EXPORT InferenceRequest {
+public:
+    float *input;
+    float *output;
+    std::chrono::steady_clock::time_point arrived;
+    bool done;
+    std::string error; // set instead of output, when propagating the batch threw
+};
+
+class DeepCL_EXPORT InferenceServerStats {
+public:
+    long long numRequests;
+    long long numBatches;
+    float meanBatchSize;
+    float requestsPerSecond; // since start
+    float p50LatencyMicroseconds; // over the last few thousand requests, from arriving to result ready
+    float p99LatencyMicroseconds;
+};
+
+// serves propagate, one example per request, to clients on this machine, over
+// a loopback tcp socket, or a unix socket
+// requests that arrive close together are propagated as one batch: the batch
+// is run as soon as it has maxBatchSize examples, or when the oldest example
+// has waited maxLatencyMicroseconds, whichever is first
+// one thread per connection reads requests, and writes results; one batcher
+// thread runs the net, through an InferenceSession, so the net itself is left
+// alone, and should not be trained while the server runs
+// protocol, in native byte order, since both ends are on the same machine:
+// - on connecting, the server sends int32 inputCubeSize, int32 outputCubeSize
+// - client sends int32 command:
+//   - PROPAGATE, then inputCubeSize float32s; server replies with int32 status:
+//     - OK, then outputCubeSize float32s
+//     - FAILED, then int32 length, then that many chars of error message
+//   - STATS; server replies with int32 length, then that many chars, see statsToString
+// a connection has one request in flight at a time; clients open several
+// connections to send requests concurrently.  see InferenceClient
+class DeepCL_EXPORT InferenceServer {
+public:
+    typedef RingAllReduce::SocketHandle SocketHandle;
+    static const int PROPAGATE = 1;
+    static const int STATS = 2;
+    static const int OK = 0;
+    static const int FAILED = 1;
+
+    class Connection {
+    public:
+        SocketHandle socket;
+        std::thread thread;
+        std::atomic< bool > finished;
+        Connection( SocketHandle socket ) : socket( socket ), finished( false ) {}
+    };
+
+    NeuralNet *net; // NOT owned by us
+    InferenceSession *session;
+    const int maxBatchSize;
+    const int maxLatencyMicroseconds;
+    int inputCubeSize;
+    int outputCubeSize;
+    float *batchInput;
+
+    SocketHandle listenSocket;
+    std::string unixPath; // removed again by stop, if we listen on a unix socket
+    std::thread acceptThread;
+    std::thread batchThread;
+    std::mutex connectionsMutex;
+    std::vector< Connection * > connections;
+
+    std::mutex queueMutex; // for everything below
+    std::condition_variable queueChanged; // tells the batcher about new requests
+    std::condition_variable resultsReady; // tells the connections about finished batches
+    std::deque< InferenceRequest * > pending;
+    bool stopping;
+    bool batcherStopped;
+    std::chrono::steady_clock::time_point startTime;
+    long long numRequests;
+    long long numBatches;
+    std::vector< float > latencies; // ring of the most recent, in microseconds
+    int nextLatency;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    InferenceServer( NeuralNet *net, int maxBatchSize, int maxLatencyMicroseconds );
+    ~InferenceServer();
+    void listen( std::string address );
+    int getPort() const;
+    void start();
+    void stop();
+    void closeListenSocket();
+    InferenceServerStats getStats();
+    STATIC std::string statsToString( InferenceServerStats const &stats );
+    bool isStopping();
+    void runAccept();
+    void runConnection( Connection *connection );
+    void runBatcher();
+    STATIC void parseAddress( std::string address, std::string *unixPath, int *port );
+    STATIC SocketHandle connectTo( std::string address );
+    STATIC void shutdownSocket( SocketHandle socketHandle );
+    STATIC void sendAll( SocketHandle socketHandle, char const *data, int numBytes );
+    STATIC void receiveAll( SocketHandle socketHandle, char *data, int numBytes );
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,95 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#include "NeuralNet.h"
+#include "Layer.h"
+#include "InputLayer.h"
+#include "ActivationArena.h"
+#include "stringhelper.h"
+
+#include "InferenceSession.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+// builds the layers like NeuralNet::clone, but on the model's OpenCLHelper, so
+// that they can use the model's weights buffers directly
+InferenceSession::InferenceSession( NeuralNet *model, int maxBatchSize ) :
+        model( model ),
+        cl( model->getCl() ),
+        inputLayer( 0 ),
+        arena( 0 ),
+        maxBatchSize( maxBatchSize ),
+        batchSize( maxBatchSize ) {
+    if( maxBatchSize < 1 ) {
+        throw runtime_error("InferenceSession: maxBatchSize should be at least 1, not " + toString( maxBatchSize ) );
+    }
+    Layer *previousLayer = 0;
+    for( int i = 0; i < model->getNumLayers(); i++ ) {
+        Layer *modelLayer = model->getLayer( i );
+        LayerMaker2 *maker = modelLayer->maker->clone();
+        maker->setCl( cl );
+        Layer *layer = maker->createLayer( previousLayer );
+        layer->shareWeightsFrom( modelLayer );
+        layer->setInferenceOnly();
+        layers.push_back( layer );
+        previousLayer = layer;
+    }
+    inputLayer = dynamic_cast< InputLayer<float> * >( layers[0] );
+    if( inputLayer == 0 ) {
+        throw runtime_error("InferenceSession needs an InputLayer<float> as first layer");
+    }
+    arena = new ActivationArena( cl );
+    arena->plan( layers, maxBatchSize );
+    for( int i = 0; i < (int)layers.size(); i++ ) {
+        layers[i]->setLowLatency( true );
+    }
+}
+InferenceSession::~InferenceSession() {
+    for( int i = 0; i < (int)layers.size(); i++ ) {
+        delete layers[i];
+    }
+    delete arena;
+}
+// up to maxBatchSize; no allocation
+void InferenceSession::setBatchSize( int batchSize ) {
+    if( batchSize < 1 || batchSize > maxBatchSize ) {
+        throw runtime_error("batch size should be from 1 to maxBatchSize " + toString( maxBatchSize ) + ", not " + toString( batchSize ) );
+    }
+    for( int i = 0; i < (int)layers.size(); i++ ) {
+        layers[i]->setBatchSize( batchSize );
+    }
+    this->batchSize = batchSize;
+}
+int InferenceSession::getBatchSize() const {
+    return batchSize;
+}
+int InferenceSession::getMaxBatchSize() const {
+    return maxBatchSize;
+}
+int InferenceSession::getInputCubeSize() const {
+    return layers[0]->getOutputCubeSize();
+}
+int InferenceSession::getOutputCubeSize() const {
+    return layers[ layers.size() - 1 ]->getOutputCubeSize();
+}
+// images is [batchSize][inputCubeSize]
+void InferenceSession::propagate( float const *images ) {
+    inputLayer->in( images );
+    for( int i = 0; i < (int)layers.size(); i++ ) {
+        layers[i]->propagate();
+    }
+}
+// [batchSize][outputCubeSize]; valid until the next propagate on this session
+float const *InferenceSession::getResults() {
+    return layers[ layers.size() - 1 ]->getResults();
+}
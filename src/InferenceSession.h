@@ -0,0 +1,61 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+class NeuralNet;
+class Layer;
+class ActivationArena;
+class OpenCLHelper;
+template< typename T > class InputLayer;
+
+// a per-thread context for running one model's forward pass, concurrently with
+// other sessions on the same model
+// each session has its own layers, and so its own activations and kernels, but
+// the weights stay in the model's layers, on the device, and are used in place,
+// so N sessions hold one copy of the weights, plus N arenas of activations
+// sessions use the model's OpenCLHelper, and so its command queue: the device
+// runs their kernels one after another, but the host side of each propagate
+// runs in parallel
+// the model's weights are treated as immutable: dont train, or load weights
+// into, the model while it has sessions
+// create sessions, and delete them, from one thread; after that, each session
+// can be used by one thread at a time
+class DeepCL_EXPORT InferenceSession {
+public:
+    NeuralNet *model; // NOT owned by us
+    OpenCLHelper *cl; // the model's, NOT owned by us
+    std::vector< Layer * > layers;
+    InputLayer<float> *inputLayer;
+    ActivationArena *arena;
+    int maxBatchSize;
+    int batchSize;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    InferenceSession( NeuralNet *model, int maxBatchSize );
+    ~InferenceSession();
+    void setBatchSize( int batchSize );
+    int getBatchSize() const;
+    int getMaxBatchSize() const;
+    int getInputCubeSize() const;
+    int getOutputCubeSize() const;
+    void propagate( float const *images );
+    float const *getResults();
+
+    // [[[end]]]
+};
+
@@ -4,6 +4,8 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "OpenCLHelper.h"
+#include "ZeroCopy.h"
 #include "InputLayerMaker.h"
 
 #include "InputLayer.h"
@@ -20,16 +22,34 @@ template< typename T > InputLayer<T>::InputLayer( InputLayerMaker<T> *maker ) :
     outputPlanes( maker->_numPlanes ),
     outputImageSize( maker->_imageSize ),
     input(0),
-    results(0) {
+    results(0),
+    inputWrapper(0),
+    inputWrapperCopiedToHost(false) {
 }
 template< typename T > VIRTUAL InputLayer<T>::~InputLayer() {
+    if( results != 0 && !resultsInArena ) {
+        ZeroCopy::deallocate( results );
+    }
 }
 template< typename T > VIRTUAL std::string InputLayer<T>::getClassName() const {
     return "InputLayer";
 }
 template< typename T > VIRTUAL float *InputLayer<T>::getResults() {
+    if( inputWrapper != 0 ) {
+        if( !inputWrapperCopiedToHost ) {
+            ZeroCopy::copyToHost( inputWrapper );
+            inputWrapperCopiedToHost = true;
+        }
+        return (float *)inputWrapper->getHostArray();
+    }
     return results;
 }
+template< typename T > VIRTUAL bool InputLayer<T>::hasResultsWrapper() const {
+    return inputWrapper != 0;
+}
+template< typename T > VIRTUAL CLWrapper *InputLayer<T>::getResultsWrapper() {
+    return inputWrapper;
+}
 template< typename T > VIRTUAL ActivationFunction const *InputLayer<T>::getActivationFunction() {
     return new LinearActivation();
 }
@@ -72,10 +92,19 @@ template< typename T > VIRTUAL void InputLayer<T>::print() const {
 template< typename T > void InputLayer<T>::in( T const*images ) {
 //        std::cout << "InputLayer::in()" << std::endl;
     this->input = images;
+    this->inputWrapper = 0;
 //        this->batchStart = batchStart;
 //        this->batchEnd = batchEnd;
 //        print();
 }
+// use a batch that is already on the device, as floats, eg from DeviceDataset::gather
+// the wrapper must hold batchSize * getOutputCubeSize() floats, and stay alive until
+// after backprop.  Following layers read it directly, so no host copy is made
+template< typename T > void InputLayer<T>::inWrapper( CLWrapper *imagesWrapper ) {
+    this->input = 0;
+    this->inputWrapper = imagesWrapper;
+    this->inputWrapperCopiedToHost = false;
+}
 template< typename T > VIRTUAL bool InputLayer<T>::needErrorsBackprop() {
     return false;
 }
@@ -85,14 +114,33 @@ template< typename T > VIRTUAL void InputLayer<T>::setBatchSize( int batchSize )
         this->batchSize = batchSize;
         return;
     }
+    if( resultsInArena ) {
+        throw runtime_error("layer " + ::toString(layerIndex) + ": results are in an arena planned for batch size " +
+            ::toString(allocatedSize) + ", cannot set batch size " + ::toString(batchSize) );
+    }
     if( results != 0 ) {
-        delete[] results;
+        ZeroCopy::deallocate( results );
     }
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
-    results = new float[batchSize * getOutputCubeSize() ];
+    results = ZeroCopy::allocateFloats( batchSize * getOutputCubeSize() );
+}
+template< typename T > VIRTUAL bool InputLayer<T>::canUseArena() const {
+    return true;
+}
+template< typename T > VIRTUAL void InputLayer<T>::setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper ) {
+    if( !resultsInArena && this->results != 0 ) {
+        ZeroCopy::deallocate( this->results );
+    }
+    this->results = results;
+    this->resultsInArena = true;
+    this->batchSize = batchSize;
+    this->allocatedSize = batchSize;
 }
 template< typename T > VIRTUAL void InputLayer<T>::propagate() {
+    if( inputWrapper != 0 ) {
+        return; // already on the device, nothing to do
+    }
     int totalLinearLength = getResultsSize();
     for( int i = 0; i < totalLinearLength; i++ ) {
         results[i] = input[i];
@@ -11,6 +11,7 @@
 #include "stringhelper.h"
 
 template<typename T> class InputLayerMaker;
+class CLWrapper;
 
 #define VIRTUAL virtual
 
@@ -26,6 +27,9 @@ public:
     T const*input; // we dont own this
     float *results; // we own this :-)
 
+    CLWrapper *inputWrapper; // we dont own this; set when the batch is already on the device, eg from DeviceDataset
+    bool inputWrapperCopiedToHost;
+
     inline int getResultIndex( int n, int outPlane, int outRow, int outCol ) const {
         return ( ( n
             * outputPlanes + outPlane )
@@ -45,14 +49,19 @@ public:
     VIRTUAL ~InputLayer();
     VIRTUAL std::string getClassName() const;
     VIRTUAL float *getResults();
+    VIRTUAL bool hasResultsWrapper() const;
+    VIRTUAL CLWrapper *getResultsWrapper();
     VIRTUAL ActivationFunction const *getActivationFunction();
     VIRTUAL bool needsBackProp();
     VIRTUAL int getPersistSize() const;
     VIRTUAL void printOutput() const;
     VIRTUAL void print() const;
     void in( T const*images );
+    void inWrapper( CLWrapper *imagesWrapper );
     VIRTUAL bool needErrorsBackprop();
     VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL bool canUseArena() const;
+    VIRTUAL void setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper );
     VIRTUAL void propagate();
     VIRTUAL void backPropErrors( float learningRate, float const *errors );
     VIRTUAL int getOutputImageSize() const;
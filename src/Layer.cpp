@@ -1,4 +1,5 @@
 #include "Layer.h"
+#include "ZeroCopy.h"
 
 using namespace std;
 
@@ -10,6 +11,10 @@ Layer::Layer( Layer *previousLayer, LayerMaker2 *maker ) :
     nextLayer( 0 ),
     layerIndex( previousLayer == 0 ? 0 : previousLayer->layerIndex + 1 ),
     training( false ),
+    inferenceOnly( false ),
+    resultsInArena( false ),
+    lowLatency( false ),
+    cachedUpstreamResults( 0 ),
     maker( maker )
      {
     if( previousLayer != 0 ) {
@@ -17,14 +22,87 @@ Layer::Layer( Layer *previousLayer, LayerMaker2 *maker ) :
     }
 }
 VIRTUAL Layer::~Layer() {
+    deleteCachedUpstreamWrappers();
     if( maker != 0 ) {
         //delete maker; // this segfaults sometimes, (probably because it already
                         // self-deleted)
     }
 }
 VIRTUAL void Layer::setTraining( bool training ) {
+    if( training && inferenceOnly ) {
+        throw std::runtime_error("layer " + toString(layerIndex) + " is inference only, cannot set training");
+    }
     this->training = training;
 }
+// permanent: buffers only needed for backprop, such as errorsForUpstream, are not
+// allocated from now on, and training cannot be switched back on
+// call before setBatchSize, or before planning an ActivationArena
+VIRTUAL void Layer::setInferenceOnly() {
+    this->training = false;
+    this->inferenceOnly = true;
+}
+// for small batches, typically batch size 1, where the fixed cost of each
+// propagate dominates: no StatefulTimer calls, and layers keep the wrappers they
+// would otherwise create and delete on every propagate
+VIRTUAL void Layer::setLowLatency( bool lowLatency ) {
+    this->lowLatency = lowLatency;
+    deleteCachedUpstreamWrappers();
+}
+void Layer::deleteCachedUpstreamWrappers() {
+    for( map< int, CLWrapper * >::iterator it = cachedUpstreamWrappers.begin(); it != cachedUpstreamWrappers.end(); it++ ) {
+        delete it->second;
+    }
+    cachedUpstreamWrappers.clear();
+    cachedUpstreamResults = 0;
+}
+// in low latency mode, a previous layer without a results wrapper, eg the input
+// layer, gets wrapped once per batch size, rather than on every propagate
+// the wrapper still has to be copied to the device each time
+CLWrapper *Layer::getLowLatencyUpstreamWrapper( OpenCLHelper *cl ) {
+    float *upstreamResults = previousLayer->getResults();
+    const int upstreamSize = previousLayer->getResultsSize();
+    if( upstreamResults != cachedUpstreamResults ) {
+        deleteCachedUpstreamWrappers();
+        cachedUpstreamResults = upstreamResults;
+    }
+    CLWrapper *upstreamWrapper = 0;
+    map< int, CLWrapper * >::iterator it = cachedUpstreamWrappers.find( upstreamSize );
+    if( it != cachedUpstreamWrappers.end() ) {
+        upstreamWrapper = it->second;
+    } else {
+        upstreamWrapper = ZeroCopy::wrap( cl, upstreamSize, upstreamResults );
+        cachedUpstreamWrappers[ upstreamSize ] = upstreamWrapper;
+    }
+    ZeroCopy::copyToDevice( upstreamWrapper );
+    return upstreamWrapper;
+}
+// from now on, use source's weights, rather than our own, eg for an InferenceSession
+// source must be the same type of layer, with the same dimensions, and outlive us
+// layers without weights have nothing to share
+VIRTUAL void Layer::shareWeightsFrom( Layer *source ) {
+    if( getPersistSize() != 0 ) {
+        throw std::runtime_error("shareWeightsFrom not implemented for this layer type, layer " + toString(layerIndex) );
+    }
+}
+// layers that can write their results into a buffer they dont own, ie into an
+// ActivationArena slot, return true, and implement setResultsBuffer
+VIRTUAL bool Layer::canUseArena() const {
+    return false;
+}
+// used instead of setBatchSize, eg by ActivationArena.  results must hold at
+// least batchSize examples.  batch sizes up to batchSize can be set afterwards,
+// but not larger.  backprop buffers are still our own, unless inference only
+VIRTUAL void Layer::setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper ) {
+    throw std::runtime_error("setResultsBuffer not implemented for this layer type, layer " + toString(layerIndex) );
+}
+// number of bytes of write-only scratch this layer needs during inference, at
+// the current batch size, eg for pooling selectors.  0 means none
+VIRTUAL int Layer::getScratchSize() const {
+    return 0;
+}
+VIRTUAL void Layer::setScratchBuffer( unsigned char *scratch, CLWrapper *scratchWrapper ) {
+    throw std::runtime_error("setScratchBuffer not implemented for this layer type, layer " + toString(layerIndex) );
+}
 // used to set up internal buffers and stuff
 VIRTUAL void Layer::setBatchSize( int batchSize ) {
     throw std::runtime_error("setBatchsize not implemetned for this layer type");
@@ -126,6 +204,29 @@ VIRTUAL void Layer::printOutput() const {
 VIRTUAL void Layer::backProp( float learningRate ) {
     throw std::runtime_error("backProp not implemented for this layertype, layerindex " + toString(layerIndex ) );
 }
+// backProp, in two halves, so NeuralNet can overlap the weight update of one
+// layer with the backprop of the layer below.  backPropWeights always runs after
+// backPropErrors; layers without weights can just do everything in backPropErrors
+VIRTUAL void Layer::backPropErrors( float learningRate ) {
+    backProp( learningRate );
+}
+VIRTUAL void Layer::backPropWeights( float learningRate ) {
+}
+// whether backPropWeights runs on the cpu, and can run alongside work on the device
+// if so, backPropWeights only touches host arrays, and the device work it needs
+// is in startBackPropWeightsOnHost, before it, and finishBackPropWeightsOnHost,
+// after it, which run on the same thread as the device tasks
+VIRTUAL bool Layer::backPropWeightsOnHost() const {
+    return false;
+}
+VIRTUAL void Layer::startBackPropWeightsOnHost() {
+}
+VIRTUAL void Layer::finishBackPropWeightsOnHost() {
+}
+// layers with weights may move their weight update to the cpu, if it is tiny,
+// see NeuralNet::setTinyLayerWeightsOnHost
+VIRTUAL void Layer::setTinyWeightsOnHost( bool onHost ) {
+}
 VIRTUAL int Layer::getWeightsSize() const {
     throw std::runtime_error("getWeightsSize not implemented for this layertype");
 }
@@ -10,6 +10,7 @@
 #include <string>
 #include <iostream>
 #include <algorithm>
+#include <map>
 
 #include "MyRandom.h"
 #include "ActivationFunction.h"
@@ -25,6 +26,12 @@ public:
     Layer *nextLayer;
     const int layerIndex;
     bool training;
+    bool inferenceOnly; // set for good by setInferenceOnly(), no backprop buffers are allocated
+    bool resultsInArena; // results come from an ActivationArena, and are NOT owned by us
+    bool lowLatency; // set by setLowLatency(), propagate skips the timers, and reuses its wrappers
+    // low latency mode only, see getLowLatencyUpstreamWrapper:
+    float *cachedUpstreamResults; // previous layer's host results, that cachedUpstreamWrappers wrap
+    std::map< int, CLWrapper * > cachedUpstreamWrappers; // one per upstream results size seen
 
     LayerMaker2 *maker;
 
@@ -42,6 +49,15 @@ public:
     Layer( Layer *previousLayer, LayerMaker2 *maker );
     VIRTUAL ~Layer();
     VIRTUAL void setTraining( bool training );
+    VIRTUAL void setInferenceOnly();
+    VIRTUAL void setLowLatency( bool lowLatency );
+    void deleteCachedUpstreamWrappers();
+    CLWrapper *getLowLatencyUpstreamWrapper( OpenCLHelper *cl );
+    VIRTUAL void shareWeightsFrom( Layer *source );
+    VIRTUAL bool canUseArena() const;
+    VIRTUAL void setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper );
+    VIRTUAL int getScratchSize() const;
+    VIRTUAL void setScratchBuffer( unsigned char *scratch, CLWrapper *scratchWrapper );
     VIRTUAL void setBatchSize( int batchSize );
     VIRTUAL bool providesErrorsForUpstreamWrapper() const;
     VIRTUAL float *getErrorsForUpstream();
@@ -63,6 +79,12 @@ public:
     VIRTUAL void printWeights();
     VIRTUAL void printOutput() const;
     VIRTUAL void backProp( float learningRate );
+    VIRTUAL void backPropErrors( float learningRate );
+    VIRTUAL void backPropWeights( float learningRate );
+    VIRTUAL bool backPropWeightsOnHost() const;
+    VIRTUAL void startBackPropWeightsOnHost();
+    VIRTUAL void finishBackPropWeightsOnHost();
+    VIRTUAL void setTinyWeightsOnHost( bool onHost );
     VIRTUAL int getWeightsSize() const;
     VIRTUAL int getBiasWeightsSize() const;
     VIRTUAL void persistToArray(float *array);
@@ -85,6 +85,10 @@ public:
         deriveOthers();
         return *this;
     }
+    // one output per filter, so the layer is a plain matrix multiply
+    bool isFullyConnected() const {
+        return filterSize == inputImageSize && !padZeros && skip == 0;
+    }
     void deriveOthers();
     std::string buildOptionsString();
 };
@@ -103,8 +103,10 @@ public:
 class DeepCL_EXPORT SoftMaxMaker : public LossLayerMaker {
 public:
     bool _perPlane; // = false;
+    bool _fastMath; // = false;
     SoftMaxMaker() {
         _perPlane = false;
+        _fastMath = false;
     }
     SoftMaxMaker *perColumn() {
         this->_perPlane = false;
@@ -114,6 +116,14 @@ public:
         this->_perPlane = true;
         return this;
     }
+    SoftMaxMaker *fastMath() {
+        this->_fastMath = true;
+        return this;
+    }
+    SoftMaxMaker *fastMath( bool _fastMath ) {
+        this->_fastMath = _fastMath;
+        return this;
+    }
     static SoftMaxMaker *instance() {
         return new SoftMaxMaker();
     }
@@ -0,0 +1,104 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "FileHelper.h"
+
+#include "MappedFile.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+// throws if the file cant be opened or mapped
+MappedFile::MappedFile( std::string filepath ) :
+        data( 0 ),
+        size( 0 ) {
+    std::string localPath = FileHelper::localizePath( filepath );
+    #ifdef _WIN32
+    mappingHandle = 0;
+    fileHandle = CreateFileA( localPath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+    if( fileHandle == INVALID_HANDLE_VALUE ) {
+        throw runtime_error("MappedFile: couldnt open file " + localPath );
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx( fileHandle, &fileSize );
+    size = (long)fileSize.QuadPart;
+    if( size > 0 ) {
+        mappingHandle = CreateFileMappingA( fileHandle, 0, PAGE_READONLY, 0, 0, 0 );
+        if( mappingHandle != 0 ) {
+            data = static_cast< char const * >( MapViewOfFile( mappingHandle, FILE_MAP_READ, 0, 0, 0 ) );
+        }
+        if( data == 0 ) {
+            close();
+            throw runtime_error("MappedFile: couldnt map file " + localPath );
+        }
+    }
+    #else
+    fileDescriptor = open( localPath.c_str(), O_RDONLY );
+    if( fileDescriptor == -1 ) {
+        throw runtime_error("MappedFile: couldnt open file " + localPath );
+    }
+    struct stat fileStat;
+    fstat( fileDescriptor, &fileStat );
+    size = (long)fileStat.st_size;
+    if( size > 0 ) {
+        void *mapped = mmap( 0, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0 );
+        if( mapped == MAP_FAILED ) {
+            close();
+            throw runtime_error("MappedFile: couldnt map file " + localPath );
+        }
+        data = static_cast< char const * >( mapped );
+    }
+    #endif
+}
+MappedFile::~MappedFile() {
+    close();
+}
+char const *MappedFile::getData() const {
+    return data;
+}
+long MappedFile::getSize() const {
+    return size;
+}
+void MappedFile::close() {
+    #ifdef _WIN32
+    if( data != 0 ) {
+        UnmapViewOfFile( data );
+    }
+    if( mappingHandle != 0 ) {
+        CloseHandle( mappingHandle );
+        mappingHandle = 0;
+    }
+    if( fileHandle != INVALID_HANDLE_VALUE ) {
+        CloseHandle( fileHandle );
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+    #else
+    if( data != 0 ) {
+        munmap( const_cast< char * >( data ), size );
+    }
+    if( fileDescriptor != -1 ) {
+        ::close( fileDescriptor );
+        fileDescriptor = -1;
+    }
+    #endif
+    data = 0;
+}
+
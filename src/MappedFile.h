@@ -0,0 +1,42 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+// a whole file, mapped read-only into memory, so it can be read without
+// copying it first.  pages are only read from disk as they are touched
+class DeepCL_EXPORT MappedFile {
+public:
+    char const *data;
+    long size;
+    #ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+    #else
+    int fileDescriptor;
+    #endif
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    MappedFile( std::string filepath );
+    ~MappedFile();
+    char const *getData() const;
+    long getSize() const;
+    void close();
+
+    // [[[end]]]
+};
+
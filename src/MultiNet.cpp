@@ -11,6 +11,8 @@
 #include "InputLayer.h"
 #include "LayerMaker.h"
 #include "InputLayerMaker.h"
+#include "ThreadPool.h"
+#include "StatefulTimer.h"
 
 #include "MultiNet.h"
 
@@ -22,9 +24,7 @@ using namespace std;
 #define VIRTUAL
 
 MultiNet::MultiNet( int numNets, NeuralNet *model ) :
-        results( 0 ),
         batchSize( 0 ),
-        allocatedSize( 0 ),
         proxyInputLayer( 0 ),
         lossLayer( 0 ) {
 //    trainables.push_back( model );
@@ -44,13 +44,16 @@ VIRTUAL MultiNet::~MultiNet() {
     if( lossLayer != 0 ) {
         delete lossLayer;
     }
-    if( results != 0 ) {
-        delete[] results;
-    }
     for( vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++ ) {
         delete (*it);
     }    
 }
+int MultiNet::getNumChildren() const {
+    return (int)trainables.size();
+}
+Trainable *MultiNet::getChild( int child ) {
+    return trainables[child];
+}
 VIRTUAL int MultiNet::getInputCubeSize() const {
     return trainables[0]->getInputCubeSize();
 }
@@ -108,17 +111,7 @@ VIRTUAL void MultiNet::setBatchSize( int batchSize ) {
     }
     proxyInputLayer->setBatchSize( batchSize );
     lossLayer->setBatchSize( batchSize );
-    // now ourselves :-)
-    if( batchSize <= allocatedSize ) {
-        this->batchSize = batchSize;
-        return;
-    }
-    if( results != 0 ) {
-        delete[] results;
-    }
     this->batchSize = batchSize;
-    this->allocatedSize = batchSize;
-    results = new float[ trainables[0]->getResultsSize() ];
 }
 VIRTUAL void MultiNet::setTraining( bool training ) {
     for( vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++ ) {
@@ -143,48 +136,71 @@ VIRTUAL int MultiNet::calcNumRight( int const *labels ) {
     }
     return softMaxLayer->calcNumRight( labels );
 }
+// averages the results of the children straight into the results of our loss
+// layer, one chunk of results per thread.  within a chunk, each child is added
+// in one contiguous pass, so the compiler can vectorize it
 void MultiNet::propagateToOurselves() {
-    // now propagate to ourselves :-)
-    // I suppose this could be done in GPU, but what if we want to split across mpi?
+    StatefulTimer::timeCheck("MultiNet::propagateToOurselves start");
+    SoftMaxLayer *softMaxLayer = dynamic_cast< SoftMaxLayer * >( lossLayer );
     const int resultsSize = trainables[0]->getResultsSize();
-    memset( results, 0, sizeof( float ) * resultsSize );
-    for( vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++ ) {
-        float const*childResults = (*it)->getResults();
-        for( int i = 0; i < resultsSize; i++ ) {
-            results[i] += childResults[i];
-        }
-    }    
     const int numChildren = (int)trainables.size();
-    for( int i = 0; i < resultsSize; i++ ) {
-        results[i] /= numChildren;
+    vector< float const * > childResults( numChildren );
+    for( int i = 0; i < numChildren; i++ ) {
+        childResults[i] = trainables[i]->getResults();
     }
-    memcpy( dynamic_cast< SoftMaxLayer * >( lossLayer )->results, results, sizeof(float) * lossLayer->getResultsSize() );
-//    proxyInputLayer->in( results );
+    float *results = softMaxLayer->results;
+    const float scale = 1.0f / numChildren;
+    ThreadPool::instance()->parallelFor( resultsSize, 4096, [&]( int begin, int end ) {
+        float const *first = childResults[0];
+        for( int i = begin; i < end; i++ ) {
+            results[i] = first[i];
+        }
+        for( int child = 1; child < numChildren; child++ ) {
+            float const *thisChild = childResults[child];
+            for( int i = begin; i < end; i++ ) {
+                results[i] += thisChild[i];
+            }
+        }
+        for( int i = begin; i < end; i++ ) {
+            results[i] *= scale;
+        }
+    } );
+    softMaxLayer->resultsWrittenOnHost();
+    StatefulTimer::timeCheck("MultiNet::propagateToOurselves end");
+}
+// each child has its own OpenCLHelper, and so its own queue, so the children
+// can run at the same time, one per thread
+void MultiNet::runOnChildren( ChildFunction const &fn ) {
+    ThreadPool::instance()->parallelFor( (int)trainables.size(), [&]( int begin, int end ) {
+        for( int child = begin; child < end; child++ ) {
+            fn( trainables[child] );
+        }
+    } );
 }
 VIRTUAL void MultiNet::propagate( float const*images) {
-    for( vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++ ) {
-        (*it)->propagate( images );
-    }
+    runOnChildren( [&]( Trainable *child ) {
+        child->propagate( images );
+    } );
     propagateToOurselves();
 }
 VIRTUAL void MultiNet::propagate( unsigned char const*images) {
-    for( vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++ ) {
-        (*it)->propagate( images );
-    }
+    runOnChildren( [&]( Trainable *child ) {
+        child->propagate( images );
+    } );
     propagateToOurselves();
 }
 VIRTUAL void MultiNet::backPropFromLabels( float learningRate, int const *labels) {
     // dont think we need to backprop onto ourselves?  Just direclty onto children, right?
-    for( vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++ ) {
-        (*it)->backPropFromLabels( learningRate, labels );
-    }
+    runOnChildren( [&]( Trainable *child ) {
+        child->backPropFromLabels( learningRate, labels );
+    } );
 }
 VIRTUAL void MultiNet::backProp( float learningRate, float const *expectedResults) {
-    for( vector< Trainable * >::iterator it = trainables.begin(); it != trainables.end(); it++ ) {
-        (*it)->backProp( learningRate, expectedResults );
-    }
+    runOnChildren( [&]( Trainable *child ) {
+        child->backProp( learningRate, expectedResults );
+    } );
 }
 VIRTUAL float const *MultiNet::getResults() const {
-    return results;
+    return lossLayer->getResults();
 }
 
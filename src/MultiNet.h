@@ -9,6 +9,8 @@
 #include <algorithm>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
+#include <functional>
 
 #include "Trainable.h"
 
@@ -24,13 +26,13 @@ class NeuralNet;
 // This handles grouping several NeuralNets into one single MultiNet
 class DeepCL_EXPORT MultiNet : public Trainable {
     std::vector<Trainable * > trainables;
-    float *results;
     int batchSize;
-    int allocatedSize;
     InputLayer<float> *proxyInputLayer; // used to feed in output from children, to give to lossLayer
-    LossLayer *lossLayer;
+    LossLayer *lossLayer; // holds the averaged results
 
 public:
+    typedef std::function< void( Trainable *child ) > ChildFunction;
+
     // [[[cog
     // import cog_addheaders
     // cog_addheaders.add()
@@ -38,6 +40,8 @@ public:
     // generated, using cog:
     MultiNet( int numNets, NeuralNet *model );
     VIRTUAL ~MultiNet();
+    int getNumChildren() const;
+    Trainable *getChild( int child );
     VIRTUAL int getInputCubeSize() const;
     VIRTUAL int getOutputCubeSize() const;
     VIRTUAL int getResultsSize() const;
@@ -50,6 +54,7 @@ public:
     VIRTUAL void setTraining( bool training );
     VIRTUAL int calcNumRight( int const *labels );
     void propagateToOurselves();
+    void runOnChildren( ChildFunction const &fn );
     VIRTUAL void propagate( float const*images);
     VIRTUAL void propagate( unsigned char const*images);
     VIRTUAL void backPropFromLabels( float learningRate, int const *labels);
@@ -74,9 +74,10 @@ VIRTUAL void MultinomialCrossEntropy::calcErrors( float const*expectedResults )
     float *results = previousLayer->getResults();
     for( int i = 0; i < resultsSize; i++ ) {
         float result = results[i];
-        float partialOutBySum = fn->calcDerivative( result );
         float partialLossByOut = - expectedResults[i] / result;
-        errors[i] = partialLossByOut * partialOutBySum;
+        errors[i] = partialLossByOut;
     }
+    // times partialOutBySum
+    fn->multiplyByDerivative( resultsSize, errors, results );
 }
 
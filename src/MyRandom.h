@@ -7,6 +7,9 @@
 #pragma once
 
 #include <random>
+#include <mutex>
+#include <string>
+#include <sstream>
 
 #include "mt19937defs.h"
 
@@ -26,6 +29,7 @@
 class MyRandom {
 //    #ifdef TR1RANDOM
     MT19937 random;
+    std::mutex mutex; // eg DataParallelNet replicas draw translations from several threads
 //    #else
 //    std::mt19937 random;
 //    #endif
@@ -49,6 +53,7 @@ public:
         return thisinstance;
     }
     float _uniform() {
+        std::lock_guard< std::mutex > lock( mutex );
 //        float maxrand = (float)random.max();
         return random() / (float)random.max();
     }
@@ -62,7 +67,21 @@ public:
 //        #endif
     }
     static int uniformInt( int minvalue, int maxvalue ) {
+        std::lock_guard< std::mutex > lock( instance()->mutex );
         return ( instance()->random() % ( maxvalue - minvalue + 1 ) ) + minvalue;
     }
+    // as text, so it can go in a checkpoint, and setState can carry on exactly
+    // where it left off
+    static std::string getState() {
+        std::lock_guard< std::mutex > lock( instance()->mutex );
+        std::ostringstream stream;
+        stream << instance()->random;
+        return stream.str();
+    }
+    static void setState( std::string const &state ) {
+        std::lock_guard< std::mutex > lock( instance()->mutex );
+        std::istringstream stream( state );
+        stream >> instance()->random;
+    }
 };
 
@@ -26,6 +26,7 @@ template< typename T > NetLearner<T>::NetLearner( Trainable *net ) :
     numEpochs = 12;
     startEpoch = 1;
     dumpTimings = false;
+    resuming = false;
 }
 
 template< typename T > void NetLearner<T>::setTrainingData( int Ntrain, T *trainData, int *trainLabels ) {
@@ -57,6 +58,15 @@ template< typename T > void NetLearner<T>::setBatchSize( int batchSize ) {
     this->batchSize = batchSize;
 }
 
+// carry on from exactly where resumeState says, eg as read from a weights
+// file, rather than from the start of an epoch.  replaces the start epoch
+// from setSchedule
+template< typename T > void NetLearner<T>::setResumeState( ResumeState const &resumeState ) {
+    this->resumeState = resumeState;
+    this->startEpoch = resumeState.epoch;
+    resuming = true;
+}
+
 template< typename T > VIRTUAL NetLearner<T>::~NetLearner() {
 //    for( vector<PostEpochAction *>::iterator it = postEpochActions.begin(); it != postEpochActions.end(); it++ ) {
 //        delete (*it);
@@ -66,26 +76,47 @@ template< typename T > VIRTUAL NetLearner<T>::~NetLearner() {
 template< typename T > VIRTUAL void NetLearner<T>::addPostEpochAction( PostEpochAction *action ) {
     postEpochActions.push_back( action );
 }
+template< typename T > VIRTUAL void NetLearner<T>::addPostBatchAction( PostBatchAction *action ) {
+    postBatchActions.push_back( action );
+}
 template< typename T > void NetLearner<T>::learn( float learningRate ) {
     learn( learningRate, 1.0f );
 }
 
 template< typename T > void NetLearner<T>::learn( float learningRate, float annealLearningRate ) {
     BatchLearner<T> batchLearner( net );
+    for( int i = 0; i < (int)postBatchActions.size(); i++ ) {
+        batchLearner.addPostBatchAction( postBatchActions[i] );
+    }
     Timer timer;
+    double trainingMilliseconds = 0;
+    ResumeState progress;
     for( int epoch = startEpoch; epoch <= numEpochs; epoch++ ) {
         float annealedLearningRate = learningRate * pow( annealLearningRate, epoch );
-        EpochResult epochResult = batchLearner.runEpochFromLabels( annealedLearningRate, batchSize, Ntrain, trainData, trainLabels );
+        progress.startEpoch( epoch, annealedLearningRate );
+        if( resuming ) {
+            progress = resumeState;
+            progress.annealedLearningRate = annealedLearningRate;
+            progress.restoreRandom();
+            resuming = false;
+            cout << "resuming epoch " << epoch << " at batch " << progress.batch << endl;
+        }
+        Timer epochTimer;
+        EpochResult epochResult = batchLearner.runEpochFromLabels( annealedLearningRate, batchSize, Ntrain, trainData, trainLabels, &progress );
+        const double epochMilliseconds = epochTimer.lap();
+        trainingMilliseconds += epochMilliseconds;
         if( dumpTimings ) {
             StatefulTimer::dump(true);
         }
 //        cout << "-----------------------" << endl;
         cout << endl;
         timer.timeCheck("after epoch " + toString(epoch ) );
+        cout << ( Ntrain * 1000.0 / epochMilliseconds ) << " images/s" << endl;
         cout << "annealed learning rate: " << annealedLearningRate << " training loss: " << epochResult.loss << endl;
         cout << " train accuracy: " << epochResult.numRight << "/" << Ntrain << " " << (epochResult.numRight * 100.0f/ Ntrain) << "%" << std::endl;
         int testNumRight = batchLearner.test( batchSize, Ntest, testData, testLabels );
-        cout << "test accuracy: " << testNumRight << "/" << Ntest << " " << (testNumRight * 100.0f / Ntest ) << "%" << endl;
+        cout << "test accuracy: " << testNumRight << "/" << Ntest << " " << (testNumRight * 100.0f / Ntest ) << "%"
+            << " after " << ( trainingMilliseconds / 1000.0 ) << "s training" << endl;
         timer.timeCheck("after tests");
         for( vector<PostEpochAction *>::iterator it = postEpochActions.begin(); it != postEpochActions.end(); it++ ) {
             (*it)->run( epoch );
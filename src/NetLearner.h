@@ -8,6 +8,8 @@
 
 #include <vector>
 
+#include "ResumeState.h"
+
 #define VIRTUAL virtual
 #define STATIC static
 
@@ -21,6 +23,13 @@ public:
     virtual void run( int epoch ) = 0;
 };
 
+// run after each training batch, eg to write the weights more often than once
+// an epoch.  progress.batch counts the batches finished so far this epoch
+class DeepCL_EXPORT PostBatchAction {
+public:
+    virtual void run( ResumeState const &progress ) = 0;
+};
+
 // handles learning the neural net, ie running multiple epochs,
 // using a BatchLearner, to learn each epoch
 template<typename T>
@@ -46,6 +55,10 @@ public:
     int numEpochs;
 
     std::vector<PostEpochAction *> postEpochActions; // note: we DONT own these, dont delete, caller owns
+    std::vector<PostBatchAction *> postBatchActions; // note: we DONT own these, dont delete, caller owns
+
+    bool resuming;
+    ResumeState resumeState; // where to carry on from, if resuming
 
     // [[[cog
     // import cog_addheaders
@@ -59,8 +72,10 @@ public:
     void setDumpTimings( bool dumpTimings );
     void setSchedule( int numEpochs, int startEpoch );
     void setBatchSize( int batchSize );
+    void setResumeState( ResumeState const &resumeState );
     VIRTUAL ~NetLearner();
     VIRTUAL void addPostEpochAction( PostEpochAction *action );
+    VIRTUAL void addPostBatchAction( PostBatchAction *action );
     void learn( float learningRate );
     void learn( float learningRate, float annealLearningRate );
 
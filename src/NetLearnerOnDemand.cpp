@@ -26,6 +26,7 @@ template< typename T > NetLearnerOnDemand<T>::NetLearnerOnDemand( Trainable *net
     numEpochs = 12;
     startEpoch = 1;
     dumpTimings = false;
+    resuming = false;
 //    trainData = 0;
 //    trainLabels = 0;
 //    testData = 0;
@@ -62,6 +63,15 @@ template< typename T > void NetLearnerOnDemand<T>::setBatchSize( int fileReadBat
     this->fileReadBatches = fileReadBatches;
 }
 
+// carry on from exactly where resumeState says, eg as read from a weights
+// file, part way through an epoch, rather than from the start of the epoch.
+// replaces the start epoch from setSchedule
+template< typename T > void NetLearnerOnDemand<T>::setResumeState( ResumeState const &resumeState ) {
+    this->resumeState = resumeState;
+    this->startEpoch = resumeState.epoch;
+    resuming = true;
+}
+
 template< typename T > VIRTUAL NetLearnerOnDemand<T>::~NetLearnerOnDemand() {
 //    for( vector<PostEpochAction *>::iterator it = postEpochActions.begin(); it != postEpochActions.end(); it++ ) {
 //        delete (*it);
@@ -71,6 +81,9 @@ template< typename T > VIRTUAL NetLearnerOnDemand<T>::~NetLearnerOnDemand() {
 template< typename T > VIRTUAL void NetLearnerOnDemand<T>::addPostEpochAction( PostEpochAction *action ) {
     postEpochActions.push_back( action );
 }
+template< typename T > VIRTUAL void NetLearnerOnDemand<T>::addPostBatchAction( PostBatchAction *action ) {
+    postBatchActions.push_back( action );
+}
 template< typename T > void NetLearnerOnDemand<T>::learn( float learningRate ) {
     learn( learningRate, 1.0f );
 }
@@ -81,10 +94,22 @@ template< typename T > void NetLearnerOnDemand<T>::learn( float learningRate, fl
 //    testData = new T[ batchSize * net->getInputCubeSize() ];
 //    testLabels = new int[ batchSize ];
     BatchLearnerOnDemand<T> batchLearnerOnDemand( net );
+    for( int i = 0; i < (int)postBatchActions.size(); i++ ) {
+        batchLearnerOnDemand.addPostBatchAction( postBatchActions[i] );
+    }
     Timer timer;
+    ResumeState progress;
     for( int epoch = startEpoch; epoch <= numEpochs; epoch++ ) {
         float annealedLearningRate = learningRate * pow( annealLearningRate, epoch );
-        EpochResult epochResult = batchLearnerOnDemand.runEpochFromLabels( annealedLearningRate, trainFilepath, fileReadBatches, batchSize, Ntrain );
+        progress.startEpoch( epoch, annealedLearningRate );
+        if( resuming ) {
+            progress = resumeState;
+            progress.annealedLearningRate = annealedLearningRate;
+            progress.restoreRandom();
+            resuming = false;
+            cout << "resuming epoch " << epoch << " at batch " << progress.batch << endl;
+        }
+        EpochResult epochResult = batchLearnerOnDemand.runEpochFromLabels( annealedLearningRate, trainFilepath, fileReadBatches, batchSize, Ntrain, &progress );
         cout << "dumpTimings " << dumpTimings << endl;
         if( dumpTimings ) {
             StatefulTimer::dump(true);
@@ -52,6 +52,10 @@ public:
     int numEpochs;
 
     std::vector<PostEpochAction *> postEpochActions;
+    std::vector<PostBatchAction *> postBatchActions; // note: we DONT own these, dont delete, caller owns
+
+    bool resuming;
+    ResumeState resumeState; // where to carry on from, if resuming
 
     // [[[cog
     // import cog_addheaders
@@ -65,8 +69,10 @@ public:
     void setDumpTimings( bool dumpTimings );
     void setSchedule( int numEpochs, int startEpoch );
     void setBatchSize( int fileReadBatches, int batchSize );
+    void setResumeState( ResumeState const &resumeState );
     VIRTUAL ~NetLearnerOnDemand();
     VIRTUAL void addPostEpochAction( PostEpochAction *action );
+    VIRTUAL void addPostBatchAction( PostBatchAction *action );
     void learn( float learningRate );
     void learn( float learningRate, float annealLearningRate );
 
@@ -0,0 +1,152 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cmath>
+
+#include "StatefulTimer.h"
+#include "Timer.h"
+#include "MyRandom.h"
+#include "ResumeState.h"
+#include "BatchLearnerOnDevice.h"
+#include "DeviceDataset.h"
+#include "NeuralNet.h"
+
+#include "NetLearnerOnDevice.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+NetLearnerOnDevice::NetLearnerOnDevice( NeuralNet *net ) :
+        net( net ) {
+    trainData = 0;
+    trainLabels = 0;
+    testData = 0;
+    testLabels = 0;
+    batchSize = 128;
+    shuffle = false;
+    numEpochs = 12;
+    startEpoch = 1;
+    dumpTimings = false;
+    resuming = false;
+}
+
+void NetLearnerOnDevice::setTrainingData( DeviceDataset *trainData, int *trainLabels ) {
+    this->trainData = trainData;
+    this->trainLabels = trainLabels;
+}
+
+void NetLearnerOnDevice::setTestingData( DeviceDataset *testData, int *testLabels ) {
+    this->testData = testData;
+    this->testLabels = testLabels;
+}
+
+void NetLearnerOnDevice::setSchedule( int numEpochs ) {
+    setSchedule( numEpochs, 1 );
+}
+
+void NetLearnerOnDevice::setDumpTimings( bool dumpTimings ) {
+    this->dumpTimings = dumpTimings;
+}
+
+void NetLearnerOnDevice::setSchedule( int numEpochs, int startEpoch ) {
+    this->numEpochs = numEpochs;
+    this->startEpoch = startEpoch;
+}
+
+void NetLearnerOnDevice::setBatchSize( int batchSize ) {
+    this->batchSize = batchSize;
+}
+
+// visit the training examples in a new random order each epoch
+// only the permutation is sent to the device, the data stays where it is
+void NetLearnerOnDevice::setShuffle( bool shuffle ) {
+    this->shuffle = shuffle;
+}
+
+// carry on from exactly where resumeState says, eg as read from a weights
+// file, including the order of the examples, if shuffling.  replaces the start
+// epoch from setSchedule
+void NetLearnerOnDevice::setResumeState( ResumeState const &resumeState ) {
+    this->resumeState = resumeState;
+    this->startEpoch = resumeState.epoch;
+    resuming = true;
+}
+
+VIRTUAL NetLearnerOnDevice::~NetLearnerOnDevice() {
+}
+
+VIRTUAL void NetLearnerOnDevice::addPostEpochAction( PostEpochAction *action ) {
+    postEpochActions.push_back( action );
+}
+
+VIRTUAL void NetLearnerOnDevice::addPostBatchAction( PostBatchAction *action ) {
+    postBatchActions.push_back( action );
+}
+
+void NetLearnerOnDevice::learn( float learningRate ) {
+    learn( learningRate, 1.0f );
+}
+
+void NetLearnerOnDevice::learn( float learningRate, float annealLearningRate ) {
+    BatchLearnerOnDevice batchLearner( net );
+    for( int i = 0; i < (int)postBatchActions.size(); i++ ) {
+        batchLearner.addPostBatchAction( postBatchActions[i] );
+    }
+    const int Ntrain = trainData->getN();
+    const int Ntest = testData->getN();
+    Timer timer;
+    // the permutation lives in progress, so checkpoints taken part way through
+    // an epoch have it
+    ResumeState progress;
+    for( int epoch = startEpoch; epoch <= numEpochs; epoch++ ) {
+        float annealedLearningRate = learningRate * pow( annealLearningRate, epoch );
+        progress.startEpoch( epoch, annealedLearningRate );
+        if( resuming ) {
+            progress = resumeState;
+            progress.annealedLearningRate = annealedLearningRate;
+            progress.restoreRandom();
+            resuming = false;
+            cout << "resuming epoch " << epoch << " at batch " << progress.batch << endl;
+            if( shuffle && progress.batch > 0 && (int)progress.permutation.size() != Ntrain ) {
+                throw runtime_error("NetLearnerOnDevice: resume state has a permutation of " + toString( progress.permutation.size() ) + " examples, but there are " + toString( Ntrain ) + " training examples");
+            }
+        }
+        if( !shuffle ) {
+            progress.permutation.clear();
+        } else if( progress.batch == 0 ) {
+            // from the identity each epoch, so the order only depends on MyRandom
+            progress.permutation.resize( Ntrain );
+            for( int i = 0; i < Ntrain; i++ ) {
+                progress.permutation[i] = i;
+            }
+            for( int i = Ntrain - 1; i > 0; i-- ) {
+                int j = MyRandom::uniformInt( 0, i );
+                int temp = progress.permutation[i];
+                progress.permutation[i] = progress.permutation[j];
+                progress.permutation[j] = temp;
+            }
+        }
+        EpochResult epochResult = batchLearner.runEpochFromLabels( annealedLearningRate, batchSize, trainData, trainLabels, &progress );
+        if( dumpTimings ) {
+            StatefulTimer::dump(true);
+        }
+        cout << endl;
+        timer.timeCheck("after epoch " + toString(epoch ) );
+        cout << "annealed learning rate: " << annealedLearningRate << " training loss: " << epochResult.loss << endl;
+        cout << " train accuracy: " << epochResult.numRight << "/" << Ntrain << " " << (epochResult.numRight * 100.0f/ Ntrain) << "%" << std::endl;
+        int testNumRight = batchLearner.test( batchSize, testData, testLabels );
+        cout << "test accuracy: " << testNumRight << "/" << Ntest << " " << (testNumRight * 100.0f / Ntest ) << "%" << endl;
+        timer.timeCheck("after tests");
+        for( vector<PostEpochAction *>::iterator it = postEpochActions.begin(); it != postEpochActions.end(); it++ ) {
+            (*it)->run( epoch );
+        }
+    }
+}
+
@@ -0,0 +1,72 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "NetLearner.h"
+
+class NeuralNet;
+class DeviceDataset;
+
+#include "DeepCLDllExport.h"
+
+// handles learning the neural net, ie running multiple epochs,
+// using a BatchLearnerOnDevice, to learn each epoch
+// the training and testing data are each held in a DeviceDataset, so they are
+// uploaded to the device once, rather than once per batch per epoch
+// net must have an InputLayer<float> as first layer, since the DeviceDataset
+// does the normalization, and there should be no NormalizationLayer
+class DeepCL_EXPORT NetLearnerOnDevice {
+public:
+    NeuralNet *net;
+
+    DeviceDataset *trainData; // NOT owned by us
+    int *trainLabels;
+    DeviceDataset *testData; // NOT owned by us
+    int *testLabels;
+
+    int batchSize;
+    bool shuffle;
+
+    bool dumpTimings;
+
+    int startEpoch;
+    int numEpochs;
+
+    std::vector<PostEpochAction *> postEpochActions; // note: we DONT own these, dont delete, caller owns
+    std::vector<PostBatchAction *> postBatchActions; // note: we DONT own these, dont delete, caller owns
+
+    bool resuming;
+    ResumeState resumeState; // where to carry on from, if resuming
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    NetLearnerOnDevice( NeuralNet *net );
+    void setTrainingData( DeviceDataset *trainData, int *trainLabels );
+    void setTestingData( DeviceDataset *testData, int *testLabels );
+    void setSchedule( int numEpochs );
+    void setDumpTimings( bool dumpTimings );
+    void setSchedule( int numEpochs, int startEpoch );
+    void setBatchSize( int batchSize );
+    void setShuffle( bool shuffle );
+    void setResumeState( ResumeState const &resumeState );
+    VIRTUAL ~NetLearnerOnDevice();
+    VIRTUAL void addPostEpochAction( PostEpochAction *action );
+    VIRTUAL void addPostBatchAction( PostBatchAction *action );
+    void learn( float learningRate );
+    void learn( float learningRate, float annealLearningRate );
+
+    // [[[end]]]
+};
+
@@ -7,6 +7,7 @@
 #include "NeuralNet.h"
 
 #include "NetdefToNet.h"
+#include "ConvolutionalLayer.h"
 
 using namespace std;
 
@@ -98,7 +99,7 @@ STATIC std::string expandMultipliers( std::string netdef ) {
     }    
 }
 
-STATIC bool NetdefToNet::parseSubstring( NeuralNet *net, std::string substring, bool isLast ) {
+STATIC bool NetdefToNet::parseSubstring( NeuralNet *net, std::string substring, bool isLast, bool fastMath ) {
     vector<string>splitLayerDef = split( substring, "{" );
     string baseLayerDef = splitLayerDef[0];
 //         optionsDef = "";
@@ -148,11 +149,19 @@ STATIC bool NetdefToNet::parseSubstring( NeuralNet *net, std::string substring,
                 return false;
             }
         }
+        fn->setFastMath( fastMath );
         net->addLayer( ConvolutionalMaker::instance()->numFilters(numFilters)->filterSize(filterSize)->fn( fn )->padZeros( padZeros )->biased() );
     } else if( baseLayerDef.find("mp") != string::npos ) {
         vector<string> splitPoolDef = split( baseLayerDef, "mp" );
         int poolingSize = atoi( splitPoolDef[1] );
-        net->addLayer( PoolingMaker::instance()->poolingSize(poolingSize) );
+        PoolingMaker *poolingMaker = PoolingMaker::instance()->poolingSize(poolingSize);
+        // conv directly followed by pooling: do both in one pass, without writing
+        // out the conv results
+        ConvolutionalLayer *conv = dynamic_cast< ConvolutionalLayer * >( net->getLastLayer() );
+        if( conv != 0 && conv->dim.skip == 0 ) {
+            poolingMaker->fused();
+        }
+        net->addLayer( poolingMaker );
     } else if( baseLayerDef.find("rp") != string::npos ) {
         int patchSize = atoi( split( baseLayerDef, "rp" )[1] );
         net->addLayer( RandomPatchesMaker::instance()->patchSize( patchSize ) );
@@ -199,6 +208,7 @@ STATIC bool NetdefToNet::parseSubstring( NeuralNet *net, std::string substring,
             cout << "Last fullyconnectedlayer must be linear (because softmax is the 'activationlayer' for this layer)" << endl;
             return false;
         }
+        fn->setFastMath( fastMath );
         net->addLayer( FullyConnectedMaker::instance()->numPlanes(numPlanes)->imageSize(1)->fn(fn)->biased(biased) );
     } else {
         cout << "network definition " << baseLayerDef << " not recognised" << endl;
@@ -208,6 +218,10 @@ STATIC bool NetdefToNet::parseSubstring( NeuralNet *net, std::string substring,
 }
 
 STATIC bool NetdefToNet::createNetFromNetdef( NeuralNet *net, std::string netdef ) {
+    return createNetFromNetdef( net, netdef, false );
+}
+// fastMath: use the FastMath approximations for the activations and the softmax
+STATIC bool NetdefToNet::createNetFromNetdef( NeuralNet *net, std::string netdef, bool fastMath ) {
     string netDefLower = toLower( netdef );
     try {
         netDefLower = expandMultipliers( netDefLower );
@@ -219,12 +233,12 @@ STATIC bool NetdefToNet::createNetFromNetdef( NeuralNet *net, std::string netdef
     if( netdef != "" ) {
         for( int i = 0; i < (int)splitNetDef.size(); i++ ) {
             string thisLayerDef = splitNetDef[i];
-            if( !parseSubstring( net, thisLayerDef, i == (int)splitNetDef.size() - 1 ) ) {
+            if( !parseSubstring( net, thisLayerDef, i == (int)splitNetDef.size() - 1, fastMath ) ) {
                 return false;
             }
         }
     }
-    net->addLayer( SoftMaxMaker::instance() );
+    net->addLayer( SoftMaxMaker::instance()->fastMath( fastMath ) );
     return true;
 }
 
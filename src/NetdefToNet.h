@@ -23,8 +23,9 @@ public:
     // cog_addheaders.add()
     // ]]]
     // generated, using cog:
-    STATIC bool parseSubstring( NeuralNet *net, std::string substring, bool isLast );
+    STATIC bool parseSubstring( NeuralNet *net, std::string substring, bool isLast, bool fastMath );
     STATIC bool createNetFromNetdef( NeuralNet *net, std::string netdef );
+    STATIC bool createNetFromNetdef( NeuralNet *net, std::string netdef, bool fastMath );
 
     // [[[end]]]
 };
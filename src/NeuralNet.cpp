@@ -22,6 +22,10 @@
 #include "IAcceptsLabels.h"
 #include "ExceptionMacros.h"
 #include "InputLayerMaker.h"
+#include "ActivationArena.h"
+#include "TaskGraph.h"
+#include "ThreadPool.h"
+#include "IWeightsUpdatedListener.h"
 
 #include "NeuralNet.h"
 
@@ -35,13 +39,28 @@ using namespace std;
 #define STATIC
 
 NeuralNet::NeuralNet() :
-    isTraining( true ) {
+    isTraining( true ),
+    arena( 0 ),
+    inferenceOnly( false ),
+    checkpointEvery( 0 ),
+    liveSegment( -1 ),
+    weightsUpdatedListener( 0 ),
+    lowLatency( false ),
+    lowLatencyInputLayer( 0 ) {
 //    cout << "NeuralNet()" << endl;
     cl = OpenCLHelper::createForFirstGpuOtherwiseCpu();
 //    InputLayerMaker<T> *maker = new InputLayerMaker<T>( this, numPlanes, imageSize );
 //    maker->insert();
 }
-NeuralNet::NeuralNet( int numPlanes, int imageSize ) {
+NeuralNet::NeuralNet( int numPlanes, int imageSize ) :
+    isTraining( true ),
+    arena( 0 ),
+    inferenceOnly( false ),
+    checkpointEvery( 0 ),
+    liveSegment( -1 ),
+    weightsUpdatedListener( 0 ),
+    lowLatency( false ),
+    lowLatencyInputLayer( 0 ) {
 //    cout << "NeuralNet( " << numPlanes << ", " << imageSize << " )" << endl;
     cl = OpenCLHelper::createForFirstGpuOtherwiseCpu();
 //    InputLayerMaker<float> *maker = ( new InputLayerMaker<float>( this ) )
@@ -56,6 +75,9 @@ NeuralNet::~NeuralNet() {
     for( int i = 0; i < (int)layers.size(); i++ ) {
         delete layers[i];
     }
+    if( arena != 0 ) {
+        delete arena;
+    }
     delete cl;
 }
 NeuralNet *NeuralNet::clone() {
@@ -80,6 +102,7 @@ NeuralNet *NeuralNet::clone() {
 //            throw runtime_error("not implemetned yet, layermaker2 clone");
 //        }
     }
+    copy->checkpointEvery = checkpointEvery;
     copy->print();
     cout << "outputimagesize: " << copy->getOutputImageSize() << endl;
     return copy;
@@ -217,6 +240,12 @@ VIRTUAL int NeuralNet::getOutputImageSize() const {
 //    return layer;
 //}
 void NeuralNet::setBatchSize( int batchSize ) {
+    if( checkpointEvery > 0 && !inferenceOnly && ( arena == 0 || batchSize > arena->batchSize ) ) {
+        if( arena == 0 ) {
+            arena = new ActivationArena( cl );
+        }
+        arena->planCheckpoints( layers, batchSize, checkpointEvery );
+    }
     for( std::vector<Layer*>::iterator it = layers.begin(); it != layers.end(); it++ ) {
         (*it)->setBatchSize( batchSize );
     }
@@ -226,6 +255,68 @@ void NeuralNet::setTraining( bool training ) {
         (*it)->setTraining( training );
     }
 }
+// permanently switches the net to inference: backprop-only buffers are freed,
+// and the results of all layers are packed into one ActivationArena, sized for
+// batchSize, where layers whose results are not needed at the same time share
+// the same memory
+// only the results of the last layer are then valid after propagate;
+// getResults( layer ) on earlier layers may return data overwritten by later layers
+// batch sizes up to batchSize can still be set, larger ones throw
+void NeuralNet::setInferenceOnly( int batchSize ) {
+    isTraining = false;
+    inferenceOnly = true;
+    for( std::vector<Layer*>::iterator it = layers.begin(); it != layers.end(); it++ ) {
+        (*it)->setInferenceOnly();
+    }
+    if( arena == 0 ) {
+        arena = new ActivationArena( cl );
+    }
+    arena->plan( layers, batchSize );
+}
+// for acting, or serving, one example at a time: propagate( float const * ) no
+// longer looks up the input layer, or sets StatefulTimer prefixes, the layers
+// skip their timers, and keep their wrappers between calls, and fully connected
+// layers use a gemv kernel, for batches of up to 8
+// call after adding the layers, and setting the batch size
+void NeuralNet::setLowLatency( bool lowLatency ) {
+    InputLayer<float> *inputLayer = dynamic_cast<InputLayer<float> *>(layers[0]);
+    if( lowLatency && inputLayer == 0 ) {
+        throw std::runtime_error("setLowLatency needs an InputLayer<float> as first layer");
+    }
+    this->lowLatency = lowLatency;
+    this->lowLatencyInputLayer = lowLatency ? inputLayer : 0;
+    for( std::vector<Layer*>::iterator it = layers.begin(); it != layers.end(); it++ ) {
+        (*it)->setLowLatency( lowLatency );
+    }
+}
+// listener is told as each layer's weights are updated, during backprop; 0 for none
+void NeuralNet::setWeightsUpdatedListener( IWeightsUpdatedListener *listener ) {
+    weightsUpdatedListener = listener;
+}
+// gradient checkpointing: trade compute for memory, when training
+// only layers 0, checkpointEvery, 2 * checkpointEvery, ... keep their own results
+// the layers in between share a few buffers, and their results are recomputed
+// from the checkpoint below them during backprop, one segment at a time
+// this costs roughly one extra propagate per batch
+// call before the first setBatchSize.  0 turns it off
+void NeuralNet::setCheckpointEvery( int checkpointEvery ) {
+    if( arena != 0 ) {
+        throw std::runtime_error("setCheckpointEvery must be called before setBatchSize");
+    }
+    if( checkpointEvery == 1 || checkpointEvery < 0 ) {
+        throw std::runtime_error("checkpointEvery should be 0, or at least 2, but is " + toString( checkpointEvery ) );
+    }
+    this->checkpointEvery = checkpointEvery;
+}
+// opt in to updating the weights of tiny layers, eg small fully connected
+// output layers, on the cpu, on gpus.  the update then runs alongside the errors
+// of the layers below, see backPropLayers, at the cost of copying the layer's
+// errors, inputs and weights to the host and back each batch.  off by default
+void NeuralNet::setTinyLayerWeightsOnHost( bool onHost ) {
+    for( int layerIdx = 1; layerIdx < (int)layers.size(); layerIdx++ ) {
+        layers[layerIdx]->setTinyWeightsOnHost( onHost );
+    }
+}
 int NeuralNet::calcNumRight( int const *labels ) {
     IAcceptsLabels *acceptsLabels = dynamic_cast<IAcceptsLabels*>(getLastLayer());
     if( acceptsLabels == 0 ) {
@@ -234,6 +325,13 @@ int NeuralNet::calcNumRight( int const *labels ) {
     return acceptsLabels->calcNumRight( labels );
 }
 void NeuralNet::propagate( float const*images) {
+    if( lowLatency ) {
+        lowLatencyInputLayer->in( images );
+        for( int layerId = 0; layerId < (int)layers.size(); layerId++ ) {
+            layers[layerId]->propagate();
+        }
+        return;
+    }
     // forward...
     dynamic_cast<InputLayer<float> *>(layers[0])->in( images );
     for( int layerId = 0; layerId < (int)layers.size(); layerId++ ) {
@@ -251,32 +349,160 @@ void NeuralNet::propagate( unsigned char const*images) {
         StatefulTimer::setPrefix("" );
     }
 }
+// images are already on the device, as floats, eg from DeviceDataset::gather
+// first layer must be an InputLayer<float>
+void NeuralNet::propagateFromDevice( CLWrapper *imagesWrapper ) {
+    InputLayer<float> *inputLayer = dynamic_cast<InputLayer<float> *>(layers[0]);
+    if( inputLayer == 0 ) {
+        throw std::runtime_error("propagateFromDevice needs an InputLayer<float> as first layer");
+    }
+    inputLayer->inWrapper( imagesWrapper );
+    for( int layerId = 0; layerId < (int)layers.size(); layerId++ ) {
+        StatefulTimer::setPrefix("layer" + toString(layerId) + " " );
+        layers[layerId]->propagate();
+        StatefulTimer::setPrefix("" );
+    }
+}
 void NeuralNet::backPropFromLabels( float learningRate, int const *labels) {
     IAcceptsLabels *acceptsLabels = dynamic_cast<IAcceptsLabels*>(getLastLayer());
     if( acceptsLabels == 0 ) {
         throw std::runtime_error("Must add a child of IAcceptsLabels as last layer, to use backPropFromLabels");
     }
-    acceptsLabels->calcErrorsFromLabels( labels );
-    for( int layerIdx = (int)layers.size() - 2; layerIdx >= 1; layerIdx-- ) { // no point in propagating to input layer :-P
-        StatefulTimer::setPrefix("layer" + toString(layerIdx) + " " );
-        Layer *layer = layers[layerIdx];
-        if( layer->needsBackProp() ) {
-            layer->backProp( learningRate );
-        }
-        StatefulTimer::setPrefix("" );
+    if( inferenceOnly ) {
+        throw std::runtime_error("net is inference only, cannot backprop");
     }
+    acceptsLabels->calcErrorsFromLabels( labels );
+    backPropLayers( learningRate, true );
 }
 void NeuralNet::backProp( float learningRate, float const *expectedResults) {
     LossLayer *lossLayer = dynamic_cast<LossLayer*>(getLastLayer());
     if( lossLayer == 0 ) {
         throw std::runtime_error("Must add a LossLayer as last layer of net");
     }
+    if( inferenceOnly ) {
+        throw std::runtime_error("net is inference only, cannot backprop");
+    }
     lossLayer->calcErrors( expectedResults );
-    for( int layerIdx = (int)layers.size() - 2; layerIdx >= 1; layerIdx-- ) { // no point in propagating to input layer :-P
-        StatefulTimer::setPrefix("layer" + toString(layerIdx) + " " );
-        layers[layerIdx]->backProp( learningRate );
-        StatefulTimer::setPrefix("" );
+    backPropLayers( learningRate, false );
+}
+// backprop through every layer but the first and last.  without checkpointing,
+// this runs as a TaskGraph: the errors of each layer wait for the errors of the
+// layer above, and its weight update waits for its own errors, since that
+// changes the weights the errors are calculated from.  so the weight update of
+// one layer can overlap the errors of the layers below it, when it runs on
+// the host, see Layer::backPropWeightsOnHost
+// with checkpointing, recomputing a segment overwrites the arena, so everything
+// runs in order
+void NeuralNet::backPropLayers( float learningRate, bool onlyIfNeedsBackProp ) {
+    if( checkpointEvery > 0 ) {
+        startCheckpointedBackprop();
+        for( int layerIdx = (int)layers.size() - 2; layerIdx >= 1; layerIdx-- ) { // no point in propagating to input layer :-P
+            StatefulTimer::setPrefix("layer" + toString(layerIdx) + " " );
+            Layer *layer = layers[layerIdx];
+            recomputeInputsOf( layerIdx );
+            if( !onlyIfNeedsBackProp || layer->needsBackProp() ) {
+                layer->backProp( learningRate );
+                if( weightsUpdatedListener != 0 ) {
+                    weightsUpdatedListener->weightsUpdated( layerIdx );
+                }
+            }
+            StatefulTimer::setPrefix("" );
+        }
+        return;
+    }
+    TaskGraph graph;
+    int lastErrorsTask = -1;
+    for( int layerIdx = (int)layers.size() - 2; layerIdx >= 1; layerIdx-- ) {
+        Layer *layer = layers[layerIdx];
+        if( onlyIfNeedsBackProp && !layer->needsBackProp() ) {
+            continue;
+        }
+        const int errorsTask = graph.addTask( "layer" + toString( layerIdx ) + " errors", false, [layer, layerIdx, learningRate]() {
+            StatefulTimer::setPrefix("layer" + toString(layerIdx) + " " );
+            layer->backPropErrors( learningRate );
+            StatefulTimer::setPrefix("" );
+        } );
+        if( lastErrorsTask != -1 ) {
+            graph.addDependency( lastErrorsTask, errorsTask );
+        }
+        IWeightsUpdatedListener *listener = weightsUpdatedListener;
+        if( layer->backPropWeightsOnHost() ) {
+            // only the middle task runs on the host, the copies to and from the
+            // device stay with the other device tasks
+            const int startTask = graph.addTask( "layer" + toString( layerIdx ) + " weights start", false, [layer]() {
+                layer->startBackPropWeightsOnHost();
+            } );
+            const int weightsTask = graph.addTask( "layer" + toString( layerIdx ) + " weights", true, [layer, layerIdx, learningRate]() {
+                StatefulTimer::setPrefix("layer" + toString(layerIdx) + " " );
+                layer->backPropWeights( learningRate );
+                StatefulTimer::setPrefix("" );
+            } );
+            const int finishTask = graph.addTask( "layer" + toString( layerIdx ) + " weights finish", false, [layer, layerIdx, listener]() {
+                layer->finishBackPropWeightsOnHost();
+                if( listener != 0 ) {
+                    listener->weightsUpdated( layerIdx );
+                }
+            } );
+            graph.addDependency( errorsTask, startTask );
+            graph.addDependency( startTask, weightsTask );
+            graph.addDependency( weightsTask, finishTask );
+        } else {
+            const int weightsTask = graph.addTask( "layer" + toString( layerIdx ) + " weights", false, [layer, layerIdx, learningRate, listener]() {
+                StatefulTimer::setPrefix("layer" + toString(layerIdx) + " " );
+                layer->backPropWeights( learningRate );
+                StatefulTimer::setPrefix("" );
+                if( listener != 0 ) {
+                    listener->weightsUpdated( layerIdx );
+                }
+            } );
+            graph.addDependency( errorsTask, weightsTask );
+        }
+        lastErrorsTask = errorsTask;
+    }
+    graph.run( ThreadPool::instance() );
+}
+// with checkpointing, the arena holds the results of the last segment written by
+// propagate, ie the topmost one
+void NeuralNet::startCheckpointedBackprop() {
+    liveSegment = -1;
+    if( checkpointEvery == 0 ) {
+        return;
+    }
+    for( int i = (int)layers.size() - 1; i >= 0; i-- ) {
+        if( arena->getSlot( i ) != -1 ) {
+            liveSegment = ( i / checkpointEvery ) * checkpointEvery;
+            return;
+        }
+    }
+}
+// with checkpointing, makes sure the results that backprop of layer layerIndex
+// reads, ie those of the layer below, are there.  if that layer has no results
+// of its own, and its segment isnt the one in the arena, then recompute the
+// arena layers of the segment up to that layer, starting from the checkpoint
+// below it
+void NeuralNet::recomputeInputsOf( int layerIndex ) {
+    if( checkpointEvery == 0 ) {
+        return;
+    }
+    const int inputLayer = layerIndex - 1;
+    if( arena->getSlot( inputLayer ) == -1 ) {
+        return;
+    }
+    const int checkpoint = ( inputLayer / checkpointEvery ) * checkpointEvery;
+    if( checkpoint == liveSegment ) {
+        return;
+    }
+    StatefulTimer::timeCheck("recompute segment from layer " + toString( checkpoint ) + " start" );
+    for( int i = checkpoint + 1; i <= inputLayer; i++ ) {
+        // layers outside the arena kept their results, and might be random, eg
+        // RandomTranslations, so propagating them again would change them
+        if( arena->getSlot( i ) == -1 ) {
+            continue;
+        }
+        layers[i]->propagate();
     }
+    StatefulTimer::timeCheck("recompute segment from layer " + toString( checkpoint ) + " end" );
+    liveSegment = checkpoint;
 }
 int NeuralNet::getNumLayers() {
     return (int)layers.size();
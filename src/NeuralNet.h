@@ -30,6 +30,8 @@ class OpenCLHelper;
 class ConvolutionalMaker;
 class LayerMaker;
 class RandomTranslatorMaker;
+class ActivationArena;
+class IWeightsUpdatedListener;
 template< typename T> class InputLayerMaker;
 
 #define VIRTUAL virtual
@@ -40,6 +42,13 @@ public:
     std::vector< Layer *> layers;
     OpenCLHelper *cl;
     int isTraining; // = true;
+    ActivationArena *arena; // only used after setInferenceOnly, or with setCheckpointEvery
+    bool inferenceOnly;
+    int checkpointEvery; // 0 means keep the results of every layer until backprop
+    int liveSegment; // checkpoint layer whose segment's results are currently held in the arena
+    IWeightsUpdatedListener *weightsUpdatedListener; // not owned by us; 0 if none
+    bool lowLatency;
+    InputLayer<float> *lowLatencyInputLayer; // layers[0], looked up once by setLowLatency
 
     // [[[cog
     // import cog_addheaders
@@ -71,11 +80,20 @@ public:
     VIRTUAL int getOutputImageSize() const;
     void setBatchSize( int batchSize );
     void setTraining( bool training );
+    void setInferenceOnly( int batchSize );
+    void setLowLatency( bool lowLatency );
+    void setWeightsUpdatedListener( IWeightsUpdatedListener *listener );
+    void setCheckpointEvery( int checkpointEvery );
+    void setTinyLayerWeightsOnHost( bool onHost );
     int calcNumRight( int const *labels );
     void propagate( float const*images);
     void propagate( unsigned char const*images);
+    void propagateFromDevice( CLWrapper *imagesWrapper );
     void backPropFromLabels( float learningRate, int const *labels);
     void backProp( float learningRate, float const *expectedResults);
+    void backPropLayers( float learningRate, bool onlyIfNeedsBackProp );
+    void startCheckpointedBackprop();
+    void recomputeInputsOf( int layerIndex );
     int getNumLayers();
     float const *getResults( int layer ) const;
     int getInputCubeSize() const;
@@ -4,6 +4,7 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "ZeroCopy.h"
 #include "NormalizationLayerMaker.h"
 
 #include "NormalizationLayer.h"
@@ -24,8 +25,8 @@ NormalizationLayer::NormalizationLayer( Layer *previousLayer, NormalizationLayer
     results(0) {
 }
 VIRTUAL NormalizationLayer::~NormalizationLayer() {
-    if( results != 0 ) {
-        delete[] results;
+    if( results != 0 && !resultsInArena ) {
+        ZeroCopy::deallocate( results );
     }
 }
 VIRTUAL std::string NormalizationLayer::getClassName() const {
@@ -81,12 +82,28 @@ VIRTUAL void NormalizationLayer::setBatchSize( int batchSize ) {
         this->batchSize = batchSize;
         return;
     }
+    if( resultsInArena ) {
+        throw runtime_error("layer " + ::toString(layerIndex) + ": results are in an arena planned for batch size " +
+            ::toString(allocatedSize) + ", cannot set batch size " + ::toString(batchSize) );
+    }
     if( results != 0 ) {
-        delete[] results;
+        ZeroCopy::deallocate( results );
+    }
+    this->batchSize = batchSize;
+    this->allocatedSize = batchSize;
+    results = ZeroCopy::allocateFloats( getResultsSize() );
+}
+VIRTUAL bool NormalizationLayer::canUseArena() const {
+    return true;
+}
+VIRTUAL void NormalizationLayer::setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper ) {
+    if( !resultsInArena && this->results != 0 ) {
+        ZeroCopy::deallocate( this->results );
     }
+    this->results = results;
+    this->resultsInArena = true;
     this->batchSize = batchSize;
-    this->allocatedSize = allocatedSize;
-    results = new float[ getResultsSize() ];
+    this->allocatedSize = batchSize;
 }
 VIRTUAL void NormalizationLayer::propagate() {
     int totalLinearLength = getResultsSize();
@@ -52,6 +52,8 @@ public:
     VIRTUAL void print() const;
     VIRTUAL bool needErrorsBackprop();
     VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL bool canUseArena() const;
+    VIRTUAL void setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper );
     VIRTUAL void propagate();
     VIRTUAL void backPropErrors( float learningRate, float const *errors );
     VIRTUAL int getOutputImageSize() const;
@@ -13,6 +13,7 @@
 
 #include "PoolingBackpropCpu.h"
 #include "PoolingBackpropGpuNaive.h"
+#include "PoolingBackpropGpuGather.h"
 
 #include "PoolingBackprop.h"
 
@@ -24,7 +25,7 @@ using namespace std;
 #define STATIC
 
 STATIC PoolingBackprop *PoolingBackprop::instance( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize ) {
-    return new PoolingBackpropGpuNaive( cl, padZeros, numPlanes, inputImageSize, poolingSize );
+    return new PoolingBackpropGpuGather( cl, padZeros, numPlanes, inputImageSize, poolingSize );
 }
 STATIC PoolingBackprop *PoolingBackprop::instanceForTest( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize) {
     return new PoolingBackpropCpu( cl, padZeros, numPlanes, inputImageSize, poolingSize );
@@ -36,6 +37,9 @@ STATIC PoolingBackprop *PoolingBackprop::instanceSpecific( int idx, OpenCLHelper
     if( idx == 1 ) {
         return new PoolingBackpropGpuNaive( cl, padZeros, numPlanes, inputImageSize, poolingSize );
     }
+    if( idx == 2 ) {
+        return new PoolingBackpropGpuGather( cl, padZeros, numPlanes, inputImageSize, poolingSize );
+    }
     throw runtime_error("PoolingBackprop::instanceSpecific, idx not known: " + toString( idx ) );
 }
 PoolingBackprop::PoolingBackprop( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize ) :
@@ -46,6 +50,9 @@ PoolingBackprop::PoolingBackprop( OpenCLHelper *cl, bool padZeros, int numPlanes
         poolingSize( poolingSize ),
 //        poolingSizeSquared( poolingSize * poolingSize ),
         outputImageSize( padZeros ? ( inputImageSize + poolingSize - 1 ) / poolingSize : inputImageSize / poolingSize ) {
+    if( poolingSize * poolingSize > 256 ) {
+        throw runtime_error("poolingSize " + toString( poolingSize ) + " too large: selectors are stored in one byte, so poolingSize can be at most 16" );
+    }
 //    if( inputImageSize % poolingSize != 0 ) {
 //        throw runtime_error("inputImageSize should be an exact multiple of poolingsize: " + toString( inputImageSize ) + " " + toString(poolingSize ) );
 //    }
@@ -56,7 +63,7 @@ VIRTUAL int PoolingBackprop::getInputSize( int batchSize ) {
 VIRTUAL int PoolingBackprop::getResultsSize(int batchSize) {
     return batchSize * numPlanes * outputImageSize * outputImageSize;
 }
-VIRTUAL void PoolingBackprop::backpropErrors( int batchSize, float *errors, int *selectors, float *errorsForUpstream ) {
+VIRTUAL void PoolingBackprop::backpropErrors( int batchSize, float *errors, unsigned char *selectors, float *errorsForUpstream ) {
 //    cout << "PoolingBackprop::backpropErrors( float * )" << endl;
     StatefulTimer::instance()->timeCheck("PoolingBackprop::backpropErrors float->wrapper start" );
     CLWrapper *errorsWrapper = cl->wrap( getResultsSize(batchSize), errors );
@@ -76,6 +83,16 @@ VIRTUAL void PoolingBackprop::backpropErrors( int batchSize, float *errors, int
     delete errorsForUpstreamWrapper;
     StatefulTimer::instance()->timeCheck("PoolingBackprop::backpropErrors float->wrapper end" );
 }
+// for callers that keep their selectors as ints
+VIRTUAL void PoolingBackprop::backpropErrors( int batchSize, float *errors, int *selectors, float *errorsForUpstream ) {
+    const int resultsSize = getResultsSize( batchSize );
+    unsigned char *byteSelectors = new unsigned char[ resultsSize ];
+    for( int i = 0; i < resultsSize; i++ ) {
+        byteSelectors[i] = (unsigned char)selectors[i];
+    }
+    backpropErrors( batchSize, errors, byteSelectors, errorsForUpstream );
+    delete[] byteSelectors;
+}
 VIRTUAL void PoolingBackprop::backpropErrors( int batchSize, CLWrapper *errorsWrapper, CLWrapper *selectorsWrapper, CLWrapper *errorsForUpstreamWrapper ) {
     throw runtime_error("PoolingBackprop::backpropErrors wrappers not implemented" );
 }
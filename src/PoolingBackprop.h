@@ -51,6 +51,7 @@ public:
     PoolingBackprop( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize );
     VIRTUAL int getInputSize( int batchSize );
     VIRTUAL int getResultsSize(int batchSize);
+    VIRTUAL void backpropErrors( int batchSize, float *errors, unsigned char *selectors, float *errorsForUpstream );
     VIRTUAL void backpropErrors( int batchSize, float *errors, int *selectors, float *errorsForUpstream );
     VIRTUAL void backpropErrors( int batchSize, CLWrapper *errorsWrapper, CLWrapper *selectorsWrapper, CLWrapper *errorsForUpstreamWrapper );
 
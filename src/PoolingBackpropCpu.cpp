@@ -7,10 +7,13 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
 
 #include "OpenCLHelper.h"
 #include "PoolingBackprop.h"
 #include "StatefulTimer.h"
+#include "ZeroCopy.h"
+#include "ThreadPool.h"
 
 #include "PoolingBackpropCpu.h"
 
@@ -24,45 +27,63 @@ using namespace std;
 PoolingBackpropCpu::PoolingBackpropCpu( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize ) :
         PoolingBackprop( cl, padZeros, numPlanes, inputImageSize, poolingSize ) {
 }
-VIRTUAL void PoolingBackpropCpu::backpropErrors( int batchSize,  float *errors, int *selectors, float *errorsForUpstream ) {
-    memset( errorsForUpstream, 0, sizeof( float ) * getInputSize( batchSize ) );
-    for( int n = 0; n < batchSize; n++ ) {
-        for( int plane = 0; plane < numPlanes; plane++ ) {
-            for( int outputRow = 0; outputRow < outputImageSize; outputRow++ ) {
-                int inputRow = outputRow * poolingSize;
+// gathers, rather than scattering: each thread takes whole planes, and writes
+// every element of errorsForUpstream once, row by row, so there is no memset
+// first.  the inner loop, over one row of a pooling window, is a select, not a
+// branch, so it vectorizes
+VIRTUAL void PoolingBackpropCpu::backpropErrors( int batchSize,  float *errors, unsigned char *selectors, float *errorsForUpstream ) {
+    const int inputImageSizeSquared = inputImageSize * inputImageSize;
+    const int outputImageSizeSquared = outputImageSize * outputImageSize;
+    ThreadPool::instance()->parallelFor( batchSize * numPlanes, std::max( 1, 16384 / inputImageSizeSquared ),
+            [=]( int begin, int end ) {
+        for( int plane2d = begin; plane2d < end; plane2d++ ) {
+            float const *planeErrors = errors + plane2d * outputImageSizeSquared;
+            unsigned char const *planeSelectors = selectors + plane2d * outputImageSizeSquared;
+            float *planeErrorsForUpstream = errorsForUpstream + plane2d * inputImageSizeSquared;
+            for( int inputRow = 0; inputRow < inputImageSize; inputRow++ ) {
+                float *upstreamRow = planeErrorsForUpstream + inputRow * inputImageSize;
+                const int outputRow = inputRow / poolingSize;
+                if( outputRow >= outputImageSize ) { // past the last pooling row, when not padZeros
+                    memset( upstreamRow, 0, sizeof( float ) * inputImageSize );
+                    continue;
+                }
+                const int rowSelectorOffset = ( inputRow - outputRow * poolingSize ) * poolingSize;
+                float const *errorsRow = planeErrors + outputRow * outputImageSize;
+                unsigned char const *selectorsRow = planeSelectors + outputRow * outputImageSize;
                 for( int outputCol = 0; outputCol < outputImageSize; outputCol++ ) {
-                    int inputCol = outputCol * poolingSize;
-                    int resultIndex = getResultIndex( n, plane, outputRow, outputCol );
-                    float error = errors[resultIndex];
-                    int selector = selectors[resultIndex];
-                    int drow = selector / poolingSize;
-                    int dcol = selector % poolingSize;
-                    int inputIndex = getInputIndex( n, plane, inputRow + drow, inputCol + dcol );
-                    errorsForUpstream[ inputIndex ] = error;
+                    const int selectedCol = selectorsRow[outputCol] - rowSelectorOffset;
+                    const float error = errorsRow[outputCol];
+                    float *upstreamWindow = upstreamRow + outputCol * poolingSize;
+                    const int windowCols = std::min( poolingSize, inputImageSize - outputCol * poolingSize );
+                    for( int dCol = 0; dCol < windowCols; dCol++ ) {
+                        upstreamWindow[dCol] = dCol == selectedCol ? error : 0.0f;
+                    }
                 }
+                const int pooledCols = std::min( inputImageSize, outputImageSize * poolingSize );
+                memset( upstreamRow + pooledCols, 0, sizeof( float ) * ( inputImageSize - pooledCols ) );
             }
         }
-    }
+    } );
 }
 VIRTUAL void PoolingBackpropCpu::backpropErrors( int batchSize, CLWrapper *errorsWrapper, CLWrapper *selectorsWrapper, 
         CLWrapper *errorsForUpstreamWrapper ) {
     StatefulTimer::instance()->timeCheck("PoolingBackpropCpu::backpropErrors start" );
 
-    errorsWrapper->copyToHost();
-    selectorsWrapper->copyToHost();
+    ZeroCopy::copyToHost( errorsWrapper );
+    ZeroCopy::copyToHost( selectorsWrapper );
 
     float *errors = reinterpret_cast<float *>( errorsWrapper->getHostArray() );
-    int *selectors = reinterpret_cast<int *>( selectorsWrapper->getHostArray() );
-    float *errorsForUpstream = new float[ getInputSize( batchSize ) ];
+    if( selectorsWrapper->getElementSize() != 1 ) {
+        throw runtime_error("PoolingBackpropCpu::backpropErrors: selectors should be unsigned chars");
+    }
+    unsigned char *selectors = reinterpret_cast<unsigned char *>( selectorsWrapper->getHostArray() );
+    float *errorsForUpstream = reinterpret_cast<float *>( errorsForUpstreamWrapper->getHostArray() );
 
+    // write straight into the wrapper's host array, no temporary copy
     backpropErrors( batchSize, errors, selectors, errorsForUpstream );
 
-    float *errorsForUpstreamHostArray = reinterpret_cast<float *>( errorsForUpstreamWrapper->getHostArray() );
-    memcpy( errorsForUpstreamHostArray, errorsForUpstream, sizeof(float) * getInputSize( batchSize ) );
-    errorsForUpstreamWrapper->copyToDevice();
+    ZeroCopy::copyToDevice( errorsForUpstreamWrapper );
 
-    delete[] errorsForUpstream;
-    
     StatefulTimer::instance()->timeCheck("PoolingBackpropCpu::backpropErrors end" );
 }
 
@@ -13,6 +13,7 @@
 
 class PoolingBackpropCpu : public PoolingBackprop {
 public:
+    using PoolingBackprop::backpropErrors;
 
     // [[[cog
     // import cog_addheaders
@@ -20,7 +21,7 @@ public:
     // ]]]
     // generated, using cog:
     PoolingBackpropCpu( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize );
-    VIRTUAL void backpropErrors( int batchSize,  float *errors, int *selectors, float *errorsForUpstream );
+    VIRTUAL void backpropErrors( int batchSize,  float *errors, unsigned char *selectors, float *errorsForUpstream );
     VIRTUAL void backpropErrors( int batchSize, CLWrapper *errorsWrapper, CLWrapper *selectorsWrapper,
     CLWrapper *errorsForUpstreamWrapper );
 
@@ -0,0 +1,99 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+
+#include "OpenCLHelper.h"
+#include "StatefulTimer.h"
+#include "stringhelper.h"
+
+#include "PoolingBackpropGpuGather.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+VIRTUAL PoolingBackpropGpuGather::~PoolingBackpropGpuGather() {
+    delete kernel;
+}
+VIRTUAL void PoolingBackpropGpuGather::backpropErrors( int batchSize, CLWrapper *errorsWrapper, CLWrapper *selectorsWrapper,
+        CLWrapper *errorsForUpstreamWrapper ) {
+    StatefulTimer::instance()->timeCheck("PoolingBackpropGpuGather::backpropErrors start" );
+    if( selectorsWrapper->getElementSize() != 1 ) {
+        throw runtime_error("PoolingBackpropGpuGather::backpropErrors: selectors should be unsigned chars");
+    }
+
+    kernel->in( batchSize )->in( errorsWrapper )->in( selectorsWrapper )->out( errorsForUpstreamWrapper );
+    const int globalSize = batchSize * numPlanes * inputImageSize * inputImageSize;
+    const int workgroupSize = 64;
+    const int numWorkgroups = ( globalSize + workgroupSize - 1 ) / workgroupSize;
+    kernel->run_1d( numWorkgroups * workgroupSize, workgroupSize );
+    cl->finish();
+
+    StatefulTimer::instance()->timeCheck("PoolingBackpropGpuGather::backpropErrors end" );
+}
+PoolingBackpropGpuGather::PoolingBackpropGpuGather( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize ) :
+        PoolingBackprop( cl, padZeros, numPlanes, inputImageSize, poolingSize ) {
+    string options = "";
+    options += " -D gNumPlanes=" + toString( numPlanes );
+    options += " -D gInputImageSize=" + toString( inputImageSize );
+    options += " -D gInputImageSizeSquared=" + toString( inputImageSize * inputImageSize );
+    options += " -D gOutputImageSize=" + toString( outputImageSize );
+    options += " -D gPoolingSize=" + toString( poolingSize );
+
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2( "kernel", "cl/PoolingBackpropGpuGather.cl", "backprop_errors_gather", 'options' )
+    // ]]]
+    // generated using cog, from cl/PoolingBackpropGpuGather.cl:
+    const char * kernelSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n" 
+    "//\n" 
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n" 
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n" 
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n" 
+    "\n" 
+    "// errors: [n][plane][outrow][outcol]\n" 
+    "// selectors: [n][plane][outrow][outcol], one byte each\n" 
+    "// errorsForUpstream: [n][plane][inrow][incol]\n" 
+    "// one thread per: [n][plane][inrow][incol], ie per upstream error, rather than\n" 
+    "// per pooled error, as in backprop_errors\n" 
+    "// so every upstream error is written exactly once, by neighbouring threads, to\n" 
+    "// neighbouring addresses, and there's no need to zero errorsForUpstream first.\n" 
+    "// the threads of one pooling window all read the same selector and error\n" 
+    "kernel void backprop_errors_gather( const int batchSize,\n" 
+    "    global const float *errors, global const uchar *selectors, global float *errorsForUpstream ) {\n" 
+    "    const int globalId = get_global_id(0);\n" 
+    "    if( globalId >= batchSize * gNumPlanes * gInputImageSizeSquared ) {\n" 
+    "        return;\n" 
+    "    }\n" 
+    "    const int plane2d = globalId / gInputImageSizeSquared;\n" 
+    "    const int inputPos = globalId % gInputImageSizeSquared;\n" 
+    "    const int inputRow = inputPos / gInputImageSize;\n" 
+    "    const int inputCol = inputPos % gInputImageSize;\n" 
+    "    const int outputRow = inputRow / gPoolingSize;\n" 
+    "    const int outputCol = inputCol / gPoolingSize;\n" 
+    "\n" 
+    "    float error = 0.0f;\n" 
+    "    // without padZeros, the last rows and cols might not be in any pooling window\n" 
+    "    if( outputRow < gOutputImageSize && outputCol < gOutputImageSize ) {\n" 
+    "        const int resultIndex = ( plane2d * gOutputImageSize + outputRow ) * gOutputImageSize + outputCol;\n" 
+    "        const int thisSelector = ( inputRow - outputRow * gPoolingSize ) * gPoolingSize + inputCol - outputCol * gPoolingSize;\n" 
+    "        const float pooledError = errors[resultIndex];\n" 
+    "        error = selectors[resultIndex] == thisSelector ? pooledError : 0.0f;\n" 
+    "    }\n" 
+    "    errorsForUpstream[globalId] = error;\n" 
+    "}\n" 
+    "\n" 
+    "";
+    kernel = cl->buildKernelFromString( kernelSource, "backprop_errors_gather", options, "cl/PoolingBackpropGpuGather.cl" );
+    // [[[end]]]
+}
+
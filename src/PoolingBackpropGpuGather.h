@@ -0,0 +1,34 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "PoolingBackprop.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+class CLKernel;
+
+// one thread per upstream error, rather than per pooled error, so the writes
+// are coalesced, and there is no separate memset pass
+class PoolingBackpropGpuGather : public PoolingBackprop {
+public:
+    CLKernel *kernel;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    VIRTUAL ~PoolingBackpropGpuGather();
+    VIRTUAL void backpropErrors( int batchSize, CLWrapper *errorsWrapper, CLWrapper *selectorsWrapper,
+    CLWrapper *errorsForUpstreamWrapper );
+    PoolingBackpropGpuGather( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize );
+
+    // [[[end]]]
+};
+
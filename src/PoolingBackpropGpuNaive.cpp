@@ -30,6 +30,9 @@ VIRTUAL void PoolingBackpropGpuNaive::backpropErrors( int batchSize, CLWrapper *
         CLWrapper *errorsForUpstreamWrapper ) {
 
     StatefulTimer::instance()->timeCheck("PoolingBackpropGpuNaive::backpropErrors start" );
+    if( selectorsWrapper->getElementSize() != 1 ) {
+        throw runtime_error("PoolingBackpropGpuNaive::backpropErrors: selectors should be unsigned chars");
+    }
 
     // first, memset errors to 0 ...
     kMemset->out( errorsForUpstreamWrapper )->in( 0.0f )->in( batchSize * numPlanes * inputImageSize * inputImageSize );
@@ -75,13 +78,13 @@ PoolingBackpropGpuNaive::PoolingBackpropGpuNaive( OpenCLHelper *cl, bool padZero
     "\n" 
     "// inplane and outplane are always identical, 1:1 mapping, so can just write `plane`\n" 
     "// errors: [n][plane][outrow][outcol]\n" 
-    "// selectors: [n][plane][outrow][outcol]\n" 
+    "// selectors: [n][plane][outrow][outcol], one byte each\n" 
     "// errorsForUpstream: [n][plane][inrow][incol]\n" 
     "// wont use workgroups (since 'naive')\n" 
     "// one thread per: [n][plane][outrow][outcol]\n" 
     "// globalId: [n][plane][outrow][outcol]\n" 
     "kernel void backprop_errors( const int batchSize,\n" 
-    "    global const float *errors, global const int *selectors, global float *errorsForUpstream ) {\n" 
+    "    global const float *errors, global const uchar *selectors, global float *errorsForUpstream ) {\n" 
     "\n" 
     "    #define globalId get_global_id(0)\n" 
     "    #define nPlaneCombo ( globalId / gOutputImageSizeSquared )\n" 
@@ -11,6 +11,8 @@
 #include "PoolingLayer.h"
 #include "PoolingPropagate.h"
 #include "PoolingBackprop.h"
+#include "ConvolutionalLayer.h"
+#include "ZeroCopy.h"
 
 //#include "test/PrintBuffer.h"
 
@@ -29,6 +31,7 @@ PoolingLayer::PoolingLayer( OpenCLHelper *cl, Layer *previousLayer, PoolingMaker
         poolingSize( maker->_poolingSize ),
         outputImageSize( maker->_padZeros ? ( previousLayer->getOutputImageSize() + maker->_poolingSize - 1 ) / maker->_poolingSize : previousLayer->getOutputImageSize() / maker->_poolingSize ),
         cl( cl ),
+        fusedConv(0),
         results(0),
         selectors(0),
         errorsForUpstream(0),
@@ -37,6 +40,7 @@ PoolingLayer::PoolingLayer( OpenCLHelper *cl, Layer *previousLayer, PoolingMaker
         errorsForUpstreamWrapper(0),
         resultsCopiedToHost(false),
         errorsForUpstreamCopiedToHost(false),
+        selectorsInScratch(false),
         batchSize(0),
         allocatedSize(0){
     if( inputImageSize == 0 ){
@@ -49,28 +53,33 @@ PoolingLayer::PoolingLayer( OpenCLHelper *cl, Layer *previousLayer, PoolingMaker
     }
     poolingPropagateImpl = PoolingPropagate::instance( cl, padZeros, numPlanes, inputImageSize, poolingSize );
     poolingBackpropImpl = PoolingBackprop::instance( cl, padZeros, numPlanes, inputImageSize, poolingSize );
+    if( maker->_fused ) {
+        fusedConv = dynamic_cast< ConvolutionalLayer * >( previousLayer );
+        if( fusedConv == 0 ) {
+            throw runtime_error("Error: Pooling layer " + toString( layerIndex ) + ": can only be fused with a convolutional layer" );
+        }
+        fusedConv->fusePooling( padZeros, poolingSize );
+    }
 }
 VIRTUAL PoolingLayer::~PoolingLayer() {
     delete poolingPropagateImpl;
     delete poolingBackpropImpl;
-    if( resultsWrapper != 0 ) {
-        delete resultsWrapper;
-    }
-    if( results != 0 ) {
-        delete[] results;
-    }
-    if( selectorsWrapper != 0 ) {
-        delete selectorsWrapper;
+    if( !resultsInArena ) {
+        if( resultsWrapper != 0 ) {
+            delete resultsWrapper;
+        }
+        ZeroCopy::deallocate( results );
     }
-    if( selectors != 0 ) {
-        delete[] selectors;
+    if( !selectorsInScratch ) {
+        if( selectorsWrapper != 0 ) {
+            delete selectorsWrapper;
+        }
+        ZeroCopy::deallocate( selectors );
     }
     if( errorsForUpstreamWrapper != 0 ) {
         delete errorsForUpstreamWrapper;
     }
-    if( errorsForUpstream != 0 ) {
-        delete[] errorsForUpstream;
-    }
+    ZeroCopy::deallocate( errorsForUpstream );
 }
 VIRTUAL std::string PoolingLayer::getClassName() const {
     return "PoolingLayer";
@@ -81,40 +90,91 @@ VIRTUAL void PoolingLayer::setBatchSize( int batchSize ) {
         this->batchSize = batchSize;
         return;
     }
+    if( resultsInArena ) {
+        throw runtime_error("layer " + toString(layerIndex) + ": results are in an arena planned for batch size " +
+            toString(allocatedSize) + ", cannot set batch size " + toString(batchSize) );
+    }
     if( resultsWrapper != 0 ) {
         delete resultsWrapper;
     }
-    if( results != 0 ) {
-        delete[] results;
-    }
+    ZeroCopy::deallocate( results );
     if( selectorsWrapper != 0 ) {
         delete selectorsWrapper;
     }
-    if( selectors != 0 ) {
-        delete[] selectors;
-    }
+    ZeroCopy::deallocate( selectors );
     if( errorsForUpstreamWrapper != 0 ) {
         delete errorsForUpstreamWrapper;
     }
-    if( errorsForUpstream != 0 ) {
-        delete[] errorsForUpstream;
+    ZeroCopy::deallocate( errorsForUpstream );
+    this->batchSize = batchSize;
+    this->allocatedSize = batchSize;
+    results = ZeroCopy::allocateFloats( getResultsSize() );
+    resultsWrapper = ZeroCopy::wrap( cl, getResultsSize(), results );
+    selectors = ZeroCopy::allocateBytes( getResultsSize() );
+    selectorsWrapper = ZeroCopy::wrap( cl, getResultsSize(), selectors );
+    errorsForUpstream = 0;
+    errorsForUpstreamWrapper = 0;
+    if( !inferenceOnly ) {
+        errorsForUpstream = ZeroCopy::allocateFloats( previousLayer->getResultsSize() );
+        errorsForUpstreamWrapper = ZeroCopy::wrap( cl, previousLayer->getResultsSize(), errorsForUpstream );
+        ZeroCopy::createOnDevice( errorsForUpstreamWrapper );
     }
+}
+VIRTUAL bool PoolingLayer::canUseArena() const {
+    return true;
+}
+VIRTUAL void PoolingLayer::setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper ) {
+    if( !resultsInArena ) {
+        if( this->resultsWrapper != 0 ) {
+            delete this->resultsWrapper;
+        }
+        ZeroCopy::deallocate( this->results );
+    }
+    if( !selectorsInScratch ) {
+        if( selectorsWrapper != 0 ) {
+            delete selectorsWrapper;
+        }
+        ZeroCopy::deallocate( selectors );
+    }
+    selectors = 0;
+    selectorsWrapper = 0;
+    selectorsInScratch = false;
+    if( errorsForUpstreamWrapper != 0 ) {
+        delete errorsForUpstreamWrapper;
+        errorsForUpstreamWrapper = 0;
+    }
+    ZeroCopy::deallocate( errorsForUpstream );
+    errorsForUpstream = 0;
+    this->results = results;
+    this->resultsWrapper = resultsWrapper;
+    this->resultsInArena = true;
+    this->resultsCopiedToHost = false;
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
-    results = new float[ getResultsSize() ];
-    resultsWrapper = cl->wrap( getResultsSize(), results );
-    selectors = new int[ getResultsSize() ];
-    selectorsWrapper = cl->wrap( getResultsSize(), selectors );
-    errorsForUpstream = new float[ previousLayer->getResultsSize() ];
-    errorsForUpstreamWrapper = cl->wrap( previousLayer->getResultsSize(), errorsForUpstream );
-    errorsForUpstreamWrapper->createOnDevice();
+    if( !inferenceOnly ) {
+        selectors = ZeroCopy::allocateBytes( getResultsSize() );
+        selectorsWrapper = ZeroCopy::wrap( cl, getResultsSize(), selectors );
+        errorsForUpstream = ZeroCopy::allocateFloats( previousLayer->getResultsSize() );
+        errorsForUpstreamWrapper = ZeroCopy::wrap( cl, previousLayer->getResultsSize(), errorsForUpstream );
+        ZeroCopy::createOnDevice( errorsForUpstreamWrapper );
+    }
+}
+// selectors are only read by backprop, so when inference only, and results are
+// in an arena, they go in the arena's shared scratch buffer
+VIRTUAL int PoolingLayer::getScratchSize() const {
+    return resultsInArena && inferenceOnly ? getResultsSize() : 0;
+}
+VIRTUAL void PoolingLayer::setScratchBuffer( unsigned char *scratch, CLWrapper *scratchWrapper ) {
+    selectors = scratch;
+    selectorsWrapper = scratchWrapper;
+    selectorsInScratch = true;
 }
 VIRTUAL int PoolingLayer::getResultsSize() {
     return batchSize * numPlanes * outputImageSize * outputImageSize;
 }
 VIRTUAL float *PoolingLayer::getResults() {
     if( !resultsCopiedToHost ) {
-        resultsWrapper->copyToHost();
+        ZeroCopy::copyToHost( resultsWrapper );
         resultsCopiedToHost = true;
     }
     return results;
@@ -148,22 +208,36 @@ VIRTUAL CLWrapper *PoolingLayer::getResultsWrapper() {
     return resultsWrapper;
 }
 VIRTUAL float *PoolingLayer::getErrorsForUpstream() {
+    if( !errorsForUpstreamCopiedToHost ) {
+        ZeroCopy::copyToHost( errorsForUpstreamWrapper );
+        errorsForUpstreamCopiedToHost = true;
+    }
     return errorsForUpstream;
 }
 VIRTUAL ActivationFunction const *PoolingLayer::getActivationFunction() {
     return previousLayer->getActivationFunction(); // I guess???
 }
 VIRTUAL void PoolingLayer::propagate() {
+    if( fusedConv != 0 ) {
+        // selectors are only needed for backprop
+        fusedConv->propagateFused( selectorsWrapper, resultsWrapper, !inferenceOnly );
+        resultsCopiedToHost = false;
+        return;
+    }
     CLWrapper *upstreamResultsWrapper = 0;
+    const bool weOwnUpstreamWrapper = !previousLayer->hasResultsWrapper() && !lowLatency;
     if( previousLayer->hasResultsWrapper() ) {
         upstreamResultsWrapper = previousLayer->getResultsWrapper();
+    } else if( lowLatency ) {
+        upstreamResultsWrapper = getLowLatencyUpstreamWrapper( cl );
     } else {
         float *upstreamResults = previousLayer->getResults();
-        upstreamResultsWrapper = cl->wrap( previousLayer->getResultsSize(), upstreamResults );
-        upstreamResultsWrapper->copyToDevice();
+        upstreamResultsWrapper = ZeroCopy::wrap( cl, previousLayer->getResultsSize(), upstreamResults );
+        ZeroCopy::copyToDevice( upstreamResultsWrapper );
     }
     poolingPropagateImpl->propagate( batchSize, upstreamResultsWrapper, selectorsWrapper, resultsWrapper );
-    if( !previousLayer->hasResultsWrapper() ) {
+    resultsCopiedToHost = false;
+    if( weOwnUpstreamWrapper ) {
         delete upstreamResultsWrapper;
     }
 
@@ -186,8 +260,8 @@ VIRTUAL void PoolingLayer::backProp( float learningRate ) {
     if( nextLayer->providesErrorsForUpstreamWrapper() ) {
         errorsWrapper = nextLayer->getErrorsForUpstreamWrapper();
     } else {
-        errorsWrapper = cl->wrap( getResultsSize(), nextLayer->getErrorsForUpstream() );
-        errorsWrapper->copyToDevice();
+        errorsWrapper = ZeroCopy::wrap( cl, getResultsSize(), nextLayer->getErrorsForUpstream() );
+        ZeroCopy::copyToDevice( errorsWrapper );
         weOwnErrorsWrapper = true;
     }
 
@@ -215,6 +289,7 @@ VIRTUAL void PoolingLayer::backProp( float learningRate ) {
 //    selectorsWrapper->copyToHost();
 
     poolingBackpropImpl->backpropErrors( batchSize, errorsWrapper, selectorsWrapper, errorsForUpstreamWrapper );
+    errorsForUpstreamCopiedToHost = false;
 
 //    errorsForUpstreamWrapper->copyToHost();
 //    float *errorsForUpstream = reinterpret_cast< float * >( errorsForUpstreamWrapper->getHostArray() );
@@ -236,7 +311,7 @@ VIRTUAL void PoolingLayer::backProp( float learningRate ) {
     }
 }
 VIRTUAL std::string PoolingLayer::asString() const {
-    return "PoolingLayer{ inputPlanes=" + toString(numPlanes) + " inputImageSize=" + toString(inputImageSize) + " poolingSize=" + toString( poolingSize ) + " }";
+    return "PoolingLayer{ inputPlanes=" + toString(numPlanes) + " inputImageSize=" + toString(inputImageSize) + " poolingSize=" + toString( poolingSize ) + ( fusedConv != 0 ? " fused" : "" ) + " }";
 }
 
 
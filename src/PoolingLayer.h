@@ -17,6 +17,7 @@ class PoolingPropagate;
 class PoolingBackprop;
 
 class PoolingMaker;
+class ConvolutionalLayer;
 
 class PoolingLayer : public Layer {
 public:
@@ -30,9 +31,10 @@ public:
     OpenCLHelper *const cl; // NOT owned by us
     PoolingPropagate *poolingPropagateImpl;
     PoolingBackprop *poolingBackpropImpl;
+    ConvolutionalLayer *fusedConv; // NOT owned by us; previous layer, if we are fused with it, else 0
 
     float *results;
-    int *selectors;
+    unsigned char *selectors; // index of the max within each pooling region
     float *errorsForUpstream;
 
     CLWrapper *resultsWrapper;
@@ -41,6 +43,7 @@ public:
 
     bool resultsCopiedToHost;
     bool errorsForUpstreamCopiedToHost;
+    bool selectorsInScratch; // selectors are an ActivationArena's shared scratch, NOT owned by us
 
     int batchSize;
     int allocatedSize;
@@ -54,6 +57,10 @@ public:
     VIRTUAL ~PoolingLayer();
     VIRTUAL std::string getClassName() const;
     VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL bool canUseArena() const;
+    VIRTUAL void setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper );
+    VIRTUAL int getScratchSize() const;
+    VIRTUAL void setScratchBuffer( unsigned char *scratch, CLWrapper *scratchWrapper );
     VIRTUAL int getResultsSize();
     VIRTUAL float *getResults();
     VIRTUAL bool needsBackProp();
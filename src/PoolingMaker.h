@@ -14,9 +14,11 @@ public:
 //    Layer *previousLayer;
     int _poolingSize;
     bool _padZeros;
+    bool _fused;
     PoolingMaker() :
         _poolingSize( 2 ),
-        _padZeros( false ) {
+        _padZeros( false ),
+        _fused( false ) {
     }
     PoolingMaker *poolingSize( int _poolingSize ) {
         this->_poolingSize = _poolingSize;
@@ -26,6 +28,12 @@ public:
         this->_padZeros = true;
         return this;
     }
+    // previous layer must be a ConvolutionalLayer; the conv and the pooling then
+    // happen in one pass, without writing out the conv results
+    PoolingMaker *fused() {
+        this->_fused = true;
+        return this;
+    }
     static PoolingMaker *instance() {
         return new PoolingMaker();
     }
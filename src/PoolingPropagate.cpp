@@ -27,6 +27,9 @@ PoolingPropagate::PoolingPropagate( OpenCLHelper *cl, bool padZeros, int numPlan
         inputImageSize( inputImageSize ),
         poolingSize( poolingSize ),
         outputImageSize( padZeros ? ( inputImageSize + poolingSize - 1 ) / poolingSize : inputImageSize / poolingSize ) {
+    if( poolingSize * poolingSize > 256 ) {
+        throw runtime_error("poolingSize " + toString( poolingSize ) + " too large: selectors are stored in one byte, so poolingSize can be at most 16" );
+    }
 //    if( inputImageSize % poolingSize != 0 ) {
 //        throw runtime_error("inputImageSize should be an exact multiple of poolingsize: " + toString( inputImageSize ) + " " + toString(poolingSize ) );
 //    }
@@ -51,7 +54,9 @@ STATIC PoolingPropagate *PoolingPropagate::instanceSpecific( int idx, OpenCLHelp
 VIRTUAL void PoolingPropagate::propagate( int batchSize, CLWrapper *inputData, CLWrapper *selectors, CLWrapper *outputData ) {
     throw runtime_error("propagate not implemented for this child type");
 }
-VIRTUAL void PoolingPropagate::propagate( int batchSize, float *input, int *selectors, float *output ) {
+// selectors are bytes: each one is the index of the max within its pooling
+// region, so less than poolingSize * poolingSize
+VIRTUAL void PoolingPropagate::propagate( int batchSize, float *input, unsigned char *selectors, float *output ) {
 //    cout << "PoolingPropagate::propagate( float * )" << endl;
     CLWrapper *inputWrapper = cl->wrap( getInputSize( batchSize ), input );
     CLWrapper *selectorsWrapper = cl->wrap( getResultsSize( batchSize ), selectors );
@@ -66,6 +71,16 @@ VIRTUAL void PoolingPropagate::propagate( int batchSize, float *input, int *sele
     delete selectorsWrapper;
     delete inputWrapper;
 }
+// for callers that keep their selectors as ints
+VIRTUAL void PoolingPropagate::propagate( int batchSize, float *input, int *selectors, float *output ) {
+    const int resultsSize = getResultsSize( batchSize );
+    unsigned char *byteSelectors = new unsigned char[ resultsSize ];
+    propagate( batchSize, input, byteSelectors, output );
+    for( int i = 0; i < resultsSize; i++ ) {
+        selectors[i] = byteSelectors[i];
+    }
+    delete[] byteSelectors;
+}
 VIRTUAL int PoolingPropagate::getInputSize( int batchSize ) {
     return batchSize * numPlanes * inputImageSize * inputImageSize;
 }
@@ -49,6 +49,7 @@ public:
     STATIC PoolingPropagate *instanceForTest( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize );
     STATIC PoolingPropagate *instanceSpecific( int idx, OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize );
     VIRTUAL void propagate( int batchSize, CLWrapper *inputData, CLWrapper *selectors, CLWrapper *outputData );
+    VIRTUAL void propagate( int batchSize, float *input, unsigned char *selectors, float *output );
     VIRTUAL void propagate( int batchSize, float *input, int *selectors, float *output );
     VIRTUAL int getInputSize( int batchSize );
     VIRTUAL int getResultsSize(int batchSize);
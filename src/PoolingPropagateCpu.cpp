@@ -6,10 +6,12 @@
 
 #include <iostream>
 #include <cstring>
+#include <stdexcept>
 
 #include "OpenCLHelper.h"
 
 #include "StatefulTimer.h"
+#include "ZeroCopy.h"
 
 #include "PoolingPropagateCpu.h"
 
@@ -26,27 +28,22 @@ PoolingPropagateCpu::PoolingPropagateCpu( OpenCLHelper *cl, bool padZeros, int n
 VIRTUAL void PoolingPropagateCpu::propagate( int batchSize, CLWrapper *inputWrapper, CLWrapper *selectorsWrapper, CLWrapper *outputWrapper ) {
 //    cout << "PoolingPropagateCpu::propagate( CLWrapper * )" << endl;
 
-    inputWrapper->copyToHost();
+    ZeroCopy::copyToHost( inputWrapper );
 
     float *input = reinterpret_cast<float *>( inputWrapper->getHostArray() );
-    int *selectors = new int[ getResultsSize( batchSize ) ];
-    float *output = new float[ getResultsSize( batchSize ) ];
+    if( selectorsWrapper->getElementSize() != 1 ) {
+        throw runtime_error("PoolingPropagateCpu::propagate: selectors should be unsigned chars");
+    }
+    unsigned char *selectors = reinterpret_cast<unsigned char *>( selectorsWrapper->getHostArray() );
+    float *output = reinterpret_cast<float *>( outputWrapper->getHostArray() );
 
+    // write straight into the wrappers' host arrays, no temporary copies
     propagate( batchSize, input, selectors, output );
 
-    int *selectorsHostArray = reinterpret_cast<int *>( selectorsWrapper->getHostArray() );
-    memcpy( selectorsHostArray, selectors, sizeof(int) * getResultsSize( batchSize ) );
-
-    float *outputHostArray = reinterpret_cast<float *>( outputWrapper->getHostArray() );
-    memcpy( outputHostArray, output, sizeof(float) * getResultsSize( batchSize ) );
-
-    selectorsWrapper->copyToDevice();
-    outputWrapper->copyToDevice();
-
-    delete[] selectors;
-    delete[] output;
+    ZeroCopy::copyToDevice( selectorsWrapper );
+    ZeroCopy::copyToDevice( outputWrapper );
 }
-VIRTUAL void PoolingPropagateCpu::propagate( int batchSize, float *input, int *selectors, float *output ) {
+VIRTUAL void PoolingPropagateCpu::propagate( int batchSize, float *input, unsigned char *selectors, float *output ) {
 //    float *output = new float[ getResultsSize( batchSize ) ];
 //    cout << "PoolingPropagateCpu::propagate( float * )" << endl;
     StatefulTimer::instance()->timeCheck("PoolingPropagateCpu::propagate start" );
@@ -71,7 +68,7 @@ VIRTUAL void PoolingPropagateCpu::propagate( int batchSize, float *input, int *s
                     }
                     int resultIndex = getResultIndex( n, plane, outputRow, outputCol );
                     output[ resultIndex ] = maxValue;
-                    selectors[ resultIndex ] = selector;
+                    selectors[ resultIndex ] = (unsigned char)selector;
                 }
             }
         }
@@ -13,6 +13,7 @@
 
 class PoolingPropagateCpu : public PoolingPropagate {
 public:
+    using PoolingPropagate::propagate;
 
     // [[[cog
     // import cog_addheaders
@@ -21,7 +22,7 @@ public:
     // generated, using cog:
     PoolingPropagateCpu( OpenCLHelper *cl, bool padZeros, int numPlanes, int inputImageSize, int poolingSize );
     VIRTUAL void propagate( int batchSize, CLWrapper *inputWrapper, CLWrapper *selectorsWrapper, CLWrapper *outputWrapper );
-    VIRTUAL void propagate( int batchSize, float *input, int *selectors, float *output );
+    VIRTUAL void propagate( int batchSize, float *input, unsigned char *selectors, float *output );
 
     // [[[end]]]
 };
@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <cstring>
+#include <stdexcept>
 
 #include "OpenCLHelper.h"
 
@@ -27,8 +28,11 @@ VIRTUAL PoolingPropagateGpuNaive::~PoolingPropagateGpuNaive() {
     delete kernel;
 }
 VIRTUAL void PoolingPropagateGpuNaive::propagate( int batchSize, CLWrapper *inputWrapper, CLWrapper *selectorsWrapper, CLWrapper *outputWrapper ) {
-//    cout << StatefulTimer::instance()->prefix << "PoolingPropagateGpuNaive::propagate( CLWrapper * )" << endl;
+//    cout << StatefulTimer::getPrefix() << "PoolingPropagateGpuNaive::propagate( CLWrapper * )" << endl;
     StatefulTimer::instance()->timeCheck("PoolingPropagateGpuNaive::propagate start" );
+    if( selectorsWrapper->getElementSize() != 1 ) {
+        throw runtime_error("PoolingPropagateGpuNaive::propagate: selectors should be unsigned chars");
+    }
 
     kernel->input( batchSize )->input( inputWrapper )->output( selectorsWrapper )->output( outputWrapper );
     int globalSize = batchSize * numPlanes * outputImageSize * outputImageSize;
@@ -68,7 +72,8 @@ PoolingPropagateGpuNaive::PoolingPropagateGpuNaive( OpenCLHelper *cl, bool padZe
     "// every plane is independent\n" 
     "// every example is independent\n" 
     "// so, globalid can be: [n][plane][outputRow][outputCol]\n" 
-    "kernel void propagateNaive( const int batchSize, global const float *input, global int *selectors, global float *output ) {\n" 
+    "// selectors are bytes, since they are less than gPoolingSize * gPoolingSize\n" 
+    "kernel void propagateNaive( const int batchSize, global const float *input, global uchar *selectors, global float *output ) {\n" 
     "    const int globalId = get_global_id(0);\n" 
     "\n" 
     "    const int intraImageOffset = globalId % gOutputImageSizeSquared;\n" 
@@ -102,7 +107,7 @@ PoolingPropagateGpuNaive::PoolingPropagateGpuNaive( OpenCLHelper *cl, bool padZe
     "        }\n" 
     "    }\n" 
     "    output[ globalId ] = maxValue;\n" 
-    "    selectors[ globalId ] = selector;\n" 
+    "    selectors[ globalId ] = (uchar)selector;\n" 
     "//    selectors[globalId] = 123;\n" 
     "}\n" 
     "\n" 
@@ -16,6 +16,8 @@
 #include "Propagate3_unfactorized.h"
 #include "Propagate4.h"
 #include "PropagateFc.h"
+#include "PropagateFcGemm.h"
+#include "PropagateFcGemv.h"
 #include "PropagateByInputPlane.h"
 #include "PropagateExperimental.h"
 #include "PropagateAuto.h"
@@ -56,13 +58,16 @@ STATIC Propagate *Propagate::instanceTest(OpenCLHelper *cl, LayerDimensions laye
     return new Propagate1( cl, layerDimensions, fn );
 }
 STATIC int Propagate::getNumImplementations() {
-    return 8;
+    return 10;
 }
 STATIC bool Propagate::plausiblyOptimal( int index, int batchSize, LayerDimensions dim, ActivationFunction const*fn ) {
     if( index == 0 ) { 
         return false;
     }
-    if( index > 7 ) {
+    if( index == 8 || index == 9 ) {
+        return dim.isFullyConnected();
+    }
+    if( index > 9 ) {
         return false;
     }
     return true;
@@ -89,6 +94,10 @@ STATIC Propagate *Propagate::instanceSpecific( int idx, OpenCLHelper *cl, LayerD
         return new PropagateByInputPlane( cl, layerDimensions, fn );
     } else if( idx == 7 ) {
         return new Propagate3_unfactorized( cl, layerDimensions, fn );
+    } else if( idx == 8 ) {
+        return new PropagateFcGemm( cl, layerDimensions, fn );
+    } else if( idx == 9 ) {
+        return new PropagateFcGemv( cl, layerDimensions, fn );
     } else if( idx == 99 ) {
         return new PropagateExperimental( cl, layerDimensions, fn );
     } else {
@@ -106,6 +115,10 @@ STATIC Propagate *Propagate::instanceSpecific( std::string name, OpenCLHelper *c
         return new Propagate4( cl, layerDimensions, fn );
     } else if( name == "fc" ) {
         return new PropagateFc( cl, layerDimensions, fn );
+    } else if( name == "fcgemm" ) {
+        return new PropagateFcGemm( cl, layerDimensions, fn );
+    } else if( name == "fcgemv" ) {
+        return new PropagateFcGemv( cl, layerDimensions, fn );
     } else if( name == "byinplane" ) {
         return new PropagateByInputPlane( cl, layerDimensions, fn );
     } else if( name == "exp" ) {
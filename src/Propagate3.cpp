@@ -83,7 +83,7 @@ Propagate3::Propagate3( OpenCLHelper *cl, LayerDimensions dim, ActivationFunctio
         throw runtime_error("cannot use propagate3, since outputimagesize * outputimagesize > maxworkgroupsize");
     }
 
-    std::string options = "-D " + fn->getDefineName();
+    std::string options = fn->getKernelDefines();
     options += dim.buildOptionsString();
 
     // [[[cog
@@ -230,13 +230,40 @@ Propagate3::Propagate3( OpenCLHelper *cl, LayerDimensions dim, ActivationFunctio
     "\n" 
     "// expected defines:\n" 
     "// one of: [ TANH | RELU | LINEAR | SIGMOID | SCALEDTANH ]\n" 
+    "// optional: FAST_MATH, to use approximations in place of tanh and exp\n" 
+    "\n" 
+    "#ifdef FAST_MATH\n" 
+    "// same approximation as FastMath::tanh, 13/6 rational, max error 5e-7\n" 
+    "float approx_tanh( float x ) {\n" 
+    "    x = clamp( x, -7.90531111f, 7.90531111f );\n" 
+    "    const float x2 = x * x;\n" 
+    "    float p = -2.76076847742355e-16f;\n" 
+    "    p = p * x2 + 2.00018790482477e-13f;\n" 
+    "    p = p * x2 - 8.60467152213735e-11f;\n" 
+    "    p = p * x2 + 5.12229709037114e-08f;\n" 
+    "    p = p * x2 + 1.48572235717979e-05f;\n" 
+    "    p = p * x2 + 6.37261928875436e-04f;\n" 
+    "    p = p * x2 + 4.89352455891786e-03f;\n" 
+    "    p = p * x;\n" 
+    "    float q = 1.19825839466702e-06f;\n" 
+    "    q = q * x2 + 1.18534705686654e-04f;\n" 
+    "    q = q * x2 + 2.26843463243900e-03f;\n" 
+    "    q = q * x2 + 4.89352518554385e-03f;\n" 
+    "    return p / q;\n" 
+    "}\n" 
+    "    #define TANH_FUNCTION(x) (approx_tanh(x))\n" 
+    "    #define SIGMOID_FUNCTION(x) (0.5f + 0.5f * approx_tanh(0.5f * (x)))\n" 
+    "#else\n" 
+    "    #define TANH_FUNCTION(x) (tanh(x))\n" 
+    "    #define SIGMOID_FUNCTION(x) (1.0f / (1 + exp(-(x))))\n" 
+    "#endif\n" 
     "\n" 
     "#ifdef TANH\n" 
-    "    #define ACTIVATION_FUNCTION(output) (tanh(output))\n" 
+    "    #define ACTIVATION_FUNCTION(output) (TANH_FUNCTION(output))\n" 
     "#elif defined SCALEDTANH\n" 
-    "    #define ACTIVATION_FUNCTION(output) ( 1.7159f * tanh( 0.66667f * output))\n" 
+    "    #define ACTIVATION_FUNCTION(output) ( 1.7159f * TANH_FUNCTION( 0.66667f * output))\n" 
     "#elif SIGMOID\n" 
-    "    #define ACTIVATION_FUNCTION(output) (1.0f / (1 + exp(-output)))\n" 
+    "    #define ACTIVATION_FUNCTION(output) (SIGMOID_FUNCTION(output))\n" 
     "#elif defined RELU\n" 
     "    #define ACTIVATION_FUNCTION(output) (output> 0 ? output : 0)\n" 
     "#elif defined LINEAR\n" 
@@ -71,7 +71,7 @@ VIRTUAL void PropagateAuto::propagate( int batchSize, CLWrapper *dataWrapper, CL
                 instances[thisIndex] = candidate;
                 valid[thisIndex] = true;
             } catch( runtime_error &e ) {
-                cout << StatefulTimer::instance()->prefix << "PropagateAuto: instance " << thisIndex << ": this instance cant be used: " << e.what() << endl;
+                cout << StatefulTimer::getPrefix() << "PropagateAuto: instance " << thisIndex << ": this instance cant be used: " << e.what() << endl;
                 valid[thisIndex] = false;
             }
             if( valid[thisIndex] ) {
@@ -79,10 +79,10 @@ VIRTUAL void PropagateAuto::propagate( int batchSize, CLWrapper *dataWrapper, CL
                 try {
                     candidate->propagate( batchSize, dataWrapper, weightsWrapper, biasWeightsWrapper, resultsWrapper );
                     milliseconds[thisIndex] = timer.lap();
-//                    cout << StatefulTimer::instance()->prefix << "PropagateAuto: instance " << thisIndex << " " << milliseconds[thisIndex] << "ms" << endl;
+//                    cout << StatefulTimer::getPrefix() << "PropagateAuto: instance " << thisIndex << " " << milliseconds[thisIndex] << "ms" << endl;
                     return;
                 } catch( runtime_error &e ) {
-                    cout << StatefulTimer::instance()->prefix << "PropagateAuto: instance " << thisIndex << " this instance cant be used: " << e.what() << endl;
+                    cout << StatefulTimer::getPrefix() << "PropagateAuto: instance " << thisIndex << " this instance cant be used: " << e.what() << endl;
                     valid[thisIndex] = false;
                     delete instances[thisIndex];
                     instances[thisIndex] = 0;
@@ -91,7 +91,7 @@ VIRTUAL void PropagateAuto::propagate( int batchSize, CLWrapper *dataWrapper, CL
         }
     }
     if( chosenIndex == -1 ) {
-        cout << StatefulTimer::instance()->prefix + "PropagateAuto::propagate choosing best instance:" << endl;
+        cout << StatefulTimer::getPrefix() + "PropagateAuto::propagate choosing best instance:" << endl;
         int bestIndex = -1;
         int bestTime = 0;
         for( int i = 0; i < num; i++ ) {
@@ -114,7 +114,7 @@ VIRTUAL void PropagateAuto::propagate( int batchSize, CLWrapper *dataWrapper, CL
             cout << "   selected: instance " << bestIndex << endl;
             this->chosenIndex = bestIndex;
         } else {
-            throw runtime_error(StatefulTimer::instance()->prefix + "No valid propagate implementations found" );
+            throw runtime_error(StatefulTimer::getPrefix() + "No valid propagate implementations found" );
         }
     }
 //    cout << "PropagateAuto::propagate using instance index: " << chosenIndex << endl;
@@ -5,6 +5,8 @@
 // obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "OpenCLHelper.h"
+#include "ZeroCopy.h"
+#include "Sgemm.h"
 
 #include "PropagateCpu.h"
 
@@ -20,13 +22,13 @@ PropagateCpu::PropagateCpu( OpenCLHelper *cl, LayerDimensions dim, ActivationFun
     {
 }
 VIRTUAL void PropagateCpu::propagate( int batchSize, CLWrapper *inputDataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper, CLWrapper *resultsWrapper ) {
-    inputDataWrapper->copyToHost();
-    weightsWrapper->copyToHost();
+    ZeroCopy::copyToHost( inputDataWrapper );
+    ZeroCopy::copyToHost( weightsWrapper );
 //    weightsWrapper->copyToHost();
   //  biasWeightsWrapper->copyToHost();
     float *biasWeights = 0;
     if( dim.biased ) {
-        biasWeightsWrapper->copyToHost();
+        ZeroCopy::copyToHost( biasWeightsWrapper );
         biasWeights =  (float *)biasWeightsWrapper->getHostArray();
     }
     float *results = propagate( batchSize, (float *)inputDataWrapper->getHostArray(), (float *)weightsWrapper->getHostArray(), biasWeights );
@@ -36,12 +38,26 @@ VIRTUAL void PropagateCpu::propagate( int batchSize, CLWrapper *inputDataWrapper
     for( int i = 0; i < resultsSize; i++ ) {
         hostArray[i] = results[i];
     }
-    resultsWrapper->copyToDevice();
+    ZeroCopy::copyToDevice( resultsWrapper );
     delete[] results;
 }
 VIRTUAL float *PropagateCpu::propagate( int batchSize, float *inputData, float *weights, float *biasWeights ) {
 //    cout << "PropagateCpu::propagate outputcubesize=" << dim.outputCubeSize << " batchSize=" << batchSize << endl;
     float *results = new float[ dim.outputCubeSize * batchSize ];
+    if( dim.isFullyConnected() ) {
+        // results[n][filter] = sum over k of inputData[n][k] * weights[filter][k]
+        Sgemm::sgemm( false, true, batchSize, dim.numFilters, dim.inputCubeSize, 1.0f, inputData, dim.inputCubeSize,
+            weights, dim.inputCubeSize, 0.0f, results, dim.numFilters );
+        if( dim.biased ) {
+            for( int n = 0; n < batchSize; n++ ) {
+                for( int filter = 0; filter < dim.numFilters; filter++ ) {
+                    results[ n * dim.numFilters + filter ] += biasWeights[filter];
+                }
+            }
+        }
+        fn->calcArray( batchSize * dim.numFilters, results );
+        return results;
+    }
     for( int n = 0; n < batchSize; n++ ) {
         for( int filter = 0; filter < dim.numFilters; filter++ ) {
             for( int outRow = 0; outRow < dim.outputImageSize; outRow += 1 + dim.skip ) {
@@ -85,7 +101,6 @@ VIRTUAL float *PropagateCpu::propagate( int batchSize, float *inputData, float *
                     if( dim.biased ) {
                         sum += biasWeights[filter];
                     }
-                    sum = fn->calc( sum );
                     int resultsIndex = ( ( n 
                         * dim.numFilters + filter ) 
                         * dim.outputImageSize + outRow )
@@ -97,6 +112,8 @@ VIRTUAL float *PropagateCpu::propagate( int batchSize, float *inputData, float *
             }
         }
     }
+    // activation over the whole batch at once, rather than once per output
+    fn->calcArray( batchSize * dim.outputCubeSize, results );
     return results;
 }
 
@@ -0,0 +1,32 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "Propagate.h"
+
+#define STATIC static
+#define VIRTUAL virtual
+
+// fully-connected propagate, as a tiled matrix multiply: results = images . weights^T
+// only handles layers where dim.isFullyConnected()
+class PropagateFcGemm : public Propagate {
+public:
+    CLKernel *kernel;
+    int tileSize;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    VIRTUAL ~PropagateFcGemm();
+    VIRTUAL void propagate( int batchSize, CLWrapper *dataWrapper, CLWrapper *weightsWrapper, CLWrapper *biasWeightsWrapper, CLWrapper *resultsWrapper );
+    PropagateFcGemm( OpenCLHelper *cl, LayerDimensions dim, ActivationFunction const*fn );
+
+    // [[[end]]]
+};
+
@@ -10,6 +10,7 @@
 #include "Layer.h"
 #include "RandomTranslations.h"
 #include "MyRandom.h"
+#include "ZeroCopy.h"
 #include "Translator.h"
 
 using namespace std;
@@ -41,8 +42,8 @@ RandomTranslations::RandomTranslations( Layer *previousLayer, RandomTranslations
     }
 }
 VIRTUAL RandomTranslations::~RandomTranslations() {
-    if( results != 0 ) {
-        delete[] results;
+    if( results != 0 && !resultsInArena ) {
+        ZeroCopy::deallocate( results );
     }
 }
 VIRTUAL std::string RandomTranslations::getClassName() const {
@@ -53,12 +54,28 @@ VIRTUAL void RandomTranslations::setBatchSize( int batchSize ) {
         this->batchSize = batchSize;
         return;
     }
+    if( resultsInArena ) {
+        throw runtime_error("layer " + toString(layerIndex) + ": results are in an arena planned for batch size " +
+            toString(allocatedSize) + ", cannot set batch size " + toString(batchSize) );
+    }
     if( results != 0 ) {
-        delete[] results;
+        ZeroCopy::deallocate( results );
+    }
+    this->batchSize = batchSize;
+    this->allocatedSize = batchSize;
+    results = ZeroCopy::allocateFloats( getResultsSize() );
+}
+VIRTUAL bool RandomTranslations::canUseArena() const {
+    return true;
+}
+VIRTUAL void RandomTranslations::setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper ) {
+    if( !resultsInArena && this->results != 0 ) {
+        ZeroCopy::deallocate( this->results );
     }
+    this->results = results;
+    this->resultsInArena = true;
     this->batchSize = batchSize;
     this->allocatedSize = batchSize;
-    results = new float[ getResultsSize() ];
 }
 VIRTUAL int RandomTranslations::getResultsSize() {
     return batchSize * numPlanes * outputImageSize * outputImageSize;
@@ -39,6 +39,8 @@ public:
     VIRTUAL ~RandomTranslations();
     VIRTUAL std::string getClassName() const;
     VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL bool canUseArena() const;
+    VIRTUAL void setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper );
     VIRTUAL int getResultsSize();
     VIRTUAL float *getResults();
     VIRTUAL bool needsBackProp();
@@ -0,0 +1,94 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <cstring>
+#include <stdexcept>
+
+#include "MyRandom.h"
+#include "stringhelper.h"
+
+#include "ResumeState.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+ResumeState::ResumeState() :
+        epoch( 1 ),
+        batch( 0 ),
+        numRight( 0 ),
+        loss( 0 ),
+        annealedLearningRate( 0 ) {
+}
+// the start of epoch
+ResumeState::ResumeState( int epoch ) :
+        epoch( epoch ),
+        batch( 0 ),
+        numRight( 0 ),
+        loss( 0 ),
+        annealedLearningRate( 0 ) {
+}
+// back to the start of epoch, keeping the permutation, for the learner to
+// reshuffle
+void ResumeState::startEpoch( int epoch, float annealedLearningRate ) {
+    this->epoch = epoch;
+    this->annealedLearningRate = annealedLearningRate;
+    batch = 0;
+    numRight = 0;
+    loss = 0;
+    randomState = "";
+}
+// epoch, batch and the totals go in the weights file header; the rest go in
+// a section of their own:
+// - int: length of the MyRandom state, int: permutation size
+// - the MyRandom state, in RandomStateSize bytes, so the size of the section
+//   only depends on the permutation
+// - the permutation
+int ResumeState::getSectionSize() const {
+    return 2 * 4 + RandomStateSize + (int)permutation.size() * 4;
+}
+// saves the state of MyRandom as it is now, rather than randomState.  target
+// should be getSectionSize() bytes
+void ResumeState::writeSection( char *target ) const {
+    writeSection( target, MyRandom::getState() );
+}
+// as above, but with the given MyRandom state, eg randomState, to pass on a
+// state just read from file
+void ResumeState::writeSection( char *target, std::string const &currentRandomState ) const {
+    if( (int)currentRandomState.size() > RandomStateSize ) {
+        throw runtime_error("ResumeState: random state is " + toString( currentRandomState.size() ) + " bytes, more than the " + toString( RandomStateSize ) + " allowed");
+    }
+    int *targetInts = reinterpret_cast< int * >( target );
+    targetInts[0] = (int)currentRandomState.size();
+    targetInts[1] = (int)permutation.size();
+    memset( target + 2 * 4, 0, RandomStateSize );
+    memcpy( target + 2 * 4, currentRandomState.c_str(), currentRandomState.size() );
+    if( permutation.size() > 0 ) {
+        memcpy( target + 2 * 4 + RandomStateSize, &permutation[0], permutation.size() * 4 );
+    }
+}
+void ResumeState::readSection( char const *source, int numBytes ) {
+    int const *sourceInts = reinterpret_cast< int const * >( source );
+    if( numBytes < 2 * 4 + RandomStateSize || sourceInts[0] < 0 || sourceInts[0] > RandomStateSize || sourceInts[1] < 0
+            || 2 * 4 + RandomStateSize + (long)sourceInts[1] * 4 != numBytes ) {
+        throw runtime_error("ResumeState: section of " + toString( numBytes ) + " bytes isnt valid");
+    }
+    randomState = std::string( source + 2 * 4, sourceInts[0] );
+    permutation.resize( sourceInts[1] );
+    if( sourceInts[1] > 0 ) {
+        memcpy( &permutation[0], source + 2 * 4 + RandomStateSize, sourceInts[1] * 4 );
+    }
+}
+// puts MyRandom back as it was when the state was saved, if it was
+void ResumeState::restoreRandom() const {
+    if( randomState != "" ) {
+        MyRandom::setState( randomState );
+    }
+}
+
@@ -0,0 +1,51 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+// how far training has got, so that it can carry on from exactly there, eg
+// after being preempted: the next batch of the epoch, the totals so far this
+// epoch, the state of MyRandom, which drives shuffling and the random
+// translations and patches, and the order of this epoch's examples, if the
+// learner shuffles
+// learners keep one up to date as they go, and hand it to PostBatchActions
+class DeepCL_EXPORT ResumeState {
+public:
+    static const int RandomStateSize = 8192; // enough for mt19937, as text
+
+    int epoch; // from 1
+    int batch; // batches of this epoch already learnt
+    int numRight; // so far this epoch
+    float loss; // so far this epoch
+    float annealedLearningRate;
+    std::vector< int > permutation; // empty if the learner doesnt shuffle
+    std::string randomState; // MyRandom, when the state was read from file
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    ResumeState();
+    ResumeState( int epoch );
+    void startEpoch( int epoch, float annealedLearningRate );
+    int getSectionSize() const;
+    void writeSection( char *target ) const;
+    void writeSection( char *target, std::string const &currentRandomState ) const;
+    void readSection( char const *source, int numBytes );
+    void restoreRandom() const;
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,297 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <exception>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include "stringhelper.h"
+
+#include "RingAllReduce.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+#ifdef _WIN32
+typedef int socklen_t;
+#endif
+
+// a peer going away should give a runtime_error, rather than SIGPIPE killing
+// the process.  on mac, there is no MSG_NOSIGNAL, see setNoSigPipe instead
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+STATIC RingAllReduce::SocketHandle RingAllReduce::invalidSocket() {
+    #ifdef _WIN32
+    return (SocketHandle)INVALID_SOCKET;
+    #else
+    return -1;
+    #endif
+}
+STATIC void RingAllReduce::closeSocket( SocketHandle socketHandle ) {
+    #ifdef _WIN32
+    closesocket( socketHandle );
+    #else
+    close( socketHandle );
+    #endif
+}
+STATIC void RingAllReduce::setNoDelay( SocketHandle socketHandle ) {
+    int flag = 1;
+    setsockopt( socketHandle, IPPROTO_TCP, TCP_NODELAY, (char const *)&flag, sizeof( flag ) );
+}
+STATIC void RingAllReduce::setNoSigPipe( SocketHandle socketHandle ) {
+    #ifdef SO_NOSIGPIPE
+    int flag = 1;
+    setsockopt( socketHandle, SOL_SOCKET, SO_NOSIGPIPE, (char const *)&flag, sizeof( flag ) );
+    #endif
+}
+// one attempt; returns invalidSocket() if host cant be resolved, or isnt listening
+STATIC RingAllReduce::SocketHandle RingAllReduce::connectTcp( std::string host, int port ) {
+    addrinfo hints;
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *address = 0;
+    if( getaddrinfo( host.c_str(), toString( port ).c_str(), &hints, &address ) != 0 ) {
+        return invalidSocket();
+    }
+    SocketHandle thisSocket = (SocketHandle)socket( AF_INET, SOCK_STREAM, 0 );
+    if( thisSocket != invalidSocket() && connect( thisSocket, address->ai_addr, (socklen_t)address->ai_addrlen ) != 0 ) {
+        closeSocket( thisSocket );
+        thisSocket = invalidSocket();
+    }
+    freeaddrinfo( address );
+    if( thisSocket != invalidSocket() ) {
+        setNoDelay( thisSocket );
+        setNoSigPipe( thisSocket );
+    }
+    return thisSocket;
+}
+// false if the connection was lost, part way or before starting
+STATIC bool RingAllReduce::sendAllTo( SocketHandle socketHandle, char const *data, int numBytes ) {
+    while( numBytes > 0 ) {
+        const int numSent = (int)send( socketHandle, data, numBytes, SEND_FLAGS );
+        if( numSent <= 0 ) {
+            return false;
+        }
+        data += numSent;
+        numBytes -= numSent;
+    }
+    return true;
+}
+STATIC bool RingAllReduce::receiveAllFrom( SocketHandle socketHandle, char *data, int numBytes ) {
+    while( numBytes > 0 ) {
+        const int numReceived = (int)recv( socketHandle, data, numBytes, 0 );
+        if( numReceived <= 0 ) {
+            return false;
+        }
+        data += numReceived;
+        numBytes -= numReceived;
+    }
+    return true;
+}
+STATIC std::vector< std::string > RingAllReduce::localHosts( int worldSize ) {
+    return std::vector< std::string >( worldSize, "127.0.0.1" );
+}
+// returns once the whole ring is connected.  waits up to a minute for the
+// other ranks to start listening
+RingAllReduce::RingAllReduce( int rank, int worldSize, std::vector< std::string > hosts, int basePort ) :
+        rank( rank ),
+        worldSize( worldSize ),
+        listenSocket( invalidSocket() ),
+        nextSocket( invalidSocket() ),
+        previousSocket( invalidSocket() ) {
+    if( worldSize < 1 || rank < 0 || rank >= worldSize ) {
+        throw runtime_error("RingAllReduce: rank " + toString( rank ) + " not valid for worldsize " + toString( worldSize ) );
+    }
+    if( (int)hosts.size() != worldSize ) {
+        throw runtime_error("RingAllReduce: need one host per rank, but have " + toString( hosts.size() ) + " hosts for worldsize " + toString( worldSize ) );
+    }
+    if( worldSize == 1 ) {
+        return;
+    }
+    #ifdef _WIN32
+    WSADATA wsaData;
+    WSAStartup( MAKEWORD( 2, 2 ), &wsaData );
+    #endif
+
+    listenSocket = (SocketHandle)socket( AF_INET, SOCK_STREAM, 0 );
+    if( listenSocket == invalidSocket() ) {
+        throw runtime_error("RingAllReduce: couldnt create socket");
+    }
+    int reuse = 1;
+    setsockopt( listenSocket, SOL_SOCKET, SO_REUSEADDR, (char const *)&reuse, sizeof( reuse ) );
+    sockaddr_in listenAddress;
+    memset( &listenAddress, 0, sizeof( listenAddress ) );
+    listenAddress.sin_family = AF_INET;
+    listenAddress.sin_addr.s_addr = htonl( INADDR_ANY );
+    listenAddress.sin_port = htons( (unsigned short)( basePort + rank ) );
+    if( ::bind( listenSocket, (sockaddr *)&listenAddress, sizeof( listenAddress ) ) != 0
+            || listen( listenSocket, 1 ) != 0 ) {
+        closeAll();
+        throw runtime_error("RingAllReduce: rank " + toString( rank ) + " couldnt listen on port " + toString( basePort + rank ) );
+    }
+
+    // connecting doesnt wait for the next rank to accept, so every rank can
+    // connect first, then accept
+    const int nextRank = ( rank + 1 ) % worldSize;
+    for( int attempt = 0; attempt < 600 && nextSocket == invalidSocket(); attempt++ ) {
+        nextSocket = connectTcp( hosts[nextRank], basePort + nextRank );
+        if( nextSocket == invalidSocket() ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        }
+    }
+    if( nextSocket == invalidSocket() ) {
+        closeAll();
+        throw runtime_error("RingAllReduce: rank " + toString( rank ) + " couldnt connect to rank " + toString( nextRank ) + " at " + hosts[nextRank] );
+    }
+    sendAll( (char const *)&rank, sizeof( rank ) );
+
+    previousSocket = (SocketHandle)accept( listenSocket, 0, 0 );
+    if( previousSocket == invalidSocket() ) {
+        closeAll();
+        throw runtime_error("RingAllReduce: rank " + toString( rank ) + " accept failed" );
+    }
+    setNoDelay( previousSocket );
+    setNoSigPipe( previousSocket );
+    int previousRank = -1;
+    receiveAll( (char *)&previousRank, sizeof( previousRank ) );
+    if( previousRank != ( rank + worldSize - 1 ) % worldSize ) {
+        closeAll();
+        throw runtime_error("RingAllReduce: rank " + toString( rank ) + " expected a connection from rank " +
+            toString( ( rank + worldSize - 1 ) % worldSize ) + " but got one from rank " + toString( previousRank ) );
+    }
+}
+RingAllReduce::~RingAllReduce() {
+    closeAll();
+}
+int RingAllReduce::getRank() const {
+    return rank;
+}
+int RingAllReduce::getWorldSize() const {
+    return worldSize;
+}
+// data is replaced by the sum of data over all ranks.  every rank must call
+// this, with the same N
+void RingAllReduce::allReduce( float *data, int N ) {
+    if( worldSize == 1 || N == 0 ) {
+        return;
+    }
+    // chunk c is [ N * c / worldSize, N * ( c + 1 ) / worldSize )
+    auto chunkBegin = [this, N]( int chunk ) {
+        return (int)( (long long)N * chunk / worldSize );
+    };
+    auto chunkSize = [&chunkBegin]( int chunk ) {
+        return chunkBegin( chunk + 1 ) - chunkBegin( chunk );
+    };
+    receiveBuffer.resize( N / worldSize + 1 );
+    // reduce-scatter: after step s, chunk ( rank - s - 1 ) holds the sum over
+    // ranks rank - s - 1 ... rank.  at the end, we hold the total of chunk rank + 1
+    for( int step = 0; step < worldSize - 1; step++ ) {
+        const int sendChunk = ( rank - step + worldSize ) % worldSize;
+        const int receiveChunk = ( rank - step - 1 + worldSize ) % worldSize;
+        sendAndReceive( data + chunkBegin( sendChunk ), chunkSize( sendChunk ),
+            &receiveBuffer[0], chunkSize( receiveChunk ) );
+        float *target = data + chunkBegin( receiveChunk );
+        float const *received = &receiveBuffer[0];
+        const int receiveSize = chunkSize( receiveChunk );
+        for( int i = 0; i < receiveSize; i++ ) {
+            target[i] += received[i];
+        }
+    }
+    // all-gather: pass the totals round the ring
+    for( int step = 0; step < worldSize - 1; step++ ) {
+        const int sendChunk = ( rank + 1 - step + worldSize ) % worldSize;
+        const int receiveChunk = ( rank - step + worldSize ) % worldSize;
+        sendAndReceive( data + chunkBegin( sendChunk ), chunkSize( sendChunk ),
+            data + chunkBegin( receiveChunk ), chunkSize( receiveChunk ) );
+    }
+}
+// data on every rank is replaced by data on rank 0
+void RingAllReduce::broadcastFromRank0( float *data, int N ) {
+    broadcastBytesFromRank0( (char *)data, N * (int)sizeof( float ) );
+}
+// as above, for anything else, eg where to resume training from
+void RingAllReduce::broadcastBytesFromRank0( char *data, int numBytes ) {
+    if( worldSize == 1 ) {
+        return;
+    }
+    if( rank != 0 ) {
+        receiveAll( data, numBytes );
+    }
+    if( rank != worldSize - 1 ) {
+        sendAll( data, numBytes );
+    }
+}
+// sends to the next rank, while receiving from the previous one, so that
+// large chunks cant deadlock the ring, with every rank stuck sending
+void RingAllReduce::sendAndReceive( float const *sendData, int numSend, float *receiveData, int numReceive ) {
+    std::exception_ptr sendError;
+    std::thread sender( [this, sendData, numSend, &sendError]() {
+        try {
+            sendAll( (char const *)sendData, numSend * (int)sizeof( float ) );
+        } catch( ... ) {
+            sendError = std::current_exception();
+        }
+    } );
+    try {
+        receiveAll( (char *)receiveData, numReceive * (int)sizeof( float ) );
+    } catch( ... ) {
+        sender.join();
+        throw;
+    }
+    sender.join();
+    if( sendError ) {
+        std::rethrow_exception( sendError );
+    }
+}
+void RingAllReduce::sendAll( char const *data, int numBytes ) {
+    if( !sendAllTo( nextSocket, data, numBytes ) ) {
+        throw runtime_error("RingAllReduce: rank " + toString( rank ) + " lost connection to the next rank");
+    }
+}
+void RingAllReduce::receiveAll( char *data, int numBytes ) {
+    if( !receiveAllFrom( previousSocket, data, numBytes ) ) {
+        throw runtime_error("RingAllReduce: rank " + toString( rank ) + " lost connection to the previous rank");
+    }
+}
+void RingAllReduce::closeAll() {
+    if( nextSocket != invalidSocket() ) {
+        closeSocket( nextSocket );
+        nextSocket = invalidSocket();
+    }
+    if( previousSocket != invalidSocket() ) {
+        closeSocket( previousSocket );
+        previousSocket = invalidSocket();
+    }
+    if( listenSocket != invalidSocket() ) {
+        closeSocket( listenSocket );
+        listenSocket = invalidSocket();
+    }
+}
+
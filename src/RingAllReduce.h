@@ -0,0 +1,65 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// sums arrays of floats across worldSize processes, connected in a ring over tcp:
+// each rank listens on basePort + rank, and connects to the next rank.  allReduce
+// is the usual two pass ring: reduce-scatter, then all-gather, so each rank
+// sends and receives about 2 * N floats, whatever the number of ranks, and every
+// rank ends up with exactly the same bytes
+// hosts has one entry per rank; for testing, all ranks can be on 127.0.0.1
+class DeepCL_EXPORT RingAllReduce {
+public:
+    #ifdef _WIN32
+    typedef unsigned long long SocketHandle; // SOCKET
+    #else
+    typedef int SocketHandle;
+    #endif
+
+    int rank;
+    int worldSize;
+    SocketHandle listenSocket;
+    SocketHandle nextSocket; // we send to rank + 1
+    SocketHandle previousSocket; // we receive from rank - 1
+    std::vector< float > receiveBuffer;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    STATIC SocketHandle invalidSocket();
+    STATIC void closeSocket( SocketHandle socketHandle );
+    STATIC void setNoDelay( SocketHandle socketHandle );
+    STATIC void setNoSigPipe( SocketHandle socketHandle );
+    STATIC SocketHandle connectTcp( std::string host, int port );
+    STATIC bool sendAllTo( SocketHandle socketHandle, char const *data, int numBytes );
+    STATIC bool receiveAllFrom( SocketHandle socketHandle, char *data, int numBytes );
+    STATIC std::vector< std::string > localHosts( int worldSize );
+    RingAllReduce( int rank, int worldSize, std::vector< std::string > hosts, int basePort );
+    ~RingAllReduce();
+    int getRank() const;
+    int getWorldSize() const;
+    void allReduce( float *data, int N );
+    void broadcastFromRank0( float *data, int N );
+    void broadcastBytesFromRank0( char *data, int numBytes );
+    void sendAndReceive( float const *sendData, int numSend, float *receiveData, int numReceive );
+    void sendAll( char const *data, int numBytes );
+    void receiveAll( char *data, int numBytes );
+    void closeAll();
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,76 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <algorithm>
+
+#include "Sgemm.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+// blocks sized so that a block of each of A, B and C stays in L2 together
+#define SGEMM_BLOCK_M 64
+#define SGEMM_BLOCK_N 256
+#define SGEMM_BLOCK_K 128
+
+STATIC void Sgemm::sgemm( bool transA, bool transB, int M, int N, int K, float alpha, float const *A, int lda,
+        float const *B, int ldb, float beta, float *C, int ldc ) {
+    if( beta != 1.0f ) {
+        for( int i = 0; i < M; i++ ) {
+            float *Crow = C + i * ldc;
+            for( int j = 0; j < N; j++ ) {
+                Crow[j] = beta == 0.0f ? 0.0f : beta * Crow[j]; // beta 0 overwrites, even if C had nans
+            }
+        }
+    }
+    for( int i0 = 0; i0 < M; i0 += SGEMM_BLOCK_M ) {
+        const int i1 = min( M, i0 + SGEMM_BLOCK_M );
+        for( int p0 = 0; p0 < K; p0 += SGEMM_BLOCK_K ) {
+            const int p1 = min( K, p0 + SGEMM_BLOCK_K );
+            for( int j0 = 0; j0 < N; j0 += SGEMM_BLOCK_N ) {
+                const int j1 = min( N, j0 + SGEMM_BLOCK_N );
+                if( transB ) {
+                    // rows of B run along K, so take dot products
+                    for( int i = i0; i < i1; i++ ) {
+                        float *Crow = C + i * ldc;
+                        for( int j = j0; j < j1; j++ ) {
+                            float const *Brow = B + j * ldb;
+                            float sum = 0;
+                            if( transA ) {
+                                for( int p = p0; p < p1; p++ ) {
+                                    sum += A[ p * lda + i ] * Brow[p];
+                                }
+                            } else {
+                                float const *Arow = A + i * lda;
+                                for( int p = p0; p < p1; p++ ) {
+                                    sum += Arow[p] * Brow[p];
+                                }
+                            }
+                            Crow[j] += alpha * sum;
+                        }
+                    }
+                } else {
+                    // rows of B run along N, so accumulate scaled rows of B into rows of C
+                    for( int i = i0; i < i1; i++ ) {
+                        float *Crow = C + i * ldc;
+                        for( int p = p0; p < p1; p++ ) {
+                            const float a = alpha * ( transA ? A[ p * lda + i ] : A[ i * lda + p ] );
+                            float const *Brow = B + p * ldb;
+                            for( int j = j0; j < j1; j++ ) {
+                                Crow[j] += a * Brow[j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
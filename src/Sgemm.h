@@ -0,0 +1,32 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+// host-side single precision matrix multiply, for the cpu fully-connected path
+// all matrices are row-major:
+//     C = alpha * op(A) . op(B) + beta * C
+// where op(A) is M x K, op(B) is K x N, and C is M x N
+// lda, ldb, ldc are the row strides of A, B, C, as stored
+class DeepCL_EXPORT Sgemm {
+public:
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    STATIC void sgemm( bool transA, bool transB, int M, int N, int K, float alpha, float const *A, int lda,
+    float const *B, int ldb, float beta, float *C, int ldc );
+
+    // [[[end]]]
+};
+
@@ -4,7 +4,14 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "OpenCLHelper.h"
 #include "StatefulTimer.h"
+#include "ZeroCopy.h"
+#include "FastMath.h"
 
 #include "LayerMaker.h"
 #include "SoftMaxLayer.h"
@@ -18,80 +25,589 @@ using namespace std;
 
 SoftMaxLayer::SoftMaxLayer( Layer *previousLayer, SoftMaxMaker *maker ) :
     LossLayer( previousLayer, maker ),
+        cl( maker->cl ),
         perPlane( maker->_perPlane ),
+        fastMath( maker->_fastMath ),
         imageSize( previousLayer->getOutputImageSize() ),
         numPlanes( previousLayer->getOutputPlanes() ),
         imageSizeSquared( previousLayer->getOutputImageSize() * previousLayer->getOutputImageSize() ),
+        groupSize( maker->_perPlane ? imageSizeSquared : numPlanes ),
+        groupsPerExample( maker->_perPlane ? numPlanes : 1 ),
+        kernelPropagate( 0 ),
+        kernelFromLabels( 0 ),
+        workgroupSize( 0 ),
         results( 0 ),
         errorsForUpstream( 0 ),
+        resultsWrapper( 0 ),
+        errorsForUpstreamWrapper( 0 ),
+        logSumExps( 0 ),
+        logSumExpsWrapper( 0 ),
+        groupLabels( 0 ),
+        groupLabelsWrapper( 0 ),
+        groupLosses( 0 ),
+        groupLossesWrapper( 0 ),
+        groupRights( 0 ),
+        groupRightsWrapper( 0 ),
         allocatedSize( 0 ),
-        batchSize( 0 )
+        batchSize( 0 ),
+        onDevice( false ),
+        resultsCopiedToHost( true ),
+        errorsForUpstreamCopiedToHost( true ),
+        haveLogits( true ),
+        labelResultsValid( false ),
+        loss( 0 ),
+        numRight( 0 )
          {
+    // if the logits are on the gpu, keep them there
+    if( cl != 0 && previousLayer->hasResultsWrapper() ) {
+        workgroupSize = std::min( cl->getNextPower2( groupSize ), cl->getMaxWorkgroupSize() );
+        std::string options = "";
+        options += " -DgGroupSize=" + ::toString( groupSize );
+        options += " -DgWorkgroupSize=" + ::toString( workgroupSize );
+        if( fastMath ) {
+            options += " -D FAST_MATH";
+        }
+        // [[[cog
+        // import stringify
+        // stringify.write_kernel2( "kernelPropagate", "cl/softmax.cl", "softmax_propagate", 'options' )
+        // stringify.write_kernel2( "kernelFromLabels", "cl/softmax.cl", "softmax_from_labels", 'options' )
+        // ]]]
+        // generated using cog, from cl/softmax.cl:
+        const char * kernelPropagateSource =  
+        "// Copyright Hugh Perkins 2015 hughperkins at gmail\n" 
+        "//\n" 
+        "// This Source Code Form is subject to the terms of the Mozilla Public License,\n" 
+        "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n" 
+        "// obtain one at http://mozilla.org/MPL/2.0/.\n" 
+        "\n" 
+        "// expected defines:\n" 
+        "//  - gGroupSize: number of values each softmax is taken over, ie numPlanes for\n" 
+        "//    per-column softmax, or imageSize * imageSize for per-plane softmax\n" 
+        "//  - gWorkgroupSize: power of 2\n" 
+        "//  - optional: FAST_MATH, to use approximations in place of exp and log\n" 
+        "//\n" 
+        "// one workgroup per softmax group, ie per [n] for per-column, or per [n][plane]\n" 
+        "// for per-plane, and each thread strides over the values of the group\n" 
+        "// logits, results, errorsForUpstream: [group][i]\n" 
+        "// labels, logSumExps, losses, rights: [group]\n" 
+        "\n" 
+        "#ifdef FAST_MATH\n" 
+        "// same approximation as FastMath::exp, max relative error 1e-5\n" 
+        "float approx_exp( float x ) {\n" 
+        "    x = clamp( x, -87.0f, 88.0f );\n" 
+        "    const float t = x * 1.44269504f;\n" 
+        "    const int n = (int)( t + ( t >= 0 ? 0.5f : -0.5f ) );\n" 
+        "    const float f = ( t - n ) * 0.693147181f;\n" 
+        "    const float p = 1.0f + f * ( 1.0f + f * ( 0.5f + f * ( 0.166666667f + f * ( 0.0416666667f\n" 
+        "        + f * 0.00833333333f ) ) ) );\n" 
+        "    return p * as_float( ( n + 127 ) << 23 );\n" 
+        "}\n" 
+        "    #define EXP(x) (approx_exp(x))\n" 
+        "    #define LOG(x) (native_log(x))\n" 
+        "#else\n" 
+        "    #define EXP(x) (exp(x))\n" 
+        "    #define LOG(x) (log(x))\n" 
+        "#endif\n" 
+        "\n" 
+        "// returns the max over the workgroup, to all threads\n" 
+        "float reduceMax( local float *_reduce, float value ) {\n" 
+        "    const int localId = get_local_id(0);\n" 
+        "    _reduce[localId] = value;\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {\n" 
+        "        if( localId < offset ) {\n" 
+        "            _reduce[localId] = max( _reduce[localId], _reduce[localId + offset] );\n" 
+        "        }\n" 
+        "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    }\n" 
+        "    const float result = _reduce[0];\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    return result;\n" 
+        "}\n" 
+        "\n" 
+        "// returns the sum over the workgroup, to all threads\n" 
+        "float reduceSum( local float *_reduce, float value ) {\n" 
+        "    const int localId = get_local_id(0);\n" 
+        "    _reduce[localId] = value;\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {\n" 
+        "        if( localId < offset ) {\n" 
+        "            _reduce[localId] += _reduce[localId + offset];\n" 
+        "        }\n" 
+        "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    }\n" 
+        "    const float result = _reduce[0];\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    return result;\n" 
+        "}\n" 
+        "\n" 
+        "// results = exp( logits - logsumexp( logits ) ), and keeps the logsumexp, for the loss\n" 
+        "kernel void softmax_propagate( const int numGroups,\n" 
+        "        global const float *logits, global float *results, global float *logSumExps ) {\n" 
+        "    local float _reduce[gWorkgroupSize];\n" 
+        "    const int group = get_group_id(0);\n" 
+        "    const int localId = get_local_id(0);\n" 
+        "    if( group >= numGroups ) { // whole workgroup returns together\n" 
+        "        return;\n" 
+        "    }\n" 
+        "    global const float *groupLogits = logits + group * gGroupSize;\n" 
+        "\n" 
+        "    float thisMax = - INFINITY;\n" 
+        "    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {\n" 
+        "        thisMax = max( thisMax, groupLogits[i] );\n" 
+        "    }\n" 
+        "    const float maxValue = reduceMax( _reduce, thisMax );\n" 
+        "    float thisSum = 0;\n" 
+        "    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {\n" 
+        "        thisSum += EXP( groupLogits[i] - maxValue );\n" 
+        "    }\n" 
+        "    const float logSumExp = maxValue + LOG( reduceSum( _reduce, thisSum ) );\n" 
+        "    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {\n" 
+        "        results[ group * gGroupSize + i ] = EXP( groupLogits[i] - logSumExp );\n" 
+        "    }\n" 
+        "    if( localId == 0 ) {\n" 
+        "        logSumExps[group] = logSumExp;\n" 
+        "    }\n" 
+        "}\n" 
+        "\n" 
+        "// one pass giving, for each group:\n" 
+        "// - errorsForUpstream = results - onehot( label )\n" 
+        "// - losses = - log( softmax[label] ) = logsumexp - logits[label]\n" 
+        "// - rights = 1 if argmax of results is label, else 0.  ties go to the lowest index\n" 
+        "// labels should already have been checked to be in range\n" 
+        "kernel void softmax_from_labels( const int numGroups, global const int *labels,\n" 
+        "        global const float *logits, global const float *results, global const float *logSumExps,\n" 
+        "        global float *errorsForUpstream, global float *losses, global int *rights ) {\n" 
+        "    local float _values[gWorkgroupSize];\n" 
+        "    local int _indices[gWorkgroupSize];\n" 
+        "    const int group = get_group_id(0);\n" 
+        "    const int localId = get_local_id(0);\n" 
+        "    if( group >= numGroups ) {\n" 
+        "        return;\n" 
+        "    }\n" 
+        "    const int label = labels[group];\n" 
+        "    const int groupOffset = group * gGroupSize;\n" 
+        "\n" 
+        "    float bestValue = - INFINITY;\n" 
+        "    int bestIndex = gGroupSize;\n" 
+        "    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {\n" 
+        "        const float result = results[ groupOffset + i ];\n" 
+        "        errorsForUpstream[ groupOffset + i ] = i == label ? result - 1.0f : result;\n" 
+        "        if( result > bestValue ) { // i is increasing, so first max wins\n" 
+        "            bestValue = result;\n" 
+        "            bestIndex = i;\n" 
+        "        }\n" 
+        "    }\n" 
+        "    _values[localId] = bestValue;\n" 
+        "    _indices[localId] = bestIndex;\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {\n" 
+        "        if( localId < offset ) {\n" 
+        "            const float otherValue = _values[localId + offset];\n" 
+        "            const int otherIndex = _indices[localId + offset];\n" 
+        "            if( otherValue > _values[localId] || ( otherValue == _values[localId] && otherIndex < _indices[localId] ) ) {\n" 
+        "                _values[localId] = otherValue;\n" 
+        "                _indices[localId] = otherIndex;\n" 
+        "            }\n" 
+        "        }\n" 
+        "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    }\n" 
+        "    if( localId == 0 ) {\n" 
+        "        losses[group] = logSumExps[group] - logits[ groupOffset + label ];\n" 
+        "        rights[group] = _indices[0] == label ? 1 : 0;\n" 
+        "    }\n" 
+        "}\n" 
+        "\n" 
+        "";
+        kernelPropagate = cl->buildKernelFromString( kernelPropagateSource, "softmax_propagate", options, "cl/softmax.cl" );
+        // generated using cog, from cl/softmax.cl:
+        const char * kernelFromLabelsSource =  
+        "// Copyright Hugh Perkins 2015 hughperkins at gmail\n" 
+        "//\n" 
+        "// This Source Code Form is subject to the terms of the Mozilla Public License,\n" 
+        "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n" 
+        "// obtain one at http://mozilla.org/MPL/2.0/.\n" 
+        "\n" 
+        "// expected defines:\n" 
+        "//  - gGroupSize: number of values each softmax is taken over, ie numPlanes for\n" 
+        "//    per-column softmax, or imageSize * imageSize for per-plane softmax\n" 
+        "//  - gWorkgroupSize: power of 2\n" 
+        "//  - optional: FAST_MATH, to use approximations in place of exp and log\n" 
+        "//\n" 
+        "// one workgroup per softmax group, ie per [n] for per-column, or per [n][plane]\n" 
+        "// for per-plane, and each thread strides over the values of the group\n" 
+        "// logits, results, errorsForUpstream: [group][i]\n" 
+        "// labels, logSumExps, losses, rights: [group]\n" 
+        "\n" 
+        "#ifdef FAST_MATH\n" 
+        "// same approximation as FastMath::exp, max relative error 1e-5\n" 
+        "float approx_exp( float x ) {\n" 
+        "    x = clamp( x, -87.0f, 88.0f );\n" 
+        "    const float t = x * 1.44269504f;\n" 
+        "    const int n = (int)( t + ( t >= 0 ? 0.5f : -0.5f ) );\n" 
+        "    const float f = ( t - n ) * 0.693147181f;\n" 
+        "    const float p = 1.0f + f * ( 1.0f + f * ( 0.5f + f * ( 0.166666667f + f * ( 0.0416666667f\n" 
+        "        + f * 0.00833333333f ) ) ) );\n" 
+        "    return p * as_float( ( n + 127 ) << 23 );\n" 
+        "}\n" 
+        "    #define EXP(x) (approx_exp(x))\n" 
+        "    #define LOG(x) (native_log(x))\n" 
+        "#else\n" 
+        "    #define EXP(x) (exp(x))\n" 
+        "    #define LOG(x) (log(x))\n" 
+        "#endif\n" 
+        "\n" 
+        "// returns the max over the workgroup, to all threads\n" 
+        "float reduceMax( local float *_reduce, float value ) {\n" 
+        "    const int localId = get_local_id(0);\n" 
+        "    _reduce[localId] = value;\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {\n" 
+        "        if( localId < offset ) {\n" 
+        "            _reduce[localId] = max( _reduce[localId], _reduce[localId + offset] );\n" 
+        "        }\n" 
+        "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    }\n" 
+        "    const float result = _reduce[0];\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    return result;\n" 
+        "}\n" 
+        "\n" 
+        "// returns the sum over the workgroup, to all threads\n" 
+        "float reduceSum( local float *_reduce, float value ) {\n" 
+        "    const int localId = get_local_id(0);\n" 
+        "    _reduce[localId] = value;\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {\n" 
+        "        if( localId < offset ) {\n" 
+        "            _reduce[localId] += _reduce[localId + offset];\n" 
+        "        }\n" 
+        "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    }\n" 
+        "    const float result = _reduce[0];\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    return result;\n" 
+        "}\n" 
+        "\n" 
+        "// results = exp( logits - logsumexp( logits ) ), and keeps the logsumexp, for the loss\n" 
+        "kernel void softmax_propagate( const int numGroups,\n" 
+        "        global const float *logits, global float *results, global float *logSumExps ) {\n" 
+        "    local float _reduce[gWorkgroupSize];\n" 
+        "    const int group = get_group_id(0);\n" 
+        "    const int localId = get_local_id(0);\n" 
+        "    if( group >= numGroups ) { // whole workgroup returns together\n" 
+        "        return;\n" 
+        "    }\n" 
+        "    global const float *groupLogits = logits + group * gGroupSize;\n" 
+        "\n" 
+        "    float thisMax = - INFINITY;\n" 
+        "    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {\n" 
+        "        thisMax = max( thisMax, groupLogits[i] );\n" 
+        "    }\n" 
+        "    const float maxValue = reduceMax( _reduce, thisMax );\n" 
+        "    float thisSum = 0;\n" 
+        "    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {\n" 
+        "        thisSum += EXP( groupLogits[i] - maxValue );\n" 
+        "    }\n" 
+        "    const float logSumExp = maxValue + LOG( reduceSum( _reduce, thisSum ) );\n" 
+        "    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {\n" 
+        "        results[ group * gGroupSize + i ] = EXP( groupLogits[i] - logSumExp );\n" 
+        "    }\n" 
+        "    if( localId == 0 ) {\n" 
+        "        logSumExps[group] = logSumExp;\n" 
+        "    }\n" 
+        "}\n" 
+        "\n" 
+        "// one pass giving, for each group:\n" 
+        "// - errorsForUpstream = results - onehot( label )\n" 
+        "// - losses = - log( softmax[label] ) = logsumexp - logits[label]\n" 
+        "// - rights = 1 if argmax of results is label, else 0.  ties go to the lowest index\n" 
+        "// labels should already have been checked to be in range\n" 
+        "kernel void softmax_from_labels( const int numGroups, global const int *labels,\n" 
+        "        global const float *logits, global const float *results, global const float *logSumExps,\n" 
+        "        global float *errorsForUpstream, global float *losses, global int *rights ) {\n" 
+        "    local float _values[gWorkgroupSize];\n" 
+        "    local int _indices[gWorkgroupSize];\n" 
+        "    const int group = get_group_id(0);\n" 
+        "    const int localId = get_local_id(0);\n" 
+        "    if( group >= numGroups ) {\n" 
+        "        return;\n" 
+        "    }\n" 
+        "    const int label = labels[group];\n" 
+        "    const int groupOffset = group * gGroupSize;\n" 
+        "\n" 
+        "    float bestValue = - INFINITY;\n" 
+        "    int bestIndex = gGroupSize;\n" 
+        "    for( int i = localId; i < gGroupSize; i += gWorkgroupSize ) {\n" 
+        "        const float result = results[ groupOffset + i ];\n" 
+        "        errorsForUpstream[ groupOffset + i ] = i == label ? result - 1.0f : result;\n" 
+        "        if( result > bestValue ) { // i is increasing, so first max wins\n" 
+        "            bestValue = result;\n" 
+        "            bestIndex = i;\n" 
+        "        }\n" 
+        "    }\n" 
+        "    _values[localId] = bestValue;\n" 
+        "    _indices[localId] = bestIndex;\n" 
+        "    barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    for( int offset = gWorkgroupSize >> 1; offset > 0; offset >>= 1 ) {\n" 
+        "        if( localId < offset ) {\n" 
+        "            const float otherValue = _values[localId + offset];\n" 
+        "            const int otherIndex = _indices[localId + offset];\n" 
+        "            if( otherValue > _values[localId] || ( otherValue == _values[localId] && otherIndex < _indices[localId] ) ) {\n" 
+        "                _values[localId] = otherValue;\n" 
+        "                _indices[localId] = otherIndex;\n" 
+        "            }\n" 
+        "        }\n" 
+        "        barrier(CLK_LOCAL_MEM_FENCE);\n" 
+        "    }\n" 
+        "    if( localId == 0 ) {\n" 
+        "        losses[group] = logSumExps[group] - logits[ groupOffset + label ];\n" 
+        "        rights[group] = _indices[0] == label ? 1 : 0;\n" 
+        "    }\n" 
+        "}\n" 
+        "\n" 
+        "";
+        kernelFromLabels = cl->buildKernelFromString( kernelFromLabelsSource, "softmax_from_labels", options, "cl/softmax.cl" );
+        // [[[end]]]
+    }
 }
 VIRTUAL SoftMaxLayer::~SoftMaxLayer() {
-    if( errorsForUpstream != 0 ) {
-        delete[] errorsForUpstream;
-    }
-    if( results != 0 ) {
-        delete[] results;
+    freeGroupBuffers();
+    if( !resultsInArena ) {
+        if( resultsWrapper != 0 ) {
+            delete resultsWrapper;
+        }
+        ZeroCopy::deallocate( results );
     }
+    delete kernelPropagate;
+    delete kernelFromLabels;
 }
 VIRTUAL std::string SoftMaxLayer::getClassName() const {
     return "SoftMaxLayer";
 }
 VIRTUAL float *SoftMaxLayer::getResults() {
+    if( !resultsCopiedToHost ) {
+        ZeroCopy::copyToHost( resultsWrapper );
+        resultsCopiedToHost = true;
+    }
     return results;
 }
 VIRTUAL float *SoftMaxLayer::getErrorsForUpstream() {
+    if( !errorsForUpstreamCopiedToHost ) {
+        ZeroCopy::copyToHost( errorsForUpstreamWrapper );
+        errorsForUpstreamCopiedToHost = true;
+    }
     return errorsForUpstream;
 }
+VIRTUAL bool SoftMaxLayer::providesErrorsForUpstreamWrapper() const {
+    return onDevice;
+}
+VIRTUAL CLWrapper *SoftMaxLayer::getErrorsForUpstreamWrapper() {
+    return errorsForUpstreamWrapper;
+}
 VIRTUAL void SoftMaxLayer::setBatchSize( int batchSize ) {
-    this->batchSize = batchSize;
+    labelResultsValid = false;
     if( batchSize <= this->allocatedSize ) {
+        this->batchSize = batchSize;
         return;
     }
-    if( results != 0 ) {
-        delete[] results;
+    if( resultsInArena ) {
+        throw runtime_error("layer " + toString(layerIndex) + ": results are in an arena planned for batch size " +
+            toString(allocatedSize) + ", cannot set batch size " + toString(batchSize) );
+    }
+    this->batchSize = batchSize;
+    this->allocatedSize = batchSize;
+    if( resultsWrapper != 0 ) {
+        delete resultsWrapper;
+        resultsWrapper = 0;
     }
-    if( errorsForUpstream != 0 ) {
-        delete[] errorsForUpstream;
+    ZeroCopy::deallocate( results );
+    results = ZeroCopy::allocateFloats( allocatedSize * getOutputCubeSize() );
+    if( kernelPropagate != 0 ) {
+        resultsWrapper = ZeroCopy::wrap( cl, allocatedSize * getOutputCubeSize(), results );
+        ZeroCopy::createOnDevice( resultsWrapper );
     }
-    results = new float[ getResultsSize() ];
-    errorsForUpstream = new float[ previousLayer-> getResultsSize() ];
-    allocatedSize = batchSize;
+    allocateGroupBuffers();
 }
-
-// need to calculate multinomial logistic /cross-entropy loss
-VIRTUAL float SoftMaxLayer::calcLossFromLabels( int const *labels ) {
-//    cout << "softmaxlayer::calcloss" << endl;
-    StatefulTimer::timeCheck("start SoftMaxLayer calcLossfromlabels");
-    float loss = 0;
-    if( perPlane ) {
-        for( int n = 0; n < batchSize; n++ ) {
-            for( int plane = 0; plane < numPlanes; plane++ ) {
-                int label = labels[n * numPlanes + plane];
-                int imageOffset = ( n * numPlanes + plane ) * imageSizeSquared;
-                loss += - log( results[ imageOffset + label ] );
-            }
+VIRTUAL bool SoftMaxLayer::canUseArena() const {
+    return true;
+}
+VIRTUAL void SoftMaxLayer::setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper ) {
+    if( !resultsInArena ) {
+        if( this->resultsWrapper != 0 ) {
+            delete this->resultsWrapper;
         }
-    } else {
-        // force imagesize of 1 for now
-        if( imageSize != 1 ) {
-            throw std::runtime_error("perColumn only supported for imagesize 1 for now.  Sit tight :-)  (But please raise an issue to highlight your need)");
+        ZeroCopy::deallocate( this->results );
+    }
+    this->results = results;
+    this->resultsWrapper = resultsWrapper;
+    this->resultsInArena = true;
+    this->batchSize = batchSize;
+    this->allocatedSize = batchSize;
+    labelResultsValid = false;
+    allocateGroupBuffers();
+}
+// (re)allocates everything except the results, for allocatedSize examples
+// when inference only, errorsForUpstream is left till someone asks for it, see allocateErrorsForUpstream
+void SoftMaxLayer::allocateGroupBuffers() {
+    freeGroupBuffers();
+    const int numGroups = allocatedSize * groupsPerExample;
+    logSumExps = ZeroCopy::allocateFloats( numGroups );
+    groupLabels = ZeroCopy::allocateInts( numGroups );
+    groupLosses = ZeroCopy::allocateFloats( numGroups );
+    groupRights = ZeroCopy::allocateInts( numGroups );
+    if( kernelPropagate != 0 ) {
+        logSumExpsWrapper = ZeroCopy::wrap( cl, numGroups, logSumExps );
+        ZeroCopy::createOnDevice( logSumExpsWrapper );
+        groupLabelsWrapper = ZeroCopy::wrap( cl, numGroups, groupLabels );
+        ZeroCopy::createOnDevice( groupLabelsWrapper );
+        groupLossesWrapper = ZeroCopy::wrap( cl, numGroups, groupLosses );
+        ZeroCopy::createOnDevice( groupLossesWrapper );
+        groupRightsWrapper = ZeroCopy::wrap( cl, numGroups, groupRights );
+        ZeroCopy::createOnDevice( groupRightsWrapper );
+    }
+    if( !inferenceOnly ) {
+        allocateErrorsForUpstream();
+    }
+}
+void SoftMaxLayer::allocateErrorsForUpstream() {
+    errorsForUpstream = ZeroCopy::allocateFloats( allocatedSize * getOutputCubeSize() );
+    if( kernelPropagate != 0 ) {
+        errorsForUpstreamWrapper = ZeroCopy::wrap( cl, allocatedSize * getOutputCubeSize(), errorsForUpstream );
+        ZeroCopy::createOnDevice( errorsForUpstreamWrapper );
+    }
+}
+void SoftMaxLayer::freeGroupBuffers() {
+    if( errorsForUpstreamWrapper != 0 ) {
+        delete errorsForUpstreamWrapper;
+    }
+    ZeroCopy::deallocate( errorsForUpstream );
+    if( logSumExpsWrapper != 0 ) {
+        delete logSumExpsWrapper;
+    }
+    ZeroCopy::deallocate( logSumExps );
+    if( groupLabelsWrapper != 0 ) {
+        delete groupLabelsWrapper;
+    }
+    ZeroCopy::deallocate( groupLabels );
+    if( groupLossesWrapper != 0 ) {
+        delete groupLossesWrapper;
+    }
+    ZeroCopy::deallocate( groupLosses );
+    if( groupRightsWrapper != 0 ) {
+        delete groupRightsWrapper;
+    }
+    ZeroCopy::deallocate( groupRights );
+    errorsForUpstream = 0;
+    errorsForUpstreamWrapper = 0;
+    logSumExps = 0;
+    logSumExpsWrapper = 0;
+    groupLabels = 0;
+    groupLabelsWrapper = 0;
+    groupLosses = 0;
+    groupLossesWrapper = 0;
+    groupRights = 0;
+    groupRightsWrapper = 0;
+}
+// for when the results dont come from propagate, eg MultiNet averaging the results of its child nets
+// there are no logits then, so the loss is taken from the probabilities directly
+void SoftMaxLayer::setResults( float const *probabilities ) {
+    memcpy( results, probabilities, sizeof(float) * getResultsSize() );
+    resultsWrittenOnHost();
+}
+// for callers that write the probabilities straight into results, rather than
+// using setResults, eg MultiNet
+void SoftMaxLayer::resultsWrittenOnHost() {
+    onDevice = false;
+    resultsCopiedToHost = true;
+    haveLogits = false;
+    labelResultsValid = false;
+}
+// the fused pass: errorsForUpstream, loss, and numRight, for these labels
+// loss is - log( softmax[label] ) = logsumexp - logits[label], which stays finite, even if
+// softmax[label] underflows
+// does nothing if already done for these same labels since the last propagate
+// the logits are read from the layer below, so this should run before anything is backpropped
+// (backPropFromLabels calls calcErrorsFromLabels first, so this is the case)
+void SoftMaxLayer::calcLabelResults( int const *labels ) {
+    const int numGroups = batchSize * groupsPerExample;
+    if( labelResultsValid && memcmp( groupLabels, labels, sizeof(int) * numGroups ) == 0 ) {
+        return;
+    }
+    StatefulTimer::timeCheck("start SoftMaxLayer calcLabelResults");
+    if( !perPlane && imageSize != 1 ) {
+        throw std::runtime_error("perColumn only supported for imagesize 1 for now.  Sit tight :-)  (But please raise an issue to highlight your need)");
+    }
+    for( int group = 0; group < numGroups; group++ ) {
+        const int label = labels[group];
+        if( label >= groupSize ) {
+            throw runtime_error("Label " + toString( label ) + " exceeds number of softmax " + ( perPlane ? "positions " : "planes " ) + toString( groupSize ) );
+        } else if( label < 0 ) {
+            throw runtime_error("Label " + toString( label ) + " negative" );
         }
-        for( int n = 0; n < batchSize; n++ ) {
-            int imageOffset = n * numPlanes * imageSizeSquared;
-            int label = labels[n];
-            loss += - log( results[imageOffset + label] );
+    }
+    memcpy( groupLabels, labels, sizeof(int) * numGroups );
+    if( errorsForUpstream == 0 ) {
+        allocateErrorsForUpstream();
+    }
+    loss = 0;
+    numRight = 0;
+    if( onDevice ) {
+        ZeroCopy::copyToDevice( groupLabelsWrapper );
+        kernelFromLabels->in( numGroups )
+            ->in( groupLabelsWrapper )
+            ->in( previousLayer->getResultsWrapper() )
+            ->in( resultsWrapper )
+            ->in( logSumExpsWrapper )
+            ->out( errorsForUpstreamWrapper )
+            ->out( groupLossesWrapper )
+            ->out( groupRightsWrapper );
+        kernelFromLabels->run_1d( numGroups * workgroupSize, workgroupSize );
+        cl->finish();
+        ZeroCopy::copyToHost( groupLossesWrapper );
+        ZeroCopy::copyToHost( groupRightsWrapper );
+        for( int group = 0; group < numGroups; group++ ) {
+            loss += groupLosses[group];
+            numRight += groupRights[group];
+        }
+        errorsForUpstreamCopiedToHost = false;
+    } else {
+        float const *logits = haveLogits ? previousLayer->getResults() : 0;
+        for( int group = 0; group < numGroups; group++ ) {
+            const int groupOffset = group * groupSize;
+            const int label = labels[group];
+            float const *groupResults = results + groupOffset;
+            float *groupErrors = errorsForUpstream + groupOffset;
+            float bestValue = groupResults[0];
+            int bestIndex = 0;
+            for( int i = 0; i < groupSize; i++ ) {
+                groupErrors[i] = groupResults[i];
+                if( groupResults[i] > bestValue ) {
+                    bestValue = groupResults[i];
+                    bestIndex = i;
+                }
+            }
+            groupErrors[label] -= 1;
+            loss += haveLogits ? logSumExps[group] - logits[groupOffset + label] : - log( groupResults[label] );
+            if( bestIndex == label ) {
+                numRight++;
+            }
         }
+        errorsForUpstreamCopiedToHost = true;
     }
-    StatefulTimer::timeCheck("end SoftMaxLayer calcLossfromlabels");
+    labelResultsValid = true;
+    StatefulTimer::timeCheck("end SoftMaxLayer calcLabelResults");
+}
+// need to calculate multinomial logistic /cross-entropy loss
+VIRTUAL float SoftMaxLayer::calcLossFromLabels( int const *labels ) {
+    calcLabelResults( labels );
     return loss;
 }
 // need to calculate multinomial logistic /cross-entropy loss
 VIRTUAL float SoftMaxLayer::calcLoss( float const *expectedValues ) {
 //    cout << "softmaxlayer::calcloss" << endl;
     StatefulTimer::timeCheck("start SoftMaxLayer calcLoss");
+    getResults();
     float loss = 0;
     if( perPlane ) {
         for( int n = 0; n < batchSize; n++ ) {
@@ -126,39 +642,7 @@ VIRTUAL float SoftMaxLayer::calcLoss( float const *expectedValues ) {
 // (multinomial cross-entropy) loss derivative wrt our output, and
 // derivative of softmax wrt our inputs
 VIRTUAL void SoftMaxLayer::calcErrorsFromLabels( int const *labels ) {
-//    cout << "softmaxlayer::calcerrors" << endl;
-    StatefulTimer::timeCheck("start SoftMaxLayer calcErrorsfromlabels");
-    if( perPlane ) {
-        for( int n = 0; n < batchSize; n++ ) {
-            for( int plane = 0; plane < numPlanes; plane++ ) {
-                int imageOffset = ( n * numPlanes + plane ) * imageSizeSquared;
-                int label = labels[n * numPlanes + plane];
-                for( int i = 0; i < imageSizeSquared; i++ ) {
-                    errorsForUpstream[imageOffset + i] = results[imageOffset + i];
-                }
-                errorsForUpstream[imageOffset + label] -= 1;
-            }
-        }
-    } else {
-        // force imagesize of 1 for now
-        if( imageSize != 1 ) {
-            throw std::runtime_error("perColumn only supported for imagesize 1 for now.  Sit tight :-)  (But please raise an issue to highlight your need)");
-        }
-        for( int n = 0; n < batchSize; n++ ) {
-            int imageOffset = n * numPlanes * imageSizeSquared;
-            int label = labels[n];
-            for( int plane = 0; plane < numPlanes; plane++ ) {
-                errorsForUpstream[imageOffset + plane] = results[imageOffset + plane];
-            }
-            if( label >= numPlanes ) {
-                throw runtime_error("Label " + toString( label ) + " exceeds number of softmax planes " + toString( numPlanes ) );
-            } else if( label < 0 ) {
-                throw runtime_error("Label " + toString( label ) + " negative" );
-            }
-            errorsForUpstream[imageOffset + label] -= 1;
-        }
-    }
-    StatefulTimer::timeCheck("end SoftMaxLayer calcErrorsfromlabels");
+    calcLabelResults( labels );
 }
 // calculate partial deriv loss wrt our inputs, in other words, product of
 // (multinomial cross-entropy) loss derivative wrt our output, and
@@ -166,6 +650,7 @@ VIRTUAL void SoftMaxLayer::calcErrorsFromLabels( int const *labels ) {
 VIRTUAL void SoftMaxLayer::calcErrors( float const *expectedValues ) {
 //    cout << "softmaxlayer::calcerrors" << endl;
     StatefulTimer::timeCheck("start SoftMaxLayer calcErrors");
+    getResults();
     if( perPlane ) {
         for( int n = 0; n < batchSize; n++ ) {
             for( int plane = 0; plane < numPlanes; plane++ ) {
@@ -189,6 +674,9 @@ VIRTUAL void SoftMaxLayer::calcErrors( float const *expectedValues ) {
             }
         }
     }
+    onDevice = false;
+    errorsForUpstreamCopiedToHost = true;
+    labelResultsValid = false;
     StatefulTimer::timeCheck("end SoftMaxLayer calcErrors");
 }
 VIRTUAL int SoftMaxLayer::getNumLabelsPerExample() {
@@ -202,99 +690,69 @@ VIRTUAL int SoftMaxLayer::getPersistSize() const {
     return 0;
 }
 VIRTUAL int SoftMaxLayer::calcNumRight( int const*labels ) {
-    StatefulTimer::timeCheck("start SoftMaxLayer calcNumRight");
-//    float *resultsFromUpstream = previousLayer->getResults(); // just retrieve as host-side array for now
-    int numRight = 0;
-    if( perPlane ) {
-        for( int n = 0; n < batchSize; n++ ) {
-            for( int plane = 0; plane < numPlanes; plane++ ) {
-                int imageOffset = ( n * numPlanes + plane ) * imageSizeSquared;
-                int label = labels[n * numPlanes + plane];
-                float thisMax = results[imageOffset + 0];
-                int iMax = 0;
-                for( int i = 1; i < imageSizeSquared; i++ ) {
-                    if( results[imageOffset + i] > thisMax ) {
-                        thisMax = results[imageOffset + i];
-                        iMax = i;
-                    }
-                }
-                if( label == iMax ) {
-//                    cout << "n " << n << " plane " << plane << " label " << label << endl;
-                    numRight++;
-                }
-            }
-        }
-    } else {
-        // force imagesize of 1 for now
-        if( imageSize != 1 ) {
-            throw std::runtime_error("perColumn only supported for imagesize 1 for now.  Sit tight :-)  (But please raise an issue to highlight your need)");
-        }
-        for( int n = 0; n < batchSize; n++ ) {
-            int imageOffset = n * numPlanes * imageSizeSquared;
-            int label = labels[n];
-            float thisMax = results[imageOffset + 0];
-            int iMax = 0;
-            for( int i = 1; i < numPlanes; i++ ) {
-                if( results[imageOffset + i] > thisMax ) {
-                    thisMax = results[imageOffset + i];
-                    iMax = i;
-                }
-            }
-            if( label == iMax ) {
-                numRight++;
-            }
-        }
-    }
-
-    StatefulTimer::timeCheck("start SoftMaxLayer calcNumRight");
+    calcLabelResults( labels );
     return numRight;
 }
 // for propagate, we just need to apply the softmax activation. "just" :-P
+// we keep log( sum( exp( logits ) ) ) for each group, so the loss doesnt need log( results )
 VIRTUAL void SoftMaxLayer::propagate() {
-//    cout << "softmaxlayer::propagate" << endl;
-    StatefulTimer::timeCheck("start SoftMaxLayer propagate");
-    float *resultsFromUpstream = previousLayer->getResults(); // just retrieve as host-side array for now
-    if( perPlane ) {
-        for( int n = 0; n < batchSize; n++ ) {
-            for( int plane = 0; plane < numPlanes; plane++ ) {
-                int imageOffset = ( n * numPlanes + plane ) * imageSizeSquared;
-                float maxValue = resultsFromUpstream[imageOffset + 0];
-                for( int i = 1; i < imageSizeSquared; i++ ) {
-                    maxValue = std::max( maxValue, resultsFromUpstream[imageOffset + i] );
-                }
-                float denominator = 0;
-                for( int i = 0; i < imageSizeSquared; i++ ) {
-                    denominator += exp( resultsFromUpstream[imageOffset + i] - maxValue );
-                }
-                for( int i = 0; i < imageSizeSquared; i++ ) {
-                    results[imageOffset + i] = exp( resultsFromUpstream[imageOffset + i] - maxValue ) / denominator;
-                }
-            }
-        }
-    } else {
+    if( !lowLatency ) {
+        StatefulTimer::timeCheck("start SoftMaxLayer propagate");
+    }
+    if( !perPlane && imageSize != 1 ) {
         // force imagesize of 1 for now
-        if( imageSize != 1 ) {
-            throw std::runtime_error("perColumn only supported for imagesize 1 for now.  Sit tight :-)  (But please raise an issue to highlight your need)");
-        }
-        for( int n = 0; n < batchSize; n++ ) {
-            int imageOffset = n * numPlanes * imageSizeSquared;
-            // first get the max
-            float maxValue = resultsFromUpstream[imageOffset + 0]; // since we assume imagesize 1, this is correct
-            for( int plane = 1; plane < numPlanes; plane++ ) {
-                maxValue = std::max( maxValue, resultsFromUpstream[imageOffset + plane] );
+        throw std::runtime_error("perColumn only supported for imagesize 1 for now.  Sit tight :-)  (But please raise an issue to highlight your need)");
+    }
+    const int numGroups = batchSize * groupsPerExample;
+    labelResultsValid = false;
+    haveLogits = true;
+    if( kernelPropagate != 0 ) {
+        kernelPropagate->in( numGroups )
+            ->in( previousLayer->getResultsWrapper() )
+            ->out( resultsWrapper )
+            ->out( logSumExpsWrapper );
+        kernelPropagate->run_1d( numGroups * workgroupSize, workgroupSize );
+        cl->finish();
+        onDevice = true;
+        resultsCopiedToHost = false;
+    } else {
+        float *resultsFromUpstream = previousLayer->getResults(); // just retrieve as host-side array for now
+        for( int group = 0; group < numGroups; group++ ) {
+            const int groupOffset = group * groupSize;
+            float const *logits = resultsFromUpstream + groupOffset;
+            float maxValue = logits[0];
+            for( int i = 1; i < groupSize; i++ ) {
+                maxValue = std::max( maxValue, logits[i] );
             }
-            // calculate sum, under this max
             float denominator = 0;
-            for( int plane = 0; plane < numPlanes; plane++ ) {
-                denominator += exp( resultsFromUpstream[imageOffset + plane] - maxValue );
+            float *groupResults = results + groupOffset;
+            if( fastMath ) {
+                for( int i = 0; i < groupSize; i++ ) {
+                    denominator += FastMath::exp( logits[i] - maxValue );
+                }
+            } else {
+                for( int i = 0; i < groupSize; i++ ) {
+                    denominator += exp( logits[i] - maxValue );
+                }
             }
-            // now calc the softmaxes:
-            for( int plane = 0; plane < numPlanes; plane++ ) {
-                results[imageOffset + plane] = exp( resultsFromUpstream[imageOffset + plane] - maxValue ) / denominator;
+            const float logSumExp = maxValue + log( denominator );
+            if( fastMath ) {
+                for( int i = 0; i < groupSize; i++ ) {
+                    groupResults[i] = FastMath::exp( logits[i] - logSumExp );
+                }
+            } else {
+                for( int i = 0; i < groupSize; i++ ) {
+                    groupResults[i] = exp( logits[i] - logSumExp );
+                }
             }
+            logSumExps[group] = logSumExp;
         }
+        onDevice = false;
+        resultsCopiedToHost = true;
+    }
+    if( !lowLatency ) {
+        StatefulTimer::timeCheck("end SoftMaxLayer propagate");
     }
-    StatefulTimer::timeCheck("end SoftMaxLayer propagate");
 }
 // this seems to be handled by calcErrors? So, just to a nop?
 // (cos this layer kind of combines loss layer and a 'normal' propagation layer )
@@ -11,6 +11,9 @@
 #include "IAcceptsLabels.h"
 
 class SoftMaxMaker;
+class OpenCLHelper;
+class CLKernel;
+class CLWrapper;
 
 #define VIRTUAL virtual
 #define STATIC static
@@ -19,18 +22,52 @@ class SoftMaxMaker;
 // it will have the same shape as the previous layer, ie same imagesize, same number of planes
 // the softmax will be per-plane, or maybe that is configurable?
 // this will ALWAYS use multinomial logistic loss (ie cross-entropy loss), at least for now
+// each softmax is over a 'group': all the planes of one example, for per-column, or
+// one plane of one example, for per-plane
+// the loss, the errors for upstream, and the number right, given some labels, are
+// all calculated together, in one pass, by whichever of calcLossFromLabels,
+// calcErrorsFromLabels, calcNumRight is called first after propagate.  The others
+// just return the results from that pass, as long as the labels are the same
+// if the layer below has its results on the gpu, then all of this runs on the gpu,
+// and only the loss and number right for each group come back to the host
 class SoftMaxLayer : public LossLayer, public IAcceptsLabels {
 public:
+    OpenCLHelper *cl; // NOT owned by us
     const bool perPlane;
+    const bool fastMath; // FastMath::exp, rather than exp
     const int imageSize;
     const int numPlanes;
     const int imageSizeSquared;
+    const int groupSize; // number of values each softmax is over
+    const int groupsPerExample;
+
+    CLKernel *kernelPropagate; // 0 if we run on the host
+    CLKernel *kernelFromLabels;
+    int workgroupSize;
 
     float *results;
     float *errorsForUpstream;
+    CLWrapper *resultsWrapper;
+    CLWrapper *errorsForUpstreamWrapper;
+    float *logSumExps; // per group, log of the softmax denominator, including the max
+    CLWrapper *logSumExpsWrapper;
+    int *groupLabels;
+    CLWrapper *groupLabelsWrapper;
+    float *groupLosses;
+    CLWrapper *groupLossesWrapper;
+    int *groupRights;
+    CLWrapper *groupRightsWrapper;
     int allocatedSize;
     int batchSize;
 
+    bool onDevice; // results, and errors for upstream, were last written on the gpu
+    bool resultsCopiedToHost;
+    bool errorsForUpstreamCopiedToHost;
+    bool haveLogits; // false if results were set directly, using setResults
+    bool labelResultsValid; // loss, numRight and errorsForUpstream are for groupLabels
+    float loss;
+    int numRight;
+
     // [[[cog
     // import cog_addheaders
     // cog_addheaders.add()
@@ -41,7 +78,17 @@ public:
     VIRTUAL std::string getClassName() const;
     VIRTUAL float *getResults();
     VIRTUAL float *getErrorsForUpstream();
+    VIRTUAL bool providesErrorsForUpstreamWrapper() const;
+    VIRTUAL CLWrapper *getErrorsForUpstreamWrapper();
     VIRTUAL void setBatchSize( int batchSize );
+    VIRTUAL bool canUseArena() const;
+    VIRTUAL void setResultsBuffer( int batchSize, float *results, CLWrapper *resultsWrapper );
+    void allocateGroupBuffers();
+    void allocateErrorsForUpstream();
+    void freeGroupBuffers();
+    void setResults( float const *probabilities );
+    void resultsWrittenOnHost();
+    void calcLabelResults( int const *labels );
     VIRTUAL float calcLossFromLabels( int const *labels );
     VIRTUAL float calcLoss( float const *expectedValues );
     VIRTUAL void calcErrorsFromLabels( int const *labels );
@@ -6,6 +6,7 @@
 
 #include "SquareLossLayer.h"
 #include "LossLayer.h"
+#include "ZeroCopy.h"
 #include "LayerMaker.h"
 
 using namespace std;
@@ -22,7 +23,7 @@ SquareLossLayer::SquareLossLayer( Layer *previousLayer, SquareLossMaker *maker )
 }
 VIRTUAL SquareLossLayer::~SquareLossLayer(){
     if( errors != 0 ) {
-        delete[] errors;
+        ZeroCopy::deallocate( errors );
     }
 }
 VIRTUAL std::string SquareLossLayer::getClassName() const {
@@ -69,11 +70,14 @@ VIRTUAL void SquareLossLayer::setBatchSize( int batchSize ) {
         return;
     }
     if( errors != 0 ) {
-        delete[] errors;
+        ZeroCopy::deallocate( errors );
+        errors = 0;
     }
     this->batchSize = batchSize;
     allocatedSize = batchSize;
-    errors = new float[ batchSize * previousLayer->getResultsSize() ];
+    if( !inferenceOnly ) {
+        errors = ZeroCopy::allocateFloats( batchSize * previousLayer->getResultsSize() );
+    }
 }
 VIRTUAL void SquareLossLayer::calcErrors( float const*expectedResults ) {
     ActivationFunction const*fn = previousLayer->getActivationFunction();
@@ -81,10 +85,11 @@ VIRTUAL void SquareLossLayer::calcErrors( float const*expectedResults ) {
     float *results = previousLayer->getResults();
     for( int i = 0; i < resultsSize; i++ ) {
         float result = results[i];
-        float partialOutBySum = fn->calcDerivative( result );
         float partialLossByOut = result - expectedResults[i];
-        errors[i] = partialLossByOut * partialOutBySum;
+        errors[i] = partialLossByOut;
     }
+    // times partialOutBySum
+    fn->multiplyByDerivative( resultsSize, errors, results );
 }
 VIRTUAL int SquareLossLayer::getPersistSize() const {
     return 0;
@@ -21,6 +21,8 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <mutex>
+#include <thread>
 
 class StatefulTimer {
 public:
@@ -34,8 +36,10 @@ public:
     std::chrono::time_point<std::chrono::high_resolution_clock> last;
     #endif
     std::map< std::string, float > timeByState;
-    std::string prefix; // = "";
-    StatefulTimer() : prefix("") {
+    // per thread, since TaskGraph tasks for different layers run at the same time
+    std::map< std::thread::id, std::string > prefixByThread;
+    std::mutex mutex; // timeCheck can be called from the thread pool, eg by TaskGraph tasks
+    StatefulTimer() {
         #ifdef WINNOCHRONO
         last = timeGetTime();
         #else
@@ -49,6 +53,7 @@ public:
         }
     }
     void _dump(bool force = false) {
+        std::lock_guard< std::mutex > lock( mutex );
         double totalTimings = 0;
         for( std::map< std::string, float >::iterator it = timeByState.begin(); it != timeByState.end(); it++ ) {
 //            std::cout << "   " << it->first << ": " << it->second << std::endl;
@@ -66,7 +71,21 @@ public:
         timeByState.clear();
     }
     static void setPrefix( std::string _prefix ) {
-        instance()->prefix = _prefix;
+        std::lock_guard< std::mutex > lock( instance()->mutex );
+        if( _prefix == "" ) {
+            instance()->prefixByThread.erase( std::this_thread::get_id() );
+        } else {
+            instance()->prefixByThread[ std::this_thread::get_id() ] = _prefix;
+        }
+    }
+    static std::string getPrefix() {
+        std::lock_guard< std::mutex > lock( instance()->mutex );
+        return instance()->_getPrefix();
+    }
+    // mutex must be held
+    std::string _getPrefix() {
+        std::map< std::thread::id, std::string >::iterator it = prefixByThread.find( std::this_thread::get_id() );
+        return it == prefixByThread.end() ? "" : it->second;
     }
     static void dump(bool force = false) {
         instance()->_dump(force);
@@ -75,7 +94,8 @@ public:
         instance()->_timeCheck( state );
     }
     void _timeCheck( std::string state ) {
-        state = prefix + state;
+        std::lock_guard< std::mutex > lock( mutex );
+        state = _getPrefix() + state;
         #ifdef WINNOCHRONO
         DWORD thistime = timeGetTime();
 		DWORD timemilliseconds = thistime - last;
@@ -0,0 +1,163 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+
+#include "ThreadPool.h"
+#include "stringhelper.h"
+
+#include "TaskGraph.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+TaskGraph::TaskGraph() :
+        numDone( 0 ),
+        numOnHost( 0 ) {
+}
+// returns the id of the new task, for addDependency
+int TaskGraph::addTask( std::string name, bool onHost, TaskFunction const &fn ) {
+    Task task;
+    task.name = name;
+    task.fn = fn;
+    task.onHost = onHost;
+    task.numDependencies = 0;
+    tasks.push_back( task );
+    return (int)tasks.size() - 1;
+}
+// task after wont start until task before has finished
+void TaskGraph::addDependency( int before, int after ) {
+    if( before < 0 || before >= (int)tasks.size() || after < 0 || after >= (int)tasks.size() ) {
+        throw runtime_error("TaskGraph::addDependency: no such task " + toString( before ) + " or " + toString( after ) );
+    }
+    if( before >= after ) {
+        throw runtime_error("TaskGraph::addDependency: tasks should be added after the tasks they depend on");
+    }
+    tasks[before].dependents.push_back( after );
+    tasks[after].numDependencies++;
+}
+int TaskGraph::getNumTasks() const {
+    return (int)tasks.size();
+}
+// returns once every task has run.  if a task throws, no more tasks start,
+// and the exception is rethrown here, once the running ones are done
+void TaskGraph::run( ThreadPool *pool ) {
+    const int numTasks = (int)tasks.size();
+    std::unique_lock< std::mutex > lock( mutex );
+    runOrder.clear();
+    numWaitingOn.resize( numTasks );
+    readyOnHost.clear();
+    readyOnDevice.clear();
+    for( int i = 0; i < numTasks; i++ ) {
+        numWaitingOn[i] = tasks[i].numDependencies;
+        if( numWaitingOn[i] == 0 ) {
+            ( tasks[i].onHost ? readyOnHost : readyOnDevice ).push_back( i );
+        }
+    }
+    numDone = 0;
+    numOnHost = 0;
+    error = std::exception_ptr();
+    while( numDone < numTasks && !error ) {
+        while( !readyOnHost.empty() ) {
+            const int taskId = readyOnHost.front();
+            readyOnHost.pop_front();
+            runOrder.push_back( tasks[taskId].name );
+            numOnHost++;
+            pool->submit( [this, taskId]() {
+                runOnHost( taskId );
+            } );
+        }
+        if( !readyOnDevice.empty() ) {
+            const int taskId = readyOnDevice.front();
+            readyOnDevice.pop_front();
+            runOrder.push_back( tasks[taskId].name );
+            lock.unlock();
+            try {
+                tasks[taskId].fn();
+            } catch( ... ) {
+                lock.lock();
+                error = std::current_exception();
+                break;
+            }
+            lock.lock();
+            markDone( taskId );
+            continue;
+        }
+        // with no workers, or busy ones, the host tasks might be waiting on us
+        lock.unlock();
+        const bool ranSomething = pool->runPendingTask();
+        lock.lock();
+        if( !ranSomething && numDone < numTasks && !error && readyOnHost.empty() && readyOnDevice.empty() ) {
+            taskDone.wait( lock );
+        }
+    }
+    // host tasks hold on to this, so wait for them, even after an error
+    while( numOnHost > 0 ) {
+        lock.unlock();
+        const bool ranSomething = pool->runPendingTask();
+        lock.lock();
+        if( !ranSomething && numOnHost > 0 ) {
+            taskDone.wait( lock );
+        }
+    }
+    if( error ) {
+        std::exception_ptr thisError = error;
+        error = std::exception_ptr();
+        std::rethrow_exception( thisError );
+    }
+}
+// runs everything on the calling thread, in the order added, which is always
+// a valid order, since tasks cant depend on later ones
+void TaskGraph::runSequential() {
+    runOrder.clear();
+    for( int i = 0; i < (int)tasks.size(); i++ ) {
+        runOrder.push_back( tasks[i].name );
+        tasks[i].fn();
+    }
+}
+// mutex must be held
+void TaskGraph::markDone( int taskId ) {
+    numDone++;
+    std::vector< int > const &dependents = tasks[taskId].dependents;
+    for( int i = 0; i < (int)dependents.size(); i++ ) {
+        const int dependent = dependents[i];
+        numWaitingOn[dependent]--;
+        if( numWaitingOn[dependent] == 0 ) {
+            ( tasks[dependent].onHost ? readyOnHost : readyOnDevice ).push_back( dependent );
+        }
+    }
+}
+// runs on a pool thread, or on the caller of run, while it waits
+void TaskGraph::runOnHost( int taskId ) {
+    bool failed = false;
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        failed = (bool)error;
+    }
+    std::exception_ptr thisError;
+    if( !failed ) {
+        try {
+            tasks[taskId].fn();
+        } catch( ... ) {
+            thisError = std::current_exception();
+        }
+    }
+    std::unique_lock< std::mutex > lock( mutex );
+    if( thisError && !error ) {
+        error = thisError;
+    }
+    if( !thisError && !failed ) {
+        markDone( taskId );
+    }
+    numOnHost--;
+    taskDone.notify_all();
+}
+
@@ -0,0 +1,70 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+class ThreadPool;
+
+// a small graph of tasks, each of which runs once dependencies are done
+// tasks that use the device run one at a time, on the thread that calls run,
+// in the order they become ready: OpenCLHelper has a single in-order queue, and
+// isnt thread-safe.  host tasks run on the thread pool, alongside the device
+// tasks, and alongside each other, so they shouldnt use the OpenCLHelper
+class DeepCL_EXPORT TaskGraph {
+public:
+    typedef std::function< void() > TaskFunction;
+
+    class Task {
+    public:
+        std::string name;
+        TaskFunction fn;
+        bool onHost;
+        int numDependencies;
+        std::vector< int > dependents;
+    };
+    std::vector< Task > tasks;
+    std::vector< std::string > runOrder; // names of the tasks, in the order they started
+
+    // state of the current run
+    std::mutex mutex;
+    std::condition_variable taskDone;
+    std::vector< int > numWaitingOn;
+    std::deque< int > readyOnHost;
+    std::deque< int > readyOnDevice;
+    int numDone;
+    int numOnHost; // submitted to the pool, not finished yet
+    std::exception_ptr error;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    TaskGraph();
+    int addTask( std::string name, bool onHost, TaskFunction const &fn );
+    void addDependency( int before, int after );
+    int getNumTasks() const;
+    void run( ThreadPool *pool );
+    void runSequential();
+    void markDone( int taskId );
+    void runOnHost( int taskId );
+
+    // [[[end]]]
+};
+
@@ -0,0 +1,124 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL
+#undef STATIC
+#define STATIC
+
+// shared by everything in the process, one thread per core, counting the caller
+STATIC ThreadPool *ThreadPool::instance() {
+    static ThreadPool *_instance = new ThreadPool( std::max( 1, (int)std::thread::hardware_concurrency() ) - 1 );
+    return _instance;
+}
+// numThreads is the number of extra threads; 0 means everything runs on the caller
+ThreadPool::ThreadPool( int numThreads ) :
+        stopping( false ) {
+    for( int i = 0; i < numThreads; i++ ) {
+        workers.push_back( std::thread( &ThreadPool::runWorker, this ) );
+    }
+}
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for( int i = 0; i < (int)workers.size(); i++ ) {
+        workers[i].join();
+    }
+}
+// counts the caller
+int ThreadPool::getNumThreads() const {
+    return (int)workers.size() + 1;
+}
+void ThreadPool::parallelFor( int N, RangeFunction const &fn ) {
+    parallelFor( N, 1, fn );
+}
+// calls fn( begin, end ) over [0, N), split into one contiguous chunk per
+// thread, but no chunk smaller than minChunkSize
+void ThreadPool::parallelFor( int N, int minChunkSize, RangeFunction const &fn ) {
+    if( N <= 0 ) {
+        return;
+    }
+    const int numChunks = std::max( 1, std::min( getNumThreads(), N / std::max( 1, minChunkSize ) ) );
+    if( numChunks == 1 ) {
+        fn( 0, N );
+        return;
+    }
+    int numRemaining = numChunks - 1;
+    std::unique_lock< std::mutex > lock( mutex );
+    for( int chunk = 1; chunk < numChunks; chunk++ ) {
+        const int begin = (int)( (long long)N * chunk / numChunks );
+        const int end = (int)( (long long)N * ( chunk + 1 ) / numChunks );
+        tasks.push_back( [this, &fn, &numRemaining, begin, end]() {
+            fn( begin, end );
+            // caller of parallelFor is waiting on taskDone, holding no lock
+            std::unique_lock< std::mutex > lock( mutex );
+            numRemaining--;
+            if( numRemaining == 0 ) {
+                taskDone.notify_all();
+            }
+        } );
+    }
+    lock.unlock();
+    taskAvailable.notify_all();
+    fn( 0, (int)( (long long)N / numChunks ) );
+    lock.lock();
+    while( numRemaining > 0 ) {
+        // help out, in case the workers are busy, eg running the task that called us
+        if( !runOneTask( lock ) ) {
+            taskDone.wait( lock );
+        }
+    }
+}
+// runs task on some worker, without waiting for it
+void ThreadPool::submit( Task const &task ) {
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        tasks.push_back( task );
+    }
+    taskAvailable.notify_one();
+}
+// runs one queued task, if there is one, on the calling thread.  for callers
+// waiting on submitted tasks, since with no workers, nothing else will run them
+bool ThreadPool::runPendingTask() {
+    std::unique_lock< std::mutex > lock( mutex );
+    return runOneTask( lock );
+}
+void ThreadPool::runWorker() {
+    std::unique_lock< std::mutex > lock( mutex );
+    while( true ) {
+        if( runOneTask( lock ) ) {
+            continue;
+        }
+        if( stopping ) {
+            return;
+        }
+        taskAvailable.wait( lock );
+    }
+}
+// lock must be held; it is released while the task runs.  returns false if
+// there was nothing to run
+bool ThreadPool::runOneTask( std::unique_lock< std::mutex > &lock ) {
+    if( tasks.empty() ) {
+        return false;
+    }
+    Task task = tasks.front();
+    tasks.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+    return true;
+}
+
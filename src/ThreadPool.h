@@ -0,0 +1,55 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "DeepCLDllExport.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+// fixed set of worker threads, for the cpu implementations of layers
+// parallelFor blocks until all its chunks are done; the calling thread runs
+// chunks too, rather than just waiting, so parallelFor can be called from
+// inside a task without deadlocking
+class DeepCL_EXPORT ThreadPool {
+public:
+    typedef std::function< void( int begin, int end ) > RangeFunction;
+    typedef std::function< void() > Task;
+
+    std::vector< std::thread > workers;
+    std::deque< Task > tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable taskDone;
+    bool stopping;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    STATIC ThreadPool *instance();
+    ThreadPool( int numThreads );
+    ~ThreadPool();
+    int getNumThreads() const;
+    void parallelFor( int N, RangeFunction const &fn );
+    void parallelFor( int N, int minChunkSize, RangeFunction const &fn );
+    void submit( Task const &task );
+    bool runPendingTask();
+    void runWorker();
+    bool runOneTask( std::unique_lock< std::mutex > &lock );
+
+    // [[[end]]]
+};
+
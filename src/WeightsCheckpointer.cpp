@@ -0,0 +1,171 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+
+#include "NeuralNet.h"
+#include "WeightsPersister.h"
+#include "ResumeState.h"
+#include "StatefulTimer.h"
+
+#include "WeightsCheckpointer.h"
+
+using namespace std;
+
+#undef STATIC
+#undef VIRTUAL
+#define STATIC
+#define VIRTUAL
+
+WeightsCheckpointer::WeightsCheckpointer( std::string filepath, std::string trainingConfigString, NeuralNet *net ) :
+        filepath( filepath ),
+        trainingConfigString( trainingConfigString ),
+        net( net ),
+        numWritten( 0 ),
+        numDropped( 0 ),
+        stopping( false ) {
+    for( int i = 0; i < 2; i++ ) {
+        buffers[i] = 0;
+        bufferSizes[i] = 0;
+        bufferUsedSizes[i] = 0;
+        bufferStates[i] = Free;
+    }
+    writer = std::thread( &WeightsCheckpointer::runWriter, this );
+}
+// writes any snapshot still waiting, before returning
+WeightsCheckpointer::~WeightsCheckpointer() {
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        while( bufferStates[0] != Free || bufferStates[1] != Free ) {
+            stateChanged.wait( lock );
+        }
+        stopping = true;
+    }
+    stateChanged.notify_all();
+    writer.join();
+    if( writeError ) {
+        try {
+            std::rethrow_exception( writeError );
+        } catch( std::exception &e ) {
+            cout << "WeightsCheckpointer: failed to write " << filepath << ": " << e.what() << endl;
+        }
+    }
+    for( int i = 0; i < 2; i++ ) {
+        delete[] buffers[i];
+    }
+}
+int WeightsCheckpointer::getNumWritten() {
+    std::unique_lock< std::mutex > lock( mutex );
+    return numWritten;
+}
+int WeightsCheckpointer::getNumDropped() {
+    std::unique_lock< std::mutex > lock( mutex );
+    return numDropped;
+}
+// copies the weights now, and returns as soon as they are copied.  the file is
+// written later, on the writer thread.  throws if an earlier write failed
+void WeightsCheckpointer::checkpoint( int epoch, int batch, float annealedLearningRate, int numRight, float loss ) {
+    ResumeState resumeState( epoch );
+    resumeState.batch = batch;
+    resumeState.annealedLearningRate = annealedLearningRate;
+    resumeState.numRight = numRight;
+    resumeState.loss = loss;
+    capture( resumeState, false );
+}
+// as above, but also saves the rest of resumeState, and the state of MyRandom,
+// so training can carry on from exactly here
+void WeightsCheckpointer::checkpoint( ResumeState const &resumeState ) {
+    capture( resumeState, true );
+}
+void WeightsCheckpointer::capture( ResumeState const &resumeState, bool withResumeSection ) {
+    StatefulTimer::timeCheck("WeightsCheckpointer::checkpoint start");
+    int buffer = -1;
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        rethrowWriteError();
+        // replace the pending snapshot, if there is one, so at most one waits
+        for( int i = 0; i < 2 && buffer == -1; i++ ) {
+            if( bufferStates[i] == Pending ) {
+                buffer = i;
+                numDropped++;
+            }
+        }
+        for( int i = 0; i < 2 && buffer == -1; i++ ) {
+            if( bufferStates[i] == Free ) {
+                buffer = i;
+            }
+        }
+        // there's only one writer, so one of the buffers isnt Writing
+        bufferStates[buffer] = Capturing;
+    }
+    // the size only changes if the permutation does, ie hardly ever
+    int persistArraySize = WeightsPersister::getPersistArraySize( net, withResumeSection ? &resumeState : 0 );
+    if( bufferSizes[buffer] < persistArraySize ) {
+        delete[] buffers[buffer];
+        buffers[buffer] = new char[persistArraySize];
+        bufferSizes[buffer] = persistArraySize;
+    }
+    WeightsPersister::copyNetToPersistArray( buffers[buffer], trainingConfigString, net, resumeState, withResumeSection );
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        bufferStates[buffer] = Pending;
+        bufferUsedSizes[buffer] = persistArraySize;
+    }
+    stateChanged.notify_all();
+    StatefulTimer::timeCheck("WeightsCheckpointer::checkpoint end");
+}
+// waits until every snapshot taken so far is on disk
+void WeightsCheckpointer::flush() {
+    std::unique_lock< std::mutex > lock( mutex );
+    while( bufferStates[0] != Free || bufferStates[1] != Free ) {
+        stateChanged.wait( lock );
+    }
+    rethrowWriteError();
+}
+// mutex must be held.  the error is only thrown once
+void WeightsCheckpointer::rethrowWriteError() {
+    if( writeError ) {
+        std::exception_ptr error = writeError;
+        writeError = std::exception_ptr();
+        std::rethrow_exception( error );
+    }
+}
+void WeightsCheckpointer::runWriter() {
+    std::unique_lock< std::mutex > lock( mutex );
+    while( true ) {
+        int buffer = -1;
+        for( int i = 0; i < 2; i++ ) {
+            if( bufferStates[i] == Pending ) {
+                buffer = i;
+            }
+        }
+        if( buffer == -1 ) {
+            if( stopping ) {
+                return;
+            }
+            stateChanged.wait( lock );
+            continue;
+        }
+        bufferStates[buffer] = Writing;
+        lock.unlock();
+        try {
+            WeightsPersister::writePersistArray( filepath, buffers[buffer], bufferUsedSizes[buffer] );
+        } catch( ... ) {
+            lock.lock();
+            writeError = std::current_exception();
+            bufferStates[buffer] = Free;
+            stateChanged.notify_all();
+            continue;
+        }
+        cout << "wrote weights to file, filesize " << ( bufferUsedSizes[buffer] / 1024 ) << "KB" << endl;
+        lock.lock();
+        numWritten++;
+        bufferStates[buffer] = Free;
+        stateChanged.notify_all();
+    }
+}
+
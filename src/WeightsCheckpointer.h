@@ -0,0 +1,71 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+class NeuralNet;
+class ResumeState;
+
+// writes weights files like WeightsPersister::persistWeights, but on a thread
+// of its own, so training only waits for the weights to be copied to host,
+// not for the file to be written
+// double-buffered: one buffer can be written whilst the next snapshot is
+// copied into the other.  if a snapshot is still waiting to be written when
+// the next one is taken, the older one is dropped, since only the latest
+// matters
+class DeepCL_EXPORT WeightsCheckpointer {
+public:
+    static const int Free = 0;
+    static const int Capturing = 1;
+    static const int Pending = 2;
+    static const int Writing = 3;
+
+    std::string filepath;
+    std::string trainingConfigString;
+    NeuralNet *net; // not owned by us
+    char *buffers[2];
+    int bufferSizes[2]; // allocated
+    int bufferUsedSizes[2]; // by the snapshot in the buffer
+    int bufferStates[2];
+    int numWritten;
+    int numDropped;
+
+    std::mutex mutex;
+    std::condition_variable stateChanged;
+    bool stopping;
+    std::exception_ptr writeError;
+    std::thread writer;
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    WeightsCheckpointer( std::string filepath, std::string trainingConfigString, NeuralNet *net );
+    ~WeightsCheckpointer();
+    int getNumWritten();
+    int getNumDropped();
+    void checkpoint( int epoch, int batch, float annealedLearningRate, int numRight, float loss );
+    void checkpoint( ResumeState const &resumeState );
+    void capture( ResumeState const &resumeState, bool withResumeSection );
+    void flush();
+    void rethrowWriteError();
+    void runWriter();
+
+    // [[[end]]]
+};
+
@@ -6,9 +6,14 @@
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
 
 #include "FileHelper.h"
 #include "NeuralNet.h"
+#include "MappedFile.h"
+#include "ResumeState.h"
 
 #include "WeightsPersister.h"
 
@@ -63,64 +68,256 @@ STATIC int WeightsPersister::getArrayOffsetForLayer( NeuralNet *net, int layer )
     }
     return pos;
 }
-STATIC void WeightsPersister::persistWeights( std::string filepath, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss ) {
-    int headerLength = 1024;
-    int totalWeightsSize = getTotalNumWeights( net );
-    char *persistArray = new char[headerLength + totalWeightsSize * sizeof(float) ];
+STATIC int WeightsPersister::alignToSection( int offset ) {
+    return ( offset + SectionAlignment - 1 ) / SectionAlignment * SectionAlignment;
+}
+// one section per layer with weights, not counting any resume state section
+STATIC int WeightsPersister::getNumSections( NeuralNet *net ) {
+    int numSections = 0;
+    for( int layerIdx = 1; layerIdx < (int)net->layers.size(); layerIdx++ ) {
+        if( net->layers[layerIdx]->getPersistSize() > 0 ) {
+            numSections++;
+        }
+    }
+    return numSections;
+}
+STATIC int WeightsPersister::getPersistArraySize( NeuralNet *net ) {
+    return getPersistArraySize( net, 0 );
+}
+// header, table of contents, then the sections, each aligned.  resumeState
+// can be 0
+STATIC int WeightsPersister::getPersistArraySize( NeuralNet *net, ResumeState const *resumeState ) {
+    int numSections = getNumSections( net ) + ( resumeState != 0 ? 1 : 0 );
+    int pos = alignToSection( HeaderSize + numSections * TocEntrySize );
+    for( int layerIdx = 1; layerIdx < (int)net->layers.size(); layerIdx++ ) {
+        int persistSize = net->layers[layerIdx]->getPersistSize();
+        if( persistSize > 0 ) {
+            pos = alignToSection( pos + persistSize * sizeof(float) );
+        }
+    }
+    if( resumeState != 0 ) {
+        pos = alignToSection( pos + resumeState->getSectionSize() );
+    }
+    return pos;
+}
+STATIC bool WeightsPersister::buildCrc32Table( unsigned int *table ) {
+    for( unsigned int i = 0; i < 256; i++ ) {
+        unsigned int crc = i;
+        for( int bit = 0; bit < 8; bit++ ) {
+            crc = ( crc & 1 ) ? ( 0xedb88320u ^ ( crc >> 1 ) ) : ( crc >> 1 );
+        }
+        table[i] = crc;
+    }
+    return true;
+}
+// standard crc-32, as used by zip and png
+STATIC unsigned int WeightsPersister::crc32( char const *data, long numBytes ) {
+    // initialized once, even if called from several threads
+    static unsigned int table[256];
+    static bool tableBuilt = buildCrc32Table( table );
+    (void)tableBuilt;
+    unsigned int crc = 0xffffffffu;
+    for( long i = 0; i < numBytes; i++ ) {
+        crc = table[ ( crc ^ (unsigned char)data[i] ) & 0xff ] ^ ( crc >> 8 );
+    }
+    return crc ^ 0xffffffffu;
+}
+STATIC void WeightsPersister::copyNetToPersistArray( char *persistArray, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss ) {
+    ResumeState resumeState( epoch );
+    resumeState.batch = batch;
+    resumeState.annealedLearningRate = annealedLearningRate;
+    resumeState.numRight = numRight;
+    resumeState.loss = loss;
+    copyNetToPersistArray( persistArray, trainingConfigString, net, resumeState, false );
+}
+// persistArray should be getPersistArraySize( net, &resumeState ) bytes, or
+// getPersistArraySize( net ) if withResumeSection is false.  leaves the
+// checksums for writePersistArray to fill in, so they can be calculated off
+// the training thread
+STATIC void WeightsPersister::copyNetToPersistArray( char *persistArray, std::string trainingConfigString, NeuralNet *net, ResumeState const &resumeState, bool withResumeSection ) {
+    int numSections = getNumSections( net ) + ( withResumeSection ? 1 : 0 );
     int *persistArrayInts = reinterpret_cast<int *>(persistArray);
     float *persistArrayFloats = reinterpret_cast<float *>(persistArray);
+    int pos = alignToSection( HeaderSize + numSections * TocEntrySize );
+    memset( persistArray, 0, pos );
     strcpy_safe( persistArray, "ClCn", 4 ); // so easy to recognise file type
-    persistArrayInts[1] = 1; // data file version number
-    persistArrayInts[2] = epoch;
-    persistArrayInts[3] = batch;
-    persistArrayInts[4] = numRight;
-    persistArrayFloats[5] = loss;
-    persistArrayFloats[6] = annealedLearningRate;
+    persistArrayInts[1] = 3; // data file version number
+    persistArrayInts[2] = resumeState.epoch;
+    persistArrayInts[3] = resumeState.batch;
+    persistArrayInts[4] = resumeState.numRight;
+    persistArrayFloats[5] = resumeState.loss;
+    persistArrayFloats[6] = resumeState.annealedLearningRate;
     strcpy_safe( persistArray + 7 * 4, trainingConfigString.c_str(), 800 );
-    copyNetWeightsToArray( net, reinterpret_cast<float *>(persistArray + headerLength) );
-    FileHelper::writeBinary( "~" + filepath, reinterpret_cast<char *>(persistArray), 
-        headerLength + totalWeightsSize * sizeof(float) );
+    persistArrayInts[224] = numSections;
+    persistArrayInts[225] = HeaderSize; // offset of table of contents
+    int section = 0;
+    for( int layerIdx = 1; layerIdx < (int)net->layers.size(); layerIdx++ ) {
+        Layer *layer = net->layers[layerIdx];
+        int persistSize = layer->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        int *tocEntry = reinterpret_cast<int *>( persistArray + HeaderSize + section * TocEntrySize );
+        tocEntry[0] = layerIdx;
+        tocEntry[1] = persistSize * sizeof(float);
+        tocEntry[2] = pos;
+        layer->persistToArray( reinterpret_cast<float *>( persistArray + pos ) );
+        int sectionEnd = pos + persistSize * sizeof(float);
+        pos = alignToSection( sectionEnd );
+        memset( persistArray + sectionEnd, 0, pos - sectionEnd );
+        section++;
+    }
+    if( withResumeSection ) {
+        int *tocEntry = reinterpret_cast<int *>( persistArray + HeaderSize + section * TocEntrySize );
+        tocEntry[0] = ResumeSection;
+        tocEntry[1] = resumeState.getSectionSize();
+        tocEntry[2] = pos;
+        resumeState.writeSection( persistArray + pos );
+        int sectionEnd = pos + tocEntry[1];
+        memset( persistArray + sectionEnd, 0, alignToSection( sectionEnd ) - sectionEnd );
+    }
+}
+STATIC void WeightsPersister::addChecksums( char *persistArray ) {
+    int *persistArrayInts = reinterpret_cast<int *>(persistArray);
+    int numSections = persistArrayInts[224];
+    for( int section = 0; section < numSections; section++ ) {
+        int *tocEntry = reinterpret_cast<int *>( persistArray + HeaderSize + section * TocEntrySize );
+        tocEntry[3] = (int)crc32( persistArray + tocEntry[2], tocEntry[1] );
+    }
+    persistArrayInts[227] = (int)crc32( persistArray + HeaderSize, numSections * TocEntrySize );
+    persistArrayInts[226] = (int)crc32( persistArray, 226 * 4 );
+}
+// writes to a temporary file first, then renames it, so filepath is never
+// left half-written
+STATIC void WeightsPersister::writePersistArray( std::string filepath, char *persistArray, int persistArraySize ) {
+    addChecksums( persistArray );
+    FileHelper::writeBinary( "~" + filepath, persistArray, persistArraySize );
     FileHelper::remove( filepath );
     FileHelper::rename( "~" + filepath, filepath );
-    std::cout << "wrote weights to file, filesize " << ( ( headerLength + totalWeightsSize ) *sizeof(float)/1024) << "KB" << std::endl;
+}
+STATIC void WeightsPersister::persistWeights( std::string filepath, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss ) {
+    int persistArraySize = getPersistArraySize( net );
+    char *persistArray = new char[persistArraySize];
+    copyNetToPersistArray( persistArray, trainingConfigString, net, epoch, batch, annealedLearningRate, numRight, loss );
+    writePersistArray( filepath, persistArray, persistArraySize );
+    std::cout << "wrote weights to file, filesize " << ( persistArraySize / 1024 ) << "KB" << std::endl;
     delete[] persistArray;
 }
 STATIC bool WeightsPersister::loadWeights( std::string filepath, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss ) {
-    if( FileHelper::exists( filepath ) ){
-        int headerSize = 1024;
-        long fileSize;
-        char * data = FileHelper::readBinary( filepath, &fileSize );
-        data[headerSize - 1] = 0; // null-terminate the string, if not already done
-        float *allWeightsArray = reinterpret_cast<float *>(data + headerSize);
-        std::cout << "read weights from file "  << (fileSize/1024) << "KB" << std::endl;
-        int expectedTotalWeightsSize = getTotalNumWeights( net );
-        int numFloatsRead = ( fileSize - headerSize ) / sizeof( float );
-        if( expectedTotalWeightsSize != numFloatsRead ) {
-            throw std::runtime_error("weights file contains " + toString(numFloatsRead) + " floats, but we expect to see: " + toString( expectedTotalWeightsSize ) + ".  So there is probably some mismatch between the weights file, and the settings, or network version, used." );
+    ResumeState resumeState;
+    if( !loadWeights( filepath, trainingConfigString, net, &resumeState ) ) {
+        return false;
+    }
+    *p_epoch = resumeState.epoch;
+    *p_batch = resumeState.batch;
+    *p_numRight = resumeState.numRight;
+    *p_loss = resumeState.loss;
+    *p_annealedLearningRate = resumeState.annealedLearningRate;
+    return true;
+}
+// reads version 1, 2 and 3 files.  the file is mapped, rather than read,
+// and each layer's weights go straight from the mapping to the layer.
+// resumeState gets the permutation and random state too, if the file has them
+STATIC bool WeightsPersister::loadWeights( std::string filepath, std::string trainingConfigString, NeuralNet *net, ResumeState *resumeState ) {
+    if( !FileHelper::exists( filepath ) ) {
+        return false;
+    }
+    MappedFile file( filepath );
+    char const *data = file.getData();
+    long fileSize = file.getSize();
+    std::cout << "read weights from file "  << (fileSize/1024) << "KB" << std::endl;
+    if( fileSize < HeaderSize || data[0] != 'C' || data[1] != 'l' || data[2] != 'C' || data[3] != 'n' ) {
+        std::cout << "weights file not ClConvolve format" << std::endl;
+        return false;
+    }
+    int const *dataAsInts = reinterpret_cast<int const *>(data);
+    float const *dataAsFloats = reinterpret_cast<float const *>(data);
+    int version = dataAsInts[1];
+    if( version < 1 || version > 3 ) {
+        std::cout << "weights file version not known" << std::endl;
+        return false;
+    }
+    if( version >= 2 && (unsigned int)dataAsInts[226] != crc32( data, 226 * 4 ) ) {
+        throw std::runtime_error("weights file " + filepath + " is corrupt: header checksum doesnt match");
+    }
+    char const *configStringEnd = std::find( data + 7 * 4, data + HeaderSize - 1, '\0' );
+    if( trainingConfigString != std::string( data + 7 * 4, configStringEnd ) ) {
+        std::cout << "training options dont match weights file" << std::endl;
+        return false;
+    }
+    *resumeState = ResumeState( dataAsInts[2] );
+    resumeState->batch = dataAsInts[3];
+    resumeState->numRight = dataAsInts[4];
+    resumeState->loss = dataAsFloats[5];
+    resumeState->annealedLearningRate = dataAsFloats[6];
+    if( version == 1 ) {
+        loadWeightsV1( data, fileSize, net );
+    } else {
+        loadWeightsV2( filepath, version, data, fileSize, net, resumeState );
+    }
+    return true;
+}
+// version 1: one flat array of floats, after the header
+STATIC void WeightsPersister::loadWeightsV1( char const *data, long fileSize, NeuralNet *net ) {
+    int expectedTotalWeightsSize = getTotalNumWeights( net );
+    int numFloatsRead = ( fileSize - HeaderSize ) / sizeof( float );
+    if( expectedTotalWeightsSize != numFloatsRead ) {
+        throw std::runtime_error("weights file contains " + toString(numFloatsRead) + " floats, but we expect to see: " + toString( expectedTotalWeightsSize ) + ".  So there is probably some mismatch between the weights file, and the settings, or network version, used." );
+    }
+    copyArrayToNetWeights( reinterpret_cast<float const *>(data + HeaderSize), net );
+}
+// size field of a table of contents entry, in bytes: version 2 counted floats
+STATIC long WeightsPersister::sectionBytes( int version, int const *tocEntry ) {
+    return version == 2 ? (long)tocEntry[1] * (long)sizeof(float) : tocEntry[1];
+}
+// versions 2 and 3: checks everything first, so the net is untouched if the
+// file is corrupt, or doesnt match
+STATIC void WeightsPersister::loadWeightsV2( std::string filepath, int version, char const *data, long fileSize, NeuralNet *net, ResumeState *resumeState ) {
+    int const *dataAsInts = reinterpret_cast<int const *>(data);
+    int numSections = dataAsInts[224];
+    int tocOffset = dataAsInts[225];
+    if( numSections < 0 || tocOffset < HeaderSize || tocOffset + (long)numSections * TocEntrySize > fileSize
+            || (unsigned int)dataAsInts[227] != crc32( data + tocOffset, numSections * TocEntrySize ) ) {
+        throw std::runtime_error("weights file " + filepath + " is corrupt: table of contents checksum doesnt match");
+    }
+    std::vector< int > layerSections( net->layers.size(), -1 );
+    int resumeSection = -1;
+    int numLayerSections = 0;
+    for( int section = 0; section < numSections; section++ ) {
+        int const *tocEntry = reinterpret_cast<int const *>( data + tocOffset + section * TocEntrySize );
+        const long sectionSize = sectionBytes( version, tocEntry );
+        // the table's checksum only says it was written like this, so check it
+        // points inside the file before reading anything it points at
+        if( tocEntry[2] < HeaderSize || tocEntry[2] % SectionAlignment != 0 || sectionSize < 0 || tocEntry[2] + sectionSize > fileSize ) {
+            throw std::runtime_error("weights file " + filepath + " is corrupt: section " + toString( section ) + " is outside the file");
         }
-        int *dataAsInts = reinterpret_cast<int *>(data);
-        float *dataAsFloats = reinterpret_cast<float *>(data);
-        if( data[0] != 'C' || data[1] != 'l' || data[2] != 'C' || data[3] != 'n' ) {
-            std::cout << "weights file not ClConvolve format" << std::endl;
-            return false;
+        if( (unsigned int)tocEntry[3] != crc32( data + tocEntry[2], sectionSize ) ) {
+            throw std::runtime_error("weights file " + filepath + " is corrupt: checksum doesnt match for section " + toString( section ) );
         }
-        if( dataAsInts[1] != 1 ) {
-            std::cout << "weights file version not known" << std::endl;
-            return false;
+        if( tocEntry[0] == ResumeSection && version >= 3 ) {
+            resumeSection = section;
+            continue;
         }
-        if( trainingConfigString != std::string( data + 7 * 4 ) ) {
-            std::cout << "training options dont match weights file" << std::endl;
-            return false;
+        int layerIdx = tocEntry[0];
+        if( layerIdx < 1 || layerIdx >= (int)net->layers.size() || sectionSize != net->layers[layerIdx]->getPersistSize() * (long)sizeof(float) ) {
+            throw std::runtime_error("weights file has " + toString( sectionSize / sizeof(float) ) + " weights for layer " + toString( layerIdx ) + ", which doesnt match the net.  So there is probably some mismatch between the weights file, and the settings, or network version, used." );
         }
-        *p_epoch = dataAsInts[2];
-        *p_batch = dataAsInts[3];
-        *p_numRight = dataAsInts[4];
-        *p_loss = dataAsFloats[5];
-        *p_annealedLearningRate = dataAsFloats[6];
-        copyArrayToNetWeights( allWeightsArray, net );
-        delete [] data;
-        return true;
-    }
-    return false;
+        layerSections[layerIdx] = section;
+        numLayerSections++;
+    }
+    if( numLayerSections != getNumSections( net ) ) {
+        throw std::runtime_error("weights file contains " + toString( numLayerSections ) + " layers with weights, but we expect to see: " + toString( getNumSections( net ) ) + ".  So there is probably some mismatch between the weights file, and the settings, or network version, used." );
+    }
+    if( resumeSection != -1 ) {
+        int const *tocEntry = reinterpret_cast<int const *>( data + tocOffset + resumeSection * TocEntrySize );
+        resumeState->readSection( data + tocEntry[2], tocEntry[1] );
+    }
+    for( int layerIdx = 1; layerIdx < (int)net->layers.size(); layerIdx++ ) {
+        if( layerSections[layerIdx] == -1 ) {
+            continue;
+        }
+        int const *tocEntry = reinterpret_cast<int const *>( data + tocOffset + layerSections[layerIdx] * TocEntrySize );
+        net->layers[layerIdx]->unpersistFromArray( reinterpret_cast<float const *>( data + tocEntry[2] ) );
+    }
 }
 
@@ -4,6 +4,7 @@
 #include <string>
 
 class NeuralNet;
+class ResumeState;
 
 #define VIRTUAL virtual
 #define STATIC static
@@ -17,9 +18,27 @@ class NeuralNet;
 // target usage for this class:
 // - quickly snapshotting the weights after each epoch, therefore should be:
 //    - fast, low IO :-)
+//
+// version 3 files, as written now:
+// - 1024 byte header: "ClCn", version, epoch, batch, numRight, loss, annealed
+//   learning rate, then the training config string from byte 28; at int 224
+//   the number of sections, then the offset of the table of contents, then
+//   the crc-32 of the header up to there, then the crc-32 of the table
+// - table of contents: one 32 byte entry per section: layer index, size of
+//   the section in bytes, offset of the section, crc-32 of the section
+// - the sections, each starting on a 64 byte boundary, so they can be used
+//   directly from a mapping of the file: one per layer with weights, then
+//   optionally one with the rest of a ResumeState, with layer index 0
+// version 2 files are the same, but with the size of each section in floats,
+// and no ResumeState section.  they, and version 1 files, which are just the
+// header, up to the config string, then all the weights, can still be loaded
 class DeepCL_EXPORT WeightsPersister {
 public:
-    
+    static const int HeaderSize = 1024;
+    static const int TocEntrySize = 32;
+    static const int SectionAlignment = 64;
+    static const int ResumeSection = 0; // layer index of the resume state section
+
     // [[[cog
     // import cog_addheaders
     // cog_addheaders.add()
@@ -30,8 +49,22 @@ public:
     STATIC void copyNetWeightsToArray( NeuralNet *net, float *target );
     STATIC void copyArrayToNetWeights( float const*source, NeuralNet *net );
     STATIC int getArrayOffsetForLayer( NeuralNet *net, int layer );
+    STATIC int alignToSection( int offset );
+    STATIC int getNumSections( NeuralNet *net );
+    STATIC int getPersistArraySize( NeuralNet *net );
+    STATIC int getPersistArraySize( NeuralNet *net, ResumeState const *resumeState );
+    STATIC bool buildCrc32Table( unsigned int *table );
+    STATIC unsigned int crc32( char const *data, long numBytes );
+    STATIC void copyNetToPersistArray( char *persistArray, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss );
+    STATIC void copyNetToPersistArray( char *persistArray, std::string trainingConfigString, NeuralNet *net, ResumeState const &resumeState, bool withResumeSection );
+    STATIC void addChecksums( char *persistArray );
+    STATIC void writePersistArray( std::string filepath, char *persistArray, int persistArraySize );
     STATIC void persistWeights( std::string filepath, std::string trainingConfigString, NeuralNet *net, int epoch, int batch, float annealedLearningRate, int numRight, float loss );
     STATIC bool loadWeights( std::string filepath, std::string trainingConfigString, NeuralNet *net, int *p_epoch, int *p_batch, float *p_annealedLearningRate, int *p_numRight, float *p_loss );
+    STATIC bool loadWeights( std::string filepath, std::string trainingConfigString, NeuralNet *net, ResumeState *resumeState );
+    STATIC void loadWeightsV1( char const *data, long fileSize, NeuralNet *net );
+    STATIC long sectionBytes( int version, int const *tocEntry );
+    STATIC void loadWeightsV2( std::string filepath, int version, char const *data, long fileSize, NeuralNet *net, ResumeState *resumeState );
 
     // [[[end]]]
 };
@@ -0,0 +1,147 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "stringhelper.h"
+
+#include "ZeroCopy.h"
+
+using namespace std;
+
+#undef VIRTUAL
+#define VIRTUAL 
+#undef STATIC
+#define STATIC
+
+// intel's cpu runtime only avoids the copy if the host pointer is 4096-byte aligned,
+// and the size a multiple of 64 bytes
+#define ZEROCOPY_ALIGNMENT 4096
+#define ZEROCOPY_SIZE_MULTIPLE 64
+
+void ZeroCopyWrapperBase::createWithHostPtr( void *hostarray ) {
+    cl_int err;
+    devicearray = clCreateBuffer( *(cl->context), CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, N * getElementSize(), hostarray, &err );
+    OpenCLHelper::checkError( err );
+    onDevice = true;
+}
+// blocking map then unmap: after this, the host array and the device buffer agree
+// use CL_MAP_READ after the device has written, CL_MAP_WRITE after the host has written
+void ZeroCopyWrapperBase::mapUnmap( cl_map_flags flags ) {
+    cl_int err;
+    void *mapped = clEnqueueMapBuffer( *(cl->queue), devicearray, CL_TRUE, flags, 0, N * getElementSize(), 0, 0, 0, &err );
+    OpenCLHelper::checkError( err );
+    err = clEnqueueUnmapMemObject( *(cl->queue), devicearray, mapped, 0, 0, 0 );
+    OpenCLHelper::checkError( err );
+}
+
+// cached per device, since wrap is called on every propagate and backprop
+STATIC bool ZeroCopy::isHostUnifiedMemory( OpenCLHelper *cl ) {
+    static std::mutex cacheMutex;
+    static std::map< cl_device_id, bool > cache;
+    std::lock_guard< std::mutex > lock( cacheMutex );
+    std::map< cl_device_id, bool >::iterator it = cache.find( cl->device );
+    if( it != cache.end() ) {
+        return it->second;
+    }
+    cl_bool hostUnifiedMemory = CL_FALSE;
+    cl_int err = clGetDeviceInfo( cl->device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof( cl_bool ), &hostUnifiedMemory, 0 );
+    bool result = err == CL_SUCCESS && hostUnifiedMemory == CL_TRUE;
+    cache[ cl->device ] = result;
+    return result;
+}
+// only arrays from allocate() are aligned enough for the driver to use them
+// in place; CL_MEM_USE_HOST_PTR over anything else can silently copy
+STATIC bool ZeroCopy::canWrapInPlace( OpenCLHelper *cl, void const *array ) {
+    return ( reinterpret_cast< size_t >( array ) % ZEROCOPY_ALIGNMENT ) == 0 && isHostUnifiedMemory( cl );
+}
+// allocate host arrays that will be wrapped using wrap() with these, and free
+// them with deallocate(), rather than new/delete[]
+STATIC float *ZeroCopy::allocateFloats( int N ) {
+    return static_cast< float * >( allocate( N * sizeof( float ) ) );
+}
+STATIC int *ZeroCopy::allocateInts( int N ) {
+    return static_cast< int * >( allocate( N * sizeof( int ) ) );
+}
+STATIC unsigned char *ZeroCopy::allocateBytes( int N ) {
+    return static_cast< unsigned char * >( allocate( N ) );
+}
+STATIC void *ZeroCopy::allocate( int numBytes ) {
+    int roundedBytes = ( ( numBytes + ZEROCOPY_SIZE_MULTIPLE - 1 ) / ZEROCOPY_SIZE_MULTIPLE ) * ZEROCOPY_SIZE_MULTIPLE;
+    if( roundedBytes == 0 ) {
+        roundedBytes = ZEROCOPY_SIZE_MULTIPLE;
+    }
+    void *array = 0;
+#ifdef _WIN32
+    array = _aligned_malloc( roundedBytes, ZEROCOPY_ALIGNMENT );
+#else
+    if( posix_memalign( &array, ZEROCOPY_ALIGNMENT, roundedBytes ) != 0 ) {
+        array = 0;
+    }
+#endif
+    if( array == 0 ) {
+        throw runtime_error("ZeroCopy::allocate failed to allocate " + toString( numBytes ) + " bytes" );
+    }
+    return array;
+}
+STATIC void ZeroCopy::deallocate( void *array ) {
+    if( array == 0 ) {
+        return;
+    }
+#ifdef _WIN32
+    _aligned_free( array );
+#else
+    free( array );
+#endif
+}
+STATIC CLWrapper *ZeroCopy::wrap( OpenCLHelper *cl, int N, float *array ) {
+    if( canWrapInPlace( cl, array ) ) {
+        return new ZeroCopyWrapper< float >( N, array, cl );
+    }
+    return cl->wrap( N, array );
+}
+STATIC CLWrapper *ZeroCopy::wrap( OpenCLHelper *cl, int N, int *array ) {
+    if( canWrapInPlace( cl, array ) ) {
+        return new ZeroCopyWrapper< int >( N, array, cl );
+    }
+    return cl->wrap( N, array );
+}
+STATIC CLWrapper *ZeroCopy::wrap( OpenCLHelper *cl, int N, unsigned char *array ) {
+    if( canWrapInPlace( cl, array ) ) {
+        return new ZeroCopyWrapper< unsigned char >( N, array, cl );
+    }
+    return cl->wrap( N, array );
+}
+STATIC void ZeroCopy::copyToHost( CLWrapper *wrapper ) {
+    ZeroCopyWrapperBase *zeroCopyWrapper = dynamic_cast< ZeroCopyWrapperBase * >( wrapper );
+    if( zeroCopyWrapper != 0 ) {
+        zeroCopyWrapper->mapUnmap( CL_MAP_READ );
+    } else {
+        wrapper->copyToHost();
+    }
+}
+STATIC void ZeroCopy::copyToDevice( CLWrapper *wrapper ) {
+    ZeroCopyWrapperBase *zeroCopyWrapper = dynamic_cast< ZeroCopyWrapperBase * >( wrapper );
+    if( zeroCopyWrapper != 0 ) {
+        zeroCopyWrapper->mapUnmap( CL_MAP_WRITE );
+    } else {
+        wrapper->copyToDevice();
+    }
+}
+STATIC void ZeroCopy::createOnDevice( CLWrapper *wrapper ) {
+    if( dynamic_cast< ZeroCopyWrapperBase * >( wrapper ) == 0 ) {
+        wrapper->createOnDevice();
+    }
+}
+
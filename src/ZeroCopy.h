@@ -0,0 +1,84 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "OpenCLHelper.h"
+
+#define VIRTUAL virtual
+#define STATIC static
+
+#include "DeepCLDllExport.h"
+
+// a CLWrapper whose device buffer is created with CL_MEM_USE_HOST_PTR, over the
+// caller's host array, so on a device with host-unified memory, eg a cpu opencl
+// device, or an integrated gpu, the host array and the device buffer are the 
+// same memory
+// synchronize using map/unmap, via ZeroCopy::copyToHost and ZeroCopy::copyToDevice,
+// rather than copyToHost/copyToDevice, which would memcpy the array onto itself
+// dont call createOnDevice() on these, the buffer is created by the constructor
+class DeepCL_EXPORT ZeroCopyWrapperBase : public CLWrapper {
+public:
+    ZeroCopyWrapperBase( int N, OpenCLHelper *cl ) :
+        CLWrapper( N, cl ) {
+    }
+    void createWithHostPtr( void *hostarray );
+    void mapUnmap( cl_map_flags flags );
+};
+
+template< typename T >
+class DeepCL_EXPORT ZeroCopyWrapper : public ZeroCopyWrapperBase {
+public:
+    T *hostarray; // NOT owned by us
+    ZeroCopyWrapper( int N, T *hostarray, OpenCLHelper *cl ) :
+            ZeroCopyWrapperBase( N, cl ),
+            hostarray( hostarray ) {
+        createWithHostPtr( hostarray );
+    }
+    virtual void *getHostArray() {
+        return hostarray;
+    }
+    virtual void const *getHostArrayConst() {
+        return hostarray;
+    }
+    virtual int getElementSize() {
+        return sizeof( T );
+    }
+};
+
+// the buffer strategy for layer results, gradients, and weights:
+// - on devices with host-unified memory, allocate the host arrays page-aligned,
+//   and wrap them in ZeroCopyWrapper, so there are no copies between host and device,
+//   just map/unmap to keep the views coherent
+//   arrays that dont come from allocate() fall back to cl->wrap, since they
+//   might not be aligned enough to use in place
+// - otherwise, plain cl->wrap, and the usual copyToHost/copyToDevice
+// the static copyToHost/copyToDevice/createOnDevice work for either kind of wrapper
+class DeepCL_EXPORT ZeroCopy {
+public:
+
+    // [[[cog
+    // import cog_addheaders
+    // cog_addheaders.add()
+    // ]]]
+    // generated, using cog:
+    STATIC bool isHostUnifiedMemory( OpenCLHelper *cl );
+    STATIC bool canWrapInPlace( OpenCLHelper *cl, void const *array );
+    STATIC float *allocateFloats( int N );
+    STATIC int *allocateInts( int N );
+    STATIC unsigned char *allocateBytes( int N );
+    STATIC void *allocate( int numBytes );
+    STATIC void deallocate( void *array );
+    STATIC CLWrapper *wrap( OpenCLHelper *cl, int N, float *array );
+    STATIC CLWrapper *wrap( OpenCLHelper *cl, int N, int *array );
+    STATIC CLWrapper *wrap( OpenCLHelper *cl, int N, unsigned char *array );
+    STATIC void copyToHost( CLWrapper *wrapper );
+    STATIC void copyToDevice( CLWrapper *wrapper );
+    STATIC void createOnDevice( CLWrapper *wrapper );
+
+    // [[[end]]]
+};
+
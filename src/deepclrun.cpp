@@ -7,6 +7,9 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <thread>
+#include <chrono>
 
 #include "GenericLoader.h"
 #include "Timer.h"
@@ -15,13 +18,22 @@
 #include "FileHelper.h"
 #include "StatefulTimer.h"
 #include "WeightsPersister.h"
+#include "WeightsCheckpointer.h"
+#include "ResumeState.h"
 #include "NormalizationHelper.h"
 //#include "BatchLearner.h"
 #include "NetdefToNet.h"
 #include "NetLearner.h"
 #include "MultiNet.h"
+#include "DataParallelNet.h"
+#include "HogwildLearner.h"
+#include "RingAllReduce.h"
+#include "DistributedNet.h"
 #include "BatchProcess.h"
 #include "NetLearnerOnDemand.h"
+#include "NetLearnerOnDevice.h"
+#include "DeviceDataset.h"
+#include "InferenceServer.h"
 
 using namespace std;
 
@@ -49,7 +61,21 @@ using namespace std;
         ('multiNet', 'int', 'number of Mcdnn columns to train', 1),
         ('loadOnDemand', 'int', 'load data on demand [1|0]', 0),
         ('fileReadBatches', 'int', 'how many batches to read from file each time? (for loadondemand=1)', 50),
-        ('normalizationExamples', 'int', 'number of examples to read to determine normalization parameters', 10000)
+        ('normalizationExamples', 'int', 'number of examples to read to determine normalization parameters', 10000),
+        ('deviceData', 'int', 'upload whole dataset to device once, and build batches there [1|0]', 0),
+        ('shuffle', 'int', 'with devicedata=1, visit the training examples in a new random order each epoch [1|0]', 0),
+        ('recomputeEvery', 'int', 'keep layer results only every this many layers, and recompute the others during backprop, to save memory (0 = off)', 0),
+        ('fastMath', 'int', 'use fast approximations to tanh, sigmoid and exp, in activations and softmax [1|0]', 0),
+        ('dataParallel', 'int', 'number of copies of the net to train at once, on separate threads, each on its own slice of each batch', 1),
+        ('hogwild', 'int', 'number of threads for asynchronous lock-free training, each with its own copy of the net, and its own batches (0 = off)', 0),
+        ('worldSize', 'int', 'number of processes training together, each on its own slice of the training data', 1),
+        ('rank', 'int', 'which of the worldsize processes this is, from 0', 0),
+        ('hosts', 'string', 'comma-separated host of each process, in rank order (default: all on this machine)', ''),
+        ('basePort', 'int', 'process with rank r listens on port baseport + r', 23456),
+        ('writeWeightsEvery', 'int', 'also write the weights file every this many batches (0 = only after each epoch)', 0),
+        ('serve', 'string', 'instead of training, serve predictions to clients on this machine, on tcp:port or unix:path; needs loadweights=1', ''),
+        ('serveMaxBatch', 'int', 'with serve, largest batch to gather requests into', 32),
+        ('serveMaxLatency', 'int', 'with serve, longest a request waits for others to batch with, in microseconds', 2000)
     ]
 *///]]]
 // [[[end]]]
@@ -82,6 +108,20 @@ public:
     int loadOnDemand;
     int fileReadBatches;
     int normalizationExamples;
+    int deviceData;
+    int shuffle;
+    int recomputeEvery;
+    int fastMath;
+    int dataParallel;
+    int hogwild;
+    int worldSize;
+    int rank;
+    string hosts;
+    int basePort;
+    int writeWeightsEvery;
+    string serve;
+    int serveMaxBatch;
+    int serveMaxLatency;
     // [[[end]]]
 
     Config() {
@@ -128,28 +168,82 @@ public:
         loadOnDemand = 0;
         fileReadBatches = 50;
         normalizationExamples = 10000;
+        deviceData = 0;
+        shuffle = 0;
+        recomputeEvery = 0;
+        fastMath = 0;
+        dataParallel = 1;
+        hogwild = 0;
+        worldSize = 1;
+        rank = 0;
+        hosts = "";
+        basePort = 23456;
+        writeWeightsEvery = 0;
+        serve = "";
+        serveMaxBatch = 32;
+        serveMaxLatency = 2000;
         // [[[end]]]
     }
     string getTrainingString() {
         string configString = "";
         configString += "netDef=" + netDef + " trainFile=" + trainFile;
+        // devicedata=1 nets have no NormalizationLayer, so every layer after
+        // the input has a different index.  only added when set, so existing
+        // weights files still match
+        if( deviceData ) {
+            configString += " deviceData=1";
+        }
         return configString;
     }
 };
 
-class WeightsWriter : public PostEpochAction {
+// writes in the background, so training carries on whilst the file is written
+// does nothing if there is no weights file
+class WeightsWriter : public PostEpochAction, public PostBatchAction {
 public:
-    NeuralNet *net;
+    WeightsCheckpointer *checkpointer;
     Config *config;
     WeightsWriter( NeuralNet *net, Config *config ) :
-        net( net ),
+        checkpointer( 0 ),
         config( config ) {
+        if( config->weightsFile != "" ) {
+            checkpointer = new WeightsCheckpointer( config->weightsFile, config->getTrainingString(), net );
+        }
+    }
+    ~WeightsWriter() {
+        delete checkpointer;
     }
     virtual void run( int epoch ) {
-        WeightsPersister::persistWeights( config->weightsFile, config->getTrainingString(), net, epoch + 1, 0, 0, 0, 0 );
+        if( checkpointer != 0 ) {
+            checkpointer->checkpoint( ResumeState( epoch + 1 ) );
+        }
+    }
+    // mid-epoch, so the file records exactly where to carry on from
+    virtual void run( ResumeState const &progress ) {
+        if( checkpointer != 0 && config->writeWeightsEvery > 0 && progress.batch % config->writeWeightsEvery == 0 ) {
+            checkpointer->checkpoint( progress );
+        }
     }
 };
 
+// runs until killed, printing stats every so often
+void serve( NeuralNet *net, Config const &config ) {
+    InferenceServer server( net, config.serveMaxBatch, config.serveMaxLatency );
+    server.listen( config.serve );
+    server.start();
+    cout << "serving on " << config.serve << ", inputs of " << net->getInputCubeSize() << " floats, outputs of "
+        << net->getOutputCubeSize() << " floats" << endl;
+    long long numRequests = 0;
+    while( true ) {
+        std::this_thread::sleep_for( std::chrono::seconds( 10 ) );
+        InferenceServerStats stats = server.getStats();
+        if( stats.numRequests != numRequests ) {
+            cout << InferenceServer::statsToString( stats ) << endl;
+            numRequests = stats.numRequests;
+        }
+    }
+}
+
 void go(Config config) {
     Timer timer;
 
@@ -241,23 +335,69 @@ void go(Config config) {
 
 //    const int numToTrain = Ntrain;
 //    const int batchSize = config.batchSize;
+    if( config.deviceData && ( config.loadOnDemand || config.multiNet > 1 || config.dataParallel > 1 ) ) {
+        cout << "Error: devicedata=1 cannot be combined with loadondemand=1, multinet > 1 or dataparallel > 1" << endl;
+        return;
+    }
+    if( config.shuffle && !config.deviceData ) {
+        cout << "Error: shuffle=1 needs devicedata=1" << endl;
+        return;
+    }
+    if( config.multiNet > 1 && config.dataParallel > 1 ) {
+        cout << "Error: multinet > 1 cannot be combined with dataparallel > 1" << endl;
+        return;
+    }
+    if( config.hogwild > 0 && ( config.deviceData || config.loadOnDemand || config.multiNet > 1 || config.dataParallel > 1 ) ) {
+        cout << "Error: hogwild cannot be combined with devicedata=1, loadondemand=1, multinet > 1 or dataparallel > 1" << endl;
+        return;
+    }
+    if( config.writeWeightsEvery > 0 && config.hogwild > 0 ) {
+        cout << "Error: writeweightsevery cannot be combined with hogwild" << endl;
+        return;
+    }
+    if( config.worldSize > 1 && ( config.deviceData || config.loadOnDemand || config.multiNet > 1 || config.dataParallel > 1 || config.hogwild > 0 ) ) {
+        cout << "Error: worldsize > 1 cannot be combined with devicedata=1, loadondemand=1, multinet > 1, dataparallel > 1 or hogwild" << endl;
+        return;
+    }
+    if( config.serve != "" && ( config.deviceData || config.multiNet > 1 || config.dataParallel > 1 || config.hogwild > 0 || config.worldSize > 1 ) ) {
+        cout << "Error: serve cannot be combined with devicedata=1, multinet > 1, dataparallel > 1, hogwild or worldsize > 1" << endl;
+        return;
+    }
+    if( config.worldSize > 1 ) {
+        // same number of examples, so the same number of batches, on every process
+        const int shardSize = Ntrain / config.worldSize;
+        const int shardOffset = config.rank * shardSize;
+        memmove( trainData, trainData + (long)shardOffset * inputCubeSize, (long)shardSize * inputCubeSize );
+        memmove( trainLabels, trainLabels + shardOffset, shardSize * sizeof(int) );
+        Ntrain = shardSize;
+        cout << "rank " << config.rank << " of " << config.worldSize << ", training on examples " << shardOffset << " to " << ( shardOffset + shardSize - 1 ) << endl;
+    }
     NeuralNet *net = new NeuralNet();
 //    net->inputMaker<unsigned char>()->numPlanes(numPlanes)->imageSize(imageSize)->insert();
-    net->addLayer( InputLayerMaker<unsigned char>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
-    net->addLayer( NormalizationLayerMaker::instance()->translate(translate)->scale(scale) );
-    if( !NetdefToNet::createNetFromNetdef( net, config.netDef ) ) {
+    if( config.deviceData ) {
+        // DeviceDataset does the normalization, as it gathers each batch
+        net->addLayer( InputLayerMaker<float>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+    } else if( config.serve != "" ) {
+        // clients send the raw values, as floats
+        net->addLayer( InputLayerMaker<float>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+        net->addLayer( NormalizationLayerMaker::instance()->translate(translate)->scale(scale) );
+    } else {
+        net->addLayer( InputLayerMaker<unsigned char>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+        net->addLayer( NormalizationLayerMaker::instance()->translate(translate)->scale(scale) );
+    }
+    if( !NetdefToNet::createNetFromNetdef( net, config.netDef, config.fastMath ) ) {
         return;
     }
     net->print();
+    if( config.recomputeEvery > 0 ) {
+        net->setCheckpointEvery( config.recomputeEvery );
+    }
 
     bool afterRestart = false;
-    int restartEpoch = 0;
-    int restartBatch = 0;
-    float restartAnnealedLearningRate = 0;
-    int restartNumRight = 0;
-    float restartLoss = 0;
-    if( config.loadWeights && config.weightsFile != "" ) {
-        afterRestart = WeightsPersister::loadWeights( config.weightsFile, config.getTrainingString(), net, &restartEpoch, &restartBatch, &restartAnnealedLearningRate, &restartNumRight, &restartLoss );
+    ResumeState resumeState;
+    // with worldsize > 1, rank 0 passes what it loaded on to the other ranks
+    if( config.loadWeights && config.weightsFile != "" && ( config.worldSize <= 1 || config.rank == 0 ) ) {
+        afterRestart = WeightsPersister::loadWeights( config.weightsFile, config.getTrainingString(), net, &resumeState );
         if( !afterRestart && FileHelper::exists( config.weightsFile ) ) {
             cout << "Weights file " << config.weightsFile << " exists, but doesnt match training options provided => aborting" << endl;
             cout << "Please either check the training options, or choose a weights file that doesnt exist yet" << endl;
@@ -265,6 +405,15 @@ void go(Config config) {
         }
     }
 
+    if( config.serve != "" ) {
+        if( !afterRestart ) {
+            cout << "Error: serve needs loadweights=1, and a weights file matching netdef and trainfile" << endl;
+            return;
+        }
+        serve( net, config );
+        return;
+    }
+
     timer.timeCheck("before learning start");
     if( config.dumpTimings ) {
         StatefulTimer::dump( true );
@@ -277,14 +426,74 @@ void go(Config config) {
         multiNet = new MultiNet( config.multiNet, net );
         trainable = multiNet;
     }
+    DataParallelNet *dataParallelNet = 0;
+    if( config.dataParallel > 1 ) {
+        // net is replica 0, and holds the shared weights, so WeightsWriter still works
+        dataParallelNet = new DataParallelNet( config.dataParallel, net );
+        trainable = dataParallelNet;
+    }
+    RingAllReduce *ring = 0;
+    DistributedNet *distributedNet = 0;
+    if( config.worldSize > 1 ) {
+        vector< string > hosts = RingAllReduce::localHosts( config.worldSize );
+        if( config.hosts != "" ) {
+            hosts = split( config.hosts, "," );
+        }
+        ring = new RingAllReduce( config.rank, config.worldSize, hosts, config.basePort );
+        // every rank resumes from where rank 0 does, or none do
+        afterRestart = DistributedNet::broadcastResumeState( ring, afterRestart, &resumeState );
+        // takes the weights of rank 0, so every process starts the same
+        distributedNet = new DistributedNet( net, ring );
+        trainable = distributedNet;
+        if( config.rank != 0 ) {
+            // the weights are the same everywhere, so only rank 0 writes them
+            config.weightsFile = "";
+        }
+    }
     if( config.loadOnDemand ) {
         NetLearnerOnDemand<unsigned char> netLearner( trainable );
         netLearner.setTrainingData( config.dataDir + "/" + config.trainFile, Ntrain );
         netLearner.setTestingData( config.dataDir + "/" + config.validateFile, Ntest );
-        netLearner.setSchedule( config.numEpochs, afterRestart ? restartEpoch : 1 );
+        netLearner.setSchedule( config.numEpochs );
+        if( afterRestart ) {
+            netLearner.setResumeState( resumeState );
+        }
         netLearner.setBatchSize( config.fileReadBatches, config.batchSize );
         netLearner.setDumpTimings( config.dumpTimings );
         WeightsWriter weightsWriter( net, &config );
+        if( config.weightsFile != "" ) {
+            netLearner.addPostEpochAction( &weightsWriter );
+            netLearner.addPostBatchAction( &weightsWriter );
+        }
+        netLearner.learn( config.learningRate, config.annealLearningRate );
+    } else if( config.deviceData ) {
+        DeviceDataset trainDataset( net->getCl(), Ntrain, inputCubeSize, trainData, translate, scale );
+        DeviceDataset testDataset( net->getCl(), Ntest, inputCubeSize, testData, translate, scale );
+        timer.timeCheck("after uploading datasets to device");
+        NetLearnerOnDevice netLearner( net );
+        netLearner.setTrainingData( &trainDataset, trainLabels );
+        netLearner.setTestingData( &testDataset, testLabels );
+        netLearner.setSchedule( config.numEpochs );
+        if( afterRestart ) {
+            netLearner.setResumeState( resumeState );
+        }
+        netLearner.setBatchSize( config.batchSize );
+        netLearner.setShuffle( config.shuffle );
+        netLearner.setDumpTimings( config.dumpTimings );
+        WeightsWriter weightsWriter( net, &config );
+        if( config.weightsFile != "" ) {
+            netLearner.addPostEpochAction( &weightsWriter );
+            netLearner.addPostBatchAction( &weightsWriter );
+        }
+        netLearner.learn( config.learningRate, config.annealLearningRate );
+    } else if( config.hogwild > 0 ) {
+        HogwildLearner<unsigned char> netLearner( net, config.hogwild );
+        netLearner.setTrainingData( Ntrain, trainData, trainLabels );
+        netLearner.setTestingData( Ntest, testData, testLabels );
+        netLearner.setSchedule( config.numEpochs, afterRestart ? resumeState.epoch : 1 );
+        netLearner.setBatchSize( config.batchSize );
+        netLearner.setDumpTimings( config.dumpTimings );
+        WeightsWriter weightsWriter( net, &config );
         if( config.weightsFile != "" ) {
             netLearner.addPostEpochAction( &weightsWriter );
         }
@@ -293,12 +502,16 @@ void go(Config config) {
         NetLearner<unsigned char> netLearner( trainable );
         netLearner.setTrainingData( Ntrain, trainData, trainLabels );
         netLearner.setTestingData( Ntest, testData, testLabels );
-        netLearner.setSchedule( config.numEpochs, afterRestart ? restartEpoch : 1 );
+        netLearner.setSchedule( config.numEpochs );
+        if( afterRestart ) {
+            netLearner.setResumeState( resumeState );
+        }
         netLearner.setBatchSize( config.batchSize );
         netLearner.setDumpTimings( config.dumpTimings );
         WeightsWriter weightsWriter( net, &config );
         if( config.weightsFile != "" ) {
             netLearner.addPostEpochAction( &weightsWriter );
+            netLearner.addPostBatchAction( &weightsWriter );
         }
         netLearner.learn( config.learningRate, config.annealLearningRate );
     }
@@ -306,6 +519,13 @@ void go(Config config) {
     if( multiNet != 0 ) {
         delete multiNet;
     }
+    if( dataParallelNet != 0 ) {
+        delete dataParallelNet;
+    }
+    if( distributedNet != 0 ) {
+        delete distributedNet;
+        delete ring;
+    }
     delete net;
 
     if( trainData != 0 ) {
@@ -352,6 +572,20 @@ void printUsage( char *argv[], Config config ) {
     cout << "    loadondemand=[load data on demand [1|0]] (" << config.loadOnDemand << ")" << endl;
     cout << "    filereadbatches=[how many batches to read from file each time? (for loadondemand=1)] (" << config.fileReadBatches << ")" << endl;
     cout << "    normalizationexamples=[number of examples to read to determine normalization parameters] (" << config.normalizationExamples << ")" << endl;
+    cout << "    devicedata=[upload whole dataset to device once, and build batches there [1|0]] (" << config.deviceData << ")" << endl;
+    cout << "    shuffle=[with devicedata=1, visit the training examples in a new random order each epoch [1|0]] (" << config.shuffle << ")" << endl;
+    cout << "    recomputeevery=[keep layer results only every this many layers, and recompute the others during backprop, to save memory (0 = off)] (" << config.recomputeEvery << ")" << endl;
+    cout << "    fastmath=[use fast approximations to tanh, sigmoid and exp, in activations and softmax [1|0]] (" << config.fastMath << ")" << endl;
+    cout << "    dataparallel=[number of copies of the net to train at once, on separate threads, each on its own slice of each batch] (" << config.dataParallel << ")" << endl;
+    cout << "    hogwild=[number of threads for asynchronous lock-free training, each with its own copy of the net, and its own batches (0 = off)] (" << config.hogwild << ")" << endl;
+    cout << "    worldsize=[number of processes training together, each on its own slice of the training data] (" << config.worldSize << ")" << endl;
+    cout << "    rank=[which of the worldsize processes this is, from 0] (" << config.rank << ")" << endl;
+    cout << "    hosts=[comma-separated host of each process, in rank order (default: all on this machine)] (" << config.hosts << ")" << endl;
+    cout << "    baseport=[process with rank r listens on port baseport + r] (" << config.basePort << ")" << endl;
+    cout << "    writeweightsevery=[also write the weights file every this many batches (0 = only after each epoch)] (" << config.writeWeightsEvery << ")" << endl;
+    cout << "    serve=[instead of training, serve predictions to clients on this machine, on tcp:port or unix:path; needs loadweights=1] (" << config.serve << ")" << endl;
+    cout << "    servemaxbatch=[with serve, largest batch to gather requests into] (" << config.serveMaxBatch << ")" << endl;
+    cout << "    servemaxlatency=[with serve, longest a request waits for others to batch with, in microseconds] (" << config.serveMaxLatency << ")" << endl;
     // [[[end]]]
 }
 
@@ -423,6 +657,34 @@ int main( int argc, char *argv[] ) {
                 config.fileReadBatches = atoi(value);
             } else if( key == "normalizationexamples" ) {
                 config.normalizationExamples = atoi(value);
+            } else if( key == "devicedata" ) {
+                config.deviceData = atoi(value);
+            } else if( key == "shuffle" ) {
+                config.shuffle = atoi(value);
+            } else if( key == "recomputeevery" ) {
+                config.recomputeEvery = atoi(value);
+            } else if( key == "fastmath" ) {
+                config.fastMath = atoi(value);
+            } else if( key == "dataparallel" ) {
+                config.dataParallel = atoi(value);
+            } else if( key == "hogwild" ) {
+                config.hogwild = atoi(value);
+            } else if( key == "worldsize" ) {
+                config.worldSize = atoi(value);
+            } else if( key == "rank" ) {
+                config.rank = atoi(value);
+            } else if( key == "hosts" ) {
+                config.hosts = (value);
+            } else if( key == "baseport" ) {
+                config.basePort = atoi(value);
+            } else if( key == "writeweightsevery" ) {
+                config.writeWeightsEvery = atoi(value);
+            } else if( key == "serve" ) {
+                config.serve = (value);
+            } else if( key == "servemaxbatch" ) {
+                config.serveMaxBatch = atoi(value);
+            } else if( key == "servemaxlatency" ) {
+                config.serveMaxLatency = atoi(value);
             // [[[end]]]
             } else {
                 cout << endl;
@@ -0,0 +1,34 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License, 
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can 
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "Scenario.h"
+
+// a 1d corridor: move left or right, reward at the right hand end.  small
+// enough for the qlearning tests to learn in a few hundred steps
+class Corridor : public Scenario {
+public:
+    int size;
+    int pos;
+    Corridor( int size ) : size( size ), pos( 0 ) {
+    }
+    virtual int getPerceptionSize() { return size; }
+    virtual int getPerceptionPlanes() { return 1; }
+    virtual void getPerception( float *perception ) {
+        for( int i = 0; i < size * size; i++ ) {
+            perception[i] = i == pos ? 1.0f : 0.0f;
+        }
+    }
+    virtual void reset() { pos = 0; }
+    virtual int getNumActions() { return 2; }
+    virtual float act( int index ) {
+        pos += index == 0 ? -1 : 1;
+        pos = pos < 0 ? 0 : pos;
+        return pos == size - 1 ? 1.0f : 0.0f;
+    }
+    virtual bool hasFinished() { return pos == size - 1; }
+};
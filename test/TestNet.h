@@ -0,0 +1,38 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#include "NeuralNet.h"
+
+// the small net that most of the tests build: conv, pooling, conv, then a
+// linear fully connected layer, so it exercises each kind of weighted layer
+class TestNet {
+public:
+    // adds the layers on top of net's input layer, up to the fully connected
+    // layer with numOutputs outputs.  the caller adds the loss layer
+    static void addLayers( NeuralNet *net, int numOutputs ) {
+        net->addLayer( ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->tanh()->biased()->padZeros() );
+        net->addLayer( PoolingMaker::instance()->poolingSize(2) );
+        net->addLayer( ConvolutionalMaker::instance()->numFilters(5)->filterSize(3)->relu()->biased()->padZeros() );
+        net->addLayer( FullyConnectedMaker::instance()->numPlanes(numOutputs)->imageSize(1)->linear()->biased() );
+    }
+    // classifies numPlanes x imageSize x imageSize inputs, with softmax loss
+    static NeuralNet *makeNet( int numPlanes, int imageSize, int numClasses ) {
+        NeuralNet *net = NeuralNet::maker()->planes(numPlanes)->imageSize(imageSize)->instance();
+        addLayers( net, numClasses );
+        net->addLayer( SoftMaxMaker::instance() );
+        return net;
+    }
+    // regresses numOutputs values, eg q values, with square loss
+    static NeuralNet *makeSquareLossNet( int numPlanes, int imageSize, int numOutputs ) {
+        NeuralNet *net = NeuralNet::maker()->planes(numPlanes)->imageSize(imageSize)->instance();
+        addLayers( net, numOutputs );
+        net->addLayer( SquareLossMaker::instance() );
+        return net;
+    }
+};
+
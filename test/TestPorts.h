@@ -0,0 +1,31 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+#pragma once
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// tcp ports for the tests that listen on loopback.  they depend on the pid, so
+// that two test runs at once, eg on a shared build machine, dont collide, and
+// they stay below the linux ephemeral range
+class TestPorts {
+public:
+    // each test file passes its own offset, below 100, so that the files dont
+    // collide with each other within one run
+    static int basePort( int offset ) {
+        #ifdef _WIN32
+        const int pid = _getpid();
+        #else
+        const int pid = getpid();
+        #endif
+        return 10000 + ( pid % 220 ) * 100 + offset;
+    }
+};
+
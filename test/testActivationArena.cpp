@@ -0,0 +1,274 @@
+// tests ActivationArena slot planning, and that nets using an arena, either
+// inference only, or training with recomputation, match normal nets
+
+#include <iostream>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "OpenCLHelper.h"
+#include "NeuralNet.h"
+#include "ActivationArena.h"
+#include "MyRandom.h"
+
+using namespace std;
+
+TEST( testActivationArena, assignSlotsChain ) {
+    // plain chain: each result is read only by the next layer, last one stays alive
+    int lastUseArray[] = { 1, 2, 3, 4, 5 };
+    int sizesArray[] = { 100, 400, 300, 200, 10 };
+    vector< int > lastUse( lastUseArray, lastUseArray + 5 );
+    vector< int > sizes( sizesArray, sizesArray + 5 );
+    vector< int > slots;
+    vector< int > slotSizes;
+    EXPECT_EQ( 2, ActivationArena::assignSlots( lastUse, sizes, slots, slotSizes ) );
+    EXPECT_EQ( 0, slots[0] );
+    EXPECT_EQ( 1, slots[1] );
+    EXPECT_EQ( 0, slots[2] );
+    EXPECT_EQ( 1, slots[3] );
+    EXPECT_EQ( 0, slots[4] );
+    EXPECT_EQ( 300, slotSizes[0] );
+    EXPECT_EQ( 400, slotSizes[1] );
+}
+
+TEST( testActivationArena, assignSlotsLongLived ) {
+    // layer 1 keeps its own results (size 0), and might alias those of layer 0,
+    // so layer 0 results live until layer 1 results are done with
+    int lastUseArray[] = { 2, 2, 3, 4 };
+    int sizesArray[] = { 50, 0, 50, 50 };
+    vector< int > lastUse( lastUseArray, lastUseArray + 4 );
+    vector< int > sizes( sizesArray, sizesArray + 4 );
+    vector< int > slots;
+    vector< int > slotSizes;
+    EXPECT_EQ( 2, ActivationArena::assignSlots( lastUse, sizes, slots, slotSizes ) );
+    EXPECT_EQ( 0, slots[0] );
+    EXPECT_EQ( -1, slots[1] );
+    EXPECT_EQ( 1, slots[2] );
+    EXPECT_EQ( 0, slots[3] );
+}
+
+TEST( testActivationArena, propagateSameAsNormal ) {
+    const int batchSize = 5;
+    const int numPlanes = 2;
+    const int imageSize = 12;
+    const int numClasses = 4;
+
+    NeuralNet *net = new NeuralNet();
+    net->addLayer( InputLayerMaker<float>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+    net->addLayer( NormalizationLayerMaker::instance()->translate(-0.5f)->scale(2.0f) );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(6)->filterSize(3)->relu()->biased()->padZeros() );
+    net->addLayer( PoolingMaker::instance()->poolingSize(2) );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(8)->filterSize(3)->tanh()->biased()->padZeros() );
+    net->addLayer( PoolingMaker::instance()->poolingSize(3) );
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(numClasses)->imageSize(1)->linear()->biased() );
+    net->addLayer( SoftMaxMaker::instance() );
+
+    NeuralNet *arenaNet = net->clone();
+    for( int layer = 1; layer < net->getNumLayers(); layer++ ) {
+        const int persistSize = net->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *persisted = new float[ persistSize ];
+        net->getLayer(layer)->persistToArray( persisted );
+        arenaNet->getLayer(layer)->unpersistFromArray( persisted );
+        delete[] persisted;
+    }
+
+    float *images = new float[ batchSize * numPlanes * imageSize * imageSize ];
+    for( int i = 0; i < batchSize * numPlanes * imageSize * imageSize; i++ ) {
+        images[i] = ( ( i * 17 ) % 101 ) / 101.0f;
+    }
+
+    net->setBatchSize( batchSize );
+    net->propagate( images );
+
+    arenaNet->setInferenceOnly( batchSize );
+    EXPECT_EQ( 2, arenaNet->arena->getNumSlots() );
+    int unpackedSize = 0;
+    for( int layer = 0; layer < arenaNet->getNumLayers(); layer++ ) {
+        unpackedSize += arenaNet->getLayer(layer)->getResultsSize();
+    }
+    EXPECT_GT( unpackedSize, arenaNet->arena->getArenaSize() );
+    arenaNet->propagate( images );
+
+    float const*results = net->getResults();
+    float const*arenaResults = arenaNet->getResults();
+    for( int i = 0; i < batchSize * numClasses; i++ ) {
+        EXPECT_FLOAT_NEAR( results[i], arenaResults[i] );
+    }
+
+    // smaller batch still fits, larger does not
+    arenaNet->setBatchSize( batchSize - 2 );
+    arenaNet->propagate( images );
+    arenaResults = arenaNet->getResults();
+    for( int i = 0; i < ( batchSize - 2 ) * numClasses; i++ ) {
+        EXPECT_FLOAT_NEAR( results[i], arenaResults[i] );
+    }
+    EXPECT_THROW( arenaNet->setBatchSize( batchSize + 1 ), runtime_error );
+    EXPECT_THROW( arenaNet->setTraining( true ), runtime_error );
+
+    delete[] images;
+    delete arenaNet;
+    delete net;
+}
+
+TEST( testActivationArena, checkpointedBackpropSameAsNormal ) {
+    const int batchSize = 4;
+    const int numPlanes = 1;
+    const int imageSize = 10;
+    const int numClasses = 3;
+
+    NeuralNet *net = new NeuralNet();
+    net->addLayer( InputLayerMaker<float>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->tanh()->biased()->padZeros() );
+    net->addLayer( PoolingMaker::instance()->poolingSize(2) );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(5)->filterSize(3)->tanh()->biased()->padZeros() );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(5)->filterSize(3)->tanh()->biased()->padZeros() );
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(numClasses)->imageSize(1)->linear()->biased() );
+    net->addLayer( SoftMaxMaker::instance() );
+
+    NeuralNet *checkpointedNet = net->clone();
+    for( int layer = 1; layer < net->getNumLayers(); layer++ ) {
+        const int persistSize = net->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *persisted = new float[ persistSize ];
+        net->getLayer(layer)->persistToArray( persisted );
+        checkpointedNet->getLayer(layer)->unpersistFromArray( persisted );
+        delete[] persisted;
+    }
+    checkpointedNet->setCheckpointEvery( 3 );
+
+    float *images = new float[ batchSize * numPlanes * imageSize * imageSize ];
+    for( int i = 0; i < batchSize * numPlanes * imageSize * imageSize; i++ ) {
+        images[i] = ( ( i * 29 ) % 97 ) / 97.0f - 0.5f;
+    }
+    int labels[] = { 2, 0, 1, 1 };
+
+    net->setBatchSize( batchSize );
+    checkpointedNet->setBatchSize( batchSize );
+    // layers 0 and 3 are checkpoints, and so is the last layer
+    EXPECT_EQ( -1, checkpointedNet->arena->getSlot(0) );
+    EXPECT_EQ( 0, checkpointedNet->arena->getSlot(1) );
+    EXPECT_EQ( 1, checkpointedNet->arena->getSlot(2) );
+    EXPECT_EQ( -1, checkpointedNet->arena->getSlot(3) );
+    EXPECT_EQ( 0, checkpointedNet->arena->getSlot(4) );
+    EXPECT_EQ( 1, checkpointedNet->arena->getSlot(5) );
+    EXPECT_EQ( -1, checkpointedNet->arena->getSlot(6) );
+    for( int it = 0; it < 3; it++ ) {
+        net->propagate( images );
+        net->backPropFromLabels( 0.1f, labels );
+        checkpointedNet->propagate( images );
+        checkpointedNet->backPropFromLabels( 0.1f, labels );
+    }
+    net->propagate( images );
+    checkpointedNet->propagate( images );
+
+    float const*results = net->getResults();
+    float const*checkpointedResults = checkpointedNet->getResults();
+    for( int i = 0; i < batchSize * numClasses; i++ ) {
+        EXPECT_FLOAT_NEAR( results[i], checkpointedResults[i] );
+    }
+    for( int layer = 1; layer < net->getNumLayers(); layer++ ) {
+        const int persistSize = net->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *weights = new float[ persistSize ];
+        float *checkpointedWeights = new float[ persistSize ];
+        net->getLayer(layer)->persistToArray( weights );
+        checkpointedNet->getLayer(layer)->persistToArray( checkpointedWeights );
+        for( int i = 0; i < persistSize; i++ ) {
+            EXPECT_FLOAT_NEAR( weights[i], checkpointedWeights[i] );
+        }
+        delete[] checkpointedWeights;
+        delete[] weights;
+    }
+
+    delete[] images;
+    delete checkpointedNet;
+    delete net;
+}
+
+
+// layers that stay out of the arena, like RandomTranslations, are not propagated
+// again when their segment is recomputed, so they keep the translations, and
+// the random numbers, of the forward pass
+TEST( testActivationArena, checkpointedBackpropRandomLayerInSegment ) {
+    const int batchSize = 4;
+    const int numPlanes = 1;
+    const int imageSize = 10;
+    const int numClasses = 3;
+
+    NeuralNet *net = new NeuralNet();
+    net->addLayer( InputLayerMaker<float>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+    net->addLayer( RandomTranslationsMaker::instance()->translateSize(2) );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->tanh()->biased()->padZeros() );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(5)->filterSize(3)->tanh()->biased()->padZeros() );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(5)->filterSize(3)->tanh()->biased()->padZeros() );
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(numClasses)->imageSize(1)->linear()->biased() );
+    net->addLayer( SoftMaxMaker::instance() );
+
+    NeuralNet *checkpointedNet = net->clone();
+    for( int layer = 1; layer < net->getNumLayers(); layer++ ) {
+        const int persistSize = net->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *persisted = new float[ persistSize ];
+        net->getLayer(layer)->persistToArray( persisted );
+        checkpointedNet->getLayer(layer)->unpersistFromArray( persisted );
+        delete[] persisted;
+    }
+    checkpointedNet->setCheckpointEvery( 3 );
+    net->setTraining( true );
+    checkpointedNet->setTraining( true );
+
+    float *images = new float[ batchSize * numPlanes * imageSize * imageSize ];
+    for( int i = 0; i < batchSize * numPlanes * imageSize * imageSize; i++ ) {
+        images[i] = ( ( i * 29 ) % 97 ) / 97.0f - 0.5f;
+    }
+    int labels[] = { 2, 0, 1, 1 };
+
+    net->setBatchSize( batchSize );
+    checkpointedNet->setBatchSize( batchSize );
+    // the translations are in the first segment, but keep their own results
+    EXPECT_EQ( -1, checkpointedNet->arena->getSlot(1) );
+    EXPECT_EQ( 1, checkpointedNet->arena->getSlot(2) );
+    EXPECT_EQ( -1, checkpointedNet->arena->getSlot(3) );
+
+    const std::string randomState = MyRandom::getState();
+    for( int it = 0; it < 3; it++ ) {
+        net->propagate( images );
+        net->backPropFromLabels( 0.1f, labels );
+    }
+    const std::string randomStateAfter = MyRandom::getState();
+    MyRandom::setState( randomState );
+    for( int it = 0; it < 3; it++ ) {
+        checkpointedNet->propagate( images );
+        checkpointedNet->backPropFromLabels( 0.1f, labels );
+    }
+    EXPECT_EQ( randomStateAfter, MyRandom::getState() );
+
+    for( int layer = 1; layer < net->getNumLayers(); layer++ ) {
+        const int persistSize = net->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *weights = new float[ persistSize ];
+        float *checkpointedWeights = new float[ persistSize ];
+        net->getLayer(layer)->persistToArray( weights );
+        checkpointedNet->getLayer(layer)->persistToArray( checkpointedWeights );
+        for( int i = 0; i < persistSize; i++ ) {
+            EXPECT_FLOAT_NEAR( weights[i], checkpointedWeights[i] );
+        }
+        delete[] checkpointedWeights;
+        delete[] weights;
+    }
+
+    delete[] images;
+    delete checkpointedNet;
+    delete net;
+}
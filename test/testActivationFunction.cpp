@@ -0,0 +1,47 @@
+// checks the whole-array activation functions against the per-element ones
+
+#include <iostream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "ActivationFunction.h"
+
+using namespace std;
+
+namespace testActivationFunction {
+
+void checkArraySameAsElementwise( string name ) {
+    ActivationFunction *fn = ActivationFunction::fromName( name );
+    const int N = 37;
+    float values[N];
+    float outputs[N];
+    float target[N];
+    for( int i = 0; i < N; i++ ) {
+        values[i] = ( i - 18 ) / 6.0f;
+        outputs[i] = values[i];
+        target[i] = ( ( i * 7 ) % 11 ) / 5.0f - 1.0f;
+    }
+    fn->calcArray( N, outputs );
+    float errors[N];
+    for( int i = 0; i < N; i++ ) {
+        errors[i] = target[i];
+    }
+    fn->multiplyByDerivative( N, errors, outputs );
+    for( int i = 0; i < N; i++ ) {
+        EXPECT_FLOAT_NEAR( fn->calc( values[i] ), outputs[i] );
+        EXPECT_FLOAT_NEAR( target[i] * fn->calcDerivative( outputs[i] ), errors[i] );
+    }
+    delete fn;
+}
+
+TEST( testActivationFunction, arraySameAsElementwise ) {
+    checkArraySameAsElementwise( "tanh" );
+    checkArraySameAsElementwise( "scaledtanh" );
+    checkArraySameAsElementwise( "sigmoid" );
+    checkArraySameAsElementwise( "linear" );
+    checkArraySameAsElementwise( "relu" );
+}
+
+}
+
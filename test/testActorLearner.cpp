@@ -0,0 +1,152 @@
+// checks the lock-free TransitionQueue, between two threads, and runs an
+// ActorLearner with a few actors until it has learnt for a while
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+#include "NeuralNet.h"
+#include "QLearner.h"
+#include "ActorLearner.h"
+#include "TransitionQueue.h"
+
+#include "gtest/gtest.h"
+#include "test/Corridor.h"
+
+using namespace std;
+
+namespace testActorLearner {
+
+TEST( testActorLearner, queuefull ) {
+    TransitionQueue queue( 2, 3 );
+    float before[] = { 1, 2, 3 };
+    float after[] = { 4, 5, 6 };
+    EXPECT_TRUE( queue.push( before, 0, 0.5f, false, after ) );
+    EXPECT_TRUE( queue.push( after, 1, 1.5f, true, before ) );
+    EXPECT_FALSE( queue.push( before, 2, 2.5f, false, after ) );
+    EXPECT_EQ( 2, queue.getSize() );
+
+    float const *peekedBefore = 0;
+    float const *peekedAfter = 0;
+    int action = -1;
+    float reward = 0;
+    bool isEndState = false;
+    EXPECT_TRUE( queue.peek( &peekedBefore, &action, &reward, &isEndState, &peekedAfter ) );
+    EXPECT_EQ( 0, action );
+    EXPECT_FLOAT_EQ( 0.5f, reward );
+    EXPECT_FALSE( isEndState );
+    EXPECT_FLOAT_EQ( 3, peekedBefore[2] );
+    EXPECT_FLOAT_EQ( 4, peekedAfter[0] );
+    queue.pop();
+    // wraps around, into the slot just popped
+    EXPECT_TRUE( queue.push( before, 2, 2.5f, false, after ) );
+    EXPECT_TRUE( queue.peek( &peekedBefore, &action, &reward, &isEndState, &peekedAfter ) );
+    EXPECT_EQ( 1, action );
+    EXPECT_TRUE( isEndState );
+    EXPECT_FLOAT_EQ( 4, peekedBefore[0] );
+    queue.pop();
+    EXPECT_TRUE( queue.peek( &peekedBefore, &action, &reward, &isEndState, &peekedAfter ) );
+    EXPECT_EQ( 2, action );
+    queue.pop();
+    EXPECT_FALSE( queue.peek( &peekedBefore, &action, &reward, &isEndState, &peekedAfter ) );
+}
+
+// consumer sees every experience the producer managed to push, in order, and
+// intact, even though the queue is much smaller than the number pushed
+TEST( testActorLearner, queuetwothreads ) {
+    const int stateSize = 16;
+    const int numToPush = 200000;
+    TransitionQueue queue( 64, stateSize );
+    std::thread producer( [&]() {
+        float before[stateSize];
+        float after[stateSize];
+        for( int n = 0; n < numToPush; n++ ) {
+            for( int i = 0; i < stateSize; i++ ) {
+                before[i] = (float)n;
+                after[i] = (float)-n;
+            }
+            while( !queue.push( before, n, (float)n, n % 2 == 0, after ) ) {
+                std::this_thread::yield();
+            }
+        }
+    } );
+    int expected = 0;
+    while( expected < numToPush ) {
+        float const *before = 0;
+        float const *after = 0;
+        int action = 0;
+        float reward = 0;
+        bool isEndState = false;
+        if( !queue.peek( &before, &action, &reward, &isEndState, &after ) ) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ( expected, action );
+        ASSERT_EQ( (float)expected, reward );
+        ASSERT_EQ( expected % 2 == 0, isEndState );
+        for( int i = 0; i < stateSize; i++ ) {
+            ASSERT_EQ( (float)expected, before[i] );
+            ASSERT_EQ( (float)-expected, after[i] );
+        }
+        queue.pop();
+        expected++;
+    }
+    producer.join();
+    EXPECT_EQ( 0, queue.getSize() );
+}
+
+TEST( testActorLearner, badintervals ) {
+    NeuralNet *net = NeuralNet::maker()->planes(1)->imageSize(4)->instance();
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(2)->imageSize(1)->linear()->biased() );
+    net->addLayer( SquareLossMaker::instance() );
+    Corridor corridor( 4 );
+    vector< Scenario * > scenarios;
+    scenarios.push_back( &corridor );
+    ActorLearner *actorLearner = new ActorLearner( scenarios, net );
+    EXPECT_THROW( actorLearner->setRefreshEvery( 0 ), runtime_error );
+    EXPECT_THROW( actorLearner->setPublishEvery( 0 ), runtime_error );
+    delete actorLearner;
+    delete net;
+}
+
+TEST( testActorLearner, run ) {
+    NeuralNet *net = NeuralNet::maker()->planes(1)->imageSize(4)->instance();
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(8)->imageSize(1)->tanh()->biased() );
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(2)->imageSize(1)->linear()->biased() );
+    net->addLayer( SquareLossMaker::instance() );
+    vector< Scenario * > scenarios;
+    for( int actor = 0; actor < 3; actor++ ) {
+        scenarios.push_back( new Corridor( 4 ) );
+    }
+    ActorLearner *actorLearner = new ActorLearner( scenarios, net );
+    actorLearner->setRefreshEvery( 10 );
+    actorLearner->setPublishEvery( 5 );
+    actorLearner->getQLearner()->setMaxSamples( 16 );
+    actorLearner->start();
+    // gives up after a minute, eg if a thread failed; stop rethrows why
+    for( int wait = 0; wait < 6000 && actorLearner->getNumLearnSteps() < 200; wait++ ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+    actorLearner->stop();
+    EXPECT_GE( actorLearner->getNumLearnSteps(), 200 );
+    EXPECT_GT( actorLearner->getNumFrames(), 0 );
+
+    // can start again, after stopping
+    const long long numLearnSteps = actorLearner->getNumLearnSteps();
+    actorLearner->start();
+    for( int wait = 0; wait < 6000 && actorLearner->getNumLearnSteps() < numLearnSteps + 20; wait++ ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+    }
+    actorLearner->stop();
+    EXPECT_GE( actorLearner->getNumLearnSteps(), numLearnSteps + 20 );
+
+    delete actorLearner;
+    for( int actor = 0; actor < 3; actor++ ) {
+        delete scenarios[actor];
+    }
+    delete net;
+}
+
+}
+
@@ -0,0 +1,209 @@
+// Copyright Hugh Perkins 2015 hughperkins at gmail
+//
+// This Source Code Form is subject to the terms of the Mozilla Public License,
+// v. 2.0. If a copy of the MPL was not distributed with this file, You can
+// obtain one at http://mozilla.org/MPL/2.0/.
+
+// checks fused conv + pooling against conv followed by pooling, both for the
+// ConvPoolPropagate implementations directly, and for nets with a fused pooling layer
+
+#include <iostream>
+
+#include "OpenCLHelper.h"
+#include "NeuralNet.h"
+#include "NetdefToNet.h"
+#include "PropagateCpu.h"
+#include "PoolingPropagateCpu.h"
+#include "ConvPoolPropagate.h"
+#include "ConvPoolPropagateCpu.h"
+#include "PoolingLayer.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+namespace testConvPoolPropagate {
+
+void compareWithUnfused( LayerDimensions dim, ActivationFunction *fn, bool poolingPadZeros, int poolingSize, int batchSize ) {
+    OpenCLHelper *cl = OpenCLHelper::createForFirstGpuOtherwiseCpu();
+    const int inputSize = batchSize * dim.inputCubeSize;
+    float *inputData = new float[ inputSize ];
+    float *weights = new float[ dim.filtersSize ];
+    float *biasWeights = new float[ dim.numFilters ];
+    WeightRandomizer::randomize( 0, inputData, inputSize, -1.0f, 1.0f );
+    WeightRandomizer::randomize( 1, weights, dim.filtersSize, -0.5f, 0.5f );
+    WeightRandomizer::randomize( 2, biasWeights, dim.numFilters, -0.5f, 0.5f );
+
+    PropagateCpu propagateCpu( cl, dim, fn );
+    float *convResults = propagateCpu.propagate( batchSize, inputData, weights, biasWeights );
+    PoolingPropagateCpu poolingCpu( cl, poolingPadZeros, dim.numFilters, dim.outputImageSize, poolingSize );
+    const int pooledSize = poolingCpu.getResultsSize( batchSize );
+    float *expectedPooled = new float[ pooledSize ];
+    unsigned char *expectedSelectors = new unsigned char[ pooledSize ];
+    poolingCpu.propagate( batchSize, convResults, expectedSelectors, expectedPooled );
+
+    for( int idx = 0; idx <= 1; idx++ ) {
+        ConvPoolPropagate *convPool = ConvPoolPropagate::instanceSpecific( idx, cl, dim, fn, poolingPadZeros, poolingSize );
+        EXPECT_EQ( pooledSize, convPool->getPooledSize( batchSize ) );
+        float *pooled = new float[ pooledSize ];
+        unsigned char *selectors = new unsigned char[ pooledSize ];
+        CLWrapper *inputWrapper = cl->wrap( inputSize, inputData );
+        CLWrapper *weightsWrapper = cl->wrap( dim.filtersSize, weights );
+        CLWrapper *biasWrapper = cl->wrap( dim.numFilters, biasWeights );
+        CLWrapper *selectorsWrapper = cl->wrap( pooledSize, selectors );
+        CLWrapper *pooledWrapper = cl->wrap( pooledSize, pooled );
+        inputWrapper->copyToDevice();
+        weightsWrapper->copyToDevice();
+        biasWrapper->copyToDevice();
+        convPool->propagate( batchSize, inputWrapper, weightsWrapper, biasWrapper, selectorsWrapper, pooledWrapper, true );
+        selectorsWrapper->copyToHost();
+        pooledWrapper->copyToHost();
+        for( int i = 0; i < pooledSize; i++ ) {
+            EXPECT_FLOAT_NEAR( expectedPooled[i], pooled[i] );
+            EXPECT_EQ( expectedSelectors[i], selectors[i] );
+        }
+        delete pooledWrapper;
+        delete selectorsWrapper;
+        delete biasWrapper;
+        delete weightsWrapper;
+        delete inputWrapper;
+        delete[] selectors;
+        delete[] pooled;
+        delete convPool;
+    }
+
+    delete[] expectedSelectors;
+    delete[] expectedPooled;
+    delete[] convResults;
+    delete[] biasWeights;
+    delete[] weights;
+    delete[] inputData;
+    delete cl;
+}
+
+TEST( testConvPoolPropagate, tanhPadZeros ) {
+    LayerDimensions dim( 3, 12, 5, 3, true, true );
+    compareWithUnfused( dim, new TanhActivation(), false, 2, 3 );
+}
+
+TEST( testConvPoolPropagate, tanhFastMath ) {
+    // the gpu kernel gets FAST_MATH, so it matches the cpu approximation
+    LayerDimensions dim( 3, 12, 5, 3, true, true );
+    compareWithUnfused( dim, ( new TanhActivation() )->setFastMath( true ), false, 2, 3 );
+}
+
+TEST( testConvPoolPropagate, reluUnpaddedPooling3 ) {
+    // conv output 10, pooled 3, so the last row and column of the conv output are dropped
+    LayerDimensions dim( 2, 14, 4, 5, false, true );
+    compareWithUnfused( dim, new ReluActivation(), false, 3, 2 );
+}
+
+TEST( testConvPoolPropagate, linearPoolingPadZeros ) {
+    // conv output 11, pooled 4, last window is partial
+    LayerDimensions dim( 1, 11, 3, 3, true, false );
+    compareWithUnfused( dim, new LinearActivation(), true, 3, 2 );
+}
+
+TEST( testConvPoolPropagate, netSameAsUnfused ) {
+    const int batchSize = 4;
+    const int imageSize = 12;
+    const int numClasses = 3;
+
+    NeuralNet *nets[2];
+    for( int fused = 0; fused <= 1; fused++ ) {
+        PoolingMaker *poolingMaker = PoolingMaker::instance()->poolingSize(2);
+        if( fused ) {
+            poolingMaker->fused();
+        }
+        nets[fused] = NeuralNet::maker()->planes(2)->imageSize(imageSize)->instance();
+        nets[fused]->addLayer( ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->tanh()->biased()->padZeros() );
+        nets[fused]->addLayer( poolingMaker );
+        nets[fused]->addLayer( ConvolutionalMaker::instance()->numFilters(5)->filterSize(3)->relu()->biased()->padZeros() );
+        nets[fused]->addLayer( FullyConnectedMaker::instance()->numPlanes(numClasses)->imageSize(1)->linear()->biased() );
+        nets[fused]->addLayer( SoftMaxMaker::instance() );
+        nets[fused]->setBatchSize( batchSize );
+    }
+    EXPECT_EQ( 0, dynamic_cast< PoolingLayer * >( nets[0]->getLayer(2) )->fusedConv );
+    EXPECT_EQ( nets[1]->getLayer(1), dynamic_cast< PoolingLayer * >( nets[1]->getLayer(2) )->fusedConv );
+    for( int layer = 1; layer < nets[0]->getNumLayers(); layer++ ) {
+        const int persistSize = nets[0]->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *persisted = new float[ persistSize ];
+        nets[0]->getLayer(layer)->persistToArray( persisted );
+        nets[1]->getLayer(layer)->unpersistFromArray( persisted );
+        delete[] persisted;
+    }
+
+    float *images = new float[ batchSize * 2 * imageSize * imageSize ];
+    WeightRandomizer::randomize( 3, images, batchSize * 2 * imageSize * imageSize, -1.0f, 1.0f );
+    int labels[] = { 0, 2, 1, 2 };
+    for( int it = 0; it < 3; it++ ) {
+        for( int fused = 0; fused <= 1; fused++ ) {
+            nets[fused]->propagate( images );
+            nets[fused]->backPropFromLabels( 0.05f, labels );
+        }
+    }
+    for( int fused = 0; fused <= 1; fused++ ) {
+        nets[fused]->propagate( images );
+    }
+    for( int i = 0; i < batchSize * numClasses; i++ ) {
+        EXPECT_FLOAT_NEAR( nets[0]->getResults()[i], nets[1]->getResults()[i] );
+    }
+    // conv results of the fused net are worked out on demand
+    float const *convResults = nets[0]->getLayer(1)->getResults();
+    float const *fusedConvResults = nets[1]->getLayer(1)->getResults();
+    for( int i = 0; i < nets[0]->getLayer(1)->getResultsSize(); i++ ) {
+        EXPECT_FLOAT_NEAR( convResults[i], fusedConvResults[i] );
+    }
+
+    delete[] images;
+    delete nets[1];
+    delete nets[0];
+}
+
+TEST( testConvPoolPropagate, netdefFuses ) {
+    NeuralNet *net = NeuralNet::maker()->planes(1)->imageSize(16)->instance();
+    EXPECT_TRUE( NetdefToNet::createNetFromNetdef( net, "8c3{z}-mp2-rt2-8c3{z}-mp2-10n" ) );
+    EXPECT_EQ( net->getLayer(1), dynamic_cast< PoolingLayer * >( net->getLayer(2) )->fusedConv );
+    EXPECT_EQ( net->getLayer(4), dynamic_cast< PoolingLayer * >( net->getLayer(5) )->fusedConv );
+
+    // inference, with an arena: pooling reads the conv input, which has to stay alive
+    NeuralNet *unfusedNet = NeuralNet::maker()->planes(1)->imageSize(16)->instance();
+    unfusedNet->addLayer( ConvolutionalMaker::instance()->numFilters(8)->filterSize(3)->relu()->biased()->padZeros() );
+    unfusedNet->addLayer( PoolingMaker::instance()->poolingSize(2) );
+    unfusedNet->addLayer( RandomTranslationsMaker::instance()->translateSize(2) );
+    unfusedNet->addLayer( ConvolutionalMaker::instance()->numFilters(8)->filterSize(3)->relu()->biased()->padZeros() );
+    unfusedNet->addLayer( PoolingMaker::instance()->poolingSize(2) );
+    unfusedNet->addLayer( FullyConnectedMaker::instance()->numPlanes(10)->imageSize(1)->linear()->biased() );
+    unfusedNet->addLayer( SoftMaxMaker::instance() );
+    for( int layer = 1; layer < net->getNumLayers(); layer++ ) {
+        const int persistSize = net->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *persisted = new float[ persistSize ];
+        net->getLayer(layer)->persistToArray( persisted );
+        unfusedNet->getLayer(layer)->unpersistFromArray( persisted );
+        delete[] persisted;
+    }
+    const int batchSize = 3;
+    float images[ batchSize * 16 * 16 ];
+    WeightRandomizer::randomize( 4, images, batchSize * 16 * 16, -1.0f, 1.0f );
+    net->setInferenceOnly( batchSize );
+    unfusedNet->setBatchSize( batchSize );
+    unfusedNet->setTraining( false );
+    net->propagate( images );
+    unfusedNet->propagate( images );
+    for( int i = 0; i < batchSize * 10; i++ ) {
+        EXPECT_FLOAT_NEAR( unfusedNet->getResults()[i], net->getResults()[i] );
+    }
+    delete unfusedNet;
+    delete net;
+}
+
+}
+
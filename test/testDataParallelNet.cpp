@@ -0,0 +1,113 @@
+// checks DataParallelNet learns the same weights as a single net trained on the
+// whole batch, including batches smaller than the number of replicas.
+// SLOW_testDataParallelNet.throughput times one replica against one per core
+
+#include <iostream>
+#include <thread>
+
+#include "NeuralNet.h"
+#include "DataParallelNet.h"
+#include "WeightsPersister.h"
+#include "Timer.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+#include "test/TestNet.h"
+
+using namespace std;
+
+namespace testDataParallelNet {
+
+void checkSameAsSingleNet( int numReplicas, int batchSize ) {
+    const int imageSize = 12;
+    const int numClasses = 3;
+    NeuralNet *single = TestNet::makeNet( 2, imageSize, numClasses );
+    NeuralNet *model = TestNet::makeNet( 2, imageSize, numClasses );
+    const int numWeights = WeightsPersister::getTotalNumWeights( single );
+    float *weights = new float[ numWeights ];
+    WeightsPersister::copyNetWeightsToArray( single, weights );
+    WeightsPersister::copyArrayToNetWeights( weights, model );
+    DataParallelNet *dataParallel = new DataParallelNet( numReplicas, model );
+    single->setBatchSize( batchSize );
+    dataParallel->setBatchSize( batchSize );
+
+    const int inputSize = batchSize * 2 * imageSize * imageSize;
+    float *images = new float[ inputSize ];
+    WeightRandomizer::randomize( 7, images, inputSize, -1.0f, 1.0f );
+    int *labels = new int[ batchSize ];
+    for( int n = 0; n < batchSize; n++ ) {
+        labels[n] = ( n * 7 ) % numClasses;
+    }
+    for( int it = 0; it < 3; it++ ) {
+        single->propagate( images );
+        dataParallel->propagate( images );
+        for( int i = 0; i < batchSize * numClasses; i++ ) {
+            EXPECT_FLOAT_NEAR( single->getResults()[i], dataParallel->getResults()[i] );
+        }
+        EXPECT_EQ( single->calcNumRight( labels ), dataParallel->calcNumRight( labels ) );
+        EXPECT_FLOAT_NEAR( single->calcLossFromLabels( labels ), dataParallel->calcLossFromLabels( labels ) );
+        single->backPropFromLabels( 0.05f, labels );
+        dataParallel->backPropFromLabels( 0.05f, labels );
+    }
+    float *parallelWeights = new float[ numWeights ];
+    WeightsPersister::copyNetWeightsToArray( single, weights );
+    for( int replica = 0; replica < numReplicas; replica++ ) {
+        WeightsPersister::copyNetWeightsToArray( dataParallel->getReplica( replica ), parallelWeights );
+        for( int i = 0; i < numWeights; i++ ) {
+            EXPECT_NEAR( weights[i], parallelWeights[i], 1e-5f );
+        }
+    }
+
+    delete[] parallelWeights;
+    delete[] labels;
+    delete[] images;
+    delete[] weights;
+    delete dataParallel;
+    delete model;
+    delete single;
+}
+
+TEST( testDataParallelNet, sameAsSingleNet ) {
+    checkSameAsSingleNet( 2, 8 );
+    checkSameAsSingleNet( 3, 7 );
+}
+
+TEST( testDataParallelNet, batchSmallerThanNumReplicas ) {
+    checkSameAsSingleNet( 4, 3 );
+}
+
+TEST( SLOW_testDataParallelNet, throughput ) {
+    const int batchSize = 128;
+    const int imageSize = 28;
+    const int numBatches = 20;
+    const int maxReplicas = std::max( 1, (int)std::thread::hardware_concurrency() );
+    float *images = new float[ batchSize * 2 * imageSize * imageSize ];
+    WeightRandomizer::randomize( 3, images, batchSize * 2 * imageSize * imageSize, -1.0f, 1.0f );
+    int *labels = new int[ batchSize ];
+    for( int n = 0; n < batchSize; n++ ) {
+        labels[n] = n % 10;
+    }
+    double times[2];
+    const int numReplicas[] = { 1, maxReplicas };
+    for( int i = 0; i < 2; i++ ) {
+        NeuralNet *model = TestNet::makeNet( 2, imageSize, 10 );
+        DataParallelNet *dataParallel = new DataParallelNet( numReplicas[i], model );
+        dataParallel->setBatchSize( batchSize );
+        Timer timer;
+        for( int batch = 0; batch < numBatches; batch++ ) {
+            dataParallel->propagate( images );
+            dataParallel->backPropFromLabels( 0.001f, labels );
+        }
+        times[i] = timer.lap();
+        cout << numReplicas[i] << " replicas: " << ( batchSize * numBatches / times[i] * 1000 ) << " examples/s" << endl;
+        delete dataParallel;
+        delete model;
+    }
+    cout << "speedup " << ( times[0] / times[1] ) << " on " << maxReplicas << " threads" << endl;
+    delete[] labels;
+    delete[] images;
+}
+
+}
+
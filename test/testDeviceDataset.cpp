@@ -0,0 +1,111 @@
+// tests DeviceDataset gathering batches on the device, and feeding them
+// into a NeuralNet, compared with the normal host path
+
+#include <iostream>
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "OpenCLHelper.h"
+#include "NeuralNet.h"
+#include "DeviceDataset.h"
+#include "ZeroCopy.h"
+
+using namespace std;
+
+TEST( testDeviceDataset, gather ) {
+    OpenCLHelper *cl = OpenCLHelper::createForFirstGpuOtherwiseCpu();
+    const int N = 17;
+    const int cubeSize = 2 * 5 * 5;
+    const float translate = -12.5f;
+    const float scale = 0.03f;
+    unsigned char *data = new unsigned char[N * cubeSize];
+    for( int i = 0; i < N * cubeSize; i++ ) {
+        data[i] = (unsigned char)( ( i * 37 ) % 256 );
+    }
+    DeviceDataset dataset( cl, N, cubeSize, data, translate, scale );
+    int indices[] = { 16, 3, 3, 0, 9 };
+    const int batchSize = 5;
+    CLWrapper *batchWrapper = dataset.gather( batchSize, indices );
+    ZeroCopy::copyToHost( batchWrapper );
+    float *batch = (float *)batchWrapper->getHostArray();
+    for( int n = 0; n < batchSize; n++ ) {
+        for( int i = 0; i < cubeSize; i++ ) {
+            float expected = ( data[ indices[n] * cubeSize + i ] + translate ) * scale;
+            EXPECT_FLOAT_NEAR( expected, batch[ n * cubeSize + i ] );
+        }
+    }
+    // second, smaller, batch reuses the buffers
+    int indices2[] = { 1, 2 };
+    batchWrapper = dataset.gather( 2, indices2 );
+    ZeroCopy::copyToHost( batchWrapper );
+    batch = (float *)batchWrapper->getHostArray();
+    for( int n = 0; n < 2; n++ ) {
+        for( int i = 0; i < cubeSize; i++ ) {
+            float expected = ( data[ indices2[n] * cubeSize + i ] + translate ) * scale;
+            EXPECT_FLOAT_NEAR( expected, batch[ n * cubeSize + i ] );
+        }
+    }
+    delete[] data;
+    delete cl;
+}
+
+TEST( testDeviceDataset, propagateSameAsHost ) {
+    const int N = 8;
+    const int numPlanes = 1;
+    const int imageSize = 6;
+    const int cubeSize = numPlanes * imageSize * imageSize;
+    const float translate = -100.0f;
+    const float scale = 0.01f;
+    unsigned char *data = new unsigned char[N * cubeSize];
+    for( int i = 0; i < N * cubeSize; i++ ) {
+        data[i] = (unsigned char)( ( i * 101 ) % 256 );
+    }
+
+    NeuralNet *hostNet = new NeuralNet();
+    hostNet->addLayer( InputLayerMaker<unsigned char>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+    hostNet->addLayer( NormalizationLayerMaker::instance()->translate(translate)->scale(scale) );
+    hostNet->addLayer( ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->tanh()->biased() );
+    hostNet->addLayer( FullyConnectedMaker::instance()->numPlanes(3)->imageSize(1)->linear()->biased() );
+    hostNet->addLayer( SoftMaxMaker::instance() );
+
+    NeuralNet *deviceNet = new NeuralNet();
+    deviceNet->addLayer( InputLayerMaker<float>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+    deviceNet->addLayer( ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->tanh()->biased() );
+    deviceNet->addLayer( FullyConnectedMaker::instance()->numPlanes(3)->imageSize(1)->linear()->biased() );
+    deviceNet->addLayer( SoftMaxMaker::instance() );
+
+    // same weights in both nets.  deviceNet has no NormalizationLayer, so its layers are offset by one
+    for( int layer = 2; layer <= 3; layer++ ) {
+        float *persisted = new float[ hostNet->getLayer(layer)->getPersistSize() ];
+        hostNet->getLayer(layer)->persistToArray( persisted );
+        deviceNet->getLayer(layer - 1)->unpersistFromArray( persisted );
+        delete[] persisted;
+    }
+
+    int indices[] = { 5, 1, 7, 2 };
+    const int batchSize = 4;
+    unsigned char *hostBatch = new unsigned char[batchSize * cubeSize];
+    for( int n = 0; n < batchSize; n++ ) {
+        for( int i = 0; i < cubeSize; i++ ) {
+            hostBatch[ n * cubeSize + i ] = data[ indices[n] * cubeSize + i ];
+        }
+    }
+    hostNet->setBatchSize( batchSize );
+    hostNet->propagate( hostBatch );
+
+    DeviceDataset dataset( deviceNet->getCl(), N, cubeSize, data, translate, scale );
+    deviceNet->setBatchSize( batchSize );
+    deviceNet->propagateFromDevice( dataset.gather( batchSize, indices ) );
+
+    float const*hostResults = hostNet->getResults();
+    float const*deviceResults = deviceNet->getResults();
+    for( int i = 0; i < batchSize * 3; i++ ) {
+        EXPECT_FLOAT_NEAR( hostResults[i], deviceResults[i] );
+    }
+
+    delete[] hostBatch;
+    delete deviceNet;
+    delete hostNet;
+    delete[] data;
+}
+
@@ -0,0 +1,169 @@
+// checks DistributedNet, with one thread standing in for each process, learns
+// the same weights as a single net trained on all the processes' batches at once,
+// and that ranks without the weights file resume from where rank 0 does
+
+#include <iostream>
+#include <vector>
+#include <thread>
+
+#include "NeuralNet.h"
+#include "RingAllReduce.h"
+#include "DistributedNet.h"
+#include "WeightsPersister.h"
+#include "WeightsCheckpointer.h"
+#include "ResumeState.h"
+#include "FileHelper.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+#include "test/TestNet.h"
+#include "test/TestPorts.h"
+
+using namespace std;
+
+namespace testDistributedNet {
+
+const int basePort = TestPorts::basePort( 50 );
+
+TEST( testDistributedNet, sameAsSingleNet ) {
+    const int worldSize = 2;
+    const int imageSize = 12;
+    const int numClasses = 3;
+    const int batchSize = 4;
+    const int inputCubeSize = 2 * imageSize * imageSize;
+
+    // different random weights everywhere: rank 0's should win
+    NeuralNet *single = TestNet::makeNet( 2, imageSize, numClasses );
+    vector< NeuralNet * > nets;
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        nets.push_back( TestNet::makeNet( 2, imageSize, numClasses ) );
+        nets[rank]->setBatchSize( batchSize );
+    }
+    const int numWeights = WeightsPersister::getTotalNumWeights( single );
+    float *weights = new float[ numWeights ];
+    WeightsPersister::copyNetWeightsToArray( nets[0], weights );
+    WeightsPersister::copyArrayToNetWeights( weights, single );
+    single->setBatchSize( batchSize * worldSize );
+
+    const int inputSize = worldSize * batchSize * inputCubeSize;
+    float *images = new float[ inputSize ];
+    WeightRandomizer::randomize( 11, images, inputSize, -1.0f, 1.0f );
+    int *labels = new int[ worldSize * batchSize ];
+    for( int n = 0; n < worldSize * batchSize; n++ ) {
+        labels[n] = ( n * 5 ) % numClasses;
+    }
+    const int numIts = 3;
+    for( int it = 0; it < numIts; it++ ) {
+        single->propagate( images );
+        single->backPropFromLabels( 0.05f, labels );
+    }
+
+    vector< thread > ranks;
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        ranks.push_back( thread( [rank, &nets, images, labels, inputCubeSize]() {
+            RingAllReduce ring( rank, worldSize, RingAllReduce::localHosts( worldSize ), basePort );
+            DistributedNet distributedNet( nets[rank], &ring );
+            for( int it = 0; it < numIts; it++ ) {
+                distributedNet.propagate( images + rank * batchSize * inputCubeSize );
+                distributedNet.backPropFromLabels( 0.05f, labels + rank * batchSize );
+            }
+        } ) );
+    }
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        ranks[rank].join();
+    }
+
+    float *distributedWeights = new float[ numWeights ];
+    WeightsPersister::copyNetWeightsToArray( single, weights );
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        WeightsPersister::copyNetWeightsToArray( nets[rank], distributedWeights );
+        for( int i = 0; i < numWeights; i++ ) {
+            EXPECT_NEAR( weights[i], distributedWeights[i], 1e-5f );
+        }
+    }
+
+    delete[] distributedWeights;
+    delete[] labels;
+    delete[] images;
+    delete[] weights;
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        delete nets[rank];
+    }
+    delete single;
+}
+
+TEST( testDistributedNet, onlyRank0HasResumeFile ) {
+    const int worldSize = 3;
+    const int imageSize = 12;
+    const int numClasses = 3;
+    const string filepath = "testDistributedNet.dat";
+
+    NeuralNet *saved = TestNet::makeNet( 2, imageSize, numClasses );
+    const int numWeights = WeightsPersister::getTotalNumWeights( saved );
+    ResumeState savedState( 3 );
+    savedState.batch = 2;
+    savedState.numRight = 5;
+    savedState.loss = 1.5f;
+    savedState.annealedLearningRate = 0.25f;
+    savedState.permutation.push_back( 2 );
+    savedState.permutation.push_back( 0 );
+    savedState.permutation.push_back( 1 );
+    WeightsCheckpointer *checkpointer = new WeightsCheckpointer( filepath, "some config", saved );
+    checkpointer->checkpoint( savedState );
+    checkpointer->flush();
+    delete checkpointer;
+    float *savedWeights = new float[ numWeights ];
+    WeightsPersister::copyNetWeightsToArray( saved, savedWeights );
+
+    vector< NeuralNet * > nets;
+    vector< ResumeState > states( worldSize );
+    vector< char > resuming( worldSize, 0 );
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        nets.push_back( TestNet::makeNet( 2, imageSize, numClasses ) );
+    }
+    vector< thread > ranks;
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        ranks.push_back( thread( [rank, &nets, &states, &resuming, filepath]() {
+            bool loaded = false;
+            if( rank == 0 ) {
+                loaded = WeightsPersister::loadWeights( filepath, "some config", nets[rank], &states[rank] );
+            }
+            RingAllReduce ring( rank, worldSize, RingAllReduce::localHosts( worldSize ), basePort + 10 );
+            resuming[rank] = DistributedNet::broadcastResumeState( &ring, loaded, &states[rank] );
+            DistributedNet distributedNet( nets[rank], &ring );
+        } ) );
+    }
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        ranks[rank].join();
+    }
+
+    float *weights = new float[ numWeights ];
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        EXPECT_TRUE( resuming[rank] );
+        EXPECT_EQ( 3, states[rank].epoch );
+        EXPECT_EQ( 2, states[rank].batch );
+        EXPECT_EQ( 5, states[rank].numRight );
+        EXPECT_EQ( 1.5f, states[rank].loss );
+        EXPECT_EQ( 0.25f, states[rank].annealedLearningRate );
+        EXPECT_EQ( 3, (int)states[rank].permutation.size() );
+        EXPECT_EQ( 2, states[rank].permutation[0] );
+        EXPECT_EQ( 1, states[rank].permutation[2] );
+        EXPECT_NE( "", states[rank].randomState );
+        EXPECT_EQ( states[0].randomState, states[rank].randomState );
+        WeightsPersister::copyNetWeightsToArray( nets[rank], weights );
+        for( int i = 0; i < numWeights; i++ ) {
+            EXPECT_EQ( savedWeights[i], weights[i] );
+        }
+    }
+
+    FileHelper::remove( filepath );
+    delete[] weights;
+    delete[] savedWeights;
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        delete nets[rank];
+    }
+    delete saved;
+}
+
+}
@@ -0,0 +1,168 @@
+// checks the FastMath approximations stay inside their documented errors, and
+// times them against the libm versions.  SLOW_testFastMath.mnist checks that
+// training with fastmath gives the same accuracy on mnist as without
+
+#include <iostream>
+#include <cmath>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "FastMath.h"
+#include "ActivationFunction.h"
+#include "NeuralNet.h"
+#include "NetdefToNet.h"
+#include "GenericLoader.h"
+#include "AccuracyHelper.h"
+#include "Timer.h"
+
+using namespace std;
+
+namespace testFastMath {
+
+TEST( testFastMath, maxErrors ) {
+    double maxExpRelError = 0;
+    for( float x = -87.0f; x <= 88.0f; x += 0.0013f ) {
+        const double expected = exp( (double)x );
+        maxExpRelError = max( maxExpRelError, fabs( FastMath::exp( x ) - expected ) / expected );
+    }
+    double maxTanhError = 0;
+    double maxSigmoidError = 0;
+    for( float x = -12.0f; x <= 12.0f; x += 0.00011f ) {
+        maxTanhError = max( maxTanhError, fabs( FastMath::tanh( x ) - tanh( (double)x ) ) );
+        maxSigmoidError = max( maxSigmoidError, fabs( FastMath::sigmoid( x ) - 1.0 / ( 1.0 + exp( - (double)x ) ) ) );
+    }
+    cout << "max errors: exp " << maxExpRelError << " tanh " << maxTanhError << " sigmoid " << maxSigmoidError << endl;
+    EXPECT_GT( 1e-5, maxExpRelError );
+    EXPECT_GT( 5e-7, maxTanhError );
+    EXPECT_GT( 3e-7, maxSigmoidError );
+    // saturates, rather than overflowing
+    EXPECT_EQ( 1.0f, FastMath::tanh( 1000.0f ) );
+    EXPECT_EQ( -1.0f, FastMath::tanh( -1000.0f ) );
+    EXPECT_LT( 0.0f, FastMath::exp( -1000.0f ) );
+}
+
+TEST( testFastMath, activationsNearExact ) {
+    const int N = 1000;
+    float exact[N];
+    float fast[N];
+    string names[] = { "tanh", "scaledtanh", "sigmoid", "linear", "relu" };
+    for( int f = 0; f < 5; f++ ) {
+        for( int i = 0; i < N; i++ ) {
+            exact[i] = ( i - 500 ) / 50.0f;
+            fast[i] = exact[i];
+        }
+        ActivationFunction *exactFn = ActivationFunction::fromName( names[f] );
+        ActivationFunction *fastFn = ActivationFunction::fromName( names[f], true );
+        EXPECT_EQ( exactFn->getDefineName(), fastFn->getDefineName() );
+        EXPECT_EQ( "-D " + fastFn->getDefineName() + " -D FAST_MATH", fastFn->getKernelDefines() );
+        exactFn->calcArray( N, exact );
+        fastFn->calcArray( N, fast );
+        for( int i = 0; i < N; i++ ) {
+            EXPECT_NEAR( exact[i], fast[i], 1e-6f );
+        }
+        delete fastFn;
+        delete exactFn;
+    }
+}
+
+TEST( SLOW_testFastMath, throughput ) {
+    const int N = 1 << 22;
+    const int numIts = 20;
+    float *values = new float[N];
+    string names[] = { "tanh", "scaledtanh", "sigmoid" };
+    for( int f = 0; f < 3; f++ ) {
+        double times[2];
+        for( int fastMath = 0; fastMath <= 1; fastMath++ ) {
+            ActivationFunction *fn = ActivationFunction::fromName( names[f], fastMath );
+            for( int i = 0; i < N; i++ ) {
+                values[i] = ( i % 2000 ) / 200.0f - 5.0f;
+            }
+            Timer timer;
+            for( int it = 0; it < numIts; it++ ) {
+                fn->calcArray( N, values );
+            }
+            times[fastMath] = timer.lap();
+            delete fn;
+        }
+        const double numValues = (double)N * numIts;
+        cout << names[f] << ": exact " << ( numValues / times[0] / 1000 ) << " M/s, fast "
+            << ( numValues / times[1] / 1000 ) << " M/s, speedup " << ( times[0] / times[1] ) << endl;
+        EXPECT_GT( times[0], times[1] );
+    }
+    delete[] values;
+}
+
+float trainAndTest( NeuralNet *net, unsigned char *trainImages, int *trainLabels, int numTrain,
+        unsigned char *testImages, int *testLabels, int numTest, int inputCubeSize ) {
+    const int batchSize = 128;
+    float *batch = new float[ batchSize * inputCubeSize ];
+    for( int epoch = 0; epoch < 2; epoch++ ) {
+        for( int start = 0; start + batchSize <= numTrain; start += batchSize ) {
+            for( int i = 0; i < batchSize * inputCubeSize; i++ ) {
+                batch[i] = trainImages[ start * inputCubeSize + i ] / 255.0f - 0.13f;
+            }
+            net->setBatchSize( batchSize );
+            net->propagate( batch );
+            net->backPropFromLabels( 0.002f, trainLabels + start );
+        }
+    }
+    int numRight = 0;
+    for( int start = 0; start + batchSize <= numTest; start += batchSize ) {
+        for( int i = 0; i < batchSize * inputCubeSize; i++ ) {
+            batch[i] = testImages[ start * inputCubeSize + i ] / 255.0f - 0.13f;
+        }
+        net->propagate( batch );
+        numRight += AccuracyHelper::calcNumRight( batchSize, 10, testLabels + start, net->getResults() );
+    }
+    delete[] batch;
+    return numRight * 100.0f / ( numTest / batchSize * batchSize );
+}
+
+TEST( SLOW_testFastMath, mnist ) {
+    const string dataDir = "../data/mnist";
+    const int numTrain = 6400;
+    const int numTest = 1280;
+    int N, numPlanes, imageSize;
+    GenericLoader::getDimensions( dataDir + "/train-images-idx3-ubyte", &N, &numPlanes, &imageSize );
+    const int inputCubeSize = numPlanes * imageSize * imageSize;
+    unsigned char *trainImages = new unsigned char[ numTrain * inputCubeSize ];
+    int *trainLabels = new int[ numTrain ];
+    unsigned char *testImages = new unsigned char[ numTest * inputCubeSize ];
+    int *testLabels = new int[ numTest ];
+    GenericLoader::load( dataDir + "/train-images-idx3-ubyte", trainImages, trainLabels, 0, numTrain );
+    GenericLoader::load( dataDir + "/t10k-images-idx3-ubyte", testImages, testLabels, 0, numTest );
+
+    NeuralNet *nets[2];
+    for( int fastMath = 0; fastMath <= 1; fastMath++ ) {
+        nets[fastMath] = NeuralNet::maker()->planes( numPlanes )->imageSize( imageSize )->instance();
+        ASSERT_TRUE( NetdefToNet::createNetFromNetdef( nets[fastMath], "8c5{tanh,z}-mp2-150n-10n", fastMath ) );
+    }
+    // same starting weights for both
+    for( int layer = 1; layer < nets[0]->getNumLayers(); layer++ ) {
+        const int persistSize = nets[0]->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *persisted = new float[ persistSize ];
+        nets[0]->getLayer(layer)->persistToArray( persisted );
+        nets[1]->getLayer(layer)->unpersistFromArray( persisted );
+        delete[] persisted;
+    }
+    float accuracies[2];
+    for( int fastMath = 0; fastMath <= 1; fastMath++ ) {
+        accuracies[fastMath] = trainAndTest( nets[fastMath], trainImages, trainLabels, numTrain,
+            testImages, testLabels, numTest, inputCubeSize );
+        delete nets[fastMath];
+    }
+    cout << "test accuracy: exact " << accuracies[0] << "% fastmath " << accuracies[1] << "%" << endl;
+    EXPECT_NEAR( accuracies[0], accuracies[1], 1.0f );
+
+    delete[] testLabels;
+    delete[] testImages;
+    delete[] trainLabels;
+    delete[] trainImages;
+}
+
+}
+
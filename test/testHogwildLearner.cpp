@@ -0,0 +1,77 @@
+// checks HogwildLearner learns an easy problem, with one worker and with several,
+// and leaves the learnt weights in the net it was given
+
+#include <iostream>
+
+#include "NeuralNet.h"
+#include "HogwildLearner.h"
+#include "BatchLearner.h"
+
+#include "gtest/gtest.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+namespace testHogwildLearner {
+
+// label is the plane with the larger mean
+void makeData( int seed, int N, int imageSize, float *images, int *labels ) {
+    const int planeSize = imageSize * imageSize;
+    WeightRandomizer::randomize( seed, images, N * 2 * planeSize, -1.0f, 1.0f );
+    for( int n = 0; n < N; n++ ) {
+        labels[n] = n % 2;
+        float *plane = images + ( n * 2 + labels[n] ) * planeSize;
+        for( int i = 0; i < planeSize; i++ ) {
+            plane[i] += 0.5f;
+        }
+    }
+}
+
+void checkLearns( int numWorkers ) {
+    const int imageSize = 4;
+    const int Ntrain = 512;
+    const int Ntest = 128;
+    const int batchSize = 16;
+    NeuralNet *net = NeuralNet::maker()->planes(2)->imageSize(imageSize)->instance();
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(8)->imageSize(1)->tanh()->biased() );
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(2)->imageSize(1)->linear()->biased() );
+    net->addLayer( SoftMaxMaker::instance() );
+    float *trainImages = new float[ Ntrain * 2 * imageSize * imageSize ];
+    int *trainLabels = new int[ Ntrain ];
+    float *testImages = new float[ Ntest * 2 * imageSize * imageSize ];
+    int *testLabels = new int[ Ntest ];
+    makeData( 1, Ntrain, imageSize, trainImages, trainLabels );
+    makeData( 2, Ntest, imageSize, testImages, testLabels );
+
+    HogwildLearner<float> *learner = new HogwildLearner<float>( net, numWorkers );
+    EXPECT_EQ( numWorkers, learner->getNumWorkers() );
+    learner->setTrainingData( Ntrain, trainImages, trainLabels );
+    learner->setBatchSize( batchSize );
+    int lastNumRight = 0;
+    for( int epoch = 0; epoch < 10; epoch++ ) {
+        lastNumRight = learner->runEpoch( 0.01f ).numRight;
+    }
+    EXPECT_GT( lastNumRight, Ntrain * 85 / 100 );
+    BatchLearner<float> batchLearner( net );
+    const int testNumRight = batchLearner.test( batchSize, Ntest, testImages, testLabels );
+    cout << numWorkers << " workers: train " << lastNumRight << "/" << Ntrain << " test " << testNumRight << "/" << Ntest << endl;
+    EXPECT_GT( testNumRight, Ntest * 85 / 100 );
+
+    delete learner;
+    delete[] testLabels;
+    delete[] testImages;
+    delete[] trainLabels;
+    delete[] trainImages;
+    delete net;
+}
+
+TEST( testHogwildLearner, oneWorker ) {
+    checkLearns( 1 );
+}
+
+TEST( testHogwildLearner, fourWorkers ) {
+    checkLearns( 4 );
+}
+
+}
+
@@ -0,0 +1,113 @@
+// runs an InferenceServer on localhost, over tcp and over a unix socket, with
+// several clients at once, and checks they get the net's results, and that
+// their requests were batched together
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cmath>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "NeuralNet.h"
+#include "InferenceServer.h"
+#include "InferenceClient.h"
+#include "WeightRandomizer.h"
+#include "TestNet.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace testInferenceServer {
+
+// numClients clients, on their own threads, each sending numRequests requests
+void runClients( std::string address, NeuralNet *net, float const *inputs, float const *expected, int numExamples ) {
+    const int numClients = 6;
+    const int numRequests = 40;
+    const int inputCubeSize = net->getInputCubeSize();
+    const int outputCubeSize = net->getOutputCubeSize();
+    vector< int > numWrong( numClients, 0 );
+    vector< thread > threads;
+    for( int c = 0; c < numClients; c++ ) {
+        threads.push_back( thread( [&, c]() {
+            InferenceClient client( address );
+            vector< float > output( outputCubeSize );
+            for( int i = 0; i < numRequests; i++ ) {
+                const int n = ( c + i ) % numExamples;
+                client.propagate( inputs + n * inputCubeSize, &output[0] );
+                for( int j = 0; j < outputCubeSize; j++ ) {
+                    if( fabs( output[j] - expected[n * outputCubeSize + j] ) > 0.0001f ) {
+                        numWrong[c]++;
+                    }
+                }
+            }
+        } ) );
+    }
+    for( int c = 0; c < numClients; c++ ) {
+        threads[c].join();
+        EXPECT_EQ( 0, numWrong[c] );
+    }
+}
+
+TEST( testInferenceServer, batchesclients ) {
+    const int numExamples = 8;
+    NeuralNet *net = TestNet::makeNet( 2, 8, 10 );
+    const int inputCubeSize = net->getInputCubeSize();
+    const int outputCubeSize = net->getOutputCubeSize();
+    float *inputs = new float[ numExamples * inputCubeSize ];
+    WeightRandomizer::randomize( inputs, numExamples * inputCubeSize, -1.0f, 1.0f );
+    net->setBatchSize( numExamples );
+    net->propagate( inputs );
+    float *expected = new float[ numExamples * outputCubeSize ];
+    memcpy( expected, net->getResults(), sizeof(float) * numExamples * outputCubeSize );
+
+    // long enough a deadline that the clients requests meet up
+    InferenceServer *server = new InferenceServer( net, 8, 20000 );
+    server->listen( "tcp:0" );
+    server->start();
+    runClients( "tcp:" + toString( server->getPort() ), net, inputs, expected, numExamples );
+    InferenceServerStats stats = server->getStats();
+    EXPECT_EQ( 240, stats.numRequests );
+    EXPECT_LT( stats.numBatches, stats.numRequests );
+    InferenceClient client( "tcp:" + toString( server->getPort() ) );
+    EXPECT_EQ( inputCubeSize, client.getInputCubeSize() );
+    EXPECT_EQ( outputCubeSize, client.getOutputCubeSize() );
+    EXPECT_NE( std::string::npos, client.getStats().find( "requests=240" ) );
+    // stops with a client still connected
+    server->stop();
+    delete server;
+
+    #ifndef _WIN32
+    // per process, so runs at the same time dont share a socket
+    const std::string unixAddress = "unix:/tmp/testInferenceServer." + toString( (int)getpid() ) + ".sock";
+    server = new InferenceServer( net, 4, 1000 );
+    server->listen( unixAddress );
+    server->start();
+    runClients( unixAddress, net, inputs, expected, numExamples );
+    delete server;
+    #endif
+
+    delete[] expected;
+    delete[] inputs;
+    delete net;
+}
+
+TEST( testInferenceServer, parseaddress ) {
+    std::string path;
+    int port = -1;
+    InferenceServer::parseAddress( "tcp:5000", &path, &port );
+    EXPECT_EQ( 5000, port );
+    EXPECT_EQ( "", path );
+    InferenceServer::parseAddress( "5001", &path, &port );
+    EXPECT_EQ( 5001, port );
+    InferenceServer::parseAddress( "unix:/tmp/foo.sock", &path, &port );
+    EXPECT_EQ( "/tmp/foo.sock", path );
+    EXPECT_THROW( InferenceServer::parseAddress( "tcp:abc", &path, &port ), runtime_error );
+    EXPECT_THROW( InferenceServer::parseAddress( "unix:", &path, &port ), runtime_error );
+}
+
+}
+
@@ -0,0 +1,123 @@
+// checks that InferenceSessions give the same results as their model, share
+// its weights buffers, and can run on several threads at once
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cmath>
+
+#include "NeuralNet.h"
+#include "InferenceSession.h"
+#include "WeightRandomizer.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace testInferenceSession {
+
+NeuralNet *makeModel() {
+    NeuralNet *net = new NeuralNet();
+    net->addLayer( InputLayerMaker<float>::instance()->numPlanes(2)->imageSize(12) );
+    net->addLayer( NormalizationLayerMaker::instance()->translate(-0.5f)->scale(2.0f) );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(6)->filterSize(3)->relu()->biased()->padZeros() );
+    net->addLayer( PoolingMaker::instance()->poolingSize(2) );
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(16)->imageSize(1)->tanh()->biased() );
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(4)->imageSize(1)->linear()->biased() );
+    net->addLayer( SoftMaxMaker::instance() );
+    return net;
+}
+
+TEST( testInferenceSession, sameresults ) {
+    const int batchSize = 4;
+    NeuralNet *model = makeModel();
+    const int inputCubeSize = model->getInputCubeSize();
+    const int outputCubeSize = model->getOutputCubeSize();
+    float *input = new float[ batchSize * inputCubeSize ];
+    WeightRandomizer::randomize( input, batchSize * inputCubeSize, 0.0f, 1.0f );
+    model->setBatchSize( batchSize );
+    model->propagate( input );
+    float *expected = new float[ batchSize * outputCubeSize ];
+    memcpy( expected, model->getResults(), sizeof(float) * batchSize * outputCubeSize );
+
+    InferenceSession *session = new InferenceSession( model, batchSize );
+    EXPECT_EQ( inputCubeSize, session->getInputCubeSize() );
+    EXPECT_EQ( outputCubeSize, session->getOutputCubeSize() );
+    // one copy of the weights, on the device
+    ConvolutionalLayer *modelConv = dynamic_cast< ConvolutionalLayer * >( model->getLayer( 2 ) );
+    ConvolutionalLayer *sessionConv = dynamic_cast< ConvolutionalLayer * >( session->layers[2] );
+    EXPECT_EQ( modelConv->weightsWrapper, sessionConv->weightsWrapper );
+
+    session->propagate( input );
+    float const *results = session->getResults();
+    for( int i = 0; i < batchSize * outputCubeSize; i++ ) {
+        EXPECT_NEAR( expected[i], results[i], 0.0001f );
+    }
+    session->setBatchSize( 1 );
+    session->propagate( input + inputCubeSize );
+    results = session->getResults();
+    for( int i = 0; i < outputCubeSize; i++ ) {
+        EXPECT_NEAR( expected[outputCubeSize + i], results[i], 0.0001f );
+    }
+    EXPECT_THROW( session->setBatchSize( batchSize + 1 ), runtime_error );
+
+    delete session;
+    // the model's weights outlive the session
+    model->propagate( input );
+    EXPECT_NEAR( expected[0], model->getResults()[0], 0.0001f );
+    delete[] expected;
+    delete[] input;
+    delete model;
+}
+
+TEST( testInferenceSession, concurrent ) {
+    const int numThreads = 4;
+    const int numExamples = 8;
+    const int numPropagates = 200;
+    NeuralNet *model = makeModel();
+    const int inputCubeSize = model->getInputCubeSize();
+    const int outputCubeSize = model->getOutputCubeSize();
+    float *input = new float[ numExamples * inputCubeSize ];
+    WeightRandomizer::randomize( input, numExamples * inputCubeSize, 0.0f, 1.0f );
+    model->setBatchSize( numExamples );
+    model->propagate( input );
+    float *expected = new float[ numExamples * outputCubeSize ];
+    memcpy( expected, model->getResults(), sizeof(float) * numExamples * outputCubeSize );
+
+    vector< InferenceSession * > sessions;
+    for( int i = 0; i < numThreads; i++ ) {
+        sessions.push_back( new InferenceSession( model, 1 ) );
+    }
+    vector< int > numWrong( numThreads, 0 );
+    vector< thread > threads;
+    for( int t = 0; t < numThreads; t++ ) {
+        threads.push_back( thread( [&, t]() {
+            InferenceSession *session = sessions[t];
+            for( int i = 0; i < numPropagates; i++ ) {
+                const int n = ( i + t ) % numExamples;
+                session->propagate( input + n * inputCubeSize );
+                float const *results = session->getResults();
+                for( int j = 0; j < outputCubeSize; j++ ) {
+                    if( fabs( results[j] - expected[n * outputCubeSize + j] ) > 0.0001f ) {
+                        numWrong[t]++;
+                    }
+                }
+            }
+        } ) );
+    }
+    for( int t = 0; t < numThreads; t++ ) {
+        threads[t].join();
+        EXPECT_EQ( 0, numWrong[t] );
+    }
+
+    for( int i = 0; i < numThreads; i++ ) {
+        delete sessions[i];
+    }
+    delete[] expected;
+    delete[] input;
+    delete model;
+}
+
+}
+
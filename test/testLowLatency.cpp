@@ -0,0 +1,142 @@
+// checks that low latency mode gives the same results as the normal propagate,
+// including after the bias weights change, and across batch sizes, and measures
+// the batch size 1 latency of each
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+
+#include "NeuralNet.h"
+#include "WeightRandomizer.h"
+#include "TestNet.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace testLowLatency {
+
+void expectSameResults( int size, float const *expected, float const *actual ) {
+    for( int i = 0; i < size; i++ ) {
+        EXPECT_NEAR( expected[i], actual[i], 0.0001f );
+    }
+}
+
+TEST( testLowLatency, sameresults ) {
+    NeuralNet *net = TestNet::makeNet( 2, 8, 5 );
+    const int inputCubeSize = net->getInputCubeSize();
+    const int outputCubeSize = net->getOutputCubeSize();
+    float *input = new float[ 3 * inputCubeSize ];
+    WeightRandomizer::randomize( input, 3 * inputCubeSize, -1.0f, 1.0f );
+    float *expected = new float[ 3 * outputCubeSize ];
+
+    net->setBatchSize( 1 );
+    net->propagate( input );
+    memcpy( expected, net->getResults(), sizeof(float) * outputCubeSize );
+    net->setLowLatency( true );
+    net->propagate( input );
+    expectSameResults( outputCubeSize, expected, net->getResults() );
+    // again, now that the wrappers are cached
+    net->propagate( input + inputCubeSize );
+    net->propagate( input );
+    expectSameResults( outputCubeSize, expected, net->getResults() );
+
+    // new bias weights have to reach the device
+    float biasWeights[4];
+    for( int i = 0; i < 4; i++ ) {
+        biasWeights[i] = 0.5f;
+    }
+    net->initBiasWeights( 1, biasWeights );
+    net->setLowLatency( false );
+    net->propagate( input );
+    memcpy( expected, net->getResults(), sizeof(float) * outputCubeSize );
+    net->setLowLatency( true );
+    net->propagate( input + inputCubeSize );
+    net->initBiasWeights( 1, biasWeights );
+    net->propagate( input );
+    expectSameResults( outputCubeSize, expected, net->getResults() );
+
+    // a larger batch, then back to 1
+    net->setLowLatency( false );
+    net->setBatchSize( 3 );
+    net->propagate( input );
+    memcpy( expected, net->getResults(), sizeof(float) * 3 * outputCubeSize );
+    net->setLowLatency( true );
+    net->propagate( input );
+    expectSameResults( 3 * outputCubeSize, expected, net->getResults() );
+    net->setBatchSize( 1 );
+    net->propagate( input );
+    expectSameResults( outputCubeSize, expected, net->getResults() );
+
+    delete[] expected;
+    delete[] input;
+    delete net;
+}
+
+// when the input layer has no results wrapper, the pooling layer wraps its
+// results itself, once, and copies them up on each propagate
+TEST( testLowLatency, poolingafterinput ) {
+    NeuralNet *net = NeuralNet::maker()->planes(2)->imageSize(8)->instance();
+    net->addLayer( PoolingMaker::instance()->poolingSize(2) );
+    net->addLayer( FullyConnectedMaker::instance()->numPlanes(5)->imageSize(1)->linear()->biased() );
+    net->addLayer( SquareLossMaker::instance() );
+    const int inputCubeSize = net->getInputCubeSize();
+    const int outputCubeSize = net->getOutputCubeSize();
+    float *input = new float[ 2 * inputCubeSize ];
+    WeightRandomizer::randomize( input, 2 * inputCubeSize, -1.0f, 1.0f );
+    float *expected = new float[ 2 * outputCubeSize ];
+
+    net->setBatchSize( 1 );
+    net->propagate( input + inputCubeSize );
+    memcpy( expected + outputCubeSize, net->getResults(), sizeof(float) * outputCubeSize );
+    net->propagate( input );
+    memcpy( expected, net->getResults(), sizeof(float) * outputCubeSize );
+    net->setLowLatency( true );
+    for( int it = 0; it < 3; it++ ) {
+        net->propagate( input );
+        expectSameResults( outputCubeSize, expected, net->getResults() );
+        net->propagate( input + inputCubeSize );
+        expectSameResults( outputCubeSize, expected + outputCubeSize, net->getResults() );
+    }
+
+    delete[] expected;
+    delete[] input;
+    delete net;
+}
+
+// microseconds for each of numRuns propagates at batch size 1, including
+// reading the results back
+vector< double > timePropagates( NeuralNet *net, float const *input, int numRuns ) {
+    vector< double > times;
+    for( int run = 0; run < numRuns; run++ ) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        net->propagate( input );
+        net->getResults();
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        times.push_back( chrono::duration_cast< chrono::duration< double, micro > >( end - start ).count() );
+    }
+    sort( times.begin(), times.end() );
+    return times;
+}
+
+TEST( SLOW_testLowLatency, percentiles ) {
+    const int numRuns = 2000;
+    NeuralNet *net = TestNet::makeNet( 2, 8, 5 );
+    float *input = new float[ net->getInputCubeSize() ];
+    WeightRandomizer::randomize( input, net->getInputCubeSize(), -1.0f, 1.0f );
+    net->setBatchSize( 1 );
+    timePropagates( net, input, 100 ); // warm up, eg compile the kernels
+    vector< double > normal = timePropagates( net, input, numRuns );
+    net->setLowLatency( true );
+    timePropagates( net, input, 100 );
+    vector< double > lowLatency = timePropagates( net, input, numRuns );
+    cout << "normal:      p50 " << normal[ numRuns / 2 ] << "us p99 " << normal[ numRuns * 99 / 100 ] << "us" << endl;
+    cout << "low latency: p50 " << lowLatency[ numRuns / 2 ] << "us p99 " << lowLatency[ numRuns * 99 / 100 ] << "us" << endl;
+    delete[] input;
+    delete net;
+}
+
+}
+
@@ -0,0 +1,80 @@
+// checks MultiNet averages the results of its children, and that running the
+// children on separate threads learns the same as running each one on its own
+
+#include <iostream>
+
+#include "NeuralNet.h"
+#include "MultiNet.h"
+#include "WeightsPersister.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+
+using namespace std;
+
+namespace testMultiNet {
+
+TEST( testMultiNet, sameAsChildrenAlone ) {
+    const int batchSize = 4;
+    const int imageSize = 8;
+    const int numClasses = 3;
+    const int numChildren = 3;
+    NeuralNet *model = NeuralNet::maker()->planes(1)->imageSize(imageSize)->instance();
+    model->addLayer( ConvolutionalMaker::instance()->numFilters(4)->filterSize(3)->tanh()->biased()->padZeros() );
+    model->addLayer( FullyConnectedMaker::instance()->numPlanes(numClasses)->imageSize(1)->linear()->biased() );
+    model->addLayer( SoftMaxMaker::instance() );
+    MultiNet *multiNet = new MultiNet( numChildren, model );
+    EXPECT_EQ( numChildren, multiNet->getNumChildren() );
+    multiNet->setBatchSize( batchSize );
+
+    // a standalone copy of each child, with the same weights
+    const int numWeights = WeightsPersister::getTotalNumWeights( model );
+    float *weights = new float[ numWeights ];
+    NeuralNet *alone[numChildren];
+    for( int i = 0; i < numChildren; i++ ) {
+        alone[i] = model->clone();
+        WeightsPersister::copyNetWeightsToArray( dynamic_cast< NeuralNet * >( multiNet->getChild( i ) ), weights );
+        WeightsPersister::copyArrayToNetWeights( weights, alone[i] );
+        alone[i]->setBatchSize( batchSize );
+    }
+
+    float *images = new float[ batchSize * imageSize * imageSize ];
+    WeightRandomizer::randomize( 11, images, batchSize * imageSize * imageSize, -1.0f, 1.0f );
+    int labels[] = { 2, 0, 1, 1 };
+    for( int it = 0; it < 2; it++ ) {
+        multiNet->propagate( images );
+        for( int i = 0; i < numChildren; i++ ) {
+            alone[i]->propagate( images );
+        }
+        for( int j = 0; j < batchSize * numClasses; j++ ) {
+            float sum = 0.0f;
+            for( int i = 0; i < numChildren; i++ ) {
+                sum += alone[i]->getResults()[j];
+            }
+            EXPECT_FLOAT_NEAR( sum / numChildren, multiNet->getResults()[j] );
+        }
+        multiNet->backPropFromLabels( 0.1f, labels );
+        for( int i = 0; i < numChildren; i++ ) {
+            alone[i]->backPropFromLabels( 0.1f, labels );
+        }
+    }
+    float *aloneWeights = new float[ numWeights ];
+    for( int i = 0; i < numChildren; i++ ) {
+        WeightsPersister::copyNetWeightsToArray( dynamic_cast< NeuralNet * >( multiNet->getChild( i ) ), weights );
+        WeightsPersister::copyNetWeightsToArray( alone[i], aloneWeights );
+        for( int j = 0; j < numWeights; j++ ) {
+            EXPECT_FLOAT_NEAR( aloneWeights[j], weights[j] );
+        }
+        delete alone[i];
+    }
+
+    delete[] aloneWeights;
+    delete[] images;
+    delete[] weights;
+    delete multiNet;
+    delete model;
+}
+
+}
+
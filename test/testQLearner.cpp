@@ -0,0 +1,205 @@
+// checks QLearner's single forward pass over befores and afters together: that
+// propagating a double batch, then shrinking the batch to just the befores
+// before backprop, learns the same weights as propagating the befores alone.
+// also runs QLearner for a few hundred steps, with and without a target net,
+// and over several environments at once.
+// SLOW_testQLearner.framespersecond times stepping 1, 4 and 16 environments
+
+#include <iostream>
+#include <vector>
+
+#include "NeuralNet.h"
+#include "WeightsPersister.h"
+#include "QLearner.h"
+#include "VectorScenario.h"
+#include "Timer.h"
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "test/WeightRandomizer.h"
+#include "test/TestNet.h"
+#include "test/Corridor.h"
+
+using namespace std;
+
+namespace testQLearner {
+
+TEST( testQLearner, doublebatchsameasseparate ) {
+    const int imageSize = 6;
+    const int numActions = 3;
+    const int batchSize = 5;
+    NeuralNet *merged = TestNet::makeSquareLossNet( 1, imageSize, numActions );
+    NeuralNet *separate = TestNet::makeSquareLossNet( 1, imageSize, numActions );
+    const int numWeights = WeightsPersister::getTotalNumWeights( merged );
+    float *weights = new float[ numWeights ];
+    WeightsPersister::copyNetWeightsToArray( merged, weights );
+    WeightsPersister::copyArrayToNetWeights( weights, separate );
+
+    const int inputCubeSize = imageSize * imageSize;
+    float *states = new float[ 2 * batchSize * inputCubeSize ];
+    WeightRandomizer::randomize( 3, states, 2 * batchSize * inputCubeSize, -1.0f, 1.0f );
+    float *expected = new float[ batchSize * numActions ];
+    WeightRandomizer::randomize( 4, expected, batchSize * numActions, -1.0f, 1.0f );
+
+    merged->setBatchSize( 2 * batchSize );
+    separate->setBatchSize( batchSize );
+    for( int it = 0; it < 3; it++ ) {
+        merged->setBatchSize( 2 * batchSize );
+        merged->propagate( states );
+        separate->propagate( states + batchSize * inputCubeSize );
+        for( int i = 0; i < batchSize * numActions; i++ ) {
+            EXPECT_FLOAT_NEAR( separate->getResults()[i], merged->getResults()[batchSize * numActions + i] );
+        }
+        separate->propagate( states );
+        for( int i = 0; i < batchSize * numActions; i++ ) {
+            EXPECT_FLOAT_NEAR( separate->getResults()[i], merged->getResults()[i] );
+        }
+        merged->setBatchSize( batchSize );
+        merged->backProp( 0.1f, expected );
+        separate->backProp( 0.1f, expected );
+    }
+    float *separateWeights = new float[ numWeights ];
+    WeightsPersister::copyNetWeightsToArray( merged, weights );
+    WeightsPersister::copyNetWeightsToArray( separate, separateWeights );
+    for( int i = 0; i < numWeights; i++ ) {
+        EXPECT_NEAR( separateWeights[i], weights[i], 1e-5f );
+    }
+
+    delete[] separateWeights;
+    delete[] expected;
+    delete[] states;
+    delete[] weights;
+    delete separate;
+    delete merged;
+}
+
+void runSteps( int targetUpdateInterval ) {
+    Corridor corridor( 4 );
+    NeuralNet *net = TestNet::makeSquareLossNet( 1, 4, 2 );
+    QLearner qlearner( &corridor, net );
+    qlearner.setMaxSamples( 8 );
+    qlearner.setTargetUpdateInterval( targetUpdateInterval );
+    float perception[16];
+    float lastReward = 0;
+    bool wasReset = false;
+    for( int step = 0; step < 300; step++ ) {
+        corridor.getPerception( perception );
+        int action = qlearner.step( lastReward, wasReset, perception );
+        ASSERT_GE( action, 0 );
+        ASSERT_LT( action, 2 );
+        lastReward = corridor.act( action );
+        wasReset = corridor.hasFinished();
+        if( wasReset ) {
+            corridor.reset();
+        }
+    }
+    delete net;
+}
+
+TEST( testQLearner, steps ) {
+    runSteps( 0 );
+}
+
+TEST( testQLearner, stepswithtargetnet ) {
+    runSteps( 20 );
+}
+
+TEST( testQLearner, vectorscenario ) {
+    vector< Scenario * > scenarios;
+    for( int env = 0; env < 3; env++ ) {
+        scenarios.push_back( new Corridor( 4 ) );
+    }
+    VectorScenario environments( scenarios );
+    environments.setParallel( true );
+    // env 0 keeps going right, env 1 keeps going left, env 2 alternates
+    int actions[3];
+    float rewards[3];
+    bool finished[3];
+    float perceptions[3 * 16];
+    for( int step = 0; step < 3; step++ ) {
+        actions[0] = 1;
+        actions[1] = 0;
+        actions[2] = step % 2 == 0 ? 1 : 0;
+        environments.act( actions, rewards, finished );
+        EXPECT_EQ( step == 2, finished[0] );
+        EXPECT_FLOAT_EQ( step == 2 ? 1.0f : 0.0f, rewards[0] );
+        EXPECT_FALSE( finished[1] );
+        EXPECT_FALSE( finished[2] );
+    }
+    environments.getPerceptions( perceptions );
+    // env 0 was reset, back to the start; env 2 is one along
+    EXPECT_FLOAT_EQ( 1.0f, perceptions[0] );
+    EXPECT_FLOAT_EQ( 1.0f, perceptions[16] );
+    EXPECT_FLOAT_EQ( 1.0f, perceptions[32 + 1] );
+    EXPECT_FLOAT_EQ( 0.0f, perceptions[32] );
+    for( int env = 0; env < 3; env++ ) {
+        delete scenarios[env];
+    }
+}
+
+// returns frames per second, over all the environments
+float runVectorized( int numEnvs, int numSteps, int experiencesPerLearnStep ) {
+    vector< Scenario * > scenarios;
+    for( int env = 0; env < numEnvs; env++ ) {
+        scenarios.push_back( new Corridor( 4 ) );
+    }
+    VectorScenario environments( scenarios );
+    environments.setParallel( true );
+    NeuralNet *net = TestNet::makeSquareLossNet( 1, 4, 2 );
+    QLearner qlearner( scenarios[0], net );
+    qlearner.setMaxSamples( 8 );
+    qlearner.setExperiencesPerLearnStep( experiencesPerLearnStep );
+    float *perceptions = new float[ numEnvs * 16 ];
+    float *lastRewards = new float[ numEnvs ];
+    bool *wasResets = new bool[ numEnvs ];
+    int *actions = new int[ numEnvs ];
+    for( int env = 0; env < numEnvs; env++ ) {
+        lastRewards[env] = 0;
+        wasResets[env] = false;
+    }
+    Timer timer;
+    for( int step = 0; step < numSteps; step++ ) {
+        environments.getPerceptions( perceptions );
+        qlearner.stepBatch( numEnvs, lastRewards, wasResets, perceptions, actions );
+        for( int env = 0; env < numEnvs; env++ ) {
+            EXPECT_GE( actions[env], 0 );
+            EXPECT_LT( actions[env], 2 );
+        }
+        environments.act( actions, lastRewards, wasResets );
+    }
+    const float seconds = timer.lap() / 1000.0f;
+    // nothing to learn from on the first step
+    EXPECT_EQ( numEnvs * ( numSteps - 1 ) / experiencesPerLearnStep, qlearner.getNumLearnSteps() );
+    EXPECT_THROW( qlearner.stepBatch( numEnvs + 1, lastRewards, wasResets, perceptions, actions ), runtime_error );
+    delete[] actions;
+    delete[] wasResets;
+    delete[] lastRewards;
+    delete[] perceptions;
+    delete net;
+    for( int env = 0; env < numEnvs; env++ ) {
+        delete scenarios[env];
+    }
+    return numEnvs * numSteps / seconds;
+}
+
+TEST( testQLearner, stepsvectorized ) {
+    runVectorized( 4, 100, 1 );
+    runVectorized( 4, 100, 3 );
+}
+
+TEST( testQLearner, SLOW_framespersecond ) {
+    const int numSteps = 500;
+    const float oneEnvFps = runVectorized( 1, numSteps, 1 );
+    cout << "1 env: " << oneEnvFps << " frames per second" << endl;
+    const int numEnvsList[] = { 4, 16 };
+    for( int i = 0; i < 2; i++ ) {
+        const int numEnvs = numEnvsList[i];
+        const float fps = runVectorized( numEnvs, numSteps, 1 );
+        // learning from the past as often as one env does, per step rather than per experience
+        const float fpsSameLearnSteps = runVectorized( numEnvs, numSteps, numEnvs );
+        cout << numEnvs << " envs: " << fps << " frames per second, speedup " << ( fps / oneEnvFps ) << endl;
+        cout << numEnvs << " envs, one learn step per call: " << fpsSameLearnSteps << " frames per second, speedup " << ( fpsSameLearnSteps / oneEnvFps ) << endl;
+    }
+}
+
+}
@@ -0,0 +1,128 @@
+// checks the qlearning replay memory: overwriting the oldest experience once
+// full, gathering batches, and sampling in proportion to priority
+
+#include "ReplayMemory.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+namespace testReplayMemory {
+
+void addExperience( ReplayMemory *replay, int id ) {
+    float before[3];
+    float after[3];
+    for( int i = 0; i < 3; i++ ) {
+        before[i] = id * 10.0f + i;
+        after[i] = - id * 10.0f - i;
+    }
+    replay->add( before, id, id * 0.5f, id % 2 == 1, after );
+}
+
+TEST( testReplayMemory, wrapsaround ) {
+    ReplayMemory replay( 4, 3, false );
+    for( int id = 0; id < 3; id++ ) {
+        addExperience( &replay, id );
+    }
+    EXPECT_EQ( 3, replay.getCount() );
+    for( int id = 3; id < 10; id++ ) {
+        addExperience( &replay, id );
+    }
+    EXPECT_EQ( 4, replay.getCount() );
+    // ids 6 to 9 remain, in slots 2, 3, 0, 1
+    for( int id = 6; id < 10; id++ ) {
+        const int slot = id % 4;
+        EXPECT_EQ( id, replay.getAction( slot ) );
+        EXPECT_FLOAT_EQ( id * 0.5f, replay.getReward( slot ) );
+        EXPECT_EQ( id % 2 == 1, replay.getIsEndState( slot ) );
+        EXPECT_FLOAT_EQ( id * 10.0f + 2, replay.getBefore( slot )[2] );
+        EXPECT_FLOAT_EQ( - id * 10.0f - 1, replay.getAfter( slot )[1] );
+    }
+}
+
+TEST( testReplayMemory, gather ) {
+    ReplayMemory replay( 8, 3, false );
+    for( int id = 0; id < 5; id++ ) {
+        addExperience( &replay, id );
+    }
+    int indices[] = { 4, 0, 2, 2 };
+    float befores[4 * 3];
+    float afters[4 * 3];
+    replay.gather( 4, indices, befores, afters );
+    for( int n = 0; n < 4; n++ ) {
+        for( int i = 0; i < 3; i++ ) {
+            EXPECT_FLOAT_EQ( indices[n] * 10.0f + i, befores[n * 3 + i] );
+            EXPECT_FLOAT_EQ( - indices[n] * 10.0f - i, afters[n * 3 + i] );
+        }
+    }
+}
+
+TEST( testReplayMemory, uniformsampleonlyfilled ) {
+    ReplayMemory replay( 100, 3, false );
+    for( int id = 0; id < 5; id++ ) {
+        addExperience( &replay, id );
+    }
+    MT19937 random;
+    random.seed( 0 );
+    int indices[64];
+    replay.sample( 64, random, indices );
+    for( int n = 0; n < 64; n++ ) {
+        EXPECT_GE( indices[n], 0 );
+        EXPECT_LT( indices[n], 5 );
+    }
+}
+
+TEST( testReplayMemory, prioritizedsample ) {
+    // capacity not a power of two, so some tree leaves are never used
+    ReplayMemory replay( 5, 3, true );
+    replay.setAlpha( 1.0f );
+    replay.setMinPriority( 0.0f );
+    for( int id = 0; id < 5; id++ ) {
+        addExperience( &replay, id );
+    }
+    // priorities 1, 2, 3, 4, 0 (slot 4 is never picked)
+    for( int slot = 0; slot < 5; slot++ ) {
+        replay.updatePriority( slot, slot == 4 ? 0.0f : slot + 1.0f );
+    }
+    EXPECT_FLOAT_EQ( 10.0f, replay.getTotalPriority() );
+
+    MT19937 random;
+    random.seed( 0 );
+    const int batchSize = 3;
+    const int numBatches = 10000;
+    int counts[5] = { 0, 0, 0, 0, 0 };
+    int indices[batchSize];
+    for( int batch = 0; batch < numBatches; batch++ ) {
+        replay.sample( batchSize, random, indices );
+        for( int n = 0; n < batchSize; n++ ) {
+            ASSERT_GE( indices[n], 0 );
+            ASSERT_LT( indices[n], 5 );
+            counts[indices[n]]++;
+        }
+    }
+    for( int slot = 0; slot < 4; slot++ ) {
+        const float fraction = counts[slot] / (float)( batchSize * numBatches );
+        EXPECT_NEAR( ( slot + 1 ) / 10.0f, fraction, 0.01f );
+    }
+    for( int slot = 1; slot < 4; slot++ ) {
+        EXPECT_GT( counts[slot], counts[slot - 1] );
+    }
+    EXPECT_EQ( 0, counts[4] );
+
+    // lower priority means sampled less often, so weighted more
+    EXPECT_GT( replay.getSampleWeight( 0 ), replay.getSampleWeight( 3 ) );
+}
+
+TEST( testReplayMemory, newexperiencegetsmaxpriority ) {
+    ReplayMemory replay( 4, 3, true );
+    replay.setAlpha( 1.0f );
+    replay.setMinPriority( 0.0f );
+    addExperience( &replay, 0 );
+    replay.updatePriority( 0, 7.0f );
+    addExperience( &replay, 1 );
+    EXPECT_FLOAT_EQ( 7.0f, replay.getPriority( 1 ) );
+    EXPECT_FLOAT_EQ( 14.0f, replay.getTotalPriority() );
+}
+
+}
+
@@ -0,0 +1,200 @@
+// checks that training resumed from a checkpoint taken part way through an
+// epoch ends up with the same weights as training that was never interrupted
+
+#include <iostream>
+#include <cstdio>
+
+#include "NeuralNet.h"
+#include "NetLearner.h"
+#include "NetLearnerOnDevice.h"
+#include "DeviceDataset.h"
+#include "ResumeState.h"
+#include "WeightsPersister.h"
+#include "WeightsCheckpointer.h"
+#include "FileHelper.h"
+#include "MyRandom.h"
+
+#include "gtest/gtest.h"
+#include "test/WeightRandomizer.h"
+#include "test/TestNet.h"
+
+using namespace std;
+
+namespace testResumeState {
+
+// the translations draw on MyRandom too, so resuming has to restore it for
+// them as well as for the shuffle
+NeuralNet *makeTranslatingNet() {
+    NeuralNet *net = NeuralNet::maker()->planes(1)->imageSize(6)->instance();
+    net->addLayer( RandomTranslationsMaker::instance()->translateSize(2) );
+    TestNet::addLayers( net, 4 );
+    net->addLayer( SoftMaxMaker::instance() );
+    return net;
+}
+
+class CheckpointAtBatch : public PostBatchAction {
+public:
+    WeightsCheckpointer *checkpointer;
+    int batch;
+    CheckpointAtBatch( WeightsCheckpointer *checkpointer, int batch ) :
+        checkpointer( checkpointer ),
+        batch( batch ) {
+    }
+    virtual void run( ResumeState const &progress ) {
+        if( progress.batch == batch ) {
+            checkpointer->checkpoint( progress );
+        }
+    }
+};
+
+TEST( testResumeState, sameAsUninterrupted ) {
+    const string filepath = "testResumeState.dat";
+    const int N = 37;
+    const int batchSize = 8;
+    const int inputCubeSize = 6 * 6;
+    float *data = new float[N * inputCubeSize];
+    int *labels = new int[N];
+    WeightRandomizer::randomize( 9, data, N * inputCubeSize, -1.0f, 1.0f );
+    for( int n = 0; n < N; n++ ) {
+        labels[n] = ( n * 3 ) % 4;
+    }
+
+    NeuralNet *net = TestNet::makeNet( 1, 6, 4 );
+    const int numWeights = WeightsPersister::getTotalNumWeights( net );
+    WeightsCheckpointer *checkpointer = new WeightsCheckpointer( filepath, "some config", net );
+    CheckpointAtBatch checkpointAtBatch( checkpointer, 2 );
+    NetLearner<float> learner( net );
+    learner.setTrainingData( N, data, labels );
+    learner.setTestingData( N, data, labels );
+    learner.setBatchSize( batchSize );
+    learner.setSchedule( 2 );
+    learner.addPostBatchAction( &checkpointAtBatch );
+    learner.learn( 0.01f );
+    checkpointer->flush();
+    float *uninterruptedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray( net, uninterruptedWeights );
+
+    // the checkpoint is the last one taken: after batch 2 of epoch 2
+    NeuralNet *resumed = TestNet::makeNet( 1, 6, 4 );
+    ResumeState resumeState;
+    EXPECT_TRUE( WeightsPersister::loadWeights( filepath, "some config", resumed, &resumeState ) );
+    EXPECT_EQ( 2, resumeState.epoch );
+    EXPECT_EQ( 2, resumeState.batch );
+    EXPECT_NE( "", resumeState.randomState );
+    NetLearner<float> resumedLearner( resumed );
+    resumedLearner.setTrainingData( N, data, labels );
+    resumedLearner.setTestingData( N, data, labels );
+    resumedLearner.setBatchSize( batchSize );
+    resumedLearner.setSchedule( 2 );
+    resumedLearner.setResumeState( resumeState );
+    resumedLearner.learn( 0.01f );
+    float *resumedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray( resumed, resumedWeights );
+    for( int i = 0; i < numWeights; i++ ) {
+        EXPECT_NEAR( uninterruptedWeights[i], resumedWeights[i], 1e-5f );
+    }
+
+    delete checkpointer;
+    FileHelper::remove( filepath );
+    delete[] resumedWeights;
+    delete[] uninterruptedWeights;
+    delete[] labels;
+    delete[] data;
+    delete resumed;
+    delete net;
+}
+
+TEST( testResumeState, shuffledWithTranslationsSameAsUninterrupted ) {
+    const string filepath = "testResumeStateShuffled.dat";
+    const int N = 37;
+    const int batchSize = 8;
+    const int inputCubeSize = 6 * 6;
+    const float translate = -128.0f;
+    const float scale = 1.0f / 128.0f;
+    unsigned char *data = new unsigned char[N * inputCubeSize];
+    int *labels = new int[N];
+    for( int i = 0; i < N * inputCubeSize; i++ ) {
+        data[i] = (unsigned char)( ( i * 53 ) % 256 );
+    }
+    for( int n = 0; n < N; n++ ) {
+        labels[n] = ( n * 3 ) % 4;
+    }
+
+    NeuralNet *net = makeTranslatingNet();
+    const int numWeights = WeightsPersister::getTotalNumWeights( net );
+    DeviceDataset *dataset = new DeviceDataset( net->getCl(), N, inputCubeSize, data, translate, scale );
+    WeightsCheckpointer *checkpointer = new WeightsCheckpointer( filepath, "some config", net );
+    CheckpointAtBatch checkpointAtBatch( checkpointer, 2 );
+    NetLearnerOnDevice learner( net );
+    learner.setTrainingData( dataset, labels );
+    learner.setTestingData( dataset, labels );
+    learner.setBatchSize( batchSize );
+    learner.setShuffle( true );
+    learner.setSchedule( 2 );
+    learner.addPostBatchAction( &checkpointAtBatch );
+    learner.learn( 0.01f );
+    checkpointer->flush();
+    float *uninterruptedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray( net, uninterruptedWeights );
+
+    // whatever MyRandom did since, the resumed run takes its state from the file
+    MyRandom::uniformInt( 0, 1000 );
+    NeuralNet *resumed = makeTranslatingNet();
+    ResumeState resumeState;
+    EXPECT_TRUE( WeightsPersister::loadWeights( filepath, "some config", resumed, &resumeState ) );
+    EXPECT_EQ( 2, resumeState.epoch );
+    EXPECT_EQ( 2, resumeState.batch );
+    EXPECT_EQ( N, (int)resumeState.permutation.size() );
+    DeviceDataset *resumedDataset = new DeviceDataset( resumed->getCl(), N, inputCubeSize, data, translate, scale );
+    NetLearnerOnDevice resumedLearner( resumed );
+    resumedLearner.setTrainingData( resumedDataset, labels );
+    resumedLearner.setTestingData( resumedDataset, labels );
+    resumedLearner.setBatchSize( batchSize );
+    resumedLearner.setShuffle( true );
+    resumedLearner.setSchedule( 2 );
+    resumedLearner.setResumeState( resumeState );
+    resumedLearner.learn( 0.01f );
+    float *resumedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray( resumed, resumedWeights );
+    for( int i = 0; i < numWeights; i++ ) {
+        EXPECT_NEAR( uninterruptedWeights[i], resumedWeights[i], 1e-5f );
+    }
+
+    delete checkpointer;
+    FileHelper::remove( filepath );
+    delete[] resumedWeights;
+    delete[] uninterruptedWeights;
+    delete[] labels;
+    delete[] data;
+    delete resumedDataset;
+    delete dataset;
+    delete resumed;
+    delete net;
+}
+
+TEST( testResumeState, randomStateRoundTrip ) {
+    ResumeState state( 3 );
+    state.permutation.push_back( 2 );
+    state.permutation.push_back( 0 );
+    state.permutation.push_back( 1 );
+    char *section = new char[ state.getSectionSize() ];
+    state.writeSection( section );
+    int expected[5];
+    for( int i = 0; i < 5; i++ ) {
+        expected[i] = MyRandom::uniformInt( 0, 1000000 );
+    }
+    ResumeState readBack;
+    readBack.readSection( section, state.getSectionSize() );
+    readBack.restoreRandom();
+    for( int i = 0; i < 5; i++ ) {
+        EXPECT_EQ( expected[i], MyRandom::uniformInt( 0, 1000000 ) );
+    }
+    EXPECT_EQ( 3, (int)readBack.permutation.size() );
+    EXPECT_EQ( 2, readBack.permutation[0] );
+    EXPECT_EQ( 0, readBack.permutation[1] );
+    EXPECT_EQ( 1, readBack.permutation[2] );
+    delete[] section;
+}
+
+}
+
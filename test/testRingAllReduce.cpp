@@ -0,0 +1,106 @@
+// checks RingAllReduce sums across ranks, over loopback tcp, with one thread
+// standing in for each process
+
+#include <iostream>
+#include <vector>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
+
+#include "RingAllReduce.h"
+
+#include "gtest/gtest.h"
+#include "test/TestPorts.h"
+
+using namespace std;
+
+namespace testRingAllReduce {
+
+const int basePort = TestPorts::basePort( 0 );
+
+// rank r contributes r * 1000 + i at position i
+void checkAllReduce( int worldSize, int N ) {
+    vector< vector< float > > results( worldSize );
+    vector< thread > ranks;
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        ranks.push_back( thread( [rank, worldSize, N, &results]() {
+            RingAllReduce ring( rank, worldSize, RingAllReduce::localHosts( worldSize ), basePort );
+            vector< float > data( N );
+            for( int it = 0; it < 2; it++ ) {
+                for( int i = 0; i < N; i++ ) {
+                    data[i] = rank * 1000.0f + i;
+                }
+                ring.allReduce( N == 0 ? 0 : &data[0], N );
+            }
+            results[rank] = data;
+        } ) );
+    }
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        ranks[rank].join();
+    }
+    const float rankSum = 1000.0f * worldSize * ( worldSize - 1 ) / 2;
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        EXPECT_EQ( N, (int)results[rank].size() );
+        for( int i = 0; i < N; i++ ) {
+            EXPECT_EQ( rankSum + worldSize * i, results[rank][i] );
+        }
+    }
+}
+
+TEST( testRingAllReduce, sums ) {
+    checkAllReduce( 1, 10 );
+    checkAllReduce( 2, 10 );
+    checkAllReduce( 3, 1001 );
+    // fewer values than ranks: some chunks are empty
+    checkAllReduce( 4, 3 );
+    // bigger than the socket buffers
+    checkAllReduce( 3, 2000000 );
+}
+
+TEST( testRingAllReduce, broadcast ) {
+    const int worldSize = 3;
+    const int N = 100;
+    vector< vector< float > > results( worldSize );
+    vector< thread > ranks;
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        ranks.push_back( thread( [rank, &results]() {
+            RingAllReduce ring( rank, worldSize, RingAllReduce::localHosts( worldSize ), basePort );
+            vector< float > data( N, (float)rank );
+            if( rank == 0 ) {
+                for( int i = 0; i < N; i++ ) {
+                    data[i] = i * 0.5f;
+                }
+            }
+            ring.broadcastFromRank0( &data[0], N );
+            results[rank] = data;
+        } ) );
+    }
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        ranks[rank].join();
+    }
+    for( int rank = 0; rank < worldSize; rank++ ) {
+        for( int i = 0; i < N; i++ ) {
+            EXPECT_EQ( i * 0.5f, results[rank][i] );
+        }
+    }
+}
+
+#ifndef _WIN32
+// a peer going away is an error, not SIGPIPE, which would end the test run
+TEST( testRingAllReduce, sendToClosedPeer ) {
+    int sockets[2];
+    ASSERT_EQ( 0, socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ) );
+    RingAllReduce::setNoSigPipe( sockets[0] );
+    RingAllReduce::closeSocket( sockets[1] );
+    vector< char > data( 1 << 20 );
+    EXPECT_FALSE( RingAllReduce::sendAllTo( sockets[0], &data[0], (int)data.size() ) );
+    EXPECT_FALSE( RingAllReduce::receiveAllFrom( sockets[0], &data[0], 1 ) );
+    RingAllReduce::closeSocket( sockets[0] );
+}
+#endif
+
+}
+
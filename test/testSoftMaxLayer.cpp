@@ -0,0 +1,120 @@
+// tests the fused softmax loss / errors / numright pass, on host and on gpu,
+// against the same values calculated here directly from the logits
+
+#include <iostream>
+#include <cmath>
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "NeuralNet.h"
+#include "SoftMaxLayer.h"
+
+using namespace std;
+
+namespace testSoftMaxLayer {
+
+void checkAgainstLogits( NeuralNet *net, int numGroups, int groupSize, int const *labels ) {
+    const int numLayers = net->getNumLayers();
+    float const *logits = net->getLayer( numLayers - 2 )->getResults();
+    SoftMaxLayer *softMax = dynamic_cast< SoftMaxLayer * >( net->getLayer( numLayers - 1 ) );
+
+    // calls in a different order from backPropFromLabels, to check the caching
+    const int numRight = softMax->calcNumRight( labels );
+    const float loss = softMax->calcLossFromLabels( labels );
+    softMax->calcErrorsFromLabels( labels );
+    float const *results = softMax->getResults();
+    float const *errors = softMax->getErrorsForUpstream();
+
+    double expectedLoss = 0;
+    int expectedNumRight = 0;
+    for( int group = 0; group < numGroups; group++ ) {
+        float const *groupLogits = logits + group * groupSize;
+        double maxValue = groupLogits[0];
+        int argMax = 0;
+        for( int i = 1; i < groupSize; i++ ) {
+            if( groupLogits[i] > maxValue ) {
+                maxValue = groupLogits[i];
+                argMax = i;
+            }
+        }
+        double sum = 0;
+        for( int i = 0; i < groupSize; i++ ) {
+            sum += exp( groupLogits[i] - maxValue );
+        }
+        const double logSumExp = maxValue + log( sum );
+        const int label = labels[group];
+        expectedLoss += logSumExp - groupLogits[label];
+        if( argMax == label ) {
+            expectedNumRight++;
+        }
+        for( int i = 0; i < groupSize; i++ ) {
+            const float expectedResult = (float)exp( groupLogits[i] - logSumExp );
+            EXPECT_FLOAT_NEAR( expectedResult, results[group * groupSize + i] );
+            EXPECT_FLOAT_NEAR( i == label ? expectedResult - 1.0f : expectedResult, errors[group * groupSize + i] );
+        }
+    }
+    EXPECT_EQ( expectedNumRight, numRight );
+    EXPECT_NEAR( expectedLoss, loss, 0.0001f * expectedLoss );
+}
+
+TEST( testSoftMaxLayer, perColumnHost ) {
+    const int batchSize = 4;
+    const int numPlanes = 5;
+    // large logits, so the softmax for the label underflows for the second example
+    float logits[] = { 0.1f, 0.5f, -0.2f, 0.3f, 0.0f,
+                       100.0f, -100.0f, 80.0f, 70.0f, 60.0f,
+                       -1.0f, 2.0f, 2.0f, 0.0f, 1.5f,
+                       7.0f, 7.5f, 6.0f, -2.0f, 7.2f };
+    int labels[] = { 1, 1, 2, 4 };
+
+    NeuralNet *net = new NeuralNet();
+    net->addLayer( InputLayerMaker<float>::instance()->numPlanes(numPlanes)->imageSize(1) );
+    net->addLayer( SoftMaxMaker::instance() );
+    net->setBatchSize( batchSize );
+    net->propagate( logits );
+
+    checkAgainstLogits( net, batchSize, numPlanes, labels );
+    // 200 or so, rather than infinity
+    float loss = net->calcLossFromLabels( labels );
+    EXPECT_GT( 1000.0f, loss );
+    EXPECT_LT( 200.0f, loss );
+
+    delete net;
+}
+
+TEST( testSoftMaxLayer, perPlaneFromGpu ) {
+    const int batchSize = 3;
+    const int numPlanes = 2;
+    const int imageSize = 7;
+    const int numFilters = 3;
+
+    NeuralNet *net = new NeuralNet();
+    net->addLayer( InputLayerMaker<float>::instance()->numPlanes(numPlanes)->imageSize(imageSize) );
+    net->addLayer( ConvolutionalMaker::instance()->numFilters(numFilters)->filterSize(3)->linear()->biased()->padZeros() );
+    net->addLayer( SoftMaxMaker::instance()->perPlane() );
+    net->setBatchSize( batchSize );
+
+    float *images = new float[ batchSize * numPlanes * imageSize * imageSize ];
+    for( int i = 0; i < batchSize * numPlanes * imageSize * imageSize; i++ ) {
+        images[i] = ( ( i * 37 ) % 101 ) / 10.0f - 5.0f;
+    }
+    int labels[ batchSize * numFilters ];
+    for( int i = 0; i < batchSize * numFilters; i++ ) {
+        labels[i] = ( i * 11 ) % ( imageSize * imageSize );
+    }
+    net->propagate( images );
+    checkAgainstLogits( net, batchSize * numFilters, imageSize * imageSize, labels );
+
+    // different labels, same results
+    labels[0] = ( labels[0] + 1 ) % ( imageSize * imageSize );
+    checkAgainstLogits( net, batchSize * numFilters, imageSize * imageSize, labels );
+
+    labels[1] = imageSize * imageSize;
+    EXPECT_THROW( net->calcLossFromLabels( labels ), runtime_error );
+
+    delete[] images;
+    delete net;
+}
+
+}
+
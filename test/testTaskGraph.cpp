@@ -0,0 +1,218 @@
+// checks TaskGraph runs tasks after their dependencies, overlaps host tasks with
+// device ones, and passes on exceptions; and that a net's scheduled backward
+// pass gives the same weights as running each layer's backProp in turn
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+
+#include "OpenCLHelper.h"
+#include "ThreadPool.h"
+#include "TaskGraph.h"
+#include "NeuralNet.h"
+#include "ConvolutionalLayer.h"
+#include "BackpropWeights2Cpu.h"
+#include "ZeroCopy.h"
+#include "SoftMaxLayer.h"
+
+#include "gtest/gtest.h"
+#include "test/WeightRandomizer.h"
+#include "test/TestNet.h"
+
+using namespace std;
+
+namespace testTaskGraph {
+
+int indexOf( vector< string > const &names, string name ) {
+    for( int i = 0; i < (int)names.size(); i++ ) {
+        if( names[i] == name ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// a diamond, plus a tail, half of it on the host
+void checkDependencies( ThreadPool *pool ) {
+    TaskGraph graph;
+    vector< atomic< int > > finished( 5 );
+    for( int i = 0; i < 5; i++ ) {
+        finished[i] = 0;
+    }
+    const int a = graph.addTask( "a", false, [&]() { finished[0] = 1; } );
+    const int b = graph.addTask( "b", true, [&]() { EXPECT_EQ( 1, finished[0] ); finished[1] = 1; } );
+    const int c = graph.addTask( "c", false, [&]() { EXPECT_EQ( 1, finished[0] ); finished[2] = 1; } );
+    const int d = graph.addTask( "d", true, [&]() { EXPECT_EQ( 1, finished[1] ); EXPECT_EQ( 1, finished[2] ); finished[3] = 1; } );
+    const int e = graph.addTask( "e", false, [&]() { EXPECT_EQ( 1, finished[3] ); finished[4] = 1; } );
+    graph.addDependency( a, b );
+    graph.addDependency( a, c );
+    graph.addDependency( b, d );
+    graph.addDependency( c, d );
+    graph.addDependency( d, e );
+    for( int it = 0; it < 3; it++ ) {
+        for( int i = 0; i < 5; i++ ) {
+            finished[i] = 0;
+        }
+        graph.run( pool );
+        for( int i = 0; i < 5; i++ ) {
+            EXPECT_EQ( 1, finished[i] );
+        }
+        EXPECT_EQ( 5, (int)graph.runOrder.size() );
+        EXPECT_EQ( 0, indexOf( graph.runOrder, "a" ) );
+        EXPECT_EQ( 4, indexOf( graph.runOrder, "e" ) );
+    }
+}
+
+TEST( testTaskGraph, dependencies ) {
+    ThreadPool pool( 2 );
+    checkDependencies( &pool );
+    // no workers: the caller runs the host tasks too
+    ThreadPool callerOnly( 0 );
+    checkDependencies( &callerOnly );
+}
+
+TEST( testTaskGraph, hostOverlapsDevice ) {
+    ThreadPool pool( 1 );
+    TaskGraph graph;
+    atomic< bool > hostRunning( false );
+    atomic< bool > deviceDone( false );
+    bool sawHostRunning = false;
+    graph.addTask( "host", true, [&]() {
+        hostRunning = true;
+        for( int i = 0; i < 10000 && !deviceDone; i++ ) {
+            this_thread::sleep_for( chrono::milliseconds( 1 ) );
+        }
+    } );
+    graph.addTask( "device", false, [&]() {
+        for( int i = 0; i < 10000 && !hostRunning; i++ ) {
+            this_thread::sleep_for( chrono::milliseconds( 1 ) );
+        }
+        sawHostRunning = hostRunning;
+        deviceDone = true;
+    } );
+    graph.run( &pool );
+    EXPECT_TRUE( sawHostRunning );
+}
+
+TEST( testTaskGraph, rethrows ) {
+    ThreadPool pool( 2 );
+    for( int onHost = 0; onHost <= 1; onHost++ ) {
+        TaskGraph graph;
+        bool ranDependent = false;
+        const int failing = graph.addTask( "failing", onHost == 1, []() {
+            throw runtime_error("failing task");
+        } );
+        const int dependent = graph.addTask( "dependent", false, [&]() { ranDependent = true; } );
+        graph.addDependency( failing, dependent );
+        EXPECT_THROW( graph.run( &pool ), runtime_error );
+        EXPECT_FALSE( ranDependent );
+    }
+}
+
+// weight updates on the cpu go on the host side of the graph, so they overlap
+// the errors of the layers below, which run on the device
+void checkSameAsLayerByLayer( bool cpuWeights ) {
+    const int batchSize = 4;
+    const int imageSize = 12;
+    const int numClasses = 3;
+    NeuralNet *nets[2];
+    for( int i = 0; i < 2; i++ ) {
+        nets[i] = TestNet::makeNet( 2, imageSize, numClasses );
+        nets[i]->setBatchSize( batchSize );
+        if( cpuWeights ) {
+            for( int layer = 1; layer <= 3; layer += 2 ) {
+                ConvolutionalLayer *conv = dynamic_cast< ConvolutionalLayer * >( nets[i]->getLayer( layer ) );
+                delete conv->backpropWeightsImpl;
+                conv->backpropWeightsImpl = new BackpropWeights2Cpu( conv->cl, conv->dim );
+                EXPECT_TRUE( conv->backPropWeightsOnHost() );
+            }
+        }
+    }
+    for( int layer = 1; layer < nets[0]->getNumLayers(); layer++ ) {
+        const int persistSize = nets[0]->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *persisted = new float[ persistSize ];
+        nets[0]->getLayer(layer)->persistToArray( persisted );
+        nets[1]->getLayer(layer)->unpersistFromArray( persisted );
+        delete[] persisted;
+    }
+
+    float *images = new float[ batchSize * 2 * imageSize * imageSize ];
+    WeightRandomizer::randomize( 5, images, batchSize * 2 * imageSize * imageSize, -1.0f, 1.0f );
+    int labels[] = { 1, 0, 2, 2 };
+    for( int it = 0; it < 3; it++ ) {
+        nets[0]->propagate( images );
+        nets[0]->backPropFromLabels( 0.05f, labels );
+
+        nets[1]->propagate( images );
+        dynamic_cast< SoftMaxLayer * >( nets[1]->getLastLayer() )->calcErrorsFromLabels( labels );
+        for( int layer = nets[1]->getNumLayers() - 2; layer >= 1; layer-- ) {
+            if( nets[1]->getLayer( layer )->needsBackProp() ) {
+                nets[1]->getLayer( layer )->backProp( 0.05f );
+            }
+        }
+    }
+    for( int layer = 1; layer < nets[0]->getNumLayers(); layer++ ) {
+        const int persistSize = nets[0]->getLayer(layer)->getPersistSize();
+        if( persistSize == 0 ) {
+            continue;
+        }
+        float *persisted[2];
+        for( int i = 0; i < 2; i++ ) {
+            persisted[i] = new float[ persistSize ];
+            nets[i]->getLayer(layer)->persistToArray( persisted[i] );
+        }
+        for( int j = 0; j < persistSize; j++ ) {
+            EXPECT_EQ( persisted[0][j], persisted[1][j] );
+        }
+        delete[] persisted[1];
+        delete[] persisted[0];
+    }
+
+    delete[] images;
+    delete nets[1];
+    delete nets[0];
+}
+
+TEST( testTaskGraph, netSameAsLayerByLayer ) {
+    checkSameAsLayerByLayer( false );
+}
+
+TEST( testTaskGraph, netCpuWeightsSameAsLayerByLayer ) {
+    checkSameAsLayerByLayer( true );
+}
+
+// the host only gets the weight updates of tiny layers, only on gpus, and only
+// when asked to: instance() never picks the cpu
+TEST( testTaskGraph, tinyLayersUpdateWeightsOnHost ) {
+    OpenCLHelper *cl = OpenCLHelper::createForFirstGpuOtherwiseCpu();
+    LayerDimensions tiny( 8, 4, 10, 4, false, true );
+    EXPECT_EQ( !ZeroCopy::isHostUnifiedMemory( cl ), BackpropWeights2::suitsHost( cl, tiny ) );
+    BackpropWeights2 *impl = BackpropWeights2::instance( cl, tiny );
+    EXPECT_TRUE( dynamic_cast< BackpropWeights2Cpu * >( impl ) == 0 );
+    delete impl;
+    LayerDimensions big( 16, 28, 32, 5, true, true );
+    EXPECT_FALSE( BackpropWeights2::suitsHost( cl, big ) );
+    delete cl;
+
+    NeuralNet *net = TestNet::makeNet( 2, 12, 3 );
+    net->setBatchSize( 4 );
+    Layer *fullyConnected = net->getLayer( 4 );
+    EXPECT_FALSE( fullyConnected->backPropWeightsOnHost() );
+    net->setTinyLayerWeightsOnHost( true );
+    EXPECT_EQ( !ZeroCopy::isHostUnifiedMemory( net->getCl() ), fullyConnected->backPropWeightsOnHost() );
+    // the first convolution is too big
+    EXPECT_FALSE( net->getLayer( 1 )->backPropWeightsOnHost() );
+    net->setTinyLayerWeightsOnHost( false );
+    EXPECT_FALSE( fullyConnected->backPropWeightsOnHost() );
+    delete net;
+}
+
+}
+
@@ -0,0 +1,58 @@
+// checks ThreadPool::parallelFor covers its range exactly once, including when
+// called from inside one of its own tasks
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+
+#include "gtest/gtest.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+namespace testThreadPool {
+
+void checkCoversOnce( ThreadPool *pool, int N, int minChunkSize ) {
+    vector< atomic< int > > counts( N );
+    for( int i = 0; i < N; i++ ) {
+        counts[i] = 0;
+    }
+    pool->parallelFor( N, minChunkSize, [&]( int begin, int end ) {
+        EXPECT_TRUE( end - begin >= minChunkSize || ( begin == 0 && end == N ) );
+        for( int i = begin; i < end; i++ ) {
+            counts[i]++;
+        }
+    } );
+    for( int i = 0; i < N; i++ ) {
+        EXPECT_EQ( 1, counts[i] );
+    }
+}
+
+TEST( testThreadPool, coversRangeOnce ) {
+    ThreadPool pool( 3 );
+    EXPECT_EQ( 4, pool.getNumThreads() );
+    for( int N = 0; N < 50; N++ ) {
+        checkCoversOnce( &pool, N, 1 );
+        checkCoversOnce( &pool, N, 7 );
+    }
+    checkCoversOnce( &pool, 100000, 1 );
+    // no extra threads: everything on the caller
+    ThreadPool callerOnly( 0 );
+    checkCoversOnce( &callerOnly, 1000, 1 );
+}
+
+TEST( testThreadPool, nested ) {
+    ThreadPool pool( 2 );
+    atomic< int > total( 0 );
+    pool.parallelFor( 6, [&]( int begin, int end ) {
+        for( int i = begin; i < end; i++ ) {
+            pool.parallelFor( 100, [&]( int innerBegin, int innerEnd ) {
+                total += innerEnd - innerBegin;
+            } );
+        }
+    } );
+    EXPECT_EQ( 600, total );
+}
+
+}
+
@@ -0,0 +1,86 @@
+// checks WeightsCheckpointer writes files that WeightsPersister::loadWeights
+// reads back, with the weights as they were when checkpoint was called, even
+// if the net changes whilst the file is being written
+
+#include <iostream>
+
+#include "NeuralNet.h"
+#include "WeightsPersister.h"
+#include "WeightsCheckpointer.h"
+#include "FileHelper.h"
+
+#include "gtest/gtest.h"
+#include "test/WeightRandomizer.h"
+#include "test/TestNet.h"
+
+using namespace std;
+
+namespace testWeightsCheckpointer {
+
+TEST( testWeightsCheckpointer, roundTrip ) {
+    const string filepath = "testWeightsCheckpointer.dat";
+    NeuralNet *net = TestNet::makeNet( 2, 8, 3 );
+    const int numWeights = WeightsPersister::getTotalNumWeights( net );
+    float *snapshotWeights = new float[numWeights];
+    float *otherWeights = new float[numWeights];
+    WeightRandomizer::randomize( 3, snapshotWeights, numWeights, -1.0f, 1.0f );
+    WeightRandomizer::randomize( 4, otherWeights, numWeights, -1.0f, 1.0f );
+
+    WeightsCheckpointer *checkpointer = new WeightsCheckpointer( filepath, "some config", net );
+    WeightsPersister::copyArrayToNetWeights( snapshotWeights, net );
+    checkpointer->checkpoint( 3, 17, 0.5f, 42, 1.5f );
+    // the snapshot was taken above; this mustnt reach the file
+    WeightsPersister::copyArrayToNetWeights( otherWeights, net );
+    checkpointer->flush();
+    EXPECT_EQ( 1, checkpointer->getNumWritten() );
+    EXPECT_EQ( 0, checkpointer->getNumDropped() );
+
+    NeuralNet *loaded = TestNet::makeNet( 2, 8, 3 );
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    EXPECT_TRUE( WeightsPersister::loadWeights( filepath, "some config", loaded, &epoch, &batch, &annealedLearningRate, &numRight, &loss ) );
+    EXPECT_EQ( 3, epoch );
+    EXPECT_EQ( 17, batch );
+    EXPECT_EQ( 42, numRight );
+    EXPECT_EQ( 0.5f, annealedLearningRate );
+    EXPECT_EQ( 1.5f, loss );
+    float *loadedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray( loaded, loadedWeights );
+    for( int i = 0; i < numWeights; i++ ) {
+        EXPECT_EQ( snapshotWeights[i], loadedWeights[i] );
+    }
+
+    delete checkpointer;
+    FileHelper::remove( filepath );
+    delete[] loadedWeights;
+    delete[] otherWeights;
+    delete[] snapshotWeights;
+    delete loaded;
+    delete net;
+}
+
+// snapshots taken faster than they can be written are dropped, but the last
+// one always reaches the file
+TEST( testWeightsCheckpointer, lastSnapshotWins ) {
+    const string filepath = "testWeightsCheckpointer2.dat";
+    NeuralNet *net = TestNet::makeNet( 2, 8, 3 );
+    WeightsCheckpointer *checkpointer = new WeightsCheckpointer( filepath, "some config", net );
+    const int numCheckpoints = 50;
+    for( int i = 1; i <= numCheckpoints; i++ ) {
+        checkpointer->checkpoint( 1, i, 0, 0, 0 );
+    }
+    checkpointer->flush();
+    EXPECT_EQ( numCheckpoints, checkpointer->getNumWritten() + checkpointer->getNumDropped() );
+
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    EXPECT_TRUE( WeightsPersister::loadWeights( filepath, "some config", net, &epoch, &batch, &annealedLearningRate, &numRight, &loss ) );
+    EXPECT_EQ( numCheckpoints, batch );
+
+    delete checkpointer;
+    FileHelper::remove( filepath );
+    delete net;
+}
+
+}
+
@@ -0,0 +1,176 @@
+// checks version 2 weights files round trip, are aligned, and that corrupt
+// ones are refused without touching the net; and that version 1 files still load
+
+#include <iostream>
+#include <cstring>
+
+#include "NeuralNet.h"
+#include "WeightsPersister.h"
+#include "FileHelper.h"
+#include "stringhelper.h"
+
+#include "gtest/gtest.h"
+#include "test/WeightRandomizer.h"
+#include "test/TestNet.h"
+
+using namespace std;
+
+namespace testWeightsPersister {
+
+void expectNetWeights( float const *expected, NeuralNet *net ) {
+    const int numWeights = WeightsPersister::getTotalNumWeights( net );
+    float *weights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray( net, weights );
+    for( int i = 0; i < numWeights; i++ ) {
+        EXPECT_EQ( expected[i], weights[i] );
+    }
+    delete[] weights;
+}
+
+TEST( testWeightsPersister, version3 ) {
+    const string filepath = "testWeightsPersister.dat";
+    NeuralNet *net = TestNet::makeNet( 2, 8, 5 );
+    const int numWeights = WeightsPersister::getTotalNumWeights( net );
+    float *weights = new float[numWeights];
+    WeightRandomizer::randomize( 5, weights, numWeights, -1.0f, 1.0f );
+    WeightsPersister::copyArrayToNetWeights( weights, net );
+    WeightsPersister::persistWeights( filepath, "some config", net, 4, 9, 0.25f, 77, 3.5f );
+
+    long fileSize;
+    char *data = FileHelper::readBinary( filepath, &fileSize );
+    EXPECT_EQ( WeightsPersister::getPersistArraySize( net ), fileSize );
+    int *dataAsInts = reinterpret_cast<int *>( data );
+    EXPECT_EQ( 3, dataAsInts[1] );
+    EXPECT_EQ( 2, dataAsInts[224] );
+    for( int section = 0; section < 2; section++ ) {
+        int *tocEntry = reinterpret_cast<int *>( data + WeightsPersister::HeaderSize + section * WeightsPersister::TocEntrySize );
+        EXPECT_EQ( 0, tocEntry[2] % WeightsPersister::SectionAlignment );
+    }
+
+    NeuralNet *loaded = TestNet::makeNet( 2, 8, 5 );
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    EXPECT_TRUE( WeightsPersister::loadWeights( filepath, "some config", loaded, &epoch, &batch, &annealedLearningRate, &numRight, &loss ) );
+    EXPECT_EQ( 4, epoch );
+    EXPECT_EQ( 9, batch );
+    EXPECT_EQ( 77, numRight );
+    EXPECT_EQ( 0.25f, annealedLearningRate );
+    EXPECT_EQ( 3.5f, loss );
+    expectNetWeights( weights, loaded );
+
+    EXPECT_FALSE( WeightsPersister::loadWeights( filepath, "other config", loaded, &epoch, &batch, &annealedLearningRate, &numRight, &loss ) );
+
+    // flip one bit of the last layer's weights
+    int *lastEntry = reinterpret_cast<int *>( data + WeightsPersister::HeaderSize + WeightsPersister::TocEntrySize );
+    data[ lastEntry[2] + 5 ] ^= 1;
+    FileHelper::writeBinary( filepath, data, fileSize );
+    NeuralNet *untouched = TestNet::makeNet( 2, 8, 5 );
+    float *untouchedWeights = new float[numWeights];
+    WeightsPersister::copyNetWeightsToArray( untouched, untouchedWeights );
+    bool threw = false;
+    try {
+        WeightsPersister::loadWeights( filepath, "some config", untouched, &epoch, &batch, &annealedLearningRate, &numRight, &loss );
+    } catch( runtime_error &e ) {
+        threw = true;
+    }
+    EXPECT_TRUE( threw );
+    expectNetWeights( untouchedWeights, untouched );
+
+    // a table of contents pointing outside the file, with a good checksum, as
+    // if the file was truncated after being written
+    data[ lastEntry[2] + 5 ] ^= 1;
+    const int goodOffset = lastEntry[2];
+    const int badOffsets[] = { -WeightsPersister::SectionAlignment, (int)fileSize + WeightsPersister::SectionAlignment };
+    for( int i = 0; i < 2; i++ ) {
+        lastEntry[2] = badOffsets[i];
+        dataAsInts[227] = (int)WeightsPersister::crc32( data + WeightsPersister::HeaderSize, 2 * WeightsPersister::TocEntrySize );
+        FileHelper::writeBinary( filepath, data, fileSize );
+        EXPECT_THROW( WeightsPersister::loadWeights( filepath, "some config", untouched, &epoch, &batch, &annealedLearningRate, &numRight, &loss ), runtime_error );
+        expectNetWeights( untouchedWeights, untouched );
+    }
+    lastEntry[2] = goodOffset;
+
+    FileHelper::remove( filepath );
+    delete[] untouchedWeights;
+    delete[] data;
+    delete[] weights;
+    delete untouched;
+    delete loaded;
+    delete net;
+}
+
+// version 2 had the size of each section in floats, rather than bytes
+TEST( testWeightsPersister, version2StillLoads ) {
+    const string filepath = "testWeightsPersisterV2.dat";
+    NeuralNet *net = TestNet::makeNet( 2, 8, 5 );
+    const int numWeights = WeightsPersister::getTotalNumWeights( net );
+    float *weights = new float[numWeights];
+    WeightRandomizer::randomize( 7, weights, numWeights, -1.0f, 1.0f );
+    WeightsPersister::copyArrayToNetWeights( weights, net );
+    WeightsPersister::persistWeights( filepath, "some config", net, 3, 0, 0.5f, 21, 1.5f );
+
+    long fileSize;
+    char *data = FileHelper::readBinary( filepath, &fileSize );
+    int *dataAsInts = reinterpret_cast<int *>( data );
+    dataAsInts[1] = 2;
+    const int numSections = dataAsInts[224];
+    for( int section = 0; section < numSections; section++ ) {
+        int *tocEntry = reinterpret_cast<int *>( data + dataAsInts[225] + section * WeightsPersister::TocEntrySize );
+        tocEntry[1] /= sizeof(float);
+    }
+    dataAsInts[227] = (int)WeightsPersister::crc32( data + dataAsInts[225], numSections * WeightsPersister::TocEntrySize );
+    dataAsInts[226] = (int)WeightsPersister::crc32( data, 226 * 4 );
+    FileHelper::writeBinary( filepath, data, fileSize );
+
+    NeuralNet *loaded = TestNet::makeNet( 2, 8, 5 );
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    EXPECT_TRUE( WeightsPersister::loadWeights( filepath, "some config", loaded, &epoch, &batch, &annealedLearningRate, &numRight, &loss ) );
+    EXPECT_EQ( 3, epoch );
+    EXPECT_EQ( 21, numRight );
+    expectNetWeights( weights, loaded );
+
+    FileHelper::remove( filepath );
+    delete[] data;
+    delete[] weights;
+    delete loaded;
+    delete net;
+}
+
+TEST( testWeightsPersister, version1StillLoads ) {
+    const string filepath = "testWeightsPersisterV1.dat";
+    NeuralNet *net = TestNet::makeNet( 2, 8, 5 );
+    const int numWeights = WeightsPersister::getTotalNumWeights( net );
+    const int fileSize = 1024 + numWeights * sizeof(float);
+    char *data = new char[fileSize];
+    memset( data, 0, 1024 );
+    int *dataAsInts = reinterpret_cast<int *>( data );
+    float *dataAsFloats = reinterpret_cast<float *>( data );
+    strcpy_safe( data, "ClCn", 4 );
+    dataAsInts[1] = 1;
+    dataAsInts[2] = 6;
+    dataAsInts[3] = 0;
+    dataAsInts[4] = 12;
+    dataAsFloats[5] = 1.25f;
+    dataAsFloats[6] = 0.5f;
+    strcpy_safe( data + 7 * 4, "some config", 800 );
+    float *weights = reinterpret_cast<float *>( data + 1024 );
+    WeightRandomizer::randomize( 6, weights, numWeights, -1.0f, 1.0f );
+    FileHelper::writeBinary( filepath, data, fileSize );
+
+    int epoch, batch, numRight;
+    float annealedLearningRate, loss;
+    EXPECT_TRUE( WeightsPersister::loadWeights( filepath, "some config", net, &epoch, &batch, &annealedLearningRate, &numRight, &loss ) );
+    EXPECT_EQ( 6, epoch );
+    EXPECT_EQ( 12, numRight );
+    EXPECT_EQ( 1.25f, loss );
+    EXPECT_EQ( 0.5f, annealedLearningRate );
+    expectNetWeights( weights, net );
+
+    FileHelper::remove( filepath );
+    delete[] data;
+    delete net;
+}
+
+}
+
@@ -0,0 +1,95 @@
+// tests the ZeroCopy buffer strategy, which uses CL_MEM_USE_HOST_PTR and map/unmap
+// on devices with host-unified memory, and normal wrappers otherwise
+// either way, the results should be the same
+
+#include <iostream>
+
+#include "gtest/gtest.h"
+#include "test/gtest_supp.h"
+#include "OpenCLHelper.h"
+#include "ZeroCopy.h"
+
+using namespace std;
+
+TEST( testZeroCopy, memsetThenModify ) {
+    OpenCLHelper *cl = OpenCLHelper::createForFirstGpuOtherwiseCpu();
+    cout << "host unified memory: " << ZeroCopy::isHostUnifiedMemory( cl ) << endl;
+
+    CLKernel *kMemset = 0;
+    // [[[cog
+    // import stringify
+    // stringify.write_kernel2( "kMemset", "cl/memset.cl", "memset", '""' )
+    // ]]]
+    // generated using cog, from cl/memset.cl:
+    const char * kMemsetSource =  
+    "// Copyright Hugh Perkins 2015 hughperkins at gmail\n" 
+    "//\n" 
+    "// This Source Code Form is subject to the terms of the Mozilla Public License,\n" 
+    "// v. 2.0. If a copy of the MPL was not distributed with this file, You can\n" 
+    "// obtain one at http://mozilla.org/MPL/2.0/.\n" 
+    "\n" 
+    "kernel void memset( global float *target, const float value, const int N ) {\n" 
+    "    #define globalId get_global_id(0)\n" 
+    "    if( globalId < N ) {\n" 
+    "        target[globalId] = value;\n" 
+    "    }\n" 
+    "}\n" 
+    "\n" 
+    "";
+    kMemset = cl->buildKernelFromString( kMemsetSource, "memset", "", "cl/memset.cl" );
+    // [[[end]]]
+
+    int N = 10000;
+    float *myArray = ZeroCopy::allocateFloats( N );
+    for( int i = 0; i < N; i++ ) {
+        myArray[i] = 3.0f;
+    }
+    CLWrapper *myArrayWrapper = ZeroCopy::wrap( cl, N, myArray );
+    ZeroCopy::copyToDevice( myArrayWrapper );
+    kMemset->out( myArrayWrapper )->in( 99.0f )->in( N - 10 );
+    int workgroupSize = 64;
+    kMemset->run_1d( ( N + workgroupSize - 1 ) / workgroupSize * workgroupSize, workgroupSize );
+    cl->finish();
+    ZeroCopy::copyToHost( myArrayWrapper );
+    for( int i = 0; i < N - 10; i++ ) {
+        EXPECT_EQ( 99.0f, myArray[i] );
+    }
+    for( int i = N - 10; i < N; i++ ) {
+        EXPECT_EQ( 3.0f, myArray[i] );
+    }
+
+    // change on host, push to device, and read back again
+    myArray[N - 1] = 7.0f;
+    ZeroCopy::copyToDevice( myArrayWrapper );
+    ZeroCopy::copyToHost( myArrayWrapper );
+    EXPECT_EQ( 7.0f, myArray[N - 1] );
+    EXPECT_EQ( 99.0f, myArray[0] );
+
+    delete myArrayWrapper;
+    ZeroCopy::deallocate( myArray );
+    delete kMemset;
+    delete cl;
+}
+
+
+TEST( testZeroCopy, unalignedGetsPlainWrapper ) {
+    OpenCLHelper *cl = OpenCLHelper::createForFirstGpuOtherwiseCpu();
+    int N = 1000;
+    float *aligned = ZeroCopy::allocateFloats( N + 1 );
+    float *unaligned = aligned + 1;
+    EXPECT_FALSE( ZeroCopy::canWrapInPlace( cl, unaligned ) );
+    EXPECT_EQ( ZeroCopy::isHostUnifiedMemory( cl ), ZeroCopy::canWrapInPlace( cl, aligned ) );
+    for( int i = 0; i < N; i++ ) {
+        unaligned[i] = (float)i;
+    }
+    CLWrapper *wrapper = ZeroCopy::wrap( cl, N, unaligned );
+    EXPECT_TRUE( dynamic_cast< ZeroCopyWrapperBase * >( wrapper ) == 0 );
+    ZeroCopy::createOnDevice( wrapper );
+    ZeroCopy::copyToDevice( wrapper );
+    unaligned[5] = 0.0f;
+    ZeroCopy::copyToHost( wrapper );
+    EXPECT_EQ( 5.0f, unaligned[5] );
+    delete wrapper;
+    ZeroCopy::deallocate( aligned );
+    delete cl;
+}
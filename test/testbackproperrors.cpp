@@ -321,6 +321,19 @@ TEST( SLOW_testbackproperrors, compare_kgsgo_32c5mini2 ) {
 
 }
 
+TEST( testbackproperrors, compare_fcgemm ) {
+    int batchSize = 5;
+    LayerDimensions dim;
+    dim.setInputPlanes( 10 ).setInputImageSize(7).setNumFilters( 37 ).setFilterSize( 7 )
+        .setPadZeros( false ).setBiased( true );
+    ActivationFunction *fn = new TanhActivation();
+
+    compareSpecific( 1, 3, batchSize, dim, fn );
+    compareSpecific( 0, 3, batchSize, dim, fn );
+
+    delete fn;
+}
+
 /*
 float *test( int imageSize ) {
     const int batchSize = 128;
@@ -757,6 +757,16 @@ TEST( SLOW_testbackpropweights, compare_args ) {
     compareSpecific( debug, learningRate, its, batchSize, dim, instance0, instance1 );        
 }
 
+TEST( testbackpropweights, compare_fcgemm ) {
+    LayerDimensions dim;
+    dim.setInputImageSize( 7 ).setInputPlanes( 10 ).setNumFilters( 37 ).setFilterSize( 7 )
+        .setBiased( 1 ).setPadZeros( 0 );
+    int batchSize = 5;
+    float learningRate = 1.0f;
+    compareSpecific( false, learningRate, 1, batchSize, dim, 1, 4 );
+    compareSpecific( false, learningRate, 1, batchSize, dim, 0, 4 );
+}
+
 //    TEST( testbackpropweights, compare_instance3_smaller2 ) {
 //        LayerDimensions dim;
 //        dim.setInputImageSize( 96 ).setInputPlanes( 1 ).setNumFilters( 1 ).setFilterSize( 6 )
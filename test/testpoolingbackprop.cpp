@@ -4,6 +4,8 @@
 // v. 2.0. If a copy of the MPL was not distributed with this file, You can 
 // obtain one at http://mozilla.org/MPL/2.0/.
 
+#include <cstring>
+
 #include "OpenCLHelper.h"
 
 #include "PoolingBackprop.h"
@@ -181,6 +183,67 @@ TEST( SLOW_testpoolingbackprop, compare_args ) {
     delete cl;
 }
 
+// cpu, naive and gather implementations against each other, with byte selectors,
+// and image sizes that dont divide by poolingSize.  errorsForUpstream starts off
+// as garbage, since the cpu and gather implementations dont zero it first
+void compareAllImplementations( bool padZeros, int batchSize, int numPlanes, int inputImageSize, int poolingSize ) {
+    OpenCLHelper *cl = OpenCLHelper::createForFirstGpuOtherwiseCpu();
+    PoolingPropagate *forwardprop = PoolingPropagate::instanceSpecific( 0, cl, padZeros, numPlanes, inputImageSize, poolingSize );
+    const int errorsSize = forwardprop->getResultsSize( batchSize );
+    const int inputSize = forwardprop->getInputSize( batchSize );
+    float *input = new float[ inputSize ];
+    float *output = new float[ errorsSize ];
+    float *errors = new float[ errorsSize ];
+    unsigned char *selectors = new unsigned char[ errorsSize ];
+    float *expected = new float[ inputSize ];
+    float *errorsForUpstream = new float[ inputSize ];
+    WeightRandomizer::randomize( 0, input, inputSize, -1.0f, 1.0f );
+    WeightRandomizer::randomize( 1, errors, errorsSize, -1.0f, 1.0f );
+    forwardprop->propagate( batchSize, input, selectors, output );
+
+    for( int instance = 0; instance <= 2; instance++ ) {
+        PoolingBackprop *backprop = PoolingBackprop::instanceSpecific( instance, cl, padZeros, numPlanes, inputImageSize, poolingSize );
+        for( int i = 0; i < inputSize; i++ ) {
+            errorsForUpstream[i] = 123.0f;
+        }
+        backprop->backpropErrors( batchSize, errors, selectors, errorsForUpstream );
+        if( instance == 0 ) {
+            memcpy( expected, errorsForUpstream, sizeof(float) * inputSize );
+            float sum = 0;
+            for( int i = 0; i < inputSize; i++ ) {
+                sum += expected[i];
+            }
+            float errorsSum = 0;
+            for( int i = 0; i < errorsSize; i++ ) {
+                errorsSum += errors[i];
+            }
+            EXPECT_NEAR( errorsSum, sum, 0.001f );
+        } else {
+            for( int i = 0; i < inputSize; i++ ) {
+                EXPECT_EQ( expected[i], errorsForUpstream[i] );
+            }
+        }
+        delete backprop;
+    }
+
+    delete[] errorsForUpstream;
+    delete[] expected;
+    delete[] selectors;
+    delete[] errors;
+    delete[] output;
+    delete[] input;
+    delete forwardprop;
+    delete cl;
+}
+
+TEST( testpoolingbackprop, compareall_padzeros ) {
+    compareAllImplementations( true, 3, 5, 11, 3 );
+}
+
+TEST( testpoolingbackprop, compareall_nopadzeros ) {
+    compareAllImplementations( false, 4, 3, 9, 2 );
+}
+
 /*
 TEST( testpoolingpropagate, basic_2plane_batchsize2 ) {
     int batchSize = 2;
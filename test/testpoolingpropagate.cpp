@@ -104,7 +104,7 @@ TEST( testpoolingpropagate, fromwrappers ) {
                      -1, -3.5f,37.4f,5
     };
     int outputSize = poolingPropagate->getResultsSize( batchSize );
-    int *selectors = new int[outputSize];
+    unsigned char *selectors = new unsigned char[outputSize];
     float *output = new float[outputSize];
 
     const int inputSize = batchSize * numPlanes * imageSize * imageSize;
@@ -217,7 +217,7 @@ void compareSpecific( CompareSpecificArgs args ) {
     int outputSize = poolingPropagate0->getResultsSize( batchSize );
 
     float *input = new float[ inputSize ];
-    int *selectors = new int[ outputSize ];
+    unsigned char *selectors = new unsigned char[ outputSize ];
     float *output = new float[ outputSize ];
 
     CLWrapper *inputWrapper = cl->wrap( inputSize, input );
@@ -226,7 +226,7 @@ void compareSpecific( CompareSpecificArgs args ) {
 
     WeightRandomizer::randomize( input, inputSize, -0.1f, 0.1f );
 
-    memset( selectors, 99, sizeof(int) * outputSize );
+    memset( selectors, 99, outputSize );
     memset( output, 99, sizeof(int) * outputSize );
 
     inputWrapper->copyToDevice();
@@ -237,12 +237,12 @@ void compareSpecific( CompareSpecificArgs args ) {
     selectorsWrapper->copyToHost();
     outputWrapper->copyToHost();
 
-    int *selectors0 = new int[ outputSize ];
+    unsigned char *selectors0 = new unsigned char[ outputSize ];
     float *output0 = new float[ outputSize ];
-    memcpy( selectors0, selectors, sizeof(int) * outputSize );
+    memcpy( selectors0, selectors, outputSize );
     memcpy( output0, output, sizeof(float) * outputSize );
     
-    memset( selectors, 99, sizeof(int) * outputSize );
+    memset( selectors, 99, outputSize );
     memset( output, 99, sizeof(int) * outputSize );
 
     inputWrapper->copyToDevice();
@@ -256,7 +256,7 @@ void compareSpecific( CompareSpecificArgs args ) {
     int numErrors = 0;
     for( int i = 0; i < outputSize; i++ ) {
         if( selectors[i] != selectors0[i] ) {
-            cout << "ERROR: selectors[" << i << "] instance0:" << selectors0[i] << " != instance1:" << selectors[i] << endl;
+            cout << "ERROR: selectors[" << i << "] instance0:" << (int)selectors0[i] << " != instance1:" << (int)selectors[i] << endl;
             numErrors++;
         }
         if( output[i] != output0[i] ) {
@@ -655,6 +655,33 @@ TEST( testpropagate, compare_1_4_fcscenario ) { // only need to do nopad, since
     compareSpecific( false, N, batchSize, dim, fn, 1, 4 );
 }
 
+TEST( testpropagate, compare_fcgemm ) { // sizes not multiples of the tile size, to check the edges
+    LayerDimensions dim;
+    int batchSize = 5;
+    int N = 5;
+    string activationName = "tanh";
+    dim.setInputPlanes( 10 ).setInputImageSize(7).setNumFilters( 37 )
+        .setFilterSize( 7 )
+        .setPadZeros( false ).setBiased( true );
+    ActivationFunction *fn = ActivationFunction::fromName( activationName );
+    compareSpecific( false, N, batchSize, dim, fn, 1, 8 );
+    compareSpecific( false, N, batchSize, dim, fn, 0, 8 );
+}
+
+TEST( testpropagate, compare_fcgemv ) { // input cube larger than one workgroup, then smaller
+    LayerDimensions dim;
+    int N = 5;
+    string activationName = "tanh";
+    dim.setInputPlanes( 10 ).setInputImageSize(7).setNumFilters( 37 )
+        .setFilterSize( 7 )
+        .setPadZeros( false ).setBiased( true );
+    ActivationFunction *fn = ActivationFunction::fromName( activationName );
+    compareSpecific( false, N, 1, dim, fn, 1, 9 );
+    compareSpecific( false, N, 5, dim, fn, 1, 9 );
+    dim.setInputPlanes( 3 ).setInputImageSize(3).setFilterSize( 3 ).setBiased( false );
+    compareSpecific( false, N, 1, dim, fn, 1, 9 );
+}
+
 //TEST( SLOW_testpropagate, comparespecific ) {
 //    LayerDimensions dim;
 //    dim.setInputPlanes( 2 ).setInputImageSize(5).setNumFilters( 1 ).setFilterSize( 5 )